@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+# Copyright (c) 2016 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Print the messages ribbitcoind publishes on an address given with
+# -pubhashblock, -pubhashtx, -pubrawblock or -pubrawtx, e.g.
+#
+#   ribbitcoind -pubhashblock=unix:/tmp/ribbit.sock -pubhashtx=unix:/tmp/ribbit.sock
+#   subscriber.py unix:/tmp/ribbit.sock
+#
+
+from __future__ import print_function
+import binascii
+import socket
+import struct
+import sys
+
+def connect(address):
+    if address.startswith("unix:"):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.connect(address[5:])
+    elif address.startswith("tcp://"):
+        host, port = address[6:].rsplit(":", 1)
+        sock = socket.create_connection((host.strip("[]"), int(port)))
+    else:
+        raise ValueError("expected unix:<path> or tcp://<host>:<port>, not " + address)
+    return sock
+
+def read_exactly(sock, n):
+    data = b""
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise EOFError("publisher closed the connection")
+        data += chunk
+    return data
+
+def read_compact_size(sock):
+    n = ord(read_exactly(sock, 1))
+    if n == 253:
+        return struct.unpack("<H", read_exactly(sock, 2))[0]
+    if n == 254:
+        return struct.unpack("<I", read_exactly(sock, 4))[0]
+    if n == 255:
+        return struct.unpack("<Q", read_exactly(sock, 8))[0]
+    return n
+
+def read_message(sock):
+    """Read the next message: (topic, body, sequence)"""
+    topic = read_exactly(sock, read_compact_size(sock)).decode("ascii")
+    body = read_exactly(sock, read_compact_size(sock))
+    sequence = struct.unpack("<I", read_exactly(sock, 4))[0]
+    return topic, body, sequence
+
+def main():
+    if len(sys.argv) != 2:
+        print("Usage: %s unix:<path> | tcp://<host>:<port>" % sys.argv[0], file=sys.stderr)
+        sys.exit(1)
+    sock = connect(sys.argv[1])
+    sequences = {}
+    try:
+        while True:
+            topic, body, sequence = read_message(sock)
+            expected = sequences.get(topic)
+            if expected is not None and sequence != expected:
+                print("(missed %d %s messages)" % (sequence - expected, topic))
+            sequences[topic] = sequence + 1
+            hexbody = binascii.hexlify(body).decode("ascii")
+            if len(hexbody) > 160:
+                hexbody = hexbody[:160] + "... (%d bytes)" % len(body)
+            print("%s %d %s" % (topic, sequence, hexbody))
+            sys.stdout.flush()
+    except (EOFError, KeyboardInterrupt):
+        pass
+
+if __name__ == "__main__":
+    main()
@@ -26,6 +26,11 @@ if [ "x${ENABLE_BITCOIND}${ENABLE_UTILS}${ENABLE_WALLET}" = "x111" ]; then
   ${BUILDDIR}/qa/rpc-tests/mempool_spendcoinbase.py --srcdir "${BUILDDIR}/src"
   ${BUILDDIR}/qa/rpc-tests/httpbasics.py --srcdir "${BUILDDIR}/src"
   ${BUILDDIR}/qa/rpc-tests/mempool_coinbase_spends.py --srcdir "${BUILDDIR}/src"
+  ${BUILDDIR}/qa/rpc-tests/pushnotify.py --srcdir "${BUILDDIR}/src"
+  ${BUILDDIR}/qa/rpc-tests/utxostats.py --srcdir "${BUILDDIR}/src"
+  ${BUILDDIR}/qa/rpc-tests/rpcbatch.py --srcdir "${BUILDDIR}/src"
+  ${BUILDDIR}/qa/rpc-tests/addressindex.py --srcdir "${BUILDDIR}/src"
+  ${BUILDDIR}/qa/rpc-tests/spentindex.py --srcdir "${BUILDDIR}/src"
   #${BUILDDIR}/qa/rpc-tests/forknotify.py --srcdir "${BUILDDIR}/src"
 else
   echo "No rpc tests to run. Wallet, utils, and bitcoind must all be enabled"
@@ -0,0 +1,136 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test the -addressindex calls getaddressbalance, getaddressutxos,
+# getaddresstxids and getaddressdeltas as an address is paid and spent from,
+# as its blocks are disconnected and connected again, and on a node that
+# indexes the chain it already had, across a restart while doing so
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import time
+
+def wait_for_index(node, address):
+    """Wait for the blocks connected before the index was turned on to be indexed"""
+    for i in range(600):
+        try:
+            return node.getaddresstxids(address)
+        except JSONRPCException as e:
+            assert(e.error['message'].startswith("Address index is still being built"))
+        time.sleep(0.1)
+    raise AssertionError("address index not built in time")
+
+class AddressIndexTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-addressindex"]))
+        self.nodes.append(start_node(1, self.options.tmpdir))
+        self.nodes.append(start_node(2, self.options.tmpdir))
+        connect_nodes(self.nodes[1], 0)
+        connect_nodes(self.nodes[2], 1)
+        self.is_network_split = False
+        self.sync_all()
+
+    def index_state(self, node, address):
+        return (node.getaddressbalance(address), node.getaddressutxos(address),
+                node.getaddresstxids(address), node.getaddressdeltas(address))
+
+    def run_test(self):
+        node = self.nodes[0]
+        address = self.nodes[1].getnewaddress()
+        other = node.getnewaddress()
+
+        # Node 0 was started on the cached chain, so it first indexes that
+        wait_for_index(node, address)
+        assert_equal(node.getaddressbalance(address)["received"], 0)
+        assert_equal(node.getaddressutxos(address), [])
+        assert_raises(JSONRPCException, self.nodes[1].getaddressbalance, address)
+
+        # Paid
+        txid_pay = node.sendtoaddress(address, 10)
+        self.sync_all()
+        node.setgenerate(True, 1)
+        self.sync_all()
+        height_pay = node.getblockcount()
+        balance = node.getaddressbalance(address)
+        assert_equal(balance["principal"], 10)
+        assert_equal(balance["received"], 10)
+        assert_equal(balance["balance"], balance["principal"] + balance["interest"])
+        utxos = node.getaddressutxos(address)
+        assert_equal(len(utxos), 1)
+        assert_equal(utxos[0]["address"], address)
+        assert_equal(utxos[0]["txid"], txid_pay)
+        assert_equal(utxos[0]["amount"], 10)
+        assert_equal(utxos[0]["height"], height_pay)
+        n_pay = utxos[0]["outputIndex"]
+        assert_equal(node.getaddresstxids(address), [txid_pay])
+        deltas = node.getaddressdeltas(address)
+        assert_equal([(d["txid"], d["amount"], d["height"], d["index"]) for d in deltas],
+                     [(txid_pay, 10, height_pay, n_pay)])
+        assert_equal(deltas[0]["blockindex"], 1)
+
+        # Some blocks on, the output has accrued interest
+        node.setgenerate(True, 5)
+        self.sync_all()
+        paid = self.index_state(node, address)
+        assert_equal(paid[0]["principal"], 10)
+        assert_equal(paid[0]["interest"], paid[1][0]["interest"])
+
+        # Spent
+        raw = self.nodes[1].createrawtransaction([{"txid": txid_pay, "vout": n_pay}], {other: 9.99})
+        txid_spend = self.nodes[1].sendrawtransaction(self.nodes[1].signrawtransaction(raw)["hex"])
+        self.sync_all()
+        node.setgenerate(True, 1)
+        self.sync_all()
+        height_spend = node.getblockcount()
+        spent = self.index_state(node, address)
+        assert_equal(spent[0]["principal"], 0)
+        assert_equal(spent[0]["interest"], 0)
+        assert_equal(spent[0]["received"], 10)
+        assert_equal(spent[1], [])
+        assert_equal(spent[2], [txid_pay, txid_spend])
+        assert_equal([(d["txid"], d["amount"], d["height"]) for d in spent[3]],
+                     [(txid_pay, 10, height_pay), (txid_spend, -10, height_spend)])
+        assert_equal(spent[3][1]["index"], 0)
+
+        # Heights select the entries of a range of blocks, both ends included
+        assert_equal(node.getaddresstxids({"addresses": [address], "start": height_pay, "end": height_pay}), [txid_pay])
+        assert_equal(node.getaddresstxids({"addresses": [address], "start": height_pay + 1, "end": height_spend}), [txid_spend])
+        assert_equal(node.getaddresstxids({"addresses": [address], "start": height_spend + 1, "end": height_spend + 10}), [])
+        assert_equal(node.getaddressdeltas({"addresses": [address, other], "start": height_spend, "end": height_spend})[0]["txid"], txid_spend)
+
+        # Disconnecting the block spending the output makes it unspent again,
+        # at the height it was paid at; connecting it again spends it again
+        tip = node.getbestblockhash()
+        node.invalidateblock(tip)
+        assert_equal(self.index_state(node, address), paid)
+        node.reconsiderblock(tip)
+        assert_equal(node.getbestblockhash(), tip)
+        assert_equal(self.index_state(node, address), spent)
+
+        # A node turning the index on indexes the chain it has, and carries
+        # on where it was after a restart, whether it was done or not
+        stop_node(self.nodes[2], 2)
+        self.nodes[2] = start_node(2, self.options.tmpdir, ["-addressindex"])
+        stop_node(self.nodes[2], 2)
+        self.nodes[2] = start_node(2, self.options.tmpdir, ["-addressindex"])
+        wait_for_index(self.nodes[2], address)
+        assert_equal(self.nodes[2].getbestblockhash(), tip)
+        assert_equal(self.index_state(self.nodes[2], address), spent)
+        assert_equal(self.index_state(self.nodes[2], other), self.index_state(node, other))
+
+        # And keeps it up to date from then on
+        connect_nodes(self.nodes[2], 1)
+        node.invalidateblock(tip)
+        node.setgenerate(True, 2)
+        self.sync_all()
+        assert_equal(self.nodes[2].getbestblockhash(), node.getbestblockhash())
+        assert_equal(self.index_state(self.nodes[2], address), self.index_state(node, address))
+
+if __name__ == '__main__':
+    AddressIndexTest().main()
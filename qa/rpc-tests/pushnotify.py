@@ -0,0 +1,113 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test the -pub* push notification publisher
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import binascii
+import os
+import socket
+import struct
+
+class PushSubscriber(object):
+    """Reads the messages published on one address"""
+
+    def __init__(self, address):
+        if address.startswith("unix:"):
+            self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self.sock.connect(address[5:])
+        else:
+            host, port = address[6:].rsplit(":", 1)
+            self.sock = socket.create_connection((host, int(port)))
+        self.sock.settimeout(60)
+
+    def read_exactly(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise AssertionError("publisher closed the connection")
+            data += chunk
+        return data
+
+    def read_compact_size(self):
+        n = ord(self.read_exactly(1))
+        if n == 253:
+            return struct.unpack("<H", self.read_exactly(2))[0]
+        if n == 254:
+            return struct.unpack("<I", self.read_exactly(4))[0]
+        if n == 255:
+            return struct.unpack("<Q", self.read_exactly(8))[0]
+        return n
+
+    def read_message(self):
+        topic = self.read_exactly(self.read_compact_size()).decode("ascii")
+        body = binascii.hexlify(self.read_exactly(self.read_compact_size())).decode("ascii")
+        sequence = struct.unpack("<I", self.read_exactly(4))[0]
+        return topic, body, sequence
+
+    def close(self):
+        self.sock.close()
+
+class PushNotifyTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        self.hash_address = "unix:" + os.path.join(self.options.tmpdir, "pubhash.sock")
+        self.raw_address = "tcp://127.0.0.1:%d" % (p2p_port(3))
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir, [
+            "-pubhashblock=" + self.hash_address, "-pubhashtx=" + self.hash_address,
+            "-pubrawblock=" + self.raw_address, "-pubrawtx=" + self.raw_address]))
+        self.nodes.append(start_node(1, self.options.tmpdir))
+        connect_nodes(self.nodes[1], 0)
+        self.is_network_split = False
+        self.sync_all()
+
+    def run_test(self):
+        hashes = PushSubscriber(self.hash_address)
+        raws = PushSubscriber(self.raw_address)
+
+        # A block: its transactions first, then the block
+        self.nodes[1].setgenerate(True, 1)
+        self.sync_all()
+        blockhash = self.nodes[0].getbestblockhash()
+        coinbase = self.nodes[0].getblock(blockhash)["tx"][0]
+        assert_equal(hashes.read_message(), ("hashtx", coinbase, 0))
+        assert_equal(hashes.read_message(), ("hashblock", blockhash, 0))
+        assert_equal(raws.read_message(), ("rawtx", self.nodes[0].getrawtransaction(coinbase), 0))
+        assert_equal(raws.read_message(), ("rawblock", self.nodes[0].getblock(blockhash, False), 0))
+
+        # A transaction accepted to the memory pool, then mined
+        txid = self.nodes[1].sendtoaddress(self.nodes[0].getnewaddress(), 1)
+        self.sync_all()
+        assert_equal(hashes.read_message(), ("hashtx", txid, 1))
+        assert_equal(raws.read_message(), ("rawtx", self.nodes[0].getrawtransaction(txid), 1))
+        self.nodes[1].setgenerate(True, 1)
+        self.sync_all()
+        blockhash = self.nodes[0].getbestblockhash()
+        txids = self.nodes[0].getblock(blockhash)["tx"]
+        assert(txid in txids)
+        for i, tx in enumerate(txids):
+            assert_equal(hashes.read_message(), ("hashtx", tx, 2 + i))
+        assert_equal(hashes.read_message(), ("hashblock", blockhash, 1))
+
+        # A subscriber that connects later only gets what is published since
+        hashes.close()
+        raws.close()
+        hashes = PushSubscriber(self.hash_address)
+        self.nodes[1].setgenerate(True, 1)
+        self.sync_all()
+        blockhash = self.nodes[0].getbestblockhash()
+        topic, body, sequence = hashes.read_message()
+        assert_equal(topic, "hashtx")
+        topic, body, sequence = hashes.read_message()
+        assert_equal((topic, body, sequence), ("hashblock", blockhash, 2))
+        hashes.close()
+
+if __name__ == '__main__':
+    PushNotifyTest().main()
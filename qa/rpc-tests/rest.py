@@ -82,6 +82,46 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(json_string)
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
+
+        # the binary block is the one getblock serializes
+        hex_string = http_get_call(url.hostname, url.port, '/rest/block/'+newblockhash[0]+self.FORMAT_SEPARATOR+'hex')
+        assert_equal(hex_string.strip(), self.nodes[0].getblock(newblockhash[0], False))
+
+        # headers, from the block index
+        json_string = http_get_call(url.hostname, url.port, '/rest/headers/5/'+bb_hash+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal(len(json_obj), 2) #bb_hash and the block mined above
+        assert_equal(json_obj[0]['hash'], bb_hash)
+        assert_equal(json_obj[1]['hash'], newblockhash[0])
+        response = http_get_call(url.hostname, url.port, '/rest/headers/1/'+bb_hash+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        assert_equal(int(response.getheader('content-length')), 80)
+        response = http_get_call(url.hostname, url.port, '/rest/headers/0/'+bb_hash+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 400)
+
+        # chain info and per algorithm difficulty
+        json_obj = json.loads(http_get_call(url.hostname, url.port, '/rest/chaininfo.json'))
+        assert_equal(json_obj['bestblockhash'], newblockhash[0])
+        json_obj = json.loads(http_get_call(url.hostname, url.port, '/rest/difficulty.json'))
+        assert_equal('sha256d' in json_obj, True)
+        assert_equal('scrypt' in json_obj, True)
+
+        # mempool: a new transaction shows up in info and contents
+        txid = self.nodes[0].sendtoaddress(self.nodes[2].getnewaddress(), 11)
+        json_obj = json.loads(http_get_call(url.hostname, url.port, '/rest/mempool/info.json'))
+        assert_equal(json_obj['size'], 1)
+        json_obj = json.loads(http_get_call(url.hostname, url.port, '/rest/mempool/contents.json'))
+        assert_equal(txid in json_obj, True)
+
+        # getutxos: the new transaction's outputs are only found with checkmempool
+        json_obj = json.loads(http_get_call(url.hostname, url.port, '/rest/getutxos/'+txid+'-0.json'))
+        assert_equal(json_obj['bitmap'], "0")
+        json_obj = json.loads(http_get_call(url.hostname, url.port, '/rest/getutxos/checkmempool/'+txid+'-0/'+txid+'-9.json'))
+        assert_equal(json_obj['bitmap'], "10")
+        assert_equal(len(json_obj['utxos']), 1)
+        assert_equal(json_obj['utxos'][0]['interest'], 0)
+        response = http_get_call(url.hostname, url.port, '/rest/getutxos/checkmempool'+('/'+txid+'-0')*16+'.json', True)
+        assert_equal(response.status, 400)
                 
         
 
@@ -0,0 +1,108 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test JSON-RPC batch requests: calls that change nothing run side by side,
+# while each call with side effects is seen by every call after it
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+def call(method, *params):
+    call.nId += 1
+    return {'version': '1.1', 'method': method, 'params': list(params), 'id': call.nId}
+call.nId = 0
+
+class RPCBatchTest(BitcoinTestFramework):
+
+    def batch(self, calls):
+        replies = self.nodes[0]._batch(calls)
+        assert_equal([reply['id'] for reply in replies], [c['id'] for c in calls])
+        return replies
+
+    def run_test(self):
+        node = self.nodes[0]
+        tip = node.getbestblockhash()
+        hashes = [node.getblockhash(height) for height in range(201)]
+
+        # A run of read-only calls comes back whole and in order
+        replies = self.batch([call('getblockhash', height) for height in range(201)])
+        assert_equal([reply['error'] for reply in replies], [None] * 201)
+        assert_equal([reply['result'] for reply in replies], hashes)
+
+        # Read-only calls around invalidateblock and reconsiderblock see the
+        # chain as each of those left it
+        replies = self.batch([
+            call('getblockhash', 200),
+            call('getblock', tip),
+            call('invalidateblock', tip),
+            call('getblockhash', 199),
+            call('getblockhash', 200),
+            call('getbestblockhash'),
+            call('reconsiderblock', tip),
+            call('getblockhash', 200),
+            call('getblock', tip),
+            call('getbestblockhash'),
+        ])
+        assert_equal(replies[0]['result'], tip)
+        assert_equal(replies[1]['result']['confirmations'], 1)
+        assert_equal(replies[2]['error'], None)
+        assert_equal(replies[3]['result'], hashes[199])
+        assert_equal(replies[4]['error']['code'], -8)
+        assert_equal(replies[5]['result'], hashes[199])
+        assert_equal(replies[6]['error'], None)
+        assert_equal(replies[7]['result'], tip)
+        assert_equal(replies[8]['result']['confirmations'], 1)
+        assert_equal(replies[9]['result'], tip)
+        assert_equal(node.getbestblockhash(), tip)
+
+        # A mempool transaction, prioritised in the middle of a batch
+        txid = self.nodes[1].sendtoaddress(node.getnewaddress(), 1)
+        sync_mempools(self.nodes)
+        fee = node.getrawmempool(True)[txid]['fee']
+        replies = self.batch([
+            call('getrawmempool', True),
+            call('prioritisetransaction', txid, 0, 100000),
+            call('getblocktemplate'),
+            call('getrawmempool', True),
+            call('getrawtransaction', txid),
+        ])
+        assert_equal(replies[0]['result'][txid]['fee'], fee)
+        assert_equal(replies[1]['result'], True)
+        template = [tx for tx in replies[2]['result']['transactions'] if tx['hash'] == txid]
+        assert_equal(len(template), 1)
+        assert_equal(replies[3]['result'][txid]['fee'], fee)
+        assert_equal(replies[4]['error'], None)
+
+        # Added nodes show up to the calls after addnode, and are gone for
+        # those after it is removed
+        replies = self.batch([
+            call('getaddednodeinfo', False),
+            call('addnode', '127.0.0.1:1', 'add'),
+            call('getaddednodeinfo', False),
+            call('addnode', '127.0.0.1:1', 'remove'),
+            call('getaddednodeinfo', False),
+        ])
+        assert_equal(replies[0]['result'], [])
+        assert_equal([info['addednode'] for info in replies[2]['result']], ['127.0.0.1:1'])
+        assert_equal(replies[4]['result'], [])
+
+        # stop runs once the calls before it are done
+        replies = self.batch([
+            call('getblockhash', 0),
+            call('getblockhash', 1),
+            call('stop'),
+        ])
+        assert_equal(replies[0]['result'], hashes[0])
+        assert_equal(replies[1]['result'], hashes[1])
+        assert_equal(replies[2]['error'], None)
+        bitcoind_processes[0].wait()
+        del bitcoind_processes[0]
+        self.nodes[0] = start_node(0, self.options.tmpdir)
+        assert_equal(self.nodes[0].getbestblockhash(), tip)
+
+if __name__ == '__main__':
+    RPCBatchTest().main()
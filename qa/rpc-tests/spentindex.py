@@ -0,0 +1,110 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test getspentinfo (-spentindex) and getblockhashes (-timestampindex) as
+# outputs are spent and the blocks spending them are disconnected and
+# connected again
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+class SpentIndexTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        # The indexes are built from the cached chain by reindexing it; the
+        # address index gives the interest of the outputs not yet spent
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir,
+                                     ["-spentindex", "-timestampindex", "-addressindex", "-reindex"]))
+        self.nodes.append(start_node(1, self.options.tmpdir))
+        connect_nodes(self.nodes[1], 0)
+        self.is_network_split = False
+        self.sync_all()
+
+    def run_test(self):
+        node = self.nodes[0]
+        assert_equal(node.getblockcount(), 200)
+
+        # Blocks from low up to, not including, high, in timestamp order;
+        # those of the cached chain are ten minutes apart
+        hashes = [node.getblockhash(height) for height in range(201)]
+        times = [node.getblock(h)["time"] for h in hashes]
+        assert_equal(node.getblockhashes(times[150], times[140]), hashes[140:150])
+        assert_equal(node.getblockhashes(times[150] + 1, times[140]), hashes[140:151])
+        assert_equal(node.getblockhashes(times[150], times[150] - 1), [])
+        assert_equal(node.getblockhashes(times[150], times[150]), [])
+        assert_raises(JSONRPCException, node.getblockhashes, times[140], times[150])
+        assert_raises(JSONRPCException, self.nodes[1].getblockhashes, times[150], times[140])
+
+        # Two outputs of the same amount, paid in the same block
+        address1 = self.nodes[1].getnewaddress()
+        address2 = self.nodes[1].getnewaddress()
+        txid_pay = node.sendmany("", {address1: 10, address2: 10})
+        self.sync_all()
+        node.setgenerate(True, 1)
+        self.sync_all()
+        utxos = node.getaddressutxos({"addresses": [address1, address2]})
+        n1 = [u["outputIndex"] for u in utxos if u["address"] == address1][0]
+        n2 = [u["outputIndex"] for u in utxos if u["address"] == address2][0]
+        assert_raises(JSONRPCException, node.getspentinfo, {"txid": txid_pay, "index": n1})
+        assert_raises(JSONRPCException, self.nodes[1].getspentinfo, {"txid": txid_pay, "index": n1})
+
+        # The first spent some blocks later, in the second input of a spend
+        node.setgenerate(True, 10)
+        self.sync_all()
+        other = node.getnewaddress()
+        unspent = [u for u in self.nodes[1].listunspent() if u["txid"] != txid_pay][0]
+        raw = self.nodes[1].createrawtransaction([{"txid": unspent["txid"], "vout": unspent["vout"]},
+                                                  {"txid": txid_pay, "vout": n1}],
+                                                 {other: unspent["amount"] + Decimal("9.99")})
+        txid_spend = self.nodes[1].sendrawtransaction(self.nodes[1].signrawtransaction(raw)["hex"])
+        self.sync_all()
+        node.setgenerate(True, 1)
+        self.sync_all()
+        tip = node.getbestblockhash()
+        height_spend = node.getblockcount()
+        info = node.getspentinfo({"txid": txid_pay, "index": n1})
+        assert_equal(info["txid"], txid_spend)
+        assert_equal(info["index"], 1)
+        assert_equal(info["height"], height_spend)
+        assert_equal(info["value"], 10)
+        assert_equal(info["address"], address1)
+
+        # Its interest is the interest the other output, paid with it and
+        # still unspent, has accrued by the same block
+        interest = [u["interest"] for u in node.getaddressutxos(address2)]
+        assert_greater_than(info["interest"], 0)
+        assert_equal([info["interest"]], interest)
+
+        # The spending block is found by its timestamp
+        tip_time = node.getblock(tip)["time"]
+        assert(tip in node.getblockhashes(tip_time + 1, tip_time))
+
+        # Disconnecting the block forgets the spend and its timestamp;
+        # connecting it again brings both back
+        node.invalidateblock(tip)
+        assert_raises(JSONRPCException, node.getspentinfo, {"txid": txid_pay, "index": n1})
+        assert(tip not in node.getblockhashes(tip_time + 1, tip_time))
+        node.reconsiderblock(tip)
+        assert_equal(node.getbestblockhash(), tip)
+        assert_equal(node.getspentinfo({"txid": txid_pay, "index": n1}), info)
+        assert(tip in node.getblockhashes(tip_time + 1, tip_time))
+
+        # The other output, spent in a later block, accrued more
+        raw = self.nodes[1].createrawtransaction([{"txid": txid_pay, "vout": n2}], {other: 9.99})
+        txid_spend2 = self.nodes[1].sendrawtransaction(self.nodes[1].signrawtransaction(raw)["hex"])
+        self.sync_all()
+        node.setgenerate(True, 1)
+        self.sync_all()
+        info2 = node.getspentinfo({"txid": txid_pay, "index": n2})
+        assert_equal(info2["txid"], txid_spend2)
+        assert_equal(info2["index"], 0)
+        assert_equal(info2["height"], height_spend + 1)
+        assert_greater_than(info2["interest"], info["interest"])
+
+if __name__ == '__main__':
+    SpentIndexTest().main()
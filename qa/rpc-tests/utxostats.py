@@ -0,0 +1,59 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test that the UTXO set statistics gettxoutsetinfo keeps up to date block
+# by block match those counted from scratch, across a reorganization too
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+class UTXOStatsTest(BitcoinTestFramework):
+
+    def run_test(self):
+        # The first call counts the statistics on node 0; from here on it
+        # keeps them up to date as blocks come in
+        stats = self.nodes[0].gettxoutsetinfo()
+        assert_equal(stats["height"], 200)
+        assert_equal(stats["bestblock"], self.nodes[0].getbestblockhash())
+        assert_greater_than(stats["total_interest"], 0)
+
+        # Blocks spending coins, some outputs of a transaction and all of another
+        for i in range(3):
+            self.nodes[1].sendtoaddress(self.nodes[2].getnewaddress(), 10)
+            self.nodes[1].sendtoaddress(self.nodes[3].getnewaddress(), 5)
+            self.sync_all()
+            self.nodes[1].setgenerate(True, 1)
+            self.sync_all()
+        txid = self.nodes[2].sendtoaddress(self.nodes[3].getnewaddress(), 15)
+        self.sync_all()
+        self.nodes[2].setgenerate(True, 1)
+        self.sync_all()
+        before = self.nodes[0].gettxoutsetinfo()
+        assert_equal(before["height"], 204)
+
+        # Node 1 has never counted them, so it does so now, from scratch; the
+        # set hash comes out the same as the one node 0 kept block by block
+        assert_equal(self.nodes[1].gettxoutsetinfo(), before)
+        assert("bytes_serialized" not in before)
+
+        # Disconnecting a block goes back to the statistics kept for its parent
+        self.nodes[0].setgenerate(True, 1)
+        after = self.nodes[0].gettxoutsetinfo()
+        assert(after["hash_serialized"] != before["hash_serialized"])
+        self.nodes[0].invalidateblock(after["bestblock"])
+        assert_equal(self.nodes[0].gettxoutsetinfo(), before)
+        self.nodes[0].reconsiderblock(after["bestblock"])
+        assert_equal(self.nodes[0].gettxoutsetinfo(), after)
+
+        # The memory pool dump does not depend on how the call is served
+        self.nodes[0].sendtoaddress(self.nodes[1].getnewaddress(), 1)
+        pool = self.nodes[0].getrawmempool(True)
+        assert_equal(len(pool), 1)
+        assert_equal(self.nodes[0].getrawmempool(), pool.keys())
+
+if __name__ == '__main__':
+    UTXOStatsTest().main()
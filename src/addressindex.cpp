@@ -0,0 +1,184 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+
+#include "coins.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "pubkey.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/thread.hpp>
+
+using namespace std;
+
+/** Seconds between progress messages while indexing the old blocks */
+static const int64_t BACKFILL_LOG_INTERVAL = 30;
+
+bool GetAddressIndexDestination(const CScript& script, unsigned char& type, uint160& hashBytes)
+{
+    CTxDestination dest;
+    if (!ExtractDestination(script, dest))
+        return false;
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        type = ADDRESSINDEX_PUBKEYHASH;
+        hashBytes = *keyID;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        type = ADDRESSINDEX_SCRIPTHASH;
+        hashBytes = *scriptID;
+        return true;
+    }
+    return false;
+}
+
+void GetAddressIndexChanges(const CBlock& block, const CBlockUndo& blockUndo, int nHeight, const CCoinsViewCache* pviewPrev,
+                            vector<CAddressIndexEntry>& vDeltas,
+                            vector<CAddressUnspentEntry>& vCreated,
+                            vector<CAddressUnspentEntry>& vSpent)
+{
+    unsigned char type;
+    uint160 hashBytes;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (i > 0) {
+            const CTxUndo& txundo = blockUndo.vtxundo[i - 1];
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const CTxOut& txoutPrev = txundo.vprevout[j].txout;
+                if (!GetAddressIndexDestination(txoutPrev.scriptPubKey, type, hashBytes))
+                    continue;
+                vDeltas.push_back(make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, txhash, j, true), -txoutPrev.nValue));
+                int nHeightPrev = 0;
+                if (pviewPrev) {
+                    const CCoins* coins = pviewPrev->AccessCoins(prevout.hash);
+                    if (coins)
+                        nHeightPrev = coins->nHeight;
+                }
+                vSpent.push_back(make_pair(CAddressUnspentKey(type, hashBytes, prevout.hash, prevout.n),
+                                           CAddressUnspentValue(txoutPrev.nValue, txoutPrev.scriptPubKey, nHeightPrev)));
+            }
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+            const CTxOut& txout = tx.vout[k];
+            if (!GetAddressIndexDestination(txout.scriptPubKey, type, hashBytes))
+                continue;
+            vDeltas.push_back(make_pair(CAddressIndexKey(type, hashBytes, nHeight, i, txhash, k, false), txout.nValue));
+            vCreated.push_back(make_pair(CAddressUnspentKey(type, hashBytes, txhash, k),
+                                         CAddressUnspentValue(txout.nValue, txout.scriptPubKey, nHeight)));
+        }
+    }
+}
+
+bool IsAddressIndexBackfilling(int* pnHeight, int* pnEndHeight)
+{
+    int nHeight, nEndHeight;
+    if (!pblocktree->ReadAddressIndexBackfill(nHeight, nEndHeight))
+        return false;
+    if (pnHeight)
+        *pnHeight = nHeight;
+    if (pnEndHeight)
+        *pnEndHeight = nEndHeight;
+    return true;
+}
+
+bool StartAddressIndexBackfill()
+{
+    LOCK(cs_main);
+    // Blocks connected from now on are indexed by ConnectBlock()
+    int nEndHeight = chainActive.Height() + 1;
+    if (nEndHeight > 0 && !pblocktree->WriteAddressIndexBackfill(vector<CAddressIndexEntry>(), vector<CAddressUnspentEntry>(), 0, nEndHeight))
+        return error("%s : failed to write address index state", __func__);
+    if (!pblocktree->WriteFlag("addressindex", true))
+        return error("%s : failed to write address index flag", __func__);
+    fAddressIndex = true;
+    LogPrintf("Address index turned on; indexing the %d blocks already connected in the background\n", nEndHeight);
+    return true;
+}
+
+/**
+ * Index the next block below the height at which the index was turned on.
+ * The amounts paid and spent are written as they are; of the outputs the
+ * block creates, only those still unspent are, as the blocks that spent the
+ * others may already have been connected. Both are checked and written
+ * under cs_main, so that ConnectBlock() and DisconnectBlock() do not slip
+ * in between. Returns false when there is nothing left to do, or indexing
+ * failed.
+ */
+static bool BackfillNextBlock()
+{
+    int nHeight, nEndHeight;
+    const CBlockIndex* pindex;
+    CDiskBlockPos posUndo;
+    {
+        LOCK(cs_main);
+        if (!IsAddressIndexBackfilling(&nHeight, &nEndHeight))
+            return false;
+        pindex = chainActive[nHeight];
+        if (pindex == NULL || nHeight >= nEndHeight) {
+            // The chain was reorganized below where live indexing started:
+            // the blocks connected since were indexed by ConnectBlock()
+            pblocktree->WriteAddressIndexBackfill(vector<CAddressIndexEntry>(), vector<CAddressUnspentEntry>(), nEndHeight, nEndHeight);
+            return false;
+        }
+        if (pindex->pprev)
+            posUndo = pindex->GetUndoPos();
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s : failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+    CBlockUndo blockUndo;
+    if (pindex->pprev && !blockUndo.ReadFromDisk(posUndo, pindex->pprev->GetBlockHash()))
+        return error("%s : failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    vector<CAddressIndexEntry> vDeltas;
+    vector<CAddressUnspentEntry> vCreated, vSpent;
+    // The genesis block's outputs were never connected
+    if (pindex->pprev)
+        GetAddressIndexChanges(block, blockUndo, nHeight, NULL, vDeltas, vCreated, vSpent);
+
+    LOCK(cs_main);
+    if (chainActive[nHeight] != pindex)
+        return true; // try again at this height, on the new chain
+    vector<CAddressUnspentEntry> vUnspent;
+    BOOST_FOREACH(const CAddressUnspentEntry& entry, vCreated) {
+        const CCoins* coins = pcoinsTip->AccessCoins(entry.first.txhash);
+        if (coins && coins->IsAvailable(entry.first.index))
+            vUnspent.push_back(entry);
+    }
+    if (!pblocktree->WriteAddressIndexBackfill(vDeltas, vUnspent, nHeight + 1, nEndHeight))
+        return error("%s : failed to write address index of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    static int64_t nLastLogTime = 0;
+    if (nHeight + 1 == nEndHeight) {
+        LogPrintf("Address index is complete\n");
+    } else if (GetTime() - nLastLogTime >= BACKFILL_LOG_INTERVAL) {
+        LogPrintf("Building address index at height %d of %d\n", nHeight, nEndHeight);
+        nLastLogTime = GetTime();
+    }
+    return true;
+}
+
+void ThreadAddressIndexBackfill()
+{
+    RenameThread("bitcoin-addrindex");
+    while (true) {
+        boost::this_thread::interruption_point();
+        if (!BackfillNextBlock()) {
+            if (!IsAddressIndexBackfilling())
+                break;
+            MilliSleep(1000); // after a failure
+        }
+    }
+}
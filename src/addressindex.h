@@ -0,0 +1,182 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "crypto/common.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+class CCoinsViewCache;
+class CScript;
+
+/** -addressindex default */
+static const bool DEFAULT_ADDRESSINDEX = false;
+
+/** The kinds of address indexed; 0 is never used */
+enum AddressIndexType {
+    ADDRESSINDEX_PUBKEYHASH = 1, //!< Pay to pubkey hash, and pay to pubkey under its key's hash
+    ADDRESSINDEX_SCRIPTHASH = 2,
+};
+
+/** Heights are stored big endian, so that an address's entries sort by height */
+template<typename Stream>
+void WriteBE32Field(Stream& s, uint32_t n)
+{
+    unsigned char buf[4];
+    WriteBE32(buf, n);
+    s.write((char*)buf, 4);
+}
+
+template<typename Stream>
+uint32_t ReadBE32Field(Stream& s)
+{
+    unsigned char buf[4];
+    s.read((char*)buf, 4);
+    return ReadBE32(buf);
+}
+
+/**
+ * An amount paid to an address (spending = false, positive) or spent from
+ * it (spending = true, negative), keyed so that the entries of an address
+ * are found in height order.
+ */
+struct CAddressIndexKey
+{
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex; //!< Position of the transaction in its block
+    uint256 txhash;
+    unsigned int index;   //!< Output paid to, or input spending
+    bool spending;
+
+    CAddressIndexKey() : type(0), blockHeight(0), txindex(0), index(0), spending(false) {}
+    CAddressIndexKey(unsigned char typeIn, const uint160& hashBytesIn, int blockHeightIn, unsigned int txindexIn,
+                     const uint256& txhashIn, unsigned int indexIn, bool spendingIn) :
+        type(typeIn), hashBytes(hashBytesIn), blockHeight(blockHeightIn), txindex(txindexIn),
+        txhash(txhashIn), index(indexIn), spending(spendingIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 1 + 20 + 4 + 4 + 32 + 4 + 1;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        s << type << hashBytes;
+        WriteBE32Field(s, blockHeight);
+        WriteBE32Field(s, txindex);
+        s << txhash << index << spending;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        s >> type >> hashBytes;
+        blockHeight = ReadBE32Field(s);
+        txindex = ReadBE32Field(s);
+        s >> txhash >> index >> spending;
+    }
+};
+
+/** Where the entries of an address start, optionally from a height on */
+struct CAddressIndexIteratorKey
+{
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight; //!< -1 to not include one
+
+    CAddressIndexIteratorKey(unsigned char typeIn, const uint160& hashBytesIn, int blockHeightIn = -1) :
+        type(typeIn), hashBytes(hashBytesIn), blockHeight(blockHeightIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 1 + 20 + (blockHeight >= 0 ? 4 : 0);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        s << type << hashBytes;
+        if (blockHeight >= 0)
+            WriteBE32Field(s, blockHeight);
+    }
+};
+
+/** An unspent output paying to an address */
+struct CAddressUnspentKey
+{
+    unsigned char type;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int index;
+
+    CAddressUnspentKey() : type(0), index(0) {}
+    CAddressUnspentKey(unsigned char typeIn, const uint160& hashBytesIn, const uint256& txhashIn, unsigned int indexIn) :
+        type(typeIn), hashBytes(hashBytesIn), txhash(txhashIn), index(indexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(type);
+        READWRITE(hashBytes);
+        READWRITE(txhash);
+        READWRITE(index);
+    }
+};
+
+struct CAddressUnspentValue
+{
+    CAmount satoshis;
+    CScript script;
+    int blockHeight;
+
+    CAddressUnspentValue() : satoshis(-1), blockHeight(0) {}
+    CAddressUnspentValue(CAmount satoshisIn, const CScript& scriptIn, int blockHeightIn) :
+        satoshis(satoshisIn), script(scriptIn), blockHeight(blockHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(satoshis);
+        READWRITE(script);
+        READWRITE(blockHeight);
+    }
+};
+
+typedef std::pair<CAddressIndexKey, CAmount> CAddressIndexEntry;
+typedef std::pair<CAddressUnspentKey, CAddressUnspentValue> CAddressUnspentEntry;
+
+/** The indexed address a script pays to, if it pays to one. */
+bool GetAddressIndexDestination(const CScript& script, unsigned char& type, uint160& hashBytes);
+
+/**
+ * The address index changes of connecting a block at nHeight, of which
+ * blockUndo holds the outputs spent: the amounts paid and spent, the
+ * outputs it creates and the ones it spends. If pviewPrev is given, the
+ * heights of the spent outputs are looked up in it, so that vSpent can be
+ * written back on disconnecting the block; otherwise they are left at 0.
+ */
+void GetAddressIndexChanges(const CBlock& block, const CBlockUndo& blockUndo, int nHeight, const CCoinsViewCache* pviewPrev,
+                            std::vector<CAddressIndexEntry>& vDeltas,
+                            std::vector<CAddressUnspentEntry>& vCreated,
+                            std::vector<CAddressUnspentEntry>& vSpent);
+
+/** Whether blocks connected before -addressindex was turned on are still being indexed. */
+bool IsAddressIndexBackfilling(int* pnHeight = NULL, int* pnEndHeight = NULL);
+
+/** Turn the address index on for a block chain already connected; its blocks are indexed by ThreadAddressIndexBackfill(). */
+bool StartAddressIndexBackfill();
+
+/** Index the blocks connected before the address index was turned on, if any are left. */
+void ThreadAddressIndexBackfill();
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -0,0 +1,79 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include <iostream>
+#include <sys/time.h>
+
+using namespace benchmark;
+
+static double gettimedouble(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_usec * 0.000001 + tv.tv_sec;
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::benchmarks()
+{
+    static BenchmarkMap benchmarks_map;
+    return benchmarks_map;
+}
+
+BenchRunner::BenchRunner(const std::string& name, BenchFunction func)
+{
+    benchmarks().insert(std::make_pair(name, func));
+}
+
+void BenchRunner::RunAll(double elapsedTimeForOne)
+{
+    std::cout << "#Benchmark" << "," << "count" << "," << "min" << "," << "max" << "," << "average" << "\n";
+
+    for (BenchmarkMap::iterator it = benchmarks().begin(); it != benchmarks().end(); ++it) {
+        State state(it->first, elapsedTimeForOne);
+        BenchFunction& func = it->second;
+        func(state);
+    }
+}
+
+bool State::KeepRunning()
+{
+    double now;
+    if (count == 0) {
+        beginTime = now = gettimedouble();
+    } else {
+        // timing code is only run when (count & countMask) == 0, so that
+        // very fast loops are not dominated by calls to gettimeofday
+        if ((count & countMask) == 0) {
+            now = gettimedouble();
+            double elapsed = now - lastTime;
+            double elapsedOne = elapsed / (countMask + 1);
+            if (elapsedOne < minTime) minTime = elapsedOne;
+            if (elapsedOne > maxTime) maxTime = elapsedOne;
+            if (elapsed * 128 < maxElapsed) {
+                // Increase the mask so that the loop runs longer between
+                // timer calls.
+                countMask = countMask << 1 | 1;
+                // Avoid overflow
+                countMask &= (1LL << 60) - 1;
+            }
+        } else {
+            ++count;
+            return true;
+        }
+    }
+    lastTime = now;
+    ++count;
+
+    if (now - beginTime < maxElapsed) return true; // Keep going
+
+    --count;
+
+    // Output results
+    double average = (now - beginTime) / count;
+    std::cout << name << "," << count << "," << minTime << "," << maxTime << "," << average << "\n";
+
+    return false;
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_BENCH_H
+#define BITCOIN_BENCH_BENCH_H
+
+#include <limits>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+#include <boost/function.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+/**
+ * Microbenchmarks.
+ *
+ * Usage:
+ *
+ * static void CODE_TO_TIME(benchmark::State& state)
+ * {
+ *     ... do any setup needed...
+ *     while (state.KeepRunning()) {
+ *        ... do stuff you want to time...
+ *     }
+ *     ... do any cleanup needed...
+ * }
+ *
+ * BENCHMARK(CODE_TO_TIME);
+ *
+ * The body of the loop is run repeatedly for about a second, and the
+ * minimum, maximum and average time per iteration are reported.
+ */
+namespace benchmark {
+
+class State
+{
+    std::string name;
+    double maxElapsed;
+    double beginTime;
+    double lastTime, minTime, maxTime;
+    uint64_t count;
+    uint64_t countMask;
+
+public:
+    State(const std::string& _name, double _maxElapsed) : name(_name), maxElapsed(_maxElapsed), count(0)
+    {
+        minTime = std::numeric_limits<double>::max();
+        maxTime = std::numeric_limits<double>::min();
+        countMask = 1;
+    }
+    bool KeepRunning();
+};
+
+typedef boost::function<void(State&)> BenchFunction;
+
+class BenchRunner
+{
+    // maps from "name" -> function
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& benchmarks();
+
+public:
+    BenchRunner(const std::string& name, BenchFunction func);
+
+    static void RunAll(double elapsedTimeForOne = 1.0);
+};
+
+} // namespace benchmark
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // BITCOIN_BENCH_BENCH_H
@@ -0,0 +1,260 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/**
+ * Relay performance of this node, measured on an in-process network (see
+ * netsim.h): transaction relay throughput, block propagation with and
+ * without compact blocks, and the CPU time spent per message type.
+ *
+ * Options: -peers=<n> -latency=<ms> -bandwidth=<bytes/s> -txs=<n>
+ */
+
+#include "netsim.h"
+
+#include "amount.h"
+#include "chainparams.h"
+#include "main.h"
+#include "miner.h"
+#include "pow.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "txmempool.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+/** Fee paid by every transaction, enough for any relay fee policy */
+static const CAmount SIM_TX_FEE = COIN / 1000;
+/** Outputs of each fan-out transaction that funds the relayed ones */
+static const unsigned int FANOUT_OUTPUTS = 100;
+/** Give up on a scenario after this much virtual time */
+static const int64_t SCENARIO_TIMEOUT = 600 * 1000 * 1000;
+
+static CScript ScriptTrue()
+{
+    return CScript() << OP_TRUE;
+}
+
+/** A block on the tip with the mempool's transactions, not yet submitted. */
+static CBlock MineBlock()
+{
+    CBlockTemplate* pblocktemplate = CreateNewBlock(ScriptTrue(), ALGO_SHA256D);
+    assert(pblocktemplate);
+    CBlock block = pblocktemplate->block;
+    delete pblocktemplate;
+    unsigned int nExtraNonce = 0;
+    {
+        LOCK(cs_main);
+        IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+    }
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, block.GetAlgo()))
+        ++block.nNonce;
+    return block;
+}
+
+static void SubmitBlock(CBlock& block)
+{
+    CValidationState state;
+    bool fAccepted = ProcessNewBlock(state, NULL, &block);
+    assert(fAccepted && state.IsValid());
+}
+
+static void AddToMempool(const CTransaction& tx)
+{
+    CValidationState state;
+    bool fAccepted = AcceptToMemoryPool(mempool, state, tx, false, NULL);
+    assert(fAccepted);
+}
+
+/** Spend each of vOutPoints (worth nValue each, paying to OP_TRUE) into a transaction of nOutputs outputs. */
+static vector<CTransaction> Spend(const vector<COutPoint>& vOutPoints, CAmount nValue, unsigned int nOutputs)
+{
+    vector<CTransaction> vtx;
+    BOOST_FOREACH(const COutPoint& outpoint, vOutPoints) {
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(outpoint));
+        for (unsigned int i = 0; i < nOutputs; i++)
+            tx.vout.push_back(CTxOut((nValue - SIM_TX_FEE) / nOutputs, ScriptTrue()));
+        vtx.push_back(tx);
+    }
+    return vtx;
+}
+
+static double Seconds(int64_t nMicros)
+{
+    return nMicros / 1000000.0;
+}
+
+static void PrintOptions(const CNetSimulator::Options& options)
+{
+    printf("# %u peers, %.0f ms latency, %llu bytes/s links%s\n", options.nPeers, options.nLatency / 1000.0,
+           (unsigned long long)options.nBandwidth, options.fCompactBlocks ? ", compact blocks" : "");
+}
+
+static void MergeStats(map<string, CNetSimulator::ProcessStats>& mapTotal, const CNetSimulator& sim)
+{
+    const map<string, CNetSimulator::ProcessStats>& mapStats = sim.GetProcessStats();
+    for (map<string, CNetSimulator::ProcessStats>::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it) {
+        mapTotal[it->first].nCount += it->second.nCount;
+        mapTotal[it->first].nMicros += it->second.nMicros;
+    }
+}
+
+/** Peer 0 sends the node vtx; the other peers fetch them as the node announces them. */
+static void RunTxRelay(CNetSimulator& sim, const vector<CTransaction>& vtx)
+{
+    int64_t nStart = sim.Now();
+    BOOST_FOREACH(const CTransaction& tx, vtx)
+        sim.SendFromPeer(0, MakeSerializedNetMsg("tx", tx));
+
+    vector<int64_t> vLatency;
+    while (sim.Now() - nStart < SCENARIO_TIMEOUT) {
+        sim.RunUntil(sim.Now() + 1000 * 1000);
+        vLatency.clear();
+        BOOST_FOREACH(const CTransaction& tx, vtx) {
+            for (unsigned int i = 1; i < sim.PeerCount(); i++) {
+                int64_t nArrival = sim.GetTxArrival(i, tx.GetHash());
+                if (nArrival >= 0)
+                    vLatency.push_back(nArrival - nStart);
+            }
+        }
+        if (vLatency.size() == vtx.size() * (sim.PeerCount() - 1))
+            break;
+    }
+    sort(vLatency.begin(), vLatency.end());
+    if (vLatency.empty()) {
+        printf("tx relay: nothing relayed\n");
+        return;
+    }
+    int64_t nLast = vLatency.back();
+    printf("tx relay: %u transactions to %u peers, %u deliveries in %.2f s: %.1f tx/s, latency median %.2f s, max %.2f s\n",
+           (unsigned int)vtx.size(), sim.PeerCount() - 1, (unsigned int)vLatency.size(), Seconds(nLast),
+           vLatency.size() / Seconds(max(nLast, (int64_t)1)), Seconds(vLatency[vLatency.size() / 2]), Seconds(nLast));
+}
+
+/** Peer 0 sends the node a new block; report when the other peers have it. */
+static void RunBlockPropagation(CNetSimulator& sim, const CBlock& block, const char* pszMode)
+{
+    int64_t nStart = sim.Now();
+    CSerializedNetMsg msg = MakeSerializedNetMsg("block", block);
+    sim.SendFromPeer(0, msg);
+
+    vector<int64_t> vArrival;
+    while (sim.Now() - nStart < SCENARIO_TIMEOUT) {
+        sim.RunUntil(sim.Now() + 100 * 1000);
+        vArrival.clear();
+        for (unsigned int i = 1; i < sim.PeerCount(); i++) {
+            int64_t nArrival = sim.GetBlockArrival(i, block.GetHash());
+            if (nArrival >= 0)
+                vArrival.push_back(nArrival - nStart);
+        }
+        if (vArrival.size() == sim.PeerCount() - 1)
+            break;
+    }
+    sort(vArrival.begin(), vArrival.end());
+    if (vArrival.empty()) {
+        printf("block propagation (%s): not relayed\n", pszMode);
+        return;
+    }
+    printf("block propagation (%s): %u txs, %u bytes to %u of %u peers: first %.3f s, median %.3f s, last %.3f s\n",
+           pszMode, (unsigned int)block.vtx.size(), (unsigned int)(msg->size() - CMessageHeader::HEADER_SIZE),
+           (unsigned int)vArrival.size(), sim.PeerCount() - 1,
+           Seconds(vArrival.front()), Seconds(vArrival[vArrival.size() / 2]), Seconds(vArrival.back()));
+}
+
+int main(int argc, char** argv)
+{
+    SetupEnvironment();
+    ParseParameters(argc, argv);
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::REGTEST);
+
+    CNetSimulator::Options options;
+    options.nPeers = max((int64_t)2, GetArg("-peers", options.nPeers));
+    options.nLatency = GetArg("-latency", options.nLatency / 1000) * 1000;
+    options.nBandwidth = max((int64_t)1, GetArg("-bandwidth", options.nBandwidth));
+    unsigned int nTxs = max((int64_t)FANOUT_OUTPUTS, GetArg("-txs", 1000));
+    unsigned int nFanouts = (nTxs + FANOUT_OUTPUTS - 1) / FANOUT_OUTPUTS;
+
+    boost::filesystem::path pathTemp = GetTempPath() / strprintf("bench_netsim_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    CCoinsViewDB* pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    InitBlockIndex();
+    RegisterNodeSignals(GetNodeSignals());
+
+    // A chain with a mature coinbase: only the first block has a subsidy.
+    // It is split up to fund two batches of transactions.
+    CTransaction txCoinbase;
+    for (int i = 0; i <= COINBASE_MATURITY; i++) {
+        CBlock block = MineBlock();
+        SubmitBlock(block);
+        if (i == 0)
+            txCoinbase = block.vtx[0];
+    }
+    CTransaction txSplit = Spend(vector<COutPoint>(1, COutPoint(txCoinbase.GetHash(), 0)), txCoinbase.vout[0].nValue, 2 * nFanouts)[0];
+    AddToMempool(txSplit);
+    vector<CTransaction> vBatch[2];
+    for (unsigned int nBatch = 0; nBatch < 2; nBatch++) {
+        for (unsigned int i = 0; i < nFanouts; i++) {
+            unsigned int n = nBatch * nFanouts + i;
+            CTransaction txFanout = Spend(vector<COutPoint>(1, COutPoint(txSplit.GetHash(), n)), txSplit.vout[n].nValue, FANOUT_OUTPUTS)[0];
+            AddToMempool(txFanout);
+            for (unsigned int j = 0; j < txFanout.vout.size() && vBatch[nBatch].size() < nTxs; j++)
+                vBatch[nBatch].push_back(Spend(vector<COutPoint>(1, COutPoint(txFanout.GetHash(), j)), txFanout.vout[j].nValue, 1)[0]);
+        }
+    }
+    CBlock blockFanout = MineBlock();
+    SubmitBlock(blockFanout);
+
+    map<string, CNetSimulator::ProcessStats> mapStats;
+    {
+        // Relay the first batch, then a block of it, announced by inv
+        CNetSimulator sim(options);
+        PrintOptions(options);
+        sim.Connect();
+        RunTxRelay(sim, vBatch[0]);
+        CBlock block = MineBlock();
+        RunBlockPropagation(sim, block, "inv/getdata");
+        MergeStats(mapStats, sim);
+    }
+    {
+        // A block of the second batch, to peers that asked for compact blocks
+        BOOST_FOREACH(const CTransaction& tx, vBatch[1])
+            AddToMempool(tx);
+        options.fCompactBlocks = true;
+        CNetSimulator sim(options);
+        PrintOptions(options);
+        sim.Connect();
+        CBlock block = MineBlock();
+        RunBlockPropagation(sim, block, "compact");
+        MergeStats(mapStats, sim);
+    }
+
+    printf("#Command,count,total ms,us per message\n");
+    for (map<string, CNetSimulator::ProcessStats>::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it) {
+        printf("%s,%llu,%.3f,%.1f\n", it->first.c_str(), (unsigned long long)it->second.nCount, it->second.nMicros / 1000.0,
+               it->second.nCount ? (double)it->second.nMicros / it->second.nCount : 0.0);
+    }
+
+    UnregisterNodeSignals(GetNodeSignals());
+    delete pcoinsTip;
+    delete pcoinsdbview;
+    delete pblocktree;
+    boost::filesystem::remove_all(pathTemp);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "bloom.h"
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "script/script.h"
+
+#include <vector>
+
+// A wallet's worth of keys, and a block's worth of pay-to-pubkey-hash
+// transactions that do not involve any of them, as when building a
+// merkleblock for an SPV client.
+static const unsigned int FILTER_KEYS = 100;
+static const unsigned int BLOCK_TXS = 1000;
+
+static std::vector<unsigned char> RandomBytes(unsigned int nSize)
+{
+    uint256 hash = GetRandHash();
+    std::vector<unsigned char> vch;
+    while (vch.size() < nSize) {
+        vch.insert(vch.end(), hash.begin(), hash.end());
+        hash = Hash(hash.begin(), hash.end());
+    }
+    vch.resize(nSize);
+    return vch;
+}
+
+static CBloomFilter BuildFilter()
+{
+    CBloomFilter filter(FILTER_KEYS, 0.0001, 0, BLOOM_UPDATE_NONE);
+    for (unsigned int i = 0; i < FILTER_KEYS; i++) {
+        filter.insert(RandomBytes(33));
+        filter.insert(RandomBytes(20));
+    }
+    return filter;
+}
+
+static std::vector<CTransaction> BuildTransactions()
+{
+    std::vector<CTransaction> vtx;
+    for (unsigned int i = 0; i < BLOCK_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        tx.vin[0].scriptSig << RandomBytes(72) << RandomBytes(33);
+        tx.vout.resize(2);
+        for (unsigned int j = 0; j < tx.vout.size(); j++)
+            tx.vout[j].scriptPubKey << OP_DUP << OP_HASH160 << RandomBytes(20) << OP_EQUALVERIFY << OP_CHECKSIG;
+        vtx.push_back(tx);
+    }
+    return vtx;
+}
+
+static void BloomFilterMatchBlock(benchmark::State& state)
+{
+    CBloomFilter filter = BuildFilter();
+    std::vector<CTransaction> vtx = BuildTransactions();
+
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < vtx.size(); i++)
+            filter.IsRelevantAndUpdate(vtx[i]);
+    }
+}
+
+static void BloomFilterContainsMany(benchmark::State& state)
+{
+    CBloomFilter filter = BuildFilter();
+    std::vector<std::vector<unsigned char> > vKeys;
+    for (unsigned int i = 0; i < BLOCK_TXS; i++)
+        vKeys.push_back(RandomBytes(33));
+    std::vector<bool> vFound;
+
+    while (state.KeepRunning())
+        filter.containsMany(vKeys, vFound);
+}
+
+// All the probes of one key, one MurmurHash3 per seed...
+static void MurmurHash3PerSeed(benchmark::State& state)
+{
+    std::vector<unsigned char> vKey = RandomBytes(33);
+    uint32_t nHashes[MAX_HASH_FUNCS];
+
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < MAX_HASH_FUNCS; i++)
+            nHashes[i] = MurmurHash3(i * 0xFBA4C795, vKey);
+        vKey[0] = nHashes[0];
+    }
+}
+
+// ...and with the data mixed once and the seeds run side by side.
+static void MurmurHash3MultiSeed(benchmark::State& state)
+{
+    std::vector<unsigned char> vKey = RandomBytes(33);
+    uint32_t nSeeds[MAX_HASH_FUNCS], nHashes[MAX_HASH_FUNCS];
+    for (unsigned int i = 0; i < MAX_HASH_FUNCS; i++)
+        nSeeds[i] = i * 0xFBA4C795;
+    CMurmurHash3Multi hasher;
+
+    while (state.KeepRunning()) {
+        hasher.Set(vKey);
+        hasher.Hash(nSeeds, nHashes, MAX_HASH_FUNCS);
+        vKey[0] = nHashes[0];
+    }
+}
+
+BENCHMARK(BloomFilterMatchBlock);
+BENCHMARK(BloomFilterContainsMany);
+BENCHMARK(MurmurHash3PerSeed);
+BENCHMARK(MurmurHash3MultiSeed);
@@ -0,0 +1,282 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "netsim.h"
+
+#include "blockencodings.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "primitives/transaction.h"
+#include "protocol.h"
+#include "random.h"
+#include "streams.h"
+#include "timedata.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <deque>
+#include <limits>
+#include <set>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+/** How often the node's send side runs, as the message handler thread would */
+static const int64_t TICK_INTERVAL = 100 * 1000;
+/** How long Connect() waits for the handshakes */
+static const int64_t CONNECT_TIMEOUT = 10 * 1000 * 1000;
+
+struct CNetSimulator::Peer
+{
+    CNode* pnode;       //!< The node's side of the connection
+    Pipe pipeToNode;
+    Pipe pipeFromNode;
+    int64_t nNextInvSend; //!< Virtual time of the node's next trickle to this peer
+    bool fConnected;      //!< The peer has seen the node's verack
+    set<uint256> setRequested;
+    map<uint256, int64_t> mapBlockArrival;
+    map<uint256, int64_t> mapTxArrival;
+
+    Peer() : pnode(NULL), nNextInvSend(0), fConnected(false) {}
+};
+
+static string GetMessageCommand(const CSerializedNetMsg& msg)
+{
+    const char* pszCommand = &(*msg)[MESSAGE_START_SIZE];
+    return string(pszCommand, strnlen(pszCommand, CMessageHeader::COMMAND_SIZE));
+}
+
+CNetSimulator::CNetSimulator(const Options& optionsIn) : options(optionsIn), nNow(0), nNodeBusyUntil(0)
+{
+    for (unsigned int i = 0; i < options.nPeers; i++) {
+        Peer* peer = new Peer();
+        CAddress addr(CService(strprintf("10.0.%d.%d", i / 250, i % 250 + 1), Params().GetDefaultPort()));
+        peer->pnode = new CNode(INVALID_SOCKET, addr, "", true);
+        peer->nNextInvSend = PoissonNextSend(0, INVENTORY_BROADCAST_INTERVAL);
+        vPeers.push_back(peer);
+        LOCK(cs_vNodes);
+        peer->pnode->AddRef();
+        vNodes.push_back(peer->pnode);
+    }
+    Schedule(0, TICK, 0, CSerializedNetMsg());
+}
+
+CNetSimulator::~CNetSimulator()
+{
+    BOOST_FOREACH(Peer* peer, vPeers) {
+        {
+            LOCK(cs_vNodes);
+            vNodes.erase(remove(vNodes.begin(), vNodes.end(), peer->pnode), vNodes.end());
+            peer->pnode->Release();
+        }
+        delete peer->pnode;
+        delete peer;
+    }
+}
+
+void CNetSimulator::Connect()
+{
+    for (unsigned int i = 0; i < vPeers.size(); i++) {
+        // The version message predates addresses with a time
+        CDataStream ssVersion(SER_NETWORK, INIT_PROTO_VERSION);
+        uint64_t nNonce;
+        GetRandBytes((unsigned char*)&nNonce, sizeof(nNonce));
+        int nBestHeight;
+        {
+            LOCK(cs_main);
+            nBestHeight = chainActive.Height();
+        }
+        ssVersion << PROTOCOL_VERSION << (uint64_t)NODE_NETWORK << GetAdjustedTime()
+                  << CAddress(CService("127.0.0.1", Params().GetDefaultPort())) << vPeers[i]->pnode->addr
+                  << nNonce << FormatSubVersion("netsim", CLIENT_VERSION, vector<string>()) << nBestHeight << true;
+        SendFromPeer(i, MakeSerializedNetMsg("version", ssVersion));
+    }
+
+    int64_t nDeadline = nNow + CONNECT_TIMEOUT;
+    while (nNow < nDeadline) {
+        bool fAll = true;
+        BOOST_FOREACH(const Peer* peer, vPeers)
+            fAll = fAll && peer->fConnected && peer->pnode->fSuccessfullyConnected;
+        if (fAll)
+            return;
+        RunUntil(nNow + TICK_INTERVAL);
+    }
+    assert(!"CNetSimulator: handshakes did not complete");
+}
+
+void CNetSimulator::SendFromPeer(unsigned int nPeer, const CSerializedNetMsg& msg)
+{
+    Transmit(vPeers[nPeer]->pipeToNode, nNow, DELIVER_TO_NODE, nPeer, msg);
+}
+
+void CNetSimulator::RunUntil(int64_t nTime)
+{
+    while (!mapEvents.empty() && mapEvents.begin()->first <= nTime) {
+        std::multimap<int64_t, Event>::iterator it = mapEvents.begin();
+        nNow = max(nNow, it->first);
+        Event event = it->second;
+        mapEvents.erase(it);
+
+        switch (event.type) {
+        case DELIVER_TO_NODE:
+            DeliverToNode(event.nPeer, event.msg);
+            break;
+        case DELIVER_TO_PEER:
+            DeliverToPeer(event.nPeer, event.msg);
+            break;
+        case TICK:
+            RunSendMessages();
+            Schedule(nNow + TICK_INTERVAL, TICK, 0, CSerializedNetMsg());
+            break;
+        }
+    }
+    nNow = max(nNow, nTime);
+}
+
+int64_t CNetSimulator::GetBlockArrival(unsigned int nPeer, const uint256& hash) const
+{
+    map<uint256, int64_t>::const_iterator it = vPeers[nPeer]->mapBlockArrival.find(hash);
+    return it == vPeers[nPeer]->mapBlockArrival.end() ? -1 : it->second;
+}
+
+int64_t CNetSimulator::GetTxArrival(unsigned int nPeer, const uint256& hash) const
+{
+    map<uint256, int64_t>::const_iterator it = vPeers[nPeer]->mapTxArrival.find(hash);
+    return it == vPeers[nPeer]->mapTxArrival.end() ? -1 : it->second;
+}
+
+void CNetSimulator::Schedule(int64_t nTime, EventType type, unsigned int nPeer, const CSerializedNetMsg& msg)
+{
+    Event event;
+    event.type = type;
+    event.nPeer = nPeer;
+    event.msg = msg;
+    mapEvents.insert(make_pair(nTime, event));
+}
+
+void CNetSimulator::Transmit(Pipe& pipe, int64_t nReady, EventType type, unsigned int nPeer, const CSerializedNetMsg& msg)
+{
+    // Messages go out one after another, each taking its size over the bandwidth
+    int64_t nStart = max(nReady, pipe.nBusyUntil);
+    pipe.nBusyUntil = nStart + (int64_t)(msg->size() * 1000000 / options.nBandwidth);
+    Schedule(pipe.nBusyUntil + options.nLatency, type, nPeer, msg);
+}
+
+void CNetSimulator::DeliverToNode(unsigned int nPeer, const CSerializedNetMsg& msg)
+{
+    CNode* pnode = vPeers[nPeer]->pnode;
+    ProcessStats& stats = mapProcessStats[GetMessageCommand(msg)];
+    stats.nCount++;
+
+    // The node only starts on this once it is done with what came before
+    nNodeBusyUntil = max(nNow, nNodeBusyUntil);
+    bool fFirst = true;
+    while (true) {
+        int64_t nStart = GetTimeMicros();
+        {
+            LOCK2(pnode->cs_msgHandler, pnode->cs_vRecvMsg);
+            if (fFirst)
+                pnode->ReceiveMsgBytes(&(*msg)[0], msg->size());
+            if (!GetNodeSignals().ProcessMessages(pnode))
+                pnode->fDisconnect = true;
+        }
+        int64_t nElapsed = GetTimeMicros() - nStart;
+        stats.nMicros += nElapsed;
+        nNodeBusyUntil += nElapsed;
+        fFirst = false;
+
+        // Hand what it queued to the links before it goes on, as a full
+        // send buffer makes it leave getdata requests for later
+        deque<CSerializedNetMsg> vMsg;
+        pnode->TakeSendQueue(vMsg);
+        BOOST_FOREACH(const CSerializedNetMsg& msgOut, vMsg)
+            Transmit(vPeers[nPeer]->pipeFromNode, nNodeBusyUntil, DELIVER_TO_PEER, nPeer, msgOut);
+
+        LOCK(pnode->cs_vRecvMsg);
+        if (pnode->vRecvGetData.empty() || pnode->fDisconnect)
+            break;
+    }
+    assert(!pnode->fDisconnect);
+
+    RunSendMessages();
+}
+
+void CNetSimulator::RunSendMessages()
+{
+    nNodeBusyUntil = max(nNow, nNodeBusyUntil);
+    int64_t nStart = GetTimeMicros();
+    for (unsigned int i = 0; i < vPeers.size(); i++) {
+        Peer& peer = *vPeers[i];
+        // Run the trickle timer in virtual time
+        if (nNow >= peer.nNextInvSend) {
+            peer.pnode->nNextInvSend = 0;
+            peer.nNextInvSend = PoissonNextSend(nNow, INVENTORY_BROADCAST_INTERVAL);
+        } else {
+            peer.pnode->nNextInvSend = std::numeric_limits<int64_t>::max();
+        }
+        LOCK2(peer.pnode->cs_msgHandler, peer.pnode->cs_vSend);
+        GetNodeSignals().SendMessages(peer.pnode);
+    }
+    int64_t nElapsed = GetTimeMicros() - nStart;
+    ProcessStats& stats = mapProcessStats["(sendmessages)"];
+    stats.nCount++;
+    stats.nMicros += nElapsed;
+    nNodeBusyUntil += nElapsed;
+
+    for (unsigned int i = 0; i < vPeers.size(); i++) {
+        deque<CSerializedNetMsg> vMsg;
+        vPeers[i]->pnode->TakeSendQueue(vMsg);
+        BOOST_FOREACH(const CSerializedNetMsg& msg, vMsg)
+            Transmit(vPeers[i]->pipeFromNode, nNodeBusyUntil, DELIVER_TO_PEER, i, msg);
+    }
+}
+
+void CNetSimulator::DeliverToPeer(unsigned int nPeer, const CSerializedNetMsg& msg)
+{
+    Peer& peer = *vPeers[nPeer];
+    CDataStream ss(msg->begin(), msg->end(), SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader hdr;
+    ss >> hdr;
+    string strCommand = hdr.GetCommand();
+
+    if (strCommand == "version") {
+        SendFromPeer(nPeer, MakeSerializedNetMsg("verack", CDataStream(SER_NETWORK, PROTOCOL_VERSION)));
+    } else if (strCommand == "verack") {
+        peer.fConnected = true;
+        if (options.fCompactBlocks)
+            SendFromPeer(nPeer, MakeSerializedNetMsg("sendcmpct", make_pair(true, (uint64_t)1)));
+    } else if (strCommand == "ping") {
+        uint64_t nNonce;
+        ss >> nNonce;
+        SendFromPeer(nPeer, MakeSerializedNetMsg("pong", nNonce));
+    } else if (strCommand == "inv") {
+        vector<CInv> vInv, vGetData;
+        ss >> vInv;
+        BOOST_FOREACH(const CInv& inv, vInv) {
+            if ((inv.type == MSG_BLOCK || inv.type == MSG_TX) && peer.setRequested.insert(inv.hash).second)
+                vGetData.push_back(inv);
+        }
+        if (!vGetData.empty())
+            SendFromPeer(nPeer, MakeSerializedNetMsg("getdata", vGetData));
+    } else if (strCommand == "cmpctblock") {
+        // Taken as received: the peer is assumed to have all its transactions
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        ss >> cmpctblock;
+        peer.mapBlockArrival.insert(make_pair(cmpctblock.header.GetHash(), nNow));
+    } else if (strCommand == "block") {
+        CBlock block;
+        ss >> block;
+        peer.mapBlockArrival.insert(make_pair(block.GetHash(), nNow));
+    } else if (strCommand == "tx") {
+        CTransaction tx;
+        ss >> tx;
+        peer.mapTxArrival.insert(make_pair(tx.GetHash(), nNow));
+    }
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_NETSIM_H
+#define BITCOIN_BENCH_NETSIM_H
+
+#include "net.h"
+#include "uint256.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * An in-process network for measuring relay: the node under test, that is
+ * this process's block chain, mempool and message handlers, connected over
+ * memory pipes to a number of simulated peers.
+ *
+ * Each peer has a CNode on the node's side, without a socket; what the node
+ * queues on it is taken with CNode::TakeSendQueue() and carried over a link
+ * with the configured latency and bandwidth. The peers themselves are
+ * scripted: they complete the handshake, answer pings, fetch every block and
+ * transaction announced to them, and note when these arrive.
+ *
+ * Time is virtual, in microseconds since the simulator was created. The node
+ * handles one message at a time, and handling it advances the node's clock
+ * by the CPU time it really took, so that the results include both the link
+ * delays and the node's processing. The node's own timers still run on the
+ * real clock, except for the transaction trickle: each peer's Poisson timer
+ * is run here in virtual time.
+ */
+class CNetSimulator
+{
+public:
+    struct Options
+    {
+        unsigned int nPeers;
+        int64_t nLatency;    //!< One way, in microseconds
+        uint64_t nBandwidth; //!< Of each direction of each link, in bytes per second
+        bool fCompactBlocks; //!< Whether peers ask for new blocks as high-bandwidth compact blocks
+
+        Options() : nPeers(8), nLatency(50000), nBandwidth(1000000), fCompactBlocks(false) {}
+    };
+
+    /** CPU time the node spent on one kind of message */
+    struct ProcessStats
+    {
+        uint64_t nCount;
+        int64_t nMicros;
+
+        ProcessStats() : nCount(0), nMicros(0) {}
+    };
+
+    explicit CNetSimulator(const Options& optionsIn);
+    ~CNetSimulator();
+
+    /** Connect all peers, and run until their handshakes are done. */
+    void Connect();
+
+    /** Have a peer send a message to the node, now. */
+    void SendFromPeer(unsigned int nPeer, const CSerializedNetMsg& msg);
+
+    /** Process events until the virtual clock reaches nTime. */
+    void RunUntil(int64_t nTime);
+
+    int64_t Now() const { return nNow; }
+    unsigned int PeerCount() const { return vPeers.size(); }
+
+    /** When a peer received the block or transaction, or -1 if it has not. */
+    int64_t GetBlockArrival(unsigned int nPeer, const uint256& hash) const;
+    int64_t GetTxArrival(unsigned int nPeer, const uint256& hash) const;
+
+    /** Per message command, plus "(sendmessages)" for the send side. */
+    const std::map<std::string, ProcessStats>& GetProcessStats() const { return mapProcessStats; }
+
+private:
+    struct Peer;
+
+    enum EventType { DELIVER_TO_NODE, DELIVER_TO_PEER, TICK };
+
+    struct Event
+    {
+        EventType type;
+        unsigned int nPeer;
+        CSerializedNetMsg msg;
+    };
+
+    /** One direction of a link */
+    struct Pipe
+    {
+        int64_t nBusyUntil; //!< When the last message queued finishes going out
+
+        Pipe() : nBusyUntil(0) {}
+    };
+
+    Options options;
+    std::vector<Peer*> vPeers;
+    std::multimap<int64_t, Event> mapEvents; //!< Equal times stay in insertion order
+    int64_t nNow;
+    int64_t nNodeBusyUntil;
+    std::map<std::string, ProcessStats> mapProcessStats;
+
+    void Schedule(int64_t nTime, EventType type, unsigned int nPeer, const CSerializedNetMsg& msg);
+    void Transmit(Pipe& pipe, int64_t nReady, EventType type, unsigned int nPeer, const CSerializedNetMsg& msg);
+    void DeliverToNode(unsigned int nPeer, const CSerializedNetMsg& msg);
+    void DeliverToPeer(unsigned int nPeer, const CSerializedNetMsg& msg);
+    void RunSendMessages();
+
+    CNetSimulator(const CNetSimulator&);
+    void operator=(const CNetSimulator&);
+};
+
+#endif // BITCOIN_BENCH_NETSIM_H
@@ -0,0 +1,138 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "primitives/transaction.h"
+#include "pubkey.h"
+#include "script/interpreter.h"
+#include "script/script.h"
+#include "script/standard.h"
+
+#include <assert.h>
+#include <limits>
+
+// Accepts every signature, so that only the cost of running the script is measured.
+class AcceptAllChecker : public BaseSignatureChecker
+{
+public:
+    bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const
+    {
+        return true;
+    }
+};
+
+static CMutableTransaction BuildCreditingTransaction(const CScript& scriptPubKey)
+{
+    CMutableTransaction txCredit;
+    txCredit.nVersion = 1;
+    txCredit.nLockTime = 0;
+    txCredit.vin.resize(1);
+    txCredit.vout.resize(1);
+    txCredit.vin[0].prevout.SetNull();
+    txCredit.vin[0].scriptSig = CScript() << CScriptNum(0) << CScriptNum(0);
+    txCredit.vin[0].nSequence = std::numeric_limits<unsigned int>::max();
+    txCredit.vout[0].scriptPubKey = scriptPubKey;
+    txCredit.vout[0].nValue = 1;
+
+    return txCredit;
+}
+
+static CMutableTransaction BuildSpendingTransaction(const CScript& scriptSig, const CMutableTransaction& txCredit)
+{
+    CMutableTransaction txSpend;
+    txSpend.nVersion = 1;
+    txSpend.nLockTime = 0;
+    txSpend.vin.resize(1);
+    txSpend.vout.resize(1);
+    txSpend.vin[0].prevout.hash = txCredit.GetHash();
+    txSpend.vin[0].prevout.n = 0;
+    txSpend.vin[0].scriptSig = scriptSig;
+    txSpend.vin[0].nSequence = std::numeric_limits<unsigned int>::max();
+    txSpend.vout[0].scriptPubKey = CScript();
+    txSpend.vout[0].nValue = txCredit.vout[0].nValue;
+
+    return txSpend;
+}
+
+static const unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_MINIMALDATA | SCRIPT_VERIFY_NULLDUMMY;
+
+// Spend a pay-to-pubkey-hash output, optionally prefixed with an OP_NOP so
+// that the script no longer matches the template and the generic
+// interpreter runs it.
+static void VerifySpend(benchmark::State& state, bool fInterpreted, bool fCheckSignature)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    CScript scriptPubKey = GetScriptForDestination(pubkey.GetID());
+    if (fInterpreted)
+        scriptPubKey = (CScript() << OP_NOP) + scriptPubKey;
+
+    CMutableTransaction txCredit = BuildCreditingTransaction(scriptPubKey);
+    CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+    uint256 hash = SignatureHash(scriptPubKey, txSpend, 0, SIGHASH_ALL);
+    std::vector<unsigned char> vchSig;
+    key.Sign(hash, vchSig);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    txSpend.vin[0].scriptSig = CScript() << vchSig << ToByteVector(pubkey);
+
+    const CTransaction tx(txSpend);
+    SignatureChecker checker(tx, 0);
+    AcceptAllChecker acceptAll;
+    const BaseSignatureChecker& chosen = fCheckSignature ? (const BaseSignatureChecker&)checker : acceptAll;
+    while (state.KeepRunning()) {
+        ScriptError err;
+        bool fSuccess = VerifyScript(tx.vin[0].scriptSig, scriptPubKey, flags, chosen, &err);
+        assert(fSuccess && err == SCRIPT_ERR_OK);
+    }
+}
+
+// Standard pay-to-pubkey-hash, evaluated by the template fast path.
+static void VerifyScriptP2PKH(benchmark::State& state)
+{
+    VerifySpend(state, false, true);
+}
+
+// The same through the generic interpreter.
+static void VerifyScriptP2PKHInterpreted(benchmark::State& state)
+{
+    VerifySpend(state, true, true);
+}
+
+// Without the signature check, to compare the overhead around it.
+static void VerifyScriptP2PKHNoSig(benchmark::State& state)
+{
+    VerifySpend(state, false, false);
+}
+
+static void VerifyScriptP2PKHInterpretedNoSig(benchmark::State& state)
+{
+    VerifySpend(state, true, false);
+}
+
+// A non-standard script of stack and arithmetic operations, all of it
+// through the generic interpreter, without any signature.
+static void VerifyScriptStackOps(benchmark::State& state)
+{
+    CScript scriptPubKey;
+    for (int i = 0; i < 40; i++)
+        scriptPubKey << OP_DUP << OP_DROP << OP_1ADD;
+    scriptPubKey << OP_TOALTSTACK << OP_FROMALTSTACK << CScriptNum(41) << OP_EQUAL;
+    CScript scriptSig = CScript() << OP_1;
+
+    AcceptAllChecker acceptAll;
+    while (state.KeepRunning()) {
+        ScriptError err;
+        bool fSuccess = VerifyScript(scriptSig, scriptPubKey, flags, acceptAll, &err);
+        assert(fSuccess && err == SCRIPT_ERR_OK);
+    }
+}
+
+BENCHMARK(VerifyScriptP2PKH);
+BENCHMARK(VerifyScriptP2PKHInterpreted);
+BENCHMARK(VerifyScriptP2PKHNoSig);
+BENCHMARK(VerifyScriptP2PKHInterpretedNoSig);
+BENCHMARK(VerifyScriptStackOps);
@@ -0,0 +1,191 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "random.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "util.h"
+
+#include <map>
+
+using namespace std;
+
+#define MIN_TRANSACTION_SIZE (::GetSerializeSize(CTransaction(), SER_NETWORK, PROTOCOL_VERSION))
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block) :
+        nonce(GetRand(std::numeric_limits<uint64_t>::max())),
+        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block.GetBlockHeader())
+{
+    FillShortTxIDSelector();
+    // The coinbase is never in anyone's mempool, so always send it along
+    prefilledtxn[0].index = 0;
+    prefilledtxn[0].tx = block.vtx[0];
+    for (size_t i = 1; i < block.vtx.size(); i++)
+        shorttxids[i - 1] = GetShortID(block.vtx[i].GetHash());
+}
+
+void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << header << nonce;
+    unsigned char shorttxidhash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write((const unsigned char*)&stream[0], stream.size()).Finalize(shorttxidhash);
+    shorttxidk0 = ReadLE64(&shorttxidhash[0]);
+    shorttxidk1 = ReadLE64(&shorttxidhash[8]);
+}
+
+uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const
+{
+    return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
+}
+
+ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<CTransaction>& vExtraTxn)
+{
+    if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
+        return READ_STATUS_INVALID;
+    if (cmpctblock.shorttxids.size() + cmpctblock.prefilledtxn.size() > MAX_BLOCK_SIZE / MIN_TRANSACTION_SIZE)
+        return READ_STATUS_INVALID;
+
+    assert(header.IsNull() && txn_available.empty());
+    header = cmpctblock.header;
+    txn_available.resize(cmpctblock.BlockTxCount());
+    vAvailable.assign(cmpctblock.BlockTxCount(), false);
+
+    int32_t lastprefilledindex = -1;
+    for (size_t i = 0; i < cmpctblock.prefilledtxn.size(); i++) {
+        const PrefilledTransaction& prefilled = cmpctblock.prefilledtxn[i];
+        if (prefilled.tx.IsNull())
+            return READ_STATUS_INVALID;
+
+        // The differential encoding makes the indexes strictly increasing,
+        // so this only needs to catch ones that run past the end
+        lastprefilledindex = prefilled.index;
+        if ((uint32_t)lastprefilledindex > cmpctblock.shorttxids.size() + i)
+            return READ_STATUS_INVALID;
+        txn_available[lastprefilledindex] = prefilled.tx;
+        vAvailable[lastprefilledindex] = true;
+    }
+    prefilled_count = cmpctblock.prefilledtxn.size();
+
+    // Map each short ID to its index in the block. Collisions within the
+    // block itself can't be resolved without a round trip; report them so
+    // the caller falls back to the full block.
+    map<uint64_t, uint16_t> shorttxids;
+    uint16_t index_offset = 0;
+    for (size_t i = 0; i < cmpctblock.shorttxids.size(); i++) {
+        while (vAvailable[i + index_offset])
+            index_offset++;
+        if (!shorttxids.insert(make_pair(cmpctblock.shorttxids[i], i + index_offset)).second)
+            return READ_STATUS_FAILED;
+    }
+
+    // A mempool transaction matching a short ID is used; one that matches a
+    // short ID already matched by another transaction makes the slot
+    // ambiguous, so it is left for the getblocktxn round trip.
+    vector<bool> vHaveMatch(txn_available.size(), false);
+    size_t nMatched = 0;
+    {
+        LOCK(pool->cs);
+        for (map<uint256, CTxMemPoolEntry>::const_iterator it = pool->mapTx.begin(); it != pool->mapTx.end(); ++it) {
+            map<uint64_t, uint16_t>::iterator idit = shorttxids.find(cmpctblock.GetShortID(it->first));
+            if (idit == shorttxids.end())
+                continue;
+            uint16_t index = idit->second;
+            if (!vHaveMatch[index]) {
+                txn_available[index] = it->second.GetTx();
+                vAvailable[index] = true;
+                vHaveMatch[index] = true;
+                mempool_count++;
+                nMatched++;
+            } else if (vAvailable[index]) {
+                vAvailable[index] = false;
+                txn_available[index] = CTransaction();
+                mempool_count--;
+                nMatched--;
+            }
+            if (nMatched == shorttxids.size())
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < vExtraTxn.size() && nMatched < shorttxids.size(); i++) {
+        const uint256& hash = vExtraTxn[i].GetHash();
+        map<uint64_t, uint16_t>::iterator idit = shorttxids.find(cmpctblock.GetShortID(hash));
+        if (idit == shorttxids.end())
+            continue;
+        uint16_t index = idit->second;
+        if (!vHaveMatch[index]) {
+            txn_available[index] = vExtraTxn[i];
+            vAvailable[index] = true;
+            vHaveMatch[index] = true;
+            extra_count++;
+            nMatched++;
+        } else if (vAvailable[index] && txn_available[index].GetHash() != hash) {
+            // Same short ID, different transaction: ambiguous
+            vAvailable[index] = false;
+            txn_available[index] = CTransaction();
+            nMatched--;
+        }
+    }
+
+    LogPrint("cmpctblock", "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n",
+             cmpctblock.header.GetHash().ToString(), ::GetSerializeSize(cmpctblock, SER_NETWORK, PROTOCOL_VERSION));
+
+    return READ_STATUS_OK;
+}
+
+bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const
+{
+    assert(!header.IsNull());
+    assert(index < vAvailable.size());
+    return vAvailable[index];
+}
+
+ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransaction>& vtx_missing)
+{
+    assert(!header.IsNull());
+    block = header;
+    block.vtx.resize(txn_available.size());
+
+    size_t tx_missing_offset = 0;
+    for (size_t i = 0; i < txn_available.size(); i++) {
+        if (!vAvailable[i]) {
+            if (vtx_missing.size() <= tx_missing_offset)
+                return READ_STATUS_INVALID;
+            block.vtx[i] = vtx_missing[tx_missing_offset++];
+        } else {
+            block.vtx[i] = txn_available[i];
+        }
+    }
+
+    // Make sure we can't call FillBlock again.
+    header.SetNull();
+    txn_available.clear();
+    vAvailable.clear();
+
+    if (vtx_missing.size() != tx_missing_offset)
+        return READ_STATUS_INVALID;
+
+    // A short ID that matched the wrong transaction shows up as a merkle
+    // root mismatch. That is not the peer's fault, and the block itself may
+    // well be valid, so it must not be handed to validation (which would
+    // mark it invalid); fetch it in full instead.
+    bool fMutated = false;
+    if (block.BuildMerkleTree(&fMutated) != block.hashMerkleRoot || fMutated)
+        return READ_STATUS_FAILED;
+
+    LogPrint("cmpctblock", "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool, %lu from the extra pool and %lu txn requested\n",
+             block.GetHash().ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
+    if (vtx_missing.size() < 5) {
+        for (size_t i = 0; i < vtx_missing.size(); i++)
+            LogPrint("cmpctblock", "Reconstructed block %s required tx %s\n", block.GetHash().ToString(), vtx_missing[i].GetHash().ToString());
+    }
+
+    return READ_STATUS_OK;
+}
@@ -0,0 +1,232 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKENCODINGS_H
+#define BITCOIN_BLOCKENCODINGS_H
+
+#include "primitives/block.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <ios>
+#include <limits>
+#include <vector>
+
+class CTxMemPool;
+
+/** Maximum depth below the tip at which we answer with a compact block instead of a full one. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Maximum depth below the tip at which we answer getblocktxn requests. */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Number of peers we ask to announce new blocks to us with a cmpctblock straight away. */
+static const unsigned int MAX_HIGH_BANDWIDTH_CMPCT_PEERS = 3;
+
+/**
+ * Transaction indexes in compact block messages are sent as the difference
+ * to the previous index minus one, so that they fit in one byte most of the
+ * time. Indexes must be strictly increasing and fit in 16 bits.
+ */
+template<typename Stream>
+void WriteDifferentialIndexes(Stream& s, const std::vector<uint16_t>& vIndexes)
+{
+    WriteCompactSize(s, vIndexes.size());
+    for (size_t i = 0; i < vIndexes.size(); i++)
+        WriteCompactSize(s, vIndexes[i] - (i == 0 ? 0 : (vIndexes[i - 1] + 1)));
+}
+
+template<typename Stream>
+void ReadDifferentialIndexes(Stream& s, std::vector<uint16_t>& vIndexes)
+{
+    uint64_t nCount = ReadCompactSize(s);
+    vIndexes.clear();
+    uint64_t nOffset = 0;
+    while (vIndexes.size() < nCount) {
+        // Don't trust nCount for the allocation, grow as the data arrives
+        vIndexes.reserve(std::min<uint64_t>(nCount, vIndexes.size() + 1000));
+        uint64_t nIndex = ReadCompactSize(s) + nOffset;
+        if (nIndex > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("index overflowed 16 bits");
+        vIndexes.push_back(nIndex);
+        nOffset = nIndex + 1;
+    }
+}
+
+/** A "getblocktxn" request: the transactions of a block we could not find locally. */
+class BlockTransactionsRequest
+{
+public:
+    uint256 blockhash;
+    std::vector<uint16_t> indexes;
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        s << blockhash;
+        WriteDifferentialIndexes(s, indexes);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        s >> blockhash;
+        ReadDifferentialIndexes(s, indexes);
+    }
+};
+
+/** A "blocktxn" response: the transactions asked for in a BlockTransactionsRequest, in order. */
+class BlockTransactions
+{
+public:
+    uint256 blockhash;
+    std::vector<CTransaction> txn;
+
+    BlockTransactions() {}
+    explicit BlockTransactions(const BlockTransactionsRequest& req) :
+        blockhash(req.blockhash), txn(req.indexes.size()) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(blockhash);
+        READWRITE(txn);
+    }
+};
+
+/** A transaction sent in full inside a compact block, e.g. the coinbase. */
+struct PrefilledTransaction
+{
+    //! Index in the block; differentially encoded on the wire
+    uint16_t index;
+    CTransaction tx;
+};
+
+typedef enum ReadStatus_t
+{
+    READ_STATUS_OK,
+    READ_STATUS_INVALID, //! Invalid object, peer is sending bogus crap
+    READ_STATUS_FAILED, //! Failed to process object, e.g. a short ID collision
+} ReadStatus;
+
+/**
+ * A "cmpctblock" message: the block header, a salt, and for every
+ * transaction the peer is expected to have a 6-byte short ID; the rest are
+ * prefilled in full.
+ *
+ * Short IDs are the SipHash-2-4 of the txid, truncated to 48 bits, keyed
+ * with the first 16 bytes of SHA256(header || nonce). The per-block key
+ * keeps an attacker from grinding transactions whose short IDs collide
+ * on every link.
+ */
+class CBlockHeaderAndShortTxIDs
+{
+private:
+    mutable uint64_t shorttxidk0, shorttxidk1;
+    uint64_t nonce;
+
+    void FillShortTxIDSelector() const;
+
+    friend class PartiallyDownloadedBlock;
+
+    static const int SHORTTXIDS_LENGTH = 6;
+
+protected:
+    std::vector<uint64_t> shorttxids;
+    std::vector<PrefilledTransaction> prefilledtxn;
+
+public:
+    CBlockHeader header;
+
+    // Dummy for deserialization
+    CBlockHeaderAndShortTxIDs() {}
+
+    explicit CBlockHeaderAndShortTxIDs(const CBlock& block);
+
+    uint64_t GetShortID(const uint256& txhash) const;
+
+    size_t BlockTxCount() const { return shorttxids.size() + prefilledtxn.size(); }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        CSizeComputer s(nType, nVersion);
+        Serialize(s, nType, nVersion);
+        return s.size();
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        s << header << nonce;
+        WriteCompactSize(s, shorttxids.size());
+        for (size_t i = 0; i < shorttxids.size(); i++) {
+            uint32_t lsb = shorttxids[i] & 0xffffffff;
+            uint16_t msb = (shorttxids[i] >> 32) & 0xffff;
+            s << lsb << msb;
+        }
+        WriteCompactSize(s, prefilledtxn.size());
+        for (size_t i = 0; i < prefilledtxn.size(); i++) {
+            WriteCompactSize(s, prefilledtxn[i].index - (i == 0 ? 0 : (prefilledtxn[i - 1].index + 1)));
+            s << prefilledtxn[i].tx;
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        s >> header >> nonce;
+        uint64_t nShortIDs = ReadCompactSize(s);
+        shorttxids.clear();
+        while (shorttxids.size() < nShortIDs) {
+            shorttxids.reserve(std::min<uint64_t>(nShortIDs, shorttxids.size() + 1000));
+            uint32_t lsb;
+            uint16_t msb;
+            s >> lsb >> msb;
+            shorttxids.push_back((uint64_t(msb) << 32) | uint64_t(lsb));
+        }
+        uint64_t nPrefilled = ReadCompactSize(s);
+        prefilledtxn.clear();
+        uint64_t nOffset = 0;
+        while (prefilledtxn.size() < nPrefilled) {
+            PrefilledTransaction prefilled;
+            uint64_t nIndex = ReadCompactSize(s) + nOffset;
+            if (nIndex > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("index overflowed 16 bits");
+            prefilled.index = nIndex;
+            s >> prefilled.tx;
+            prefilledtxn.push_back(prefilled);
+            nOffset = nIndex + 1;
+        }
+        if (BlockTxCount() > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("indexes overflowed 16 bits");
+        FillShortTxIDSelector();
+    }
+};
+
+/**
+ * A block being reconstructed from a compact block: the transactions found
+ * in the mempool (or the extra transactions) are filled in right away, the
+ * remaining ones are requested with getblocktxn and handed to FillBlock().
+ */
+class PartiallyDownloadedBlock
+{
+protected:
+    std::vector<CTransaction> txn_available;
+    std::vector<bool> vAvailable;
+    size_t prefilled_count, mempool_count, extra_count;
+    CTxMemPool* pool;
+
+public:
+    CBlockHeader header;
+
+    explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : prefilled_count(0), mempool_count(0), extra_count(0), pool(poolIn) {}
+
+    /** Match the short IDs against the mempool and vExtraTxn. */
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<CTransaction>& vExtraTxn);
+    bool IsTxAvailable(size_t index) const;
+    /** Complete the block with the missing transactions, in index order; checks the merkle root. */
+    ReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& vtx_missing);
+};
+
+#endif // BITCOIN_BLOCKENCODINGS_H
@@ -0,0 +1,327 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+
+#include <algorithm>
+#include <ios>
+#include <stdexcept>
+
+#include <boost/foreach.hpp>
+
+using namespace std;
+
+/** Parameters of the basic filter, from BIP 158 */
+static const int BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+static const string strBasicFilterName = "basic";
+static const string strEmptyName = "";
+
+static void WriteCompactSizeToVector(vector<unsigned char>& vch, uint64_t n)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, n);
+    vch.insert(vch.end(), ss.begin(), ss.end());
+}
+
+/** Map x uniformly into [0, n): the high 64 bits of the 128-bit product x * n. */
+static inline uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+    uint64_t a = x >> 32, b = x & 0xffffffff, c = n >> 32, d = n & 0xffffffff;
+    uint64_t ad = a * d, bc = b * c, bd = b * d;
+    uint64_t mid34 = (bd >> 32) + (bc & 0xffffffff) + (ad & 0xffffffff);
+    return a * c + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+}
+
+/** Appends bits to a byte vector, most significant bit first. */
+class BitStreamWriter
+{
+private:
+    vector<unsigned char>& vch;
+    uint8_t nBuffer;
+    int nOffset; //!< Bits of nBuffer already used
+
+public:
+    explicit BitStreamWriter(vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+    ~BitStreamWriter() { Flush(); }
+
+    /** Write the nBits least significant bits of data, 0 <= nBits <= 64. */
+    void Write(uint64_t data, int nBits)
+    {
+        while (nBits > 0) {
+            int nWrite = min(8 - nOffset, nBits);
+            nBuffer |= (data << (64 - nBits)) >> (64 - 8 + nOffset);
+            nOffset += nWrite;
+            nBits -= nWrite;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    /** Write out the partial byte, if any, padded with zero bits. */
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+/** Reads bits from a byte range, most significant bit first. */
+class BitStreamReader
+{
+private:
+    const unsigned char* pch;
+    const unsigned char* pend;
+    uint8_t nBuffer;
+    int nOffset; //!< Bits of nBuffer already read
+
+public:
+    BitStreamReader(const unsigned char* pchIn, const unsigned char* pendIn) : pch(pchIn), pend(pendIn), nBuffer(0), nOffset(8) {}
+
+    bool AtEnd() const { return pch == pend; }
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t data = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                if (pch == pend)
+                    throw ios_base::failure("BitStreamReader::Read : end of data");
+                nBuffer = *pch++;
+                nOffset = 0;
+            }
+            int nRead = min(8 - nOffset, nBits);
+            data <<= nRead;
+            data |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - nRead);
+            nOffset += nRead;
+            nBits -= nRead;
+        }
+        return data;
+    }
+};
+
+static void GolombRiceEncode(BitStreamWriter& bitwriter, int nP, uint64_t x)
+{
+    // The quotient in unary: q ones and a zero
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? (int)q : 64;
+        bitwriter.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    bitwriter.Write(0, 1);
+
+    // The remainder in binary
+    bitwriter.Write(x, nP);
+}
+
+static uint64_t GolombRiceDecode(BitStreamReader& bitreader, int nP)
+{
+    uint64_t q = 0;
+    while (bitreader.Read(1) == 1)
+        ++q;
+    uint64_t r = bitreader.Read(nP);
+    return (q << nP) + r;
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn) : params(paramsIn), nN(0), nF(0)
+{
+    WriteCompactSizeToVector(vEncoded, 0);
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const vector<unsigned char>& vEncodedIn) :
+        params(paramsIn), vEncoded(vEncodedIn)
+{
+    if (vEncoded.empty())
+        throw ios_base::failure("encoded filter is empty");
+    CDataStream stream((const char*)&vEncoded[0], (const char*)&vEncoded[0] + vEncoded.size(), SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nElements = ReadCompactSize(stream);
+    if (nElements >= 0x100000000ULL)
+        throw ios_base::failure("N must be < 2^32");
+    nN = nElements;
+    nF = (uint64_t)nN * params.nM;
+
+    // Decode all of it, to make sure the encoding is consistent with nN
+    const unsigned char* pchBits = &vEncoded[0] + (vEncoded.size() - stream.size());
+    BitStreamReader bitreader(pchBits, &vEncoded[0] + vEncoded.size());
+    for (uint64_t i = 0; i < nN; ++i)
+        GolombRiceDecode(bitreader, params.nP);
+    if (!bitreader.AtEnd())
+        throw ios_base::failure("encoded filter contains excess data");
+}
+
+GCSFilter::GCSFilter(const Params& paramsIn, const ElementSet& elements) : params(paramsIn)
+{
+    if (elements.size() >= 0x100000000ULL)
+        throw invalid_argument("GCSFilter : N must be < 2^32");
+    nN = elements.size();
+    nF = (uint64_t)nN * params.nM;
+
+    WriteCompactSizeToVector(vEncoded, nN);
+    if (elements.empty())
+        return;
+
+    vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    BOOST_FOREACH(const Element& element, elements)
+        vHashes.push_back(HashToRange(element));
+    sort(vHashes.begin(), vHashes.end());
+
+    BitStreamWriter bitwriter(vEncoded);
+    uint64_t nLast = 0;
+    BOOST_FOREACH(uint64_t nHash, vHashes) {
+        GolombRiceEncode(bitwriter, params.nP, nHash - nLast);
+        nLast = nHash;
+    }
+    bitwriter.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t nHash = CSipHasher(params.nSipHashK0, params.nSipHashK1).Write(element.empty() ? NULL : &element[0], element.size()).Finalize();
+    return MapIntoRange(nHash, nF);
+}
+
+bool GCSFilter::MatchInternal(const vector<uint64_t>& vSortedHashes) const
+{
+    CDataStream stream((const char*)&vEncoded[0], (const char*)&vEncoded[0] + vEncoded.size(), SER_NETWORK, PROTOCOL_VERSION);
+    // Skip N, which is known already
+    ReadCompactSize(stream);
+    const unsigned char* pchBits = &vEncoded[0] + (vEncoded.size() - stream.size());
+    BitStreamReader bitreader(pchBits, &vEncoded[0] + vEncoded.size());
+
+    // Walk the filter and the sorted query side by side
+    uint64_t nValue = 0;
+    size_t nQuery = 0;
+    for (uint32_t i = 0; i < nN; ++i) {
+        nValue += GolombRiceDecode(bitreader, params.nP);
+        while (true) {
+            if (nQuery == vSortedHashes.size())
+                return false;
+            if (vSortedHashes[nQuery] == nValue)
+                return true;
+            if (vSortedHashes[nQuery] > nValue)
+                break;
+            nQuery++;
+        }
+    }
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    if (nN == 0)
+        return false;
+    return MatchInternal(vector<uint64_t>(1, HashToRange(element)));
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (nN == 0 || elements.empty())
+        return false;
+    vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    BOOST_FOREACH(const Element& element, elements)
+        vHashes.push_back(HashToRange(element));
+    sort(vHashes.begin(), vHashes.end());
+    return MatchInternal(vHashes);
+}
+
+const string& BlockFilterTypeName(BlockFilterType filterType)
+{
+    switch (filterType) {
+    case BASIC_FILTER:
+        return strBasicFilterName;
+    default:
+        return strEmptyName;
+    }
+}
+
+bool BlockFilterTypeByName(const string& strName, BlockFilterType& filterType)
+{
+    if (strName == strBasicFilterName) {
+        filterType = BASIC_FILTER;
+        return true;
+    }
+    return false;
+}
+
+static void AddScriptElement(GCSFilter::ElementSet& elements, const CScript& script)
+{
+    if (script.empty() || script[0] == OP_RETURN)
+        return;
+    elements.insert(GCSFilter::Element(script.begin(), script.end()));
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    GCSFilter::ElementSet elements;
+
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        BOOST_FOREACH(const CTxOut& txout, tx.vout)
+            AddScriptElement(elements, txout.scriptPubKey);
+    }
+
+    BOOST_FOREACH(const CTxUndo& txundo, blockUndo.vtxundo) {
+        BOOST_FOREACH(const CTxInUndo& prevout, txundo.vprevout)
+            AddScriptElement(elements, prevout.txout.scriptPubKey);
+    }
+
+    return elements;
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, const vector<unsigned char>& vFilter) :
+        filterType(filterTypeIn), hashBlock(hashBlockIn)
+{
+    GCSFilter::Params paramsFilter;
+    if (!BuildParams(paramsFilter))
+        throw invalid_argument("unknown filter type");
+    filter = GCSFilter(paramsFilter, vFilter);
+}
+
+BlockFilter::BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo) :
+        filterType(filterTypeIn), hashBlock(block.GetHash())
+{
+    GCSFilter::Params paramsFilter;
+    if (!BuildParams(paramsFilter))
+        throw invalid_argument("unknown filter type");
+    filter = GCSFilter(paramsFilter, BasicFilterElements(block, blockUndo));
+}
+
+bool BlockFilter::BuildParams(GCSFilter::Params& paramsOut) const
+{
+    switch (filterType) {
+    case BASIC_FILTER:
+        paramsOut.nSipHashK0 = ReadLE64(hashBlock.begin());
+        paramsOut.nSipHashK1 = ReadLE64(hashBlock.begin() + 8);
+        paramsOut.nP = BASIC_FILTER_P;
+        paramsOut.nM = BASIC_FILTER_M;
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    const vector<unsigned char>& vData = GetEncodedFilter();
+    return Hash(vData.begin(), vData.end());
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& hashPrevHeader) const
+{
+    uint256 hashFilter = GetHash();
+    return Hash(hashFilter.begin(), hashFilter.end(), hashPrevHeader.begin(), hashPrevHeader.end());
+}
@@ -0,0 +1,142 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <ios>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * A Golomb-coded set, as specified in BIP 158: a compact probabilistic set
+ * of byte strings. Each element is hashed with SipHash into the range
+ * [0, N * M), the hashes are sorted, and the differences between
+ * successive ones are Golomb-Rice coded with parameter P. A query for an
+ * element that is not in the set matches with probability 1/M.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+    struct Params
+    {
+        uint64_t nSipHashK0;
+        uint64_t nSipHashK1;
+        int nP;      //!< Golomb-Rice coding parameter
+        uint32_t nM; //!< Inverse false positive rate
+
+        Params(uint64_t nSipHashK0In = 0, uint64_t nSipHashK1In = 0, int nPIn = 0, uint32_t nMIn = 1) :
+            nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn) {}
+    };
+
+private:
+    Params params;
+    uint32_t nN; //!< Number of elements in the filter
+    uint64_t nF; //!< Range of element hashes, F = N * M
+    std::vector<unsigned char> vEncoded;
+
+    uint64_t HashToRange(const Element& element) const;
+    bool MatchInternal(const std::vector<uint64_t>& vSortedHashes) const;
+
+public:
+    explicit GCSFilter(const Params& paramsIn = Params());
+
+    /** Reconstruct a filter from its encoding; throws std::ios_base::failure if that is malformed. */
+    GCSFilter(const Params& paramsIn, const std::vector<unsigned char>& vEncodedIn);
+
+    /** Build a filter of the given elements. */
+    GCSFilter(const Params& paramsIn, const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    /** Whether element may be in the set. */
+    bool Match(const Element& element) const;
+
+    /** Whether any of the elements may be in the set; this takes a single pass over the filter. */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+enum BlockFilterType
+{
+    BASIC_FILTER = 0,
+    INVALID_BLOCK_FILTER_TYPE = 255,
+};
+
+/** The name of a filter type, as used in RPC and REST requests; empty if unknown. */
+const std::string& BlockFilterTypeName(BlockFilterType filterType);
+
+/** Find the filter type of a name; false if there is none. */
+bool BlockFilterTypeByName(const std::string& strName, BlockFilterType& filterType);
+
+/**
+ * The BIP 158 filter of a block. The basic filter holds every output
+ * script the block creates and every output script it spends, except for
+ * empty and OP_RETURN scripts, and is keyed with the first 16 bytes of the
+ * block hash.
+ */
+class BlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 hashBlock;
+    GCSFilter filter;
+
+    bool BuildParams(GCSFilter::Params& paramsOut) const;
+
+public:
+    BlockFilter() : filterType(INVALID_BLOCK_FILTER_TYPE) {}
+
+    /** Reconstruct a filter from its parts; throws std::ios_base::failure if it is malformed. */
+    BlockFilter(BlockFilterType filterTypeIn, const uint256& hashBlockIn, const std::vector<unsigned char>& vFilter);
+
+    /** Compute the filter of a block; blockUndo provides the outputs it spends. */
+    BlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** The double-SHA256 of the encoded filter. */
+    uint256 GetHash() const;
+
+    /** The filter header: the hash of this filter's hash and the previous block's filter header. */
+    uint256 ComputeHeader(const uint256& hashPrevHeader) const;
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 1 + hashBlock.GetSerializeSize(nType, nVersion) + ::GetSerializeSize(GetEncodedFilter(), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        s << (uint8_t)filterType << hashBlock << GetEncodedFilter();
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        uint8_t nFilterType;
+        std::vector<unsigned char> vFilter;
+        s >> nFilterType >> hashBlock >> vFilter;
+        filterType = (BlockFilterType)nFilterType;
+        GCSFilter::Params paramsFilter;
+        if (!BuildParams(paramsFilter))
+            throw std::ios_base::failure("unknown filter type");
+        filter = GCSFilter(paramsFilter, vFilter);
+    }
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
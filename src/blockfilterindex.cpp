@@ -0,0 +1,142 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilterindex.h"
+
+#include "main.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+/** Key prefix of a block's entry: its filter header and encoded filter */
+static const char DB_FILTER = 'f';
+/** Key of the last block indexed */
+static const char DB_BEST_BLOCK = 'B';
+
+/** Seconds between progress messages while catching up */
+static const int64_t SYNC_LOG_INTERVAL = 30;
+
+CBlockFilterIndex* pblockfilterindex = NULL;
+
+typedef pair<uint256, vector<unsigned char> > FilterEntry;
+
+/** The database directory of a filter type, with its parents created (leveldb only creates the last level) */
+static boost::filesystem::path IndexPath(BlockFilterType filterType)
+{
+    boost::filesystem::path path = GetDataDir() / "indexes" / "blockfilter";
+    boost::filesystem::create_directories(path);
+    return path / BlockFilterTypeName(filterType);
+}
+
+CBlockFilterIndex::CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory, bool fWipe) :
+        filterType(filterTypeIn),
+        db(IndexPath(filterTypeIn), nCacheSize, fMemory, fWipe),
+        hashBestBlock(0), fSynced(false)
+{
+    db.Read(DB_BEST_BLOCK, hashBestBlock);
+}
+
+bool CBlockFilterIndex::IndexNextBlock()
+{
+    uint256 hashLast;
+    {
+        LOCK(cs);
+        hashLast = hashBestBlock;
+    }
+
+    const CBlockIndex* pindex = NULL;
+    CDiskBlockPos posUndo;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexLast = NULL;
+        if (hashLast != 0) {
+            BlockMap::const_iterator mi = mapBlockIndex.find(hashLast);
+            if (mi != mapBlockIndex.end())
+                pindexLast = mi->second;
+        }
+        // After a reorganization, continue from the fork point
+        if (pindexLast && !chainActive.Contains(pindexLast))
+            pindexLast = chainActive.FindFork(pindexLast);
+        pindex = pindexLast ? chainActive.Next(pindexLast) : chainActive.Genesis();
+        if (pindex == NULL) {
+            static bool fLoggedUpToDate = false;
+            LOCK(cs);
+            if (!fLoggedUpToDate && pindexLast) {
+                fLoggedUpToDate = true;
+                LogPrintf("%s block filter index is up to date at height %d\n", BlockFilterTypeName(filterType), pindexLast->nHeight);
+            }
+            fSynced = true;
+            return false;
+        }
+        if (pindex->pprev)
+            posUndo = pindex->GetUndoPos();
+    }
+
+    uint256 hashPrevHeader = 0;
+    if (pindex->pprev) {
+        FilterEntry entryPrev;
+        if (!db.Read(make_pair(DB_FILTER, pindex->pprev->GetBlockHash()), entryPrev))
+            return error("%s : no filter for block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+        hashPrevHeader = entryPrev.first;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s : failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+    CBlockUndo blockUndo;
+    if (pindex->pprev && !blockUndo.ReadFromDisk(posUndo, pindex->pprev->GetBlockHash()))
+        return error("%s : failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    BlockFilter filter(filterType, block, blockUndo);
+    CLevelDBBatch batch;
+    batch.Write(make_pair(DB_FILTER, pindex->GetBlockHash()), make_pair(filter.ComputeHeader(hashPrevHeader), filter.GetEncodedFilter()));
+    batch.Write(DB_BEST_BLOCK, pindex->GetBlockHash());
+    if (!db.WriteBatch(batch))
+        return error("%s : failed to write filter of block %s", __func__, pindex->GetBlockHash().ToString());
+
+    static int64_t nLastLogTime = 0;
+    LOCK(cs);
+    hashBestBlock = pindex->GetBlockHash();
+    if (fSynced) {
+        fSynced = false;
+    } else if (GetTime() - nLastLogTime >= SYNC_LOG_INTERVAL) {
+        LogPrintf("Syncing %s block filter index with block chain at height %d\n", BlockFilterTypeName(filterType), pindex->nHeight);
+        nLastLogTime = GetTime();
+    }
+    return true;
+}
+
+bool CBlockFilterIndex::IsSynced() const
+{
+    LOCK(cs);
+    return fSynced;
+}
+
+bool CBlockFilterIndex::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter, uint256& hashHeader) const
+{
+    FilterEntry entry;
+    if (!db.Read(make_pair(DB_FILTER, pindex->GetBlockHash()), entry))
+        return false;
+    try {
+        filter = BlockFilter(filterType, pindex->GetBlockHash(), entry.second);
+    } catch (const std::exception& e) {
+        return error("%s : corrupt filter for block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    hashHeader = entry.first;
+    return true;
+}
+
+void ThreadBlockFilterIndex()
+{
+    RenameThread("bitcoin-blockfilter");
+    while (true) {
+        boost::this_thread::interruption_point();
+        if (!pblockfilterindex->IndexNextBlock())
+            MilliSleep(1000);
+    }
+}
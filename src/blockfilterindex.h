@@ -0,0 +1,68 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTERINDEX_H
+#define BITCOIN_BLOCKFILTERINDEX_H
+
+#include "blockfilter.h"
+#include "leveldbwrapper.h"
+#include "sync.h"
+#include "uint256.h"
+
+class CBlockIndex;
+
+/** -blockfilterindex default */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** max. -dbcache in (MiB) given to the block filter index */
+static const int64_t nMaxBlockFilterIndexCache = 16;
+
+/**
+ * An index of the BIP 158 filters of the blocks in the active chain, and of
+ * their filter headers, kept in its own database. It is built by a
+ * background thread, which reads the blocks and their undo data back from
+ * disk, so it never holds up block validation; see ThreadBlockFilterIndex().
+ *
+ * Entries are keyed by block hash, so after a reorganization the filters of
+ * the blocks that left the chain are still found, and only the new blocks
+ * need indexing.
+ */
+class CBlockFilterIndex
+{
+private:
+    BlockFilterType filterType;
+    CLevelDBWrapper db;
+
+    mutable CCriticalSection cs;
+    uint256 hashBestBlock; //!< Last block indexed; 0 if none
+    bool fSynced;          //!< Whether the index was caught up with the active chain last time we looked
+
+    CBlockFilterIndex(const CBlockFilterIndex&);
+    void operator=(const CBlockFilterIndex&);
+
+public:
+    CBlockFilterIndex(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+
+    /**
+     * Index the next block of the active chain, first stepping back to it
+     * if the last block indexed was reorganized away. Returns false when
+     * there is nothing to do, or indexing failed.
+     */
+    bool IndexNextBlock();
+
+    /** Whether the last call to IndexNextBlock() found the index caught up. */
+    bool IsSynced() const;
+
+    /** The filter of a block and its filter header; false if it is not indexed (yet). */
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter, uint256& hashHeader) const;
+};
+
+/** The basic filter index; NULL unless -blockfilterindex is set. */
+extern CBlockFilterIndex* pblockfilterindex;
+
+/** Keep pblockfilterindex in step with the active chain. */
+void ThreadBlockFilterIndex();
+
+#endif // BITCOIN_BLOCKFILTERINDEX_H
@@ -5,13 +5,18 @@
 #include "bloom.h"
 
 #include "primitives/transaction.h"
+#include "crypto/common.h"
 #include "hash.h"
+#include "random.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "streams.h"
 
+#include <algorithm>
+#include <limits>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <boost/foreach.hpp>
 
@@ -40,67 +45,138 @@ nFlags(nFlagsIn)
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+/** Number of hash functions evaluated together; contains() checks their bits before computing more. */
+static const unsigned int BLOOM_HASH_BATCH = 4;
+
+/** The hashes of data under hash functions nFirst to nFirst + nBatch - 1, nBatch <= BLOOM_HASH_BATCH. */
+static inline void BloomHashBatch(const CMurmurHash3Multi& hasher, uint32_t nTweak, unsigned int nFirst, unsigned int nBatch, uint32_t* pnHashes)
 {
-    // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    uint32_t nSeeds[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nBatch; i++) {
+        // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
+        nSeeds[i] = (nFirst + i) * 0xFBA4C795 + nTweak;
+    }
+    hasher.Hash(nSeeds, pnHashes, nBatch);
 }
 
-void CBloomFilter::insert(const vector<unsigned char>& vKey)
+/** The serialization of an outpoint, without going through a stream. */
+static inline void SerializeOutPoint(const COutPoint& outpoint, unsigned char* pch)
+{
+    memcpy(pch, outpoint.hash.begin(), 32);
+    WriteLE32(pch + 32, outpoint.n);
+}
+
+void CBloomFilter::insert(const CMurmurHash3Multi& hasher)
 {
     if (isFull)
         return;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
+    const unsigned int nBits = vData.size() * 8;
+    uint32_t nHashes[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_BATCH)
     {
-        unsigned int nIndex = Hash(i, vKey);
-        // Sets bit nIndex of vData
-        vData[nIndex >> 3] |= (1 << (7 & nIndex));
+        unsigned int nBatch = min(BLOOM_HASH_BATCH, nHashFuncs - i);
+        BloomHashBatch(hasher, nTweak, i, nBatch, nHashes);
+        for (unsigned int j = 0; j < nBatch; j++)
+        {
+            unsigned int nIndex = nHashes[j] % nBits;
+            // Sets bit nIndex of vData
+            vData[nIndex >> 3] |= (1 << (7 & nIndex));
+        }
     }
     isEmpty = false;
 }
 
+void CBloomFilter::insert(const vector<unsigned char>& vKey)
+{
+    if (isFull)
+        return;
+    insert(CMurmurHash3Multi(vKey));
+}
+
 void CBloomFilter::insert(const COutPoint& outpoint)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    if (isFull)
+        return;
+    unsigned char pchKey[36];
+    SerializeOutPoint(outpoint, pchKey);
+    insert(CMurmurHash3Multi(pchKey, sizeof(pchKey)));
 }
 
 void CBloomFilter::insert(const uint256& hash)
 {
-    vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    if (isFull)
+        return;
+    insert(CMurmurHash3Multi(hash.begin(), hash.size()));
 }
 
-bool CBloomFilter::contains(const vector<unsigned char>& vKey) const
+bool CBloomFilter::contains(const CMurmurHash3Multi& hasher) const
 {
     if (isFull)
         return true;
     if (isEmpty)
         return false;
-    for (unsigned int i = 0; i < nHashFuncs; i++)
+    const unsigned int nBits = vData.size() * 8;
+    uint32_t nHashes[BLOOM_HASH_BATCH];
+    for (unsigned int i = 0; i < nHashFuncs; i += BLOOM_HASH_BATCH)
     {
-        unsigned int nIndex = Hash(i, vKey);
-        // Checks bit nIndex of vData
-        if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
-            return false;
+        unsigned int nBatch = min(BLOOM_HASH_BATCH, nHashFuncs - i);
+        BloomHashBatch(hasher, nTweak, i, nBatch, nHashes);
+        for (unsigned int j = 0; j < nBatch; j++)
+        {
+            unsigned int nIndex = nHashes[j] % nBits;
+            // Checks bit nIndex of vData
+            if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
+                return false;
+        }
     }
     return true;
 }
 
+bool CBloomFilter::contains(const vector<unsigned char>& vKey) const
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return contains(CMurmurHash3Multi(vKey));
+}
+
 bool CBloomFilter::contains(const COutPoint& outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    unsigned char pchKey[36];
+    SerializeOutPoint(outpoint, pchKey);
+    return contains(CMurmurHash3Multi(pchKey, sizeof(pchKey)));
 }
 
 bool CBloomFilter::contains(const uint256& hash) const
 {
-    vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return contains(CMurmurHash3Multi(hash.begin(), hash.size()));
+}
+
+bool CBloomFilter::containsMany(const vector<vector<unsigned char> >& vKeys, vector<bool>& vFound) const
+{
+    vFound.assign(vKeys.size(), isFull);
+    if (isFull)
+        return !vKeys.empty();
+    if (isEmpty)
+        return false;
+    bool fAny = false;
+    CMurmurHash3Multi hasher;
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+    {
+        hasher.Set(vKeys[i]);
+        if (contains(hasher))
+            vFound[i] = fAny = true;
+    }
+    return fAny;
 }
 
 void CBloomFilter::clear()
@@ -125,7 +201,9 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (isEmpty)
         return false;
     const uint256& hash = tx.GetHash();
-    if (contains(hash))
+    // One hasher for all the data, so that its buffer is reused
+    CMurmurHash3Multi hasher(hash.begin(), hash.size());
+    if (contains(hasher))
         fFound = true;
 
     for (unsigned int i = 0; i < tx.vout.size(); i++)
@@ -142,17 +220,19 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
             opcodetype opcode;
             if (!txout.scriptPubKey.GetOp(pc, opcode, data))
                 break;
-            if (data.size() != 0 && contains(data))
+            if (data.size() == 0)
+                continue;
+            hasher.Set(data);
+            if (contains(hasher))
             {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
                     insert(COutPoint(hash, i));
                 else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
                 {
-                    txnouttype type;
-                    vector<vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                            (type == TX_PUBKEY || type == TX_MULTISIG))
+                    CTemplateMatch match;
+                    if (MatchTemplate(txout.scriptPubKey, match) &&
+                            (match.type == TX_PUBKEY || match.type == TX_MULTISIG))
                         insert(COutPoint(hash, i));
                 }
                 break;
@@ -166,7 +246,10 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     BOOST_FOREACH(const CTxIn& txin, tx.vin)
     {
         // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        unsigned char pchOutPoint[36];
+        SerializeOutPoint(txin.prevout, pchOutPoint);
+        hasher.Set(pchOutPoint, sizeof(pchOutPoint));
+        if (contains(hasher))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
@@ -177,7 +260,10 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
             opcodetype opcode;
             if (!txin.scriptSig.GetOp(pc, opcode, data))
                 break;
-            if (data.size() != 0 && contains(data))
+            if (data.size() == 0)
+                continue;
+            hasher.Set(data);
+            if (contains(hasher))
                 return true;
         }
     }
@@ -197,3 +283,106 @@ void CBloomFilter::UpdateEmptyFull()
     isFull = full;
     isEmpty = empty;
 }
+
+CRollingBloomFilter::CRollingBloomFilter(unsigned int nElements, double fpRate)
+{
+    double logFpRate = log(fpRate);
+    // The optimal number of hash functions is log(fpRate) / log(0.5), but
+    // restrict it to the range 1-50
+    nHashFuncs = max(1, min((int)floor(logFpRate / log(0.5) + 0.5), 50));
+    // Between 2 and 3 generations of nElements / 2 entries are stored
+    nEntriesPerGeneration = (nElements + 1) / 2;
+    uint32_t nMaxElements = nEntriesPerGeneration * 3;
+    /* The maximum fpRate = pow(1.0 - exp(-nHashFuncs * nMaxElements / nFilterBits), nHashFuncs)
+     * =>          pow(fpRate, 1.0 / nHashFuncs) = 1.0 - exp(-nHashFuncs * nMaxElements / nFilterBits)
+     * =>          log(1.0 - pow(fpRate, 1.0 / nHashFuncs)) = -nHashFuncs * nMaxElements / nFilterBits
+     * =>          nFilterBits = -nHashFuncs * nMaxElements / log(1.0 - exp(logFpRate / nHashFuncs))
+     */
+    uint32_t nFilterBits = (uint32_t)ceil(-1.0 * nHashFuncs * nMaxElements / log(1.0 - exp(logFpRate / nHashFuncs)));
+    /* Every bit position takes 2 bits. If both are 0, the position is
+     * unset; (01), (10) and (11) mean it was set in generation 1, 2 or 3.
+     * The two bits live in separate words: position P is bit (P & 63) of
+     * data[(P >> 6) * 2] and data[(P >> 6) * 2 + 1]. */
+    data.resize(((nFilterBits + 63) / 64) << 1);
+    reset();
+}
+
+void CRollingBloomFilter::insert(const CMurmurHash3Multi& hasher)
+{
+    if (nEntriesThisGeneration == nEntriesPerGeneration) {
+        nEntriesThisGeneration = 0;
+        nGeneration++;
+        if (nGeneration == 4)
+            nGeneration = 1;
+        uint64_t nGenerationMask1 = 0 - (uint64_t)(nGeneration & 1);
+        uint64_t nGenerationMask2 = 0 - (uint64_t)(nGeneration >> 1);
+        // Wipe the entries of the oldest generation, whose number is reused
+        for (uint32_t p = 0; p < data.size(); p += 2) {
+            uint64_t p1 = data[p], p2 = data[p + 1];
+            uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
+            data[p] = p1 & mask;
+            data[p + 1] = p2 & mask;
+        }
+    }
+    nEntriesThisGeneration++;
+
+    uint32_t nHashes[BLOOM_HASH_BATCH];
+    for (unsigned int n = 0; n < nHashFuncs; n += BLOOM_HASH_BATCH) {
+        unsigned int nBatch = min(BLOOM_HASH_BATCH, nHashFuncs - n);
+        BloomHashBatch(hasher, nTweak, n, nBatch, nHashes);
+        for (unsigned int j = 0; j < nBatch; j++) {
+            uint32_t h = nHashes[j];
+            int bit = h & 0x3F;
+            uint32_t pos = (h >> 6) % data.size();
+            // The lowest bit of pos is ignored: the first word is even, the second odd
+            data[pos & ~1] = (data[pos & ~1] & ~(((uint64_t)1) << bit)) | ((uint64_t)(nGeneration & 1)) << bit;
+            data[pos | 1] = (data[pos | 1] & ~(((uint64_t)1) << bit)) | ((uint64_t)(nGeneration >> 1)) << bit;
+        }
+    }
+}
+
+void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    insert(CMurmurHash3Multi(vKey));
+}
+
+void CRollingBloomFilter::insert(const uint256& hash)
+{
+    insert(CMurmurHash3Multi(hash.begin(), hash.size()));
+}
+
+bool CRollingBloomFilter::contains(const CMurmurHash3Multi& hasher) const
+{
+    uint32_t nHashes[BLOOM_HASH_BATCH];
+    for (unsigned int n = 0; n < nHashFuncs; n += BLOOM_HASH_BATCH) {
+        unsigned int nBatch = min(BLOOM_HASH_BATCH, nHashFuncs - n);
+        BloomHashBatch(hasher, nTweak, n, nBatch, nHashes);
+        for (unsigned int j = 0; j < nBatch; j++) {
+            uint32_t h = nHashes[j];
+            int bit = h & 0x3F;
+            uint32_t pos = (h >> 6) % data.size();
+            // Unset in both words means the data was not inserted
+            if (!(((data[pos & ~1] | data[pos | 1]) >> bit) & 1))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(CMurmurHash3Multi(vKey));
+}
+
+bool CRollingBloomFilter::contains(const uint256& hash) const
+{
+    return contains(CMurmurHash3Multi(hash.begin(), hash.size()));
+}
+
+void CRollingBloomFilter::reset()
+{
+    nTweak = GetRand(std::numeric_limits<unsigned int>::max());
+    nEntriesThisGeneration = 0;
+    nGeneration = 1;
+    std::fill(data.begin(), data.end(), 0);
+}
@@ -7,8 +7,10 @@
 
 #include "serialize.h"
 
+#include <stdint.h>
 #include <vector>
 
+class CMurmurHash3Multi;
 class COutPoint;
 class CTransaction;
 class uint256;
@@ -51,7 +53,8 @@ private:
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    void insert(const CMurmurHash3Multi& hasher);
+    bool contains(const CMurmurHash3Multi& hasher) const;
 
 public:
     /**
@@ -84,6 +87,13 @@ public:
     bool contains(const COutPoint& outpoint) const;
     bool contains(const uint256& hash) const;
 
+    /**
+     * contains() of many keys: sets vFound[i] to whether vKeys[i] may be in
+     * the filter, and returns whether any may be. Cheaper than calling
+     * contains() for each, as one hasher is reused for all of them.
+     */
+    bool containsMany(const std::vector<std::vector<unsigned char> >& vKeys, std::vector<bool>& vFound) const;
+
     void clear();
 
     //! True if the size is <= MAX_BLOOM_FILTER_SIZE and the number of hash functions is <= MAX_HASH_FUNCS
@@ -97,4 +107,42 @@ public:
     void UpdateEmptyFull();
 };
 
+/**
+ * RollingBloomFilter is a probabilistic "keep track of most recently inserted" set.
+ * Construct it with the number of items to keep track of, and a false-positive
+ * rate. Unlike CBloomFilter, by default nTweak is set to a cryptographically
+ * secure random value for you, so that peers can't predict which items
+ * collide in each others' filters.
+ *
+ * contains(item) will always return true if item was one of the last N to 1.5*N
+ * insert()'ed ... but may also return true for items that were not inserted.
+ *
+ * The filter keeps three generations of N/2 items, and stores the generation
+ * of each bit in two bits; it needs about 1.8 * N * log(1/fpRate) bytes,
+ * independent of the size of the items.
+ */
+class CRollingBloomFilter
+{
+public:
+    CRollingBloomFilter(unsigned int nElements, double nFPRate);
+
+    void insert(const std::vector<unsigned char>& vKey);
+    void insert(const uint256& hash);
+    bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const uint256& hash) const;
+
+    void reset();
+
+private:
+    void insert(const CMurmurHash3Multi& hasher);
+    bool contains(const CMurmurHash3Multi& hasher) const;
+
+    int nEntriesPerGeneration;
+    int nEntriesThisGeneration;
+    int nGeneration;
+    std::vector<uint64_t> data;
+    unsigned int nTweak;
+    unsigned int nHashFuncs;
+};
+
 #endif // BITCOIN_BLOOM_H
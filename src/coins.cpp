@@ -4,9 +4,14 @@
 
 #include "coins.h"
 
+#include "interest.h"
 #include "random.h"
+#include "streams.h"
+#include "version.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <math.h>
 
 /**
  * calculate number of bytes for the bitmask, and its number of non-zero bytes
@@ -54,6 +59,64 @@ bool CCoins::Spend(int nPos) {
 }
 
 
+/** What an output adds to CCoinsStats::muhashSerialized */
+static CDataStream SerializeOutput(const uint256& txid, unsigned int n, const CTxOut& out, int nCoinsHeight, bool fCoinBase)
+{
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << txid;
+    ss << VARINT(n);
+    ss << VARINT(nCoinsHeight * 2 + (fCoinBase ? 1 : 0));
+    ss << out;
+    return ss;
+}
+
+/**
+ * What an output adds to CCoinsStats::nDiscountedAmount: its value at
+ * height 0, had it earned interest all along. Interest compounds, so the sum
+ * of these grown to any height less the amount is the interest accrued by
+ * then on all the outputs.
+ */
+static CAmount GetDiscountedValue(const CTxOut& out, int nCoinsHeight)
+{
+    return (CAmount)floor(out.nValue * exp(-nCoinsHeight * log1p(InterestCompoundingRate())) + 0.5);
+}
+
+void CCoinsStats::AddOutput(const uint256& txid, unsigned int n, const CTxOut& out, int nCoinsHeight, bool fCoinBase)
+{
+    nTransactionOutputs++;
+    nTotalAmount += out.nValue;
+    nDiscountedAmount += GetDiscountedValue(out, nCoinsHeight);
+    CDataStream ss = SerializeOutput(txid, n, out, nCoinsHeight, fCoinBase);
+    muhashSerialized.Insert((const unsigned char*)&ss[0], ss.size());
+}
+
+void CCoinsStats::RemoveOutput(const uint256& txid, unsigned int n, const CTxOut& out, int nCoinsHeight, bool fCoinBase)
+{
+    nTransactionOutputs--;
+    nTotalAmount -= out.nValue;
+    nDiscountedAmount -= GetDiscountedValue(out, nCoinsHeight);
+    CDataStream ss = SerializeOutput(txid, n, out, nCoinsHeight, fCoinBase);
+    muhashSerialized.Remove((const unsigned char*)&ss[0], ss.size());
+}
+
+uint256 CCoinsStats::GetHashSerialized() const
+{
+    uint256 hash;
+    muhashSerialized.Finalize(hash.begin());
+    return hash;
+}
+
+CAmount CCoinsStats::GetAccruedInterest() const
+{
+    // The discounted amount grown to nHeight, less the amount, worked out
+    // so as to keep precision when the interest is small next to the amount.
+    // Values beyond 2^53 are rounded when discounted, so a set with next to
+    // no interest due could come out a few satoshis short of none.
+    CAmount nInterest = (CAmount)floor(nDiscountedAmount * expm1(nHeight * log1p(InterestCompoundingRate())) + 0.5) - (nTotalAmount - nDiscountedAmount);
+    return std::max(nInterest, (CAmount)0);
+}
+
+
 bool CCoinsView::GetCoins(const uint256 &txid, CCoins &coins) const { return false; }
 bool CCoinsView::HaveCoins(const uint256 &txid) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(0); }
@@ -7,6 +7,7 @@
 #define BITCOIN_COINS_H
 
 #include "compressor.h"
+#include "crypto/muhash.h"
 #include "serialize.h"
 #include "uint256.h"
 #include "undo.h"
@@ -291,17 +292,46 @@ struct CCoinsCacheEntry
 
 typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
 
+/**
+ * Statistics of the unspent transaction output set at a block. They are made
+ * of sums and a set hash over the outputs each, whatever order these are
+ * counted in, so once GetStats() has counted them they can be kept up to
+ * date block by block, by adding the outputs each block creates and
+ * removing those it spends.
+ */
 struct CCoinsStats
 {
     int nHeight;
     uint256 hashBlock;
     uint64_t nTransactions;
     uint64_t nTransactionOutputs;
-    uint64_t nSerializedSize;
-    uint256 hashSerialized;
+    CMuHash3072 muhashSerialized; //!< The serialized outputs, as a set
     CAmount nTotalAmount;
+    CAmount nDiscountedAmount; //!< Sum of the values discounted to height 0 at the interest rate
+
+    CCoinsStats() : nHeight(0), hashBlock(0), nTransactions(0), nTransactionOutputs(0), nTotalAmount(0), nDiscountedAmount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nHeight);
+        READWRITE(hashBlock);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(muhashSerialized);
+        READWRITE(nTotalAmount);
+        READWRITE(nDiscountedAmount);
+    }
 
-    CCoinsStats() : nHeight(0), hashBlock(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), hashSerialized(0), nTotalAmount(0) {}
+    //! Count in output n of txid, created at nCoinsHeight
+    void AddOutput(const uint256& txid, unsigned int n, const CTxOut& out, int nCoinsHeight, bool fCoinBase);
+    //! Count out an output AddOutput() counted in
+    void RemoveOutput(const uint256& txid, unsigned int n, const CTxOut& out, int nCoinsHeight, bool fCoinBase);
+    //! The hash of the outputs as a set: the same for the same outputs, however they were counted
+    uint256 GetHashSerialized() const;
+    //! Interest accrued on the outputs by nHeight: what ComputeInterest() gives for each, summed, to within rounding
+    CAmount GetAccruedInterest() const;
 };
 
 
@@ -92,4 +92,13 @@ typedef u_int SOCKET;
 size_t strnlen( const char *start, size_t max_len);
 #endif // HAVE_DECL_STRNLEN
 
+/** Whether select() can wait for the socket; it only takes descriptors below FD_SETSIZE */
+bool static inline IsSelectableSocket(SOCKET s) {
+#ifdef WIN32
+    return true;
+#else
+    return (s < FD_SETSIZE);
+#endif
+}
+
 #endif // BITCOIN_COMPAT_H
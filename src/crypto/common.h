@@ -15,6 +15,11 @@
 #include <endian.h>
 #endif
 
+uint16_t static inline ReadLE16(const unsigned char* ptr)
+{
+    return ((uint16_t)ptr[1] << 8 | (uint16_t)ptr[0]);
+}
+
 uint32_t static inline ReadLE32(const unsigned char* ptr)
 {
 #if HAVE_DECL_LE32TOH == 1
@@ -0,0 +1,149 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/sha256.h"
+#include "crypto/sha512.h"
+
+#include <string.h>
+
+namespace
+{
+/** 2^3072 - MAX_PRIME_DIFF is prime, so 2^3072 is MAX_PRIME_DIFF modulo it */
+const Num3072::limb_t MAX_PRIME_DIFF = 1103717;
+
+/** The number an element hashes to: SHA-512 of counters under its SHA-256 hash, to make up 3072 bits */
+Num3072 ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    unsigned char buf[Num3072::BYTE_SIZE];
+    for (unsigned char i = 0; i < Num3072::BYTE_SIZE / CSHA512::OUTPUT_SIZE; i++)
+        CSHA512().Write(key, sizeof(key)).Write(&i, 1).Finalize(buf + i * CSHA512::OUTPUT_SIZE);
+    return Num3072(buf);
+}
+} // anon namespace
+
+Num3072::Num3072()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; i++)
+        limbs[i] = 0;
+}
+
+Num3072::Num3072(const unsigned char data[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; i++) {
+        limb_t limb = 0;
+        for (int j = LIMB_SIZE / 8 - 1; j >= 0; j--)
+            limb = (limb << 8) | data[i * (LIMB_SIZE / 8) + j];
+        limbs[i] = limb;
+    }
+    if (IsOverflow())
+        FullReduce();
+}
+
+void Num3072::ToBytes(unsigned char out[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; i++) {
+        for (int j = 0; j < LIMB_SIZE / 8; j++)
+            out[i * (LIMB_SIZE / 8) + j] = (unsigned char)(limbs[i] >> (8 * j));
+    }
+}
+
+/** Whether the number is at least the prime, which it is less than twice */
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= ~(limb_t)0 - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; i++) {
+        if (limbs[i] != ~(limb_t)0)
+            return false;
+    }
+    return true;
+}
+
+/** Subtract the prime: add MAX_PRIME_DIFF, and drop the 2^3072 that carries out */
+void Num3072::FullReduce()
+{
+    double_limb_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; i++) {
+        c += limbs[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t t[2 * LIMBS];
+    memset(t, 0, sizeof(t));
+    for (int i = 0; i < LIMBS; i++) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; j++) {
+            double_limb_t x = (double_limb_t)limbs[i] * a.limbs[j] + t[i + j] + carry;
+            t[i + j] = (limb_t)x;
+            carry = (limb_t)(x >> LIMB_SIZE);
+        }
+        t[i + LIMBS] = carry;
+    }
+
+    // Fold the upper half of the product onto the lower one, times
+    // MAX_PRIME_DIFF, and then what carries out of that, until nothing does
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        double_limb_t x = (double_limb_t)t[i + LIMBS] * MAX_PRIME_DIFF + t[i] + carry;
+        limbs[i] = (limb_t)x;
+        carry = (limb_t)(x >> LIMB_SIZE);
+    }
+    while (carry) {
+        double_limb_t c = (double_limb_t)carry * MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c; i++) {
+            c += limbs[i];
+            limbs[i] = (limb_t)c;
+            c >>= LIMB_SIZE;
+        }
+        carry = (limb_t)c;
+    }
+    if (IsOverflow())
+        FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // p - 2 = 2^3072 - MAX_PRIME_DIFF - 2: all ones but in the lowest limb
+    const limb_t nLowest = ~(limb_t)0 - MAX_PRIME_DIFF - 1;
+    Num3072 r;
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        limb_t e = i ? ~(limb_t)0 : nLowest;
+        for (int b = LIMB_SIZE - 1; b >= 0; b--) {
+            r.Multiply(r);
+            if ((e >> b) & 1)
+                r.Multiply(*this);
+        }
+    }
+    return r;
+}
+
+CMuHash3072& CMuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+CMuHash3072& CMuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+void CMuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    Num3072 x = denominator.GetInverse();
+    x.Multiply(numerator);
+    unsigned char buf[Num3072::BYTE_SIZE];
+    x.ToBytes(buf);
+    CSHA256().Write(buf, sizeof(buf)).Finalize(hash);
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717, least significant limb first. */
+class Num3072
+{
+public:
+#ifdef __SIZEOF_INT128__
+    typedef uint64_t limb_t;
+    __extension__ typedef unsigned __int128 double_limb_t;
+#else
+    typedef uint32_t limb_t;
+    typedef uint64_t double_limb_t;
+#endif
+    static const int LIMB_SIZE = 8 * sizeof(limb_t);
+    static const int LIMBS = 3072 / LIMB_SIZE;
+    static const size_t BYTE_SIZE = 384;
+
+    limb_t limbs[LIMBS];
+
+    //! The number 1
+    Num3072();
+    //! The little endian number of BYTE_SIZE bytes, reduced
+    explicit Num3072(const unsigned char data[BYTE_SIZE]);
+
+    void Multiply(const Num3072& a);
+    //! This number to the power p - 2: its inverse, for one not 0
+    Num3072 GetInverse() const;
+    void ToBytes(unsigned char out[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+};
+
+/**
+ * A hash of a set of byte strings, MuHash over the group of integers modulo
+ * a 3072-bit prime: each element is hashed to a number, and the set's hash
+ * is the product of those. Elements are added and removed in any order, so
+ * that the hash of a set can be kept up to date as it changes, and finding
+ * two sets with the same hash is as hard as the discrete logarithm problem
+ * in that group. Removed elements are multiplied into a denominator, which
+ * is only divided out by Finalize().
+ */
+class CMuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! The hash of the empty set
+    CMuHash3072() {}
+
+    CMuHash3072& Insert(const unsigned char* data, size_t len);
+    CMuHash3072& Remove(const unsigned char* data, size_t len);
+    //! The SHA-256 hash of the set's number, as the little endian bytes of it
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 2 * Num3072::BYTE_SIZE;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        unsigned char buf[Num3072::BYTE_SIZE];
+        numerator.ToBytes(buf);
+        s.write((const char*)buf, sizeof(buf));
+        denominator.ToBytes(buf);
+        s.write((const char*)buf, sizeof(buf));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        unsigned char buf[Num3072::BYTE_SIZE];
+        s.read((char*)buf, sizeof(buf));
+        numerator = Num3072(buf);
+        s.read((char*)buf, sizeof(buf));
+        denominator = Num3072(buf);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -0,0 +1,224 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CUCKOOCACHE_H
+#define BITCOIN_CUCKOOCACHE_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_array.hpp>
+
+/** Counters describing how a CCuckooCache has been used. */
+struct CCuckooCacheStats
+{
+    size_t nSlots;
+    size_t nBytes;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nInserts;
+    uint64_t nEvictions;
+
+    CCuckooCacheStats() : nSlots(0), nBytes(0), nHits(0), nMisses(0), nInserts(0), nEvictions(0) {}
+};
+
+/**
+ * Fixed-size set of 256-bit digests, with lock-free lookup and insertion.
+ *
+ * Elements must already be uniformly distributed (e.g. the output of a
+ * salted hash), as the eight candidate slots of an element are taken
+ * directly from its eight 32-bit words. The all-zero digest is reserved to
+ * mark an empty slot.
+ *
+ * Every slot is protected by its own sequence counter: writers claim a
+ * slot by moving the counter from even to odd with a compare-and-swap, and
+ * readers only accept a match when they observed the same even counter
+ * before and after reading the digest. A writer that loses a race simply
+ * gives up, and a reader that races a writer reports a miss; both are
+ * harmless for a cache, and neither can produce a false positive.
+ *
+ * When all candidate slots are occupied, insertion displaces the occupant
+ * of one of them to one of its own alternative slots (cuckoo hashing), up
+ * to a bounded number of hops, after which the last displaced element is
+ * dropped.
+ */
+class CCuckooCache
+{
+public:
+    static const unsigned int NUM_HASHES = 8;
+
+private:
+    struct Slot
+    {
+        //! even: stable, odd: being written
+        boost::atomic<uint32_t> nSequence;
+        boost::atomic<uint32_t> words[8];
+    };
+
+    boost::scoped_array<Slot> slots;
+    uint32_t nSlots;
+    unsigned int nMaxDepth;
+
+    //! rotates the choice of victim when every candidate slot is taken
+    boost::atomic<uint32_t> nVictim;
+
+    boost::atomic<uint64_t> nHits;
+    boost::atomic<uint64_t> nMisses;
+    boost::atomic<uint64_t> nInserts;
+    boost::atomic<uint64_t> nEvictions;
+
+    static void Split(const uint256& e, uint32_t w[8])
+    {
+        memcpy(w, e.begin(), 32);
+    }
+
+    static bool IsEmpty(const uint32_t w[8])
+    {
+        uint32_t acc = 0;
+        for (unsigned int i = 0; i < 8; i++)
+            acc |= w[i];
+        return acc == 0;
+    }
+
+    void Locations(const uint32_t w[8], uint32_t locs[NUM_HASHES]) const
+    {
+        // Map each word onto [0, nSlots) without a division.
+        for (unsigned int i = 0; i < NUM_HASHES; i++)
+            locs[i] = (uint32_t)(((uint64_t)w[i] * (uint64_t)nSlots) >> 32);
+    }
+
+    /** Read a slot; returns false if a writer interfered. */
+    bool Load(const Slot& slot, uint32_t out[8], uint32_t& nSeq) const
+    {
+        nSeq = slot.nSequence.load(boost::memory_order_acquire);
+        if (nSeq & 1)
+            return false;
+        for (unsigned int i = 0; i < 8; i++)
+            out[i] = slot.words[i].load(boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        return slot.nSequence.load(boost::memory_order_relaxed) == nSeq;
+    }
+
+    /** Overwrite a slot that was observed at sequence nSeq; fails if it changed since. */
+    bool Store(Slot& slot, const uint32_t in[8], uint32_t nSeq)
+    {
+        if (!slot.nSequence.compare_exchange_strong(nSeq, nSeq + 1, boost::memory_order_acquire, boost::memory_order_relaxed))
+            return false;
+        boost::atomic_thread_fence(boost::memory_order_release);
+        for (unsigned int i = 0; i < 8; i++)
+            slot.words[i].store(in[i], boost::memory_order_relaxed);
+        slot.nSequence.store(nSeq + 2, boost::memory_order_release);
+        return true;
+    }
+
+public:
+    CCuckooCache() : nSlots(0), nMaxDepth(0), nVictim(0), nHits(0), nMisses(0), nInserts(0), nEvictions(0) {}
+
+    /**
+     * Allocate room for as many elements as fit in nBytes. Not thread safe:
+     * must be called before the cache is shared. Returns the number of slots.
+     */
+    uint32_t Setup(size_t nBytes)
+    {
+        size_t n = nBytes / sizeof(Slot);
+        if (n > 0xffffffffU)
+            n = 0xffffffffU;
+        nSlots = n;
+        slots.reset(nSlots ? new Slot[nSlots] : NULL);
+        for (uint32_t i = 0; i < nSlots; i++) {
+            slots[i].nSequence.store(0, boost::memory_order_relaxed);
+            for (unsigned int j = 0; j < 8; j++)
+                slots[i].words[j].store(0, boost::memory_order_relaxed);
+        }
+        // About log2(nSlots) hops are enough to find a free slot while
+        // the table is not saturated.
+        nMaxDepth = 1;
+        for (uint32_t m = nSlots; m > 1; m >>= 1)
+            nMaxDepth++;
+        boost::atomic_thread_fence(boost::memory_order_seq_cst);
+        return nSlots;
+    }
+
+    /** Returns whether e is in the cache, removing it if fErase is set. */
+    bool Contains(const uint256& e, bool fErase)
+    {
+        uint32_t w[8], locs[NUM_HASHES];
+        Split(e, w);
+        if (nSlots == 0 || IsEmpty(w)) {
+            nMisses.fetch_add(1, boost::memory_order_relaxed);
+            return false;
+        }
+        Locations(w, locs);
+        for (unsigned int i = 0; i < NUM_HASHES; i++) {
+            Slot& slot = slots[locs[i]];
+            uint32_t cur[8], nSeq;
+            if (!Load(slot, cur, nSeq) || memcmp(cur, w, sizeof(cur)) != 0)
+                continue;
+            if (fErase) {
+                static const uint32_t empty[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+                Store(slot, empty, nSeq);
+            }
+            nHits.fetch_add(1, boost::memory_order_relaxed);
+            return true;
+        }
+        nMisses.fetch_add(1, boost::memory_order_relaxed);
+        return false;
+    }
+
+    /** Add e to the cache, possibly evicting an older element. */
+    void Insert(const uint256& e)
+    {
+        uint32_t w[8], locs[NUM_HASHES];
+        Split(e, w);
+        if (nSlots == 0 || IsEmpty(w))
+            return;
+        nInserts.fetch_add(1, boost::memory_order_relaxed);
+        for (unsigned int nDepth = 0; nDepth < nMaxDepth; nDepth++) {
+            Locations(w, locs);
+            uint32_t nSeqs[NUM_HASHES];
+            for (unsigned int i = 0; i < NUM_HASHES; i++) {
+                uint32_t cur[8];
+                if (!Load(slots[locs[i]], cur, nSeqs[i])) {
+                    nSeqs[i] = 1; // contended, don't pick it as a victim
+                    continue;
+                }
+                if (memcmp(cur, w, sizeof(cur)) == 0)
+                    return;
+                if (IsEmpty(cur) && Store(slots[locs[i]], w, nSeqs[i]))
+                    return;
+            }
+
+            // Every candidate is taken: swap ourselves into one of them and
+            // carry on with the element we displaced.
+            unsigned int i = nVictim.fetch_add(1, boost::memory_order_relaxed) % NUM_HASHES;
+            if (nSeqs[i] & 1)
+                break;
+            Slot& slot = slots[locs[i]];
+            uint32_t displaced[8], nSeq;
+            if (!Load(slot, displaced, nSeq) || nSeq != nSeqs[i] || !Store(slot, w, nSeq))
+                break;
+            if (IsEmpty(displaced))
+                return;
+            memcpy(w, displaced, sizeof(w));
+        }
+        nEvictions.fetch_add(1, boost::memory_order_relaxed);
+    }
+
+    CCuckooCacheStats GetStats() const
+    {
+        CCuckooCacheStats stats;
+        stats.nSlots = nSlots;
+        stats.nBytes = (size_t)nSlots * sizeof(Slot);
+        stats.nHits = nHits.load(boost::memory_order_relaxed);
+        stats.nMisses = nMisses.load(boost::memory_order_relaxed);
+        stats.nInserts = nInserts.load(boost::memory_order_relaxed);
+        stats.nEvictions = nEvictions.load(boost::memory_order_relaxed);
+        return stats;
+    }
+};
+
+#endif // BITCOIN_CUCKOOCACHE_H
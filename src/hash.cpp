@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "crypto/common.h"
 #include "crypto/hmac_sha512.h"
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
@@ -69,6 +70,94 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
     return h1;
 }
 
+static const uint32_t MURMUR_C1 = 0xcc9e2d51;
+static const uint32_t MURMUR_C2 = 0x1b873593;
+
+/** The seed-independent part of a MurmurHash3 round. */
+static inline uint32_t MurmurMix(uint32_t k1)
+{
+    k1 *= MURMUR_C1;
+    k1 = ROTL32(k1, 15);
+    k1 *= MURMUR_C2;
+    return k1;
+}
+
+/** Fold a mixed word into the state. */
+static inline uint32_t MurmurRound(uint32_t h1, uint32_t k1)
+{
+    h1 ^= k1;
+    h1 = ROTL32(h1, 13);
+    return h1 * 5 + 0xe6546b64;
+}
+
+static inline uint32_t MurmurFinalize(uint32_t h1, uint32_t nTail, uint32_t nLength)
+{
+    h1 ^= nTail;
+    h1 ^= nLength;
+    h1 ^= h1 >> 16;
+    h1 *= 0x85ebca6b;
+    h1 ^= h1 >> 13;
+    h1 *= 0xc2b2ae35;
+    h1 ^= h1 >> 16;
+    return h1;
+}
+
+void CMurmurHash3Multi::Set(const unsigned char* pch, size_t nLen)
+{
+    nLength = nLen;
+    nWords = nLen / 4;
+    uint32_t* pWordsOut = aInlineWords;
+    if (nWords > INLINE_WORDS) {
+        vHeapWords.resize(nWords);
+        pWordsOut = &vHeapWords[0];
+    }
+    for (unsigned int i = 0; i < nWords; i++)
+        pWordsOut[i] = MurmurMix(ReadLE32(pch + 4 * i));
+    pWords = pWordsOut;
+
+    const unsigned char* tail = pch + 4 * nWords;
+    uint32_t k1 = 0;
+    switch (nLen & 3) {
+    case 3:
+        k1 ^= tail[2] << 16;
+    case 2:
+        k1 ^= tail[1] << 8;
+    case 1:
+        k1 ^= tail[0];
+    }
+    // A zero tail word mixes to zero, so the XOR with it is a no-op then
+    nTail = MurmurMix(k1);
+}
+
+uint32_t CMurmurHash3Multi::Hash(uint32_t nSeed) const
+{
+    uint32_t h1 = nSeed;
+    for (unsigned int i = 0; i < nWords; i++)
+        h1 = MurmurRound(h1, pWords[i]);
+    return MurmurFinalize(h1, nTail, nLength);
+}
+
+void CMurmurHash3Multi::Hash(const uint32_t* pnSeeds, uint32_t* pnHashes, unsigned int nSeeds) const
+{
+    unsigned int n = 0;
+    for (; n + 4 <= nSeeds; n += 4) {
+        uint32_t h0 = pnSeeds[n], h1 = pnSeeds[n + 1], h2 = pnSeeds[n + 2], h3 = pnSeeds[n + 3];
+        for (unsigned int i = 0; i < nWords; i++) {
+            uint32_t k1 = pWords[i];
+            h0 = MurmurRound(h0, k1);
+            h1 = MurmurRound(h1, k1);
+            h2 = MurmurRound(h2, k1);
+            h3 = MurmurRound(h3, k1);
+        }
+        pnHashes[n] = MurmurFinalize(h0, nTail, nLength);
+        pnHashes[n + 1] = MurmurFinalize(h1, nTail, nLength);
+        pnHashes[n + 2] = MurmurFinalize(h2, nTail, nLength);
+        pnHashes[n + 3] = MurmurFinalize(h3, nTail, nLength);
+    }
+    for (; n < nSeeds; n++)
+        pnHashes[n] = Hash(pnSeeds[n]);
+}
+
 void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64])
 {
     unsigned char num[4];
@@ -81,3 +170,131 @@ void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned
                                .Write(num, 4)
                                .Finalize(output);
 }
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND do { \
+    v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; \
+    v0 = ROTL(v0, 32); \
+    v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; \
+    v2 = ROTL(v2, 32); \
+} while (0)
+
+CSipHasher::CSipHasher(uint64_t k0, uint64_t k1)
+{
+    v[0] = 0x736f6d6570736575ULL ^ k0;
+    v[1] = 0x646f72616e646f6dULL ^ k1;
+    v[2] = 0x6c7967656e657261ULL ^ k0;
+    v[3] = 0x7465646279746573ULL ^ k1;
+    count = 0;
+    tmp = 0;
+}
+
+CSipHasher& CSipHasher::Write(uint64_t data)
+{
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+
+    assert(count % 8 == 0);
+
+    v3 ^= data;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= data;
+
+    v[0] = v0;
+    v[1] = v1;
+    v[2] = v2;
+    v[3] = v3;
+
+    count += 8;
+    return *this;
+}
+
+CSipHasher& CSipHasher::Write(const unsigned char* data, size_t size)
+{
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+    uint64_t t = tmp;
+    int c = count;
+
+    while (size--) {
+        t |= ((uint64_t)(*(data++))) << (8 * (c % 8));
+        c++;
+        if ((c & 7) == 0) {
+            v3 ^= t;
+            SIPROUND;
+            SIPROUND;
+            v0 ^= t;
+            t = 0;
+        }
+    }
+
+    v[0] = v0;
+    v[1] = v1;
+    v[2] = v2;
+    v[3] = v3;
+    count = c;
+    tmp = t;
+
+    return *this;
+}
+
+uint64_t CSipHasher::Finalize() const
+{
+    uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+
+    uint64_t t = tmp | (((uint64_t)count) << 56);
+
+    v3 ^= t;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= t;
+    v2 ^= 0xFF;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val)
+{
+    /* Specialized implementation for efficiency */
+    const unsigned char* p = val.begin();
+    uint64_t d = ReadLE64(p);
+
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1 ^ d;
+
+    SIPROUND;
+    SIPROUND;
+    v0 ^= d;
+    d = ReadLE64(p + 8);
+    v3 ^= d;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= d;
+    d = ReadLE64(p + 16);
+    v3 ^= d;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= d;
+    d = ReadLE64(p + 24);
+    v3 ^= d;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= d;
+    v3 ^= ((uint64_t)4) << 59;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= ((uint64_t)4) << 59;
+    v2 ^= 0xFF;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -127,12 +127,19 @@ public:
     int nVersion;
 
     CHashWriter(int nTypeIn, int nVersionIn) : nType(nTypeIn), nVersion(nVersionIn) {}
+    //! Continue hashing from a state previously obtained with GetState()
+    CHashWriter(int nTypeIn, int nVersionIn, const CHash256& ctxIn) : ctx(ctxIn), nType(nTypeIn), nVersion(nVersionIn) {}
 
     CHashWriter& write(const char *pch, size_t size) {
         ctx.Write((const unsigned char*)pch, size);
         return (*this);
     }
 
+    //! Snapshot of the hasher state, to resume a common prefix later
+    CHash256 GetState() const {
+        return ctx;
+    }
+
     // invalidates the object
     uint256 GetHash() {
         uint256 result;
@@ -159,6 +166,67 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/**
+ * MurmurHash3 (x86_32) of one piece of data under many seeds, as needed for
+ * the probes of a bloom filter. Hash(nSeed) equals MurmurHash3(nSeed, data).
+ *
+ * The mixing of each data word does not depend on the seed, so Set() does it
+ * once, and each seed only pays for the rounds that fold the mixed words
+ * into its state. Hash() of several seeds runs four seeds side by side, so
+ * that their otherwise serial multiply-rotate chains overlap.
+ */
+class CMurmurHash3Multi
+{
+private:
+    static const unsigned int INLINE_WORDS = 32;
+
+    uint32_t aInlineWords[INLINE_WORDS]; //!< Mixed words of data up to 128 bytes
+    std::vector<uint32_t> vHeapWords;    //!< Mixed words of longer data
+    const uint32_t* pWords;
+    unsigned int nWords;
+    uint32_t nTail;   //!< Mixed tail bytes; 0 if there are none
+    uint32_t nLength;
+
+    CMurmurHash3Multi(const CMurmurHash3Multi&);
+    void operator=(const CMurmurHash3Multi&);
+
+public:
+    CMurmurHash3Multi() : pWords(aInlineWords), nWords(0), nTail(0), nLength(0) {}
+    CMurmurHash3Multi(const unsigned char* pch, size_t nLen) { Set(pch, nLen); }
+    explicit CMurmurHash3Multi(const std::vector<unsigned char>& vch) { Set(vch); }
+
+    /** Hash this data from now on; the object can be reused for any number of pieces. */
+    void Set(const unsigned char* pch, size_t nLen);
+    void Set(const std::vector<unsigned char>& vch) { Set(vch.empty() ? NULL : &vch[0], vch.size()); }
+
+    uint32_t Hash(uint32_t nSeed) const;
+
+    /** pnHashes[i] = Hash(pnSeeds[i]) for i < nSeeds. */
+    void Hash(const uint32_t* pnSeeds, uint32_t* pnHashes, unsigned int nSeeds) const;
+};
+
+/** SipHash-2-4, a fast keyed hash for short inputs. */
+class CSipHasher
+{
+private:
+    uint64_t v[4];
+    uint64_t tmp;
+    int count;
+
+public:
+    /** Construct a SipHash calculator initialized with 128-bit key (k0, k1) */
+    CSipHasher(uint64_t k0, uint64_t k1);
+    /** Hash a 64-bit integer worth of data; only valid while the number of bytes written so far is a multiple of 8 */
+    CSipHasher& Write(uint64_t data);
+    /** Hash arbitrary bytes. */
+    CSipHasher& Write(const unsigned char* data, size_t size);
+    /** Compute the 64-bit SipHash-2-4 of the data written so far. The object remains untouched. */
+    uint64_t Finalize() const;
+};
+
+/** Optimized SipHash-2-4 of a uint256, equivalent to writing its 32 bytes to a CSipHasher. */
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
+
 void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
 #endif // BITCOIN_HASH_H
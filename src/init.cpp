@@ -9,17 +9,24 @@
 
 #include "init.h"
 
+#include "addressindex.h"
 #include "addrman.h"
 #include "amount.h"
+#include "blockfilterindex.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "key.h"
 #include "main.h"
 #include "miner.h"
 #include "net.h"
+#include "pushnotify.h"
 #include "rpcserver.h"
 #include "script/standard.h"
+#include "socketpoll.h"
+#include "spentindex.h"
+#include "timestampindex.h"
 #include "txdb.h"
+#include "txindexreader.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -50,6 +57,7 @@ using namespace std;
 CWallet* pwalletMain = NULL;
 #endif
 bool fFeeEstimatesInitialized = false;
+static CPushNotifier* pPushNotifier = NULL;
 
 #ifdef WIN32
 // Win32 LevelDB doesn't use filedescriptors, and the ones used for
@@ -57,7 +65,8 @@ bool fFeeEstimatesInitialized = false;
 // anyway.
 #define MIN_CORE_FILEDESCRIPTORS 0
 #else
-#define MIN_CORE_FILEDESCRIPTORS 150
+// Including the block files kept open for -txindex lookups
+#define MIN_CORE_FILEDESCRIPTORS (150 + (int)TXINDEX_OPEN_FILES)
 #endif
 
 /** Used to pass flags to the Bind() function */
@@ -137,6 +146,12 @@ void Shutdown()
     StopNode();
     UnregisterNodeSignals(GetNodeSignals());
 
+    if (pPushNotifier) {
+        UnregisterValidationInterface(pPushNotifier);
+        delete pPushNotifier;
+        pPushNotifier = NULL;
+    }
+
     if (fFeeEstimatesInitialized)
     {
         boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
@@ -159,6 +174,8 @@ void Shutdown()
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
+        delete pblockfilterindex;
+        pblockfilterindex = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -217,8 +234,11 @@ std::string HelpMessage(HelpMessageMode mode)
     // When adding new options to the categories, please keep and ensure alphabetical ordering.
     string strUsage = _("Options:") + "\n";
     strUsage += "  -?                     " + _("This help message") + "\n";
+    strUsage += "  -addressindex          " + strprintf(_("Maintain an index of the outputs paid to and spent from each address, used by the getaddress* rpc calls; turning it on indexes the existing chain in the background (default: %u)"), DEFAULT_ADDRESSINDEX) + "\n";
     strUsage += "  -alertnotify=<cmd>     " + _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)") + "\n";
     strUsage += "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n";
+    strUsage += "  -blockreconstructionextratxn=<n> " + strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN) + "\n";
+    strUsage += "  -blockfilterindex      " + strprintf(_("Maintain an index of compact (BIP 158) block filters, used by the getblockfilter RPC call and REST interface (default: %u)"), DEFAULT_BLOCKFILTERINDEX) + "\n";
     strUsage += "  -checkblocks=<n>       " + strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), 288) + "\n";
     strUsage += "  -checklevel=<n>        " + strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), 3) + "\n";
     strUsage += "  -conf=<file>           " + strprintf(_("Specify configuration file (default: %s)"), "ribbitcoin.conf") + "\n";
@@ -237,9 +257,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -pid=<file>            " + strprintf(_("Specify pid file (default: %s)"), "ribbitcoind.pid") + "\n";
 #endif
     strUsage += "  -reindex               " + _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup") + "\n";
+    strUsage += "  -spentindex            " + strprintf(_("Maintain an index of the inputs spending each output, used by the getspentinfo rpc call (default: %u)"), DEFAULT_SPENTINDEX) + "\n";
 #if !defined(WIN32)
     strUsage += "  -sysperms              " + _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)") + "\n";
 #endif
+    strUsage += "  -timestampindex        " + strprintf(_("Maintain an index of the blocks by timestamp, used by the getblockhashes rpc call (default: %u)"), DEFAULT_TIMESTAMPINDEX) + "\n";
     strUsage += "  -txindex               " + strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), 1) + "\n";
 
     strUsage += "\n" + _("Connection options:") + "\n";
@@ -257,12 +279,15 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -maxconnections=<n>    " + strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125) + "\n";
     strUsage += "  -maxreceivebuffer=<n>  " + strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000) + "\n";
     strUsage += "  -maxsendbuffer=<n>     " + strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000) + "\n";
+    strUsage += "  -maxuploadtarget=<n>   " + strprintf(_("Tries to keep outbound traffic under the given target (in MiB per 24h); blocks older than a week are no longer served to non-whitelisted peers once the rest of the budget is needed to relay new blocks. 0 = no limit (default: %d)"), DEFAULT_MAX_UPLOAD_TARGET) + "\n";
+    strUsage += "  -msghandthreads=<n>    " + strprintf(_("Number of threads processing peer messages (1 to %d, default: %d)"), MAX_MSGHAND_THREADS, DEFAULT_MSGHAND_THREADS) + "\n";
     strUsage += "  -onion=<ip:port>       " + strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy") + "\n";
     strUsage += "  -onlynet=<net>         " + _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)") + "\n";
     strUsage += "  -permitbaremultisig    " + strprintf(_("Relay non-P2SH multisig (default: %u)"), 1) + "\n";
     strUsage += "  -port=<port>           " + strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), 3764, 13764) + "\n";
     strUsage += "  -proxy=<ip:port>       " + _("Connect through SOCKS5 proxy") + "\n";
     strUsage += "  -seednode=<ip>         " + _("Connect to a node to retrieve peer addresses, and disconnect") + "\n";
+    strUsage += "  -socketpoller=<name>   " + strprintf(_("Mechanism used to wait for peer sockets, epoll or select (default: %s)"), DEFAULT_SOCKET_POLLER) + "\n";
     strUsage += "  -timeout=<n>           " + strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT) + "\n";
 #ifdef USE_UPNP
 #if USE_UPNP
@@ -295,6 +320,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "                         " + _("(1 = keep tx meta data e.g. account owner and payment request information, 2 = drop tx meta data)") + "\n";
 #endif
 
+    strUsage += "\n" + _("Push notification options:") + "\n";
+    strUsage += "  -pubhashblock=<address> " + _("Publish the hashes of new tip blocks on <address>, unix:<path> or tcp://<host>:<port>") + "\n";
+    strUsage += "  -pubhashtx=<address>   " + _("Publish the hashes of transactions accepted to the memory pool or in new blocks on <address>") + "\n";
+    strUsage += "  -pubrawblock=<address> " + _("Publish new tip blocks on <address>") + "\n";
+    strUsage += "  -pubrawtx=<address>    " + _("Publish transactions accepted to the memory pool or in new blocks on <address>") + "\n";
+    strUsage += "  -pubbuffer=<n>         " + strprintf(_("Messages kept for a subscriber that reads too slowly, in MiB, beyond which it misses new ones (default: %u)"), DEFAULT_PUB_BUFFER) + "\n";
+
     strUsage += "\n" + _("Debugging/Testing options:") + "\n";
     if (GetBoolArg("-help-debug", false))
     {
@@ -310,7 +342,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -debug=<category>      " + strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + "\n";
     strUsage += "                         " + _("If <category> is not supplied, output all debugging information.") + "\n";
     strUsage += "                         " + _("<category> can be:");
-    strUsage +=                                 " addrman, alert, bench, coindb, db, lock, rand, rpc, selectcoins, mempool, net"; // Don't translate these and qt below
+    strUsage +=                                 " addrman, alert, bench, coindb, db, lock, rand, rpc, selectcoins, mempool, net, pushnotify"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         strUsage += ", qt";
     strUsage += ".\n";
@@ -324,7 +356,7 @@ std::string HelpMessage(HelpMessageMode mode)
     if (GetBoolArg("-help-debug", false))
     {
         strUsage += "  -limitfreerelay=<n>    " + strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15) + "\n";
-        strUsage += "  -maxsigcachesize=<n>   " + strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), 50000) + "\n";
+        strUsage += "  -maxsigcachesize=<n>   " + strprintf(_("Limit size of signature cache to <n> MiB (default: %u, at most: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE, MAX_MAX_SIG_CACHE_SIZE) + "\n";
     }
     strUsage += "  -minrelaytxfee=<amt>   " + strprintf(_("Fees (in BTC/Kb) smaller than this are considered zero fee for relaying (default: %s)"), FormatMoney(::minRelayTxFee.GetFeePerK())) + "\n";
     strUsage += "  -printtoconsole        " + _("Send trace/debug info to console instead of debug.log file") + "\n";
@@ -358,6 +390,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += "  -rpcport=<port>        " + strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 3763, 13763) + "\n";
     strUsage += "  -rpcallowip=<ip>       " + _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times") + "\n";
     strUsage += "  -rpcthreads=<n>        " + strprintf(_("Set the number of threads to service RPC calls (default: %d)"), 8) + "\n";
+    strUsage += "  -rpcworkqueue=<n>      " + strprintf(_("Set the depth of the work queue to service RPC calls (default: %d)"), DEFAULT_RPC_WORKQUEUE) + "\n";
+    strUsage += "  -rpcmaxbatchsize=<n>   " + strprintf(_("Maximum number of calls in a JSON-RPC batch request (default: %d)"), DEFAULT_RPC_MAX_BATCH_SIZE) + "\n";
+    strUsage += "  -rpcbatchtimeout=<n>   " + strprintf(_("Calls of a JSON-RPC batch request not started after this many seconds fail (default: %d)"), DEFAULT_RPC_BATCH_TIMEOUT) + "\n";
+    strUsage += "  -rpcservertimeout=<n>  " + strprintf(_("Timeout in seconds for idle HTTP connections (default: %d)"), DEFAULT_RPC_SERVER_TIMEOUT) + "\n";
+    strUsage += "  -rpcstatsinterval=<n>  " + strprintf(_("Write the latencies of the RPC methods called to the log every <n> seconds, 0 to never (default: %d)"), DEFAULT_RPC_STATS_INTERVAL) + "\n";
 
     strUsage += "\n" + _("RPC SSL options: (see the Bitcoin Wiki for SSL setup instructions)") + "\n";
     strUsage += "  -rpcssl                                  " + _("Use OpenSSL (https) for JSON-RPC connections") + "\n";
@@ -617,10 +654,23 @@ bool AppInit2(boost::thread_group& threadGroup)
     else
         miningAlgo = ALGO_SHA256D;
 
+    // Only select() limits the number of sockets to FD_SETSIZE
+    bool fSetSizeLimited = true;
+    {
+        std::string strPoller = GetArg("-socketpoller", DEFAULT_SOCKET_POLLER);
+        CSocketPoller* pPoller = CreateSocketPoller(strPoller);
+        if (!pPoller)
+            return InitError(strprintf(_("Unsupported -socketpoller: '%s'"), strPoller));
+        fSetSizeLimited = pPoller->IsLimitedBySetSize();
+        SetSocketPoller(pPoller);
+    }
+
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", 125);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    if (fSetSizeLimited)
+        nMaxConnections = std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS));
+    nMaxConnections = std::max(nMaxConnections, 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -661,6 +711,10 @@ bool AppInit2(boost::thread_group& threadGroup)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // -maxsigcachesize used to be a number of entries, 50000 by default
+    if (GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) > MAX_MAX_SIG_CACHE_SIZE)
+        return InitError(strprintf(_("-maxsigcachesize is now in MiB and may be at most %d: '%s'"), MAX_MAX_SIG_CACHE_SIZE, mapArgs["-maxsigcachesize"]));
+
     fServer = GetBoolArg("-server", false);
 #ifdef ENABLE_WALLET
     bool fDisableWallet = GetBoolArg("-disablewallet", false);
@@ -777,6 +831,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     std::ostringstream strErrors;
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    InitSignatureCache();
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
@@ -791,6 +846,10 @@ bool AppInit2(boost::thread_group& threadGroup)
     {
         uiInterface.InitMessage.connect(SetRPCWarmupStatus);
         StartRPCThreads();
+
+        int64_t nRPCStatsInterval = GetArg("-rpcstatsinterval", DEFAULT_RPC_STATS_INTERVAL);
+        if (nRPCStatsInterval > 0)
+            threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "rpcstats", &LogRPCStats, nRPCStatsInterval * 1000));
     }
 
     int64_t nStart;
@@ -944,6 +1003,20 @@ bool AppInit2(boost::thread_group& threadGroup)
     BOOST_FOREACH(string strDest, mapMultiArgs["-seednode"])
         AddOneShot(strDest);
 
+    if (mapArgs.count("-maxuploadtarget")) {
+        int64_t nMaxUploadTarget = GetArg("-maxuploadtarget", DEFAULT_MAX_UPLOAD_TARGET);
+        if (nMaxUploadTarget < 0)
+            return InitError(strprintf(_("Invalid amount for -maxuploadtarget=<n>: '%s'"), mapArgs["-maxuploadtarget"]));
+        CNode::SetMaxOutboundTarget((uint64_t)nMaxUploadTarget * 1024 * 1024);
+    }
+
+    std::string strPushError;
+    pPushNotifier = CPushNotifier::Create(strPushError);
+    if (!strPushError.empty())
+        return InitError(strPushError);
+    if (pPushNotifier)
+        RegisterValidationInterface(pPushNotifier);
+
     // ********************************************************* Step 7: load block chain
 
     fReindex = GetBoolArg("-reindex", false);
@@ -985,6 +1058,11 @@ bool AppInit2(boost::thread_group& threadGroup)
     if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    size_t nBlockFilterIndexCache = 0;
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        nBlockFilterIndexCache = std::min(nTotalCache / 8, (size_t)(nMaxBlockFilterIndexCache << 20));
+        nTotalCache -= nBlockFilterIndexCache;
+    }
     size_t nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
@@ -1033,6 +1111,29 @@ bool AppInit2(boost::thread_group& threadGroup)
                     break;
                 }
 
+                // Check for changed -spentindex and -timestampindex state
+                if (fSpentIndex != GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
+                    break;
+                }
+                if (fTimestampIndex != GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -timestampindex");
+                    break;
+                }
+
+                // -addressindex can be turned on for a chain already connected,
+                // but turning it off needs a rebuild
+                if (fAddressIndex != GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+                    if (fAddressIndex) {
+                        strLoadError = _("You need to rebuild the database using -reindex to turn off -addressindex");
+                        break;
+                    }
+                    if (!StartAddressIndexBackfill()) {
+                        strLoadError = _("Error initializing the address index");
+                        break;
+                    }
+                }
+
                 uiInterface.InitMessage(_("Verifying blocks..."));
                 if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 3),
                               GetArg("-checkblocks", 288))) {
@@ -1239,6 +1340,18 @@ bool AppInit2(boost::thread_group& threadGroup)
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        try {
+            pblockfilterindex = new CBlockFilterIndex(BASIC_FILTER, nBlockFilterIndexCache, false, fReindex);
+        } catch (const std::exception& e) {
+            return InitError(strprintf(_("Error opening block filter index: %s"), e.what()));
+        }
+        threadGroup.create_thread(&ThreadBlockFilterIndex);
+    }
+
+    if (fAddressIndex && IsAddressIndexBackfilling())
+        threadGroup.create_thread(&ThreadAddressIndexBackfill);
+
     // ********************************************************* Step 10: start node
 
     if (!CheckDiskSpace())
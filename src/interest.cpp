@@ -3,6 +3,8 @@
 #include "interest.h"
 #include "util.h"
 
+#include <map>
+
 double InterestCompoundingRate()
 {
     //    double rate = exp(log( (1 + Params().InterestAPY() / 100 ) / 525600)) - 1;r
@@ -20,3 +22,18 @@ CAmount ComputeInterest(int n, const CTxOut& txOut)
     CAmount interest = txOut.nValue*expm1(n*log1p(r));
     return interest;
 }
+
+void ComputeInterest(const std::vector<std::pair<int, CAmount> >& vPeriodsValue, std::vector<CAmount>& vInterest)
+{
+    double r = InterestCompoundingRate();
+    std::map<int, double> mapGrowth;
+    vInterest.resize(vPeriodsValue.size());
+    for (unsigned int i = 0; i < vPeriodsValue.size(); i++) {
+        int n = vPeriodsValue[i].first;
+        std::map<int, double>::iterator it = mapGrowth.find(n);
+        if (it == mapGrowth.end())
+            it = mapGrowth.insert(std::make_pair(n, expm1(n*log1p(r)))).first;
+        CAmount interest = vPeriodsValue[i].second*it->second;
+        vInterest[i] = interest;
+    }
+}
@@ -1,6 +1,13 @@
 #include "amount.h"
 
+#include <utility>
+#include <vector>
+
+class CTxOut;
+
 double InterestRate();
 double InterestCompoundingRate();
 CAmount ComputeInterest(int periods, const CTxOut& txOut);
+/** The interest of many (periods, value) pairs, each as ComputeInterest() gives it, with the rate and growth worked out once per distinct period count */
+void ComputeInterest(const std::vector<std::pair<int, CAmount> >& vPeriodsValue, std::vector<CAmount>& vInterest);
 //#CAmount ComputeInterest(const uint256& periods, const CTxOut& txOut);
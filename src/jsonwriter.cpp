@@ -0,0 +1,120 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonwriter.h"
+
+#include <assert.h>
+
+CJSONStringWriter::CJSONStringWriter(std::string& strOutIn) : strOut(strOutIn), fAfterKey(false)
+{
+}
+
+void CJSONStringWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vFirst.empty()) {
+        if (!vFirst.back())
+            strOut += ',';
+        vFirst.back() = false;
+    }
+}
+
+void CJSONStringWriter::BeginObject()
+{
+    Separate();
+    strOut += '{';
+    vFirst.push_back(true);
+}
+
+void CJSONStringWriter::EndObject()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    strOut += '}';
+    vFirst.pop_back();
+}
+
+void CJSONStringWriter::BeginArray()
+{
+    Separate();
+    strOut += '[';
+    vFirst.push_back(true);
+}
+
+void CJSONStringWriter::EndArray()
+{
+    assert(!vFirst.empty() && !fAfterKey);
+    strOut += ']';
+    vFirst.pop_back();
+}
+
+void CJSONStringWriter::Key(const std::string& strKey)
+{
+    assert(!fAfterKey);
+    Separate();
+    // The key is escaped as any string value would be
+    strOut += UniValue(strKey).write();
+    strOut += ':';
+    fAfterKey = true;
+}
+
+void CJSONStringWriter::Value(const UniValue& val)
+{
+    Separate();
+    strOut += val.write();
+}
+
+CJSONTreeWriter::CJSONTreeWriter()
+{
+}
+
+void CJSONTreeWriter::BeginObject()
+{
+    vStack.push_back(UniValue(UniValue::VOBJ));
+    vKeys.push_back("");
+}
+
+void CJSONTreeWriter::EndObject()
+{
+    assert(!vStack.empty() && vStack.back().isObject());
+    Close();
+}
+
+void CJSONTreeWriter::BeginArray()
+{
+    vStack.push_back(UniValue(UniValue::VARR));
+    vKeys.push_back("");
+}
+
+void CJSONTreeWriter::EndArray()
+{
+    assert(!vStack.empty() && vStack.back().isArray());
+    Close();
+}
+
+void CJSONTreeWriter::Key(const std::string& strKey)
+{
+    assert(!vStack.empty() && vStack.back().isObject());
+    vKeys.back() = strKey;
+}
+
+void CJSONTreeWriter::Value(const UniValue& val)
+{
+    if (vStack.empty())
+        result = val;
+    else if (vStack.back().isObject())
+        vStack.back().pushKV(vKeys.back(), val);
+    else
+        vStack.back().push_back(val);
+}
+
+void CJSONTreeWriter::Close()
+{
+    UniValue val = vStack.back();
+    vStack.pop_back();
+    vKeys.pop_back();
+    Value(val);
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONWRITER_H
+#define BITCOIN_JSONWRITER_H
+
+#include "univalue_compat.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Receives a JSON document as a sequence of events, so that code describing
+ * a large result, like that of a verbose getblock, is written once and can
+ * either stream it out as text or build a UniValue of it.
+ *
+ * Inside an object every value is preceded by its Key(); Value() takes a
+ * scalar or a whole (small) tree.
+ */
+class CJSONWriter
+{
+public:
+    virtual ~CJSONWriter() {}
+
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+    virtual void Key(const std::string& strKey) = 0;
+    virtual void Value(const UniValue& val) = 0;
+
+    void KeyValue(const std::string& strKey, const UniValue& val)
+    {
+        Key(strKey);
+        Value(val);
+    }
+};
+
+/** Appends the document, compact, to a string */
+class CJSONStringWriter : public CJSONWriter
+{
+public:
+    explicit CJSONStringWriter(std::string& strOutIn);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const std::string& strKey);
+    void Value(const UniValue& val);
+
+private:
+    std::string& strOut;
+    std::vector<bool> vFirst; //!< Per open object or array, whether nothing has been written in it yet
+    bool fAfterKey;
+
+    void Separate();
+};
+
+/** Builds a UniValue of the document */
+class CJSONTreeWriter : public CJSONWriter
+{
+public:
+    CJSONTreeWriter();
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const std::string& strKey);
+    void Value(const UniValue& val);
+
+    /** The document, once complete */
+    const UniValue& Get() const { return result; }
+
+private:
+    UniValue result;
+    std::vector<UniValue> vStack; //!< The objects and arrays still open
+    std::vector<std::string> vKeys; //!< Per open object, the key of its next member
+
+    void Close();
+};
+
+#endif // BITCOIN_JSONWRITER_H
@@ -0,0 +1,90 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LRUCACHE_H
+#define BITCOIN_LRUCACHE_H
+
+#include <list>
+#include <map>
+#include <stddef.h>
+#include <utility>
+
+/** Map that keeps at most N entries, evicting the least recently used one. Not thread safe. */
+template <typename K, typename V>
+class lrucache
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<K, V> value_type;
+    typedef size_t size_type;
+    typedef typename std::list<value_type>::const_iterator const_iterator;
+
+protected:
+    typedef std::list<value_type> list_type;
+    list_type items; //!< Most recently used first
+    std::map<K, typename list_type::iterator> index;
+    size_type nMaxSize;
+
+public:
+    explicit lrucache(size_type nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    size_type size() const { return index.size(); }
+    size_type max_size() const { return nMaxSize; }
+    bool empty() const { return index.empty(); }
+
+    /** The value of k, if cached, which becomes the most recently used */
+    V* get(const K& k)
+    {
+        typename std::map<K, typename list_type::iterator>::iterator it = index.find(k);
+        if (it == index.end())
+            return NULL;
+        items.splice(items.begin(), items, it->second);
+        return &it->second->second;
+    }
+
+    /**
+     * Set the value of k. Returns whether that evicted another entry, which
+     * is then moved to *pevicted if given.
+     */
+    bool insert(const K& k, const V& v, value_type* pevicted = NULL)
+    {
+        V* pv = get(k);
+        if (pv) {
+            *pv = v;
+            return false;
+        }
+        items.push_front(value_type(k, v));
+        index[k] = items.begin();
+        if (nMaxSize == 0 || index.size() <= nMaxSize)
+            return false;
+        if (pevicted)
+            *pevicted = items.back();
+        index.erase(items.back().first);
+        items.pop_back();
+        return true;
+    }
+
+    bool erase(const K& k)
+    {
+        typename std::map<K, typename list_type::iterator>::iterator it = index.find(k);
+        if (it == index.end())
+            return false;
+        items.erase(it->second);
+        index.erase(it);
+        return true;
+    }
+
+    void clear()
+    {
+        index.clear();
+        items.clear();
+    }
+
+    /** Entries, most recently used first */
+    const_iterator begin() const { return items.begin(); }
+    const_iterator end() const { return items.end(); }
+};
+
+#endif // BITCOIN_LRUCACHE_H
@@ -5,8 +5,10 @@
 
 #include "main.h"
 
+#include "addressindex.h"
 #include "addrman.h"
 #include "alert.h"
+#include "blockencodings.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -14,7 +16,10 @@
 #include "merkleblock.h"
 #include "net.h"
 #include "pow.h"
+#include "spentindex.h"
+#include "timestampindex.h"
 #include "txdb.h"
+#include "txindexreader.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -25,6 +30,8 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
 using namespace boost;
@@ -50,6 +57,9 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = false;
+bool fAddressIndex = false;
+bool fSpentIndex = false;
+bool fTimestampIndex = false;
 bool fIsBareMultisigStd = true;
 unsigned int nCoinCacheSize = 5000;
 int miningAlgo = ALGO_SHA256D;
@@ -108,6 +118,12 @@ namespace {
     /** All pairs A->B, where A (or one if its ancestors) misses transactions, but B has transactions. */
     multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
 
+    /**
+     * Salt for picking the peers an address is relayed to. Set in
+     * RegisterNodeSignals, before any handler thread can read it.
+     */
+    uint256 hashAddrRelaySalt;
+
     CCriticalSection cs_LastBlockFile;
     std::vector<CBlockFileInfo> vinfoBlockFile;
     int nLastBlockFile = 0;
@@ -131,12 +147,28 @@ namespace {
         uint256 hash;
         CBlockIndex *pindex;  //! Optional.
         int64_t nTime;  //! Time of "getdata" request in microseconds.
+        boost::shared_ptr<PartiallyDownloadedBlock> partialBlock;  //! Optional, set while a compact block is being completed.
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
     /** Number of preferable block download peers. */
     int nPreferredDownload = 0;
 
+    /** Peers we asked to announce new blocks with a cmpctblock, oldest first. Protected by cs_main. */
+    list<NodeId> lNodesAnnouncingHeaderAndIDs;
+
+    /**
+     * Orphan and rejected transactions, kept in a ring so that a compact block
+     * including them can still be reconstructed without a round trip.
+     * Protected by cs_main.
+     */
+    vector<CTransaction> vExtraTxnForCompact;
+    size_t nExtraTxnForCompactIt = 0;
+
+    /** The cmpctblock message for the most recent tip, shared by all peers. Protected by cs_main. */
+    CSerializedNetMsg pLastCmpctBlockMsg;
+    uint256 hashLastCmpctBlockMsg;
+
     /** Dirty block index entries. */
     set<CBlockIndex*> setDirtyBlockIndex;
 
@@ -168,6 +200,8 @@ struct CMainSignals {
     boost::signals2::signal<void ()> Broadcast;
     /** Notifies listeners of a block validation result */
     boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
+    /** Notifies listeners of a new tip of the active chain, outside of initial block download. */
+    boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
 } g_signals;
 
 } // anon namespace
@@ -180,9 +214,11 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
     g_signals.Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn));
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
+    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn));
     g_signals.Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
@@ -193,6 +229,7 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.UpdatedBlockTip.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
     g_signals.Broadcast.disconnect_all_slots();
     g_signals.Inventory.disconnect_all_slots();
@@ -248,6 +285,10 @@ struct CNodeState {
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Whether this peer can give us compact blocks (it sent sendcmpct version 1).
+    bool fProvidesHeaderAndIDs;
+    //! Whether this peer wants new blocks announced with a cmpctblock rather than an inv.
+    bool fPreferHeaderAndIDs;
 
     CNodeState() {
         nMisbehavior = 0;
@@ -259,6 +300,8 @@ struct CNodeState {
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        fProvidesHeaderAndIDs = false;
+        fPreferHeaderAndIDs = false;
     }
 };
 
@@ -306,6 +349,7 @@ void FinalizeNode(NodeId nodeid) {
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid);
 
     mapNodeState.erase(nodeid);
 }
@@ -323,14 +367,15 @@ void MarkBlockAsReceived(const uint256& hash) {
 }
 
 // Requires cs_main.
-void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex *pindex = NULL) {
+void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex *pindex = NULL,
+                         boost::shared_ptr<PartiallyDownloadedBlock> partialBlock = boost::shared_ptr<PartiallyDownloadedBlock>()) {
     CNodeState *state = State(nodeid);
     assert(state != NULL);
 
     // Make sure it's not listed somewhere already.
     MarkBlockAsReceived(hash);
 
-    QueuedBlock newentry = {hash, pindex, GetTimeMicros()};
+    QueuedBlock newentry = {hash, pindex, GetTimeMicros(), partialBlock};
     list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
     state->nBlocksInFlight++;
     mapBlocksInFlight[hash] = std::make_pair(nodeid, it);
@@ -369,6 +414,40 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) {
     }
 }
 
+/**
+ * Ask a peer that just gave us a new block to announce the next ones with a
+ * cmpctblock straight away, saving the inv/getdata round trip. At most
+ * MAX_HIGH_BANDWIDTH_CMPCT_PEERS peers are asked; the one asked longest ago
+ * makes room for a new one. Requires cs_main.
+ */
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(CNode* pfrom)
+{
+    CNodeState* nodestate = State(pfrom->GetId());
+    if (!nodestate->fProvidesHeaderAndIDs)
+        return;
+    for (list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); ++it) {
+        if (*it == pfrom->GetId()) {
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+            return;
+        }
+    }
+    uint64_t nCMPCTBLOCKVersion = 1;
+    if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_HIGH_BANDWIDTH_CMPCT_PEERS) {
+        NodeId nodeidOldest = lNodesAnnouncingHeaderAndIDs.front();
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes) {
+            if (pnode->GetId() == nodeidOldest) {
+                pnode->PushMessage("sendcmpct", false, nCMPCTBLOCKVersion);
+                break;
+            }
+        }
+    }
+    pfrom->PushMessage("sendcmpct", true, nCMPCTBLOCKVersion);
+    lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-NULL. */
 CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb) {
@@ -490,6 +569,7 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
 
 void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
+    hashAddrRelaySalt = GetRandHash();
     nodeSignals.GetHeight.connect(&GetHeight);
     nodeSignals.ProcessMessages.connect(&ProcessMessages);
     nodeSignals.SendMessages.connect(&SendMessages);
@@ -609,6 +689,20 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
     return nEvicted;
 }
 
+// Requires cs_main.
+void static AddToCompactExtraTransactions(const CTransaction& tx)
+{
+    size_t nMaxExtraTxn = (size_t)std::max((int64_t)0, GetArg("-blockreconstructionextratxn", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
+    if (nMaxExtraTxn == 0)
+        return;
+    if (vExtraTxnForCompact.size() < nMaxExtraTxn) {
+        vExtraTxnForCompact.push_back(tx);
+    } else {
+        vExtraTxnForCompact[nExtraTxnForCompactIt % vExtraTxnForCompact.size()] = tx;
+    }
+    nExtraTxnForCompactIt = (nExtraTxnForCompactIt + 1) % nMaxExtraTxn;
+}
+
 
 
 
@@ -738,13 +832,12 @@ bool AreInputsStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
     {
         const CTxOut& prev = mapInputs.GetOutputFor(tx.vin[i]);
 
-        vector<vector<unsigned char> > vSolutions;
-        txnouttype whichType;
         // get the scriptPubKey corresponding to this input:
         const CScript& prevScript = prev.scriptPubKey;
-        if (!Solver(prevScript, whichType, vSolutions))
+        CTemplateMatch match;
+        if (!MatchTemplate(prevScript, match))
             return false;
-        int nArgsExpected = ScriptSigArgsExpected(whichType, vSolutions);
+        int nArgsExpected = ScriptSigArgsExpected(match);
         if (nArgsExpected < 0)
             return false;
 
@@ -758,16 +851,15 @@ bool AreInputsStandard(const CTransaction& tx, const CCoinsViewCache& mapInputs)
         if (!EvalScript(stack, tx.vin[i].scriptSig, false, BaseSignatureChecker()))
             return false;
 
-        if (whichType == TX_SCRIPTHASH)
+        if (match.type == TX_SCRIPTHASH)
         {
             if (stack.empty())
                 return false;
             CScript subscript(stack.back().begin(), stack.back().end());
-            vector<vector<unsigned char> > vSolutions2;
-            txnouttype whichType2;
-            if (Solver(subscript, whichType2, vSolutions2))
+            CTemplateMatch match2;
+            if (MatchTemplate(subscript, match2))
             {
-                int tmpExpected = ScriptSigArgsExpected(whichType2, vSolutions2);
+                int tmpExpected = ScriptSigArgsExpected(match2);
                 if (tmpExpected < 0)
                     return false;
                 nArgsExpected += tmpExpected;
@@ -1053,7 +1145,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
 
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true))
+        PrecomputedTransactionData txdata(tx);
+        if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, txdata))
         {
             return error("AcceptToMemoryPool: : ConnectInputs failed %s", hash.ToString());
         }
@@ -1067,7 +1160,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
         // There is a similar check in CreateNewBlock() to prevent creating
         // invalid blocks, however allowing such transactions into the mempool
         // can be exploited as a DoS attack.
-        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true, txdata))
         {
             return error("AcceptToMemoryPool: : BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s", hash.ToString());
         }
@@ -1081,6 +1174,9 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return true;
 }
 
+/** Reads what -txindex points to */
+static CTxIndexReader txIndexReader(TXINDEX_OPEN_FILES, TXINDEX_CACHED_TXS, TXINDEX_CACHED_BLOCK_HASHES);
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -1093,39 +1189,23 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
                 return true;
             }
         }
+    }
 
-        if (fTxIndex) {
-            CDiskTxPos postx;
-            if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-                if (file.IsNull())
-                    return error("%s: OpenBlockFile failed", __func__);
-                CBlockHeader header;
-                try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
-                } catch (std::exception &e) {
-                    return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-                }
-                hashBlock = header.GetHash();
-                if (txOut.GetHash() != hash)
-                    return error("%s : txid mismatch", __func__);
-                return true;
-            }
-        }
+    // Block files are only ever appended to, so the read needs no cs_main
+    if (fTxIndex && txIndexReader.Get(hash, txOut, hashBlock))
+        return true;
 
-        if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
-            int nHeight = -1;
-            {
-                CCoinsViewCache &view = *pcoinsTip;
-                const CCoins* coins = view.AccessCoins(hash);
-                if (coins)
-                    nHeight = coins->nHeight;
-            }
-            if (nHeight > 0)
-                pindexSlow = chainActive[nHeight];
+    if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+        LOCK(cs_main);
+        int nHeight = -1;
+        {
+            CCoinsViewCache &view = *pcoinsTip;
+            const CCoins* coins = view.AccessCoins(hash);
+            if (coins)
+                nHeight = coins->nHeight;
         }
+        if (nHeight > 0)
+            pindexSlow = chainActive[nHeight];
     }
 
     if (pindexSlow) {
@@ -1144,6 +1224,49 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, uint256 &hashBlock
     return false;
 }
 
+void GetTransactions(const std::vector<uint256> &vHashes, std::vector<CTransaction> &vtx, std::vector<uint256> &vHashBlock, std::vector<bool> &vFound, bool fAllowSlow)
+{
+    vtx.assign(vHashes.size(), CTransaction());
+    vHashBlock.assign(vHashes.size(), uint256(0));
+    vFound.assign(vHashes.size(), false);
+
+    std::vector<uint256> vIndexed;
+    std::vector<unsigned int> vIndexedPos;
+    {
+        LOCK(cs_main);
+        for (unsigned int i = 0; i < vHashes.size(); i++) {
+            if (mempool.lookup(vHashes[i], vtx[i])) {
+                vFound[i] = true;
+            } else {
+                vIndexed.push_back(vHashes[i]);
+                vIndexedPos.push_back(i);
+            }
+        }
+    }
+
+    if (fTxIndex && !vIndexed.empty()) {
+        std::vector<CTransaction> vtxIndexed;
+        std::vector<uint256> vHashBlockIndexed;
+        std::vector<bool> vFoundIndexed;
+        txIndexReader.GetMany(vIndexed, vtxIndexed, vHashBlockIndexed, vFoundIndexed);
+        for (unsigned int j = 0; j < vIndexed.size(); j++) {
+            unsigned int i = vIndexedPos[j];
+            if (vFoundIndexed[j]) {
+                vtx[i] = vtxIndexed[j];
+                vHashBlock[i] = vHashBlockIndexed[j];
+                vFound[i] = true;
+            }
+        }
+    }
+
+    if (fAllowSlow) {
+        for (unsigned int i = 0; i < vHashes.size(); i++) {
+            if (!vFound[i])
+                vFound[i] = GetTransaction(vHashes[i], vtx[i], vHashBlock[i], true);
+        }
+    }
+}
+
 
 
 
@@ -1208,6 +1331,42 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex)
+{
+    // The block is preceded by the network magic and its size
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.IsNull() || pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s : no block data for %s", __func__, pindex->GetBlockHash().ToString());
+    pos.nPos -= MESSAGE_START_SIZE + sizeof(unsigned int);
+    const unsigned int nHeaderSize = ::GetSerializeSize(CBlockHeader(), SER_DISK, CLIENT_VERSION);
+
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    try {
+        unsigned char pchMessageStart[MESSAGE_START_SIZE];
+        unsigned int nSize;
+        filein >> FLATDATA(pchMessageStart) >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+            return error("%s : block magic mismatch in file %d at %u", __func__, pos.nFile, pos.nPos);
+        if (nSize < nHeaderSize || nSize > MAX_BLOCK_SIZE)
+            return error("%s : invalid block size %u in file %d at %u", __func__, nSize, pos.nFile, pos.nPos);
+        vchBlock.resize(nSize);
+        filein.read((char*)&vchBlock[0], nSize);
+    } catch (std::exception &e) {
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+
+    // Only the header is decoded, to check that this is the block asked for
+    CBlockHeader header;
+    CDataStream ssHeader((const char*)&vchBlock[0], (const char*)&vchBlock[0] + nHeaderSize, SER_DISK, CLIENT_VERSION);
+    ssHeader >> header;
+    if (header.GetHash() != pindex->GetBlockHash())
+        return error("%s : GetHash() doesn't match index", __func__);
+    return true;
+}
+
 CAmount GetBlockValue(int nHeight, const CAmount& nFees)
 {
     //default block reward 906
@@ -1322,12 +1481,12 @@ void CheckForkWarningConditionsOnNewFork(CBlockIndex* pindexNewForkTip)
     CheckForkWarningConditions();
 }
 
-// Requires cs_main.
 void Misbehaving(NodeId pnode, int howmuch)
 {
     if (howmuch == 0)
         return;
 
+    LOCK(cs_main);
     CNodeState *state = State(pnode);
     if (state == NULL)
         return;
@@ -1395,13 +1554,13 @@ void UpdateCoins(const CTransaction& tx, CValidationState &state, CCoinsViewCach
 
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingSignatureChecker(*ptxTo, nIn, cacheStore), &error)) {
+    if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingSignatureChecker(*ptxTo, nIn, cacheStore, txdata), &error)) {
         return ::error("CScriptCheck() : %s:%d VerifySignature failed: %s", ptxTo->GetHash().ToString(), nIn, ScriptErrorString(error));
     }
     return true;
 }
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck> *pvChecks)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, const PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1493,7 +1652,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 assert(coins);
 
                 // Verify signature
-                CScriptCheck check(*coins, tx, i, flags, cacheStore);
+                CScriptCheck check(*coins, tx, i, flags, cacheStore, &txdata);
                 if (pvChecks) {
                     pvChecks->push_back(CScriptCheck());
                     check.swap(pvChecks->back());
@@ -1506,7 +1665,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                         // avoid splitting the network between upgraded and
                         // non-upgraded nodes.
                         CScriptCheck check(*coins, tx, i,
-                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore);
+                                flags & ~STANDARD_NOT_MANDATORY_VERIFY_FLAGS, cacheStore, &txdata);
                         if (check())
                             return state.Invalid(false, REJECT_NONSTANDARD, strprintf("non-mandatory-script-verify-flag (%s)", ScriptErrorString(check.GetScriptError())));
                     }
@@ -1604,6 +1763,28 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         }
     }
 
+    // Only when disconnecting from the chain state, not when VerifyDB() tries it out
+    if (fAddressIndex && pfClean == NULL) {
+        std::vector<CAddressIndexEntry> vDeltas;
+        std::vector<CAddressUnspentEntry> vCreated, vSpent;
+        GetAddressIndexChanges(block, blockUndo, pindex->nHeight, &view, vDeltas, vCreated, vSpent);
+        if (!pblocktree->EraseAddressIndex(vDeltas, vCreated, vSpent))
+            return state.Abort("Failed to write address index");
+    }
+    if (fSpentIndex && pfClean == NULL) {
+        std::vector<CSpentIndexKey> vSpentKeys;
+        for (unsigned int i = 1; i < block.vtx.size(); i++) {
+            BOOST_FOREACH(const CTxIn& txin, block.vtx[i].vin)
+                vSpentKeys.push_back(CSpentIndexKey(txin.prevout.hash, txin.prevout.n));
+        }
+        if (!pblocktree->EraseSpentIndex(vSpentKeys))
+            return state.Abort("Failed to write spent index");
+    }
+    if (fTimestampIndex && pfClean == NULL) {
+        if (!pblocktree->EraseTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
+            return state.Abort("Failed to write timestamp index");
+    }
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -1653,6 +1834,42 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
+/**
+ * The UTXO set statistics last kept by ConnectBlock() or counted by
+ * GetUTXOStats(); hashBlock is 0 until they are, and blocks are connected
+ * without keeping any.
+ */
+static CCoinsStats utxoStatsLast;
+
+/** The UTXO set statistics as of block hashBlock, if they were kept */
+static bool ReadUTXOStats(const uint256& hashBlock, CCoinsStats& stats)
+{
+    if (utxoStatsLast.hashBlock == 0)
+        return false;
+    if (utxoStatsLast.hashBlock == hashBlock) {
+        stats = utxoStatsLast;
+        return true;
+    }
+    return pblocktree->ReadUTXOStats(hashBlock, stats);
+}
+
+bool GetUTXOStats(CCoinsStats& stats)
+{
+    LOCK(cs_main);
+    if (ReadUTXOStats(pcoinsTip->GetBestBlock(), stats))
+        return true;
+
+    // Count them, the first time or after a reorganization to before that
+    FlushStateToDisk();
+    if (!pcoinsTip->GetStats(stats))
+        return false;
+    if (!pblocktree->WriteUTXOStats(stats))
+        return error("%s : failed to write UTXO set statistics", __func__);
+    utxoStatsLast = stats;
+    LogPrintf("%s : counted %u outputs at height %d, kept up to date from now on\n", __func__, stats.nTransactionOutputs, stats.nHeight);
+    return true;
+}
+
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck)
 {
     AssertLockHeld(cs_main);
@@ -1667,6 +1884,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == Params().HashGenesisBlock()) {
+        if (fTimestampIndex && !fJustCheck && !pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
+            return state.Abort("Failed to write timestamp index");
         view.SetBestBlock(pindex->GetBlockHash());
         return true;
     }
@@ -1714,7 +1933,14 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
+    std::vector<CSpentIndexEntry> vSpentIndex;
+    CCoinsStats utxoStats;
+    bool fUTXOStats = !fJustCheck && ReadUTXOStats(hashPrevBlock, utxoStats);
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
+    // Script checks keep pointers into txdata until control.Wait(), so it
+    // must never reallocate
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(block.vtx.size());
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = block.vtx[i];
@@ -1744,10 +1970,34 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             nFees += view.GetValueIn(tx)-tx.GetValueOut();
 
+            txdata.push_back(fScriptChecks ? PrecomputedTransactionData(tx) : PrecomputedTransactionData());
             std::vector<CScriptCheck> vChecks;
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, nScriptCheckThreads ? &vChecks : NULL))
+            if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, txdata.back(), nScriptCheckThreads ? &vChecks : NULL))
                 return false;
             control.Add(vChecks);
+
+            if (fSpentIndex) {
+                // The outputs are gone from the view once UpdateCoins() spends them
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint& prevout = tx.vin[j].prevout;
+                    const CCoins* coins = view.AccessCoins(prevout.hash);
+                    const CTxOut& txoutPrev = coins->vout[prevout.n];
+                    unsigned char addressType = 0;
+                    uint160 addressHash;
+                    GetAddressIndexDestination(txoutPrev.scriptPubKey, addressType, addressHash);
+                    vSpentIndex.push_back(make_pair(CSpentIndexKey(prevout.hash, prevout.n),
+                                                    CSpentIndexValue(tx.GetHash(), j, pindex->nHeight, txoutPrev.nValue,
+                                                                     ComputeInterest(pindex->nHeight - coins->nHeight, txoutPrev),
+                                                                     addressType, addressHash)));
+                }
+            }
+
+            if (fUTXOStats) {
+                BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+                    const CCoins* coins = view.AccessCoins(txin.prevout.hash);
+                    utxoStats.RemoveOutput(txin.prevout.hash, txin.prevout.n, coins->vout[txin.prevout.n], coins->nHeight, coins->fCoinBase);
+                }
+            }
         }
 
         CTxUndo undoDummy;
@@ -1756,6 +2006,25 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         UpdateCoins(tx, state, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
+        if (fUTXOStats) {
+            // Outputs that can never be spent are left out of the set, and
+            // undo data has the height of the transactions spent in full
+            bool fAdded = false;
+            for (unsigned int j = 0; j < tx.vout.size(); j++) {
+                if (!tx.vout[j].scriptPubKey.IsUnspendable()) {
+                    utxoStats.AddOutput(tx.GetHash(), j, tx.vout[j], pindex->nHeight, tx.IsCoinBase());
+                    fAdded = true;
+                }
+            }
+            if (fAdded)
+                utxoStats.nTransactions++;
+            if (i > 0) {
+                BOOST_FOREACH(const CTxInUndo& undo, blockundo.vtxundo.back().vprevout)
+                    if (undo.nHeight != 0)
+                        utxoStats.nTransactions--;
+            }
+        }
+
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
     }
@@ -1795,9 +2064,37 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
+    if (fTxIndex) {
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
+        txIndexReader.Forget(vPos);
+    }
+
+    if (fAddressIndex) {
+        std::vector<CAddressIndexEntry> vDeltas;
+        std::vector<CAddressUnspentEntry> vCreated, vSpent;
+        GetAddressIndexChanges(block, blockundo, pindex->nHeight, NULL, vDeltas, vCreated, vSpent);
+        if (!pblocktree->UpdateAddressIndex(vDeltas, vCreated, vSpent))
+            return state.Abort("Failed to write address index");
+    }
+
+    if (fSpentIndex)
+        if (!pblocktree->WriteSpentIndex(vSpentIndex))
+            return state.Abort("Failed to write spent index");
+
+    if (fTimestampIndex)
+        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
+            return state.Abort("Failed to write timestamp index");
+
+    // Stored by block hash, so those of the previous block are still found
+    // when this one is disconnected
+    if (fUTXOStats) {
+        utxoStats.nHeight = pindex->nHeight;
+        utxoStats.hashBlock = pindex->GetBlockHash();
+        if (!pblocktree->WriteUTXOStats(utxoStats))
+            return state.Abort("Failed to write UTXO set statistics");
+        utxoStatsLast = utxoStats;
+    }
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2182,16 +2479,55 @@ bool ActivateBestChain(CValidationState &state, CBlock *pblock) {
         // Notifications/callbacks that can run without cs_main
         if (!fInitialDownload) {
             uint256 hashNewTip = pindexNewTip->GetBlockHash();
+            CInv inv(MSG_BLOCK, hashNewTip);
+            // Peers that asked for it get the new tip as a compact block right
+            // away instead of an inv they would have to getdata.
+            set<NodeId> setPreferHeaderAndIDs;
+            CSerializedNetMsg msgCmpct;
+            {
+                LOCK(cs_main);
+                for (map<NodeId, CNodeState>::const_iterator it = mapNodeState.begin(); it != mapNodeState.end(); ++it)
+                    if (it->second.fPreferHeaderAndIDs)
+                        setPreferHeaderAndIDs.insert(it->first);
+                if (!setPreferHeaderAndIDs.empty() && chainActive.Tip() == pindexNewTip) {
+                    CBlock block;
+                    const CBlock* pblockTip = pblock;
+                    if (!pblockTip || pblockTip->GetHash() != hashNewTip) {
+                        pblockTip = NULL;
+                        if (ReadBlockFromDisk(block, pindexNewTip))
+                            pblockTip = &block;
+                    }
+                    if (pblockTip) {
+                        pLastCmpctBlockMsg = MakeSerializedNetMsg("cmpctblock", CBlockHeaderAndShortTxIDs(*pblockTip));
+                        hashLastCmpctBlockMsg = hashNewTip;
+                        msgCmpct = pLastCmpctBlockMsg;
+                    }
+                }
+            }
             // Relay inventory, but don't relay old inventory during initial block download.
             int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
             {
                 LOCK(cs_vNodes);
-                BOOST_FOREACH(CNode* pnode, vNodes)
-                    if (chainActive.Height() > (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
-                        pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
+                BOOST_FOREACH(CNode* pnode, vNodes) {
+                    if (chainActive.Height() <= (pnode->nStartingHeight != -1 ? pnode->nStartingHeight - 2000 : nBlockEstimate))
+                        continue;
+                    if (msgCmpct && setPreferHeaderAndIDs.count(pnode->GetId())) {
+                        bool fKnown;
+                        {
+                            LOCK(pnode->cs_inventory);
+                            fKnown = pnode->filterInventoryKnown.contains(inv.hash);
+                            pnode->filterInventoryKnown.insert(inv.hash);
+                        }
+                        if (!fKnown)
+                            pnode->PushSerializedMessage(msgCmpct);
+                    } else {
+                        pnode->PushInventory(inv);
+                    }
+                }
             }
             // Notify external listeners about the new tip.
             uiInterface.NotifyBlockTip(hashNewTip);
+            g_signals.UpdatedBlockTip(pindexNewTip);
         }
     } while(pindexMostWork != chainActive.Tip());
 
@@ -2969,12 +3305,26 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have an address index
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
+
+    // Check whether we have the spent and timestamp indexes
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("LoadBlockIndexDB(): spent index %s\n", fSpentIndex ? "enabled" : "disabled");
+    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
+    LogPrintf("LoadBlockIndexDB(): timestamp index %s\n", fTimestampIndex ? "enabled" : "disabled");
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
         return true;
     chainActive.SetTip(it->second);
 
+    // Keep the UTXO set statistics up to date if they were before
+    if (pblocktree->ReadUTXOStats(chainActive.Tip()->GetBlockHash(), utxoStatsLast))
+        LogPrintf("LoadBlockIndexDB(): UTXO set statistics kept\n");
+
     PruneBlockIndexCandidates();
 
     LogPrintf("LoadBlockIndexDB(): hashBestChain=%s height=%d date=%s progress=%f\n",
@@ -3077,6 +3427,7 @@ void UnloadBlockIndex()
     setBlockIndexCandidates.clear();
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
+    utxoStatsLast = CCoinsStats();
 }
 
 bool LoadBlockIndex()
@@ -3097,6 +3448,14 @@ bool InitBlockIndex() {
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    // And for -addressindex
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    // And for -spentindex and -timestampindex
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    pblocktree->WriteFlag("timestampindex", fTimestampIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -3319,14 +3678,16 @@ bool static AlreadyHave(const CInv& inv)
 }
 
 
+/** The "block" message last served from disk, kept for the next peer asking for it. Requires cs_main. */
+static CSerializedNetMsg pLastBlockMsg;
+static uint256 hashLastBlockMsg;
+
 void static ProcessGetData(CNode* pfrom)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
 
     vector<CInv> vNotFound;
 
-    LOCK(cs_main);
-
     while (it != pfrom->vRecvGetData.end()) {
         // Don't bother if send buffer is too full to respond anyway
         if (pfrom->nSendSize >= SendBufferSize())
@@ -3335,10 +3696,18 @@ void static ProcessGetData(CNode* pfrom)
         const CInv &inv = *it;
         {
             boost::this_thread::interruption_point();
-            it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
             {
+                // Only blocks need cs_main; if it is busy, leave this and the
+                // following requests queued and come back for them.
+                CCriticalBlock lockMain(cs_main, "cs_main", __FILE__, __LINE__, !pfrom->fWaitingForMain);
+                if (!lockMain) {
+                    pfrom->fWaitingForMain = true;
+                    break;
+                }
+                pfrom->fWaitingForMain = false;
+
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end())
@@ -3357,15 +3726,48 @@ void static ProcessGetData(CNode* pfrom)
                     } else {
                         send = true;
                     }
+                    // Once the upload target is close, stop serving blocks
+                    // older than a week to peers that are not whitelisted;
+                    // recent blocks are always served.
+                    static const int nOneWeek = 7 * 24 * 60 * 60;
+                    if (send && CNode::OutboundTargetReached(true) && !pfrom->fWhitelisted &&
+                        pindexBestHeader->GetBlockTime() - mi->second->GetBlockTime() > nOneWeek)
+                    {
+                        LogPrint("net", "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
+                        pfrom->fDisconnect = true;
+                        send = false;
+                    }
                 }
                 if (send)
                 {
+                    // Compact blocks only pay off for recent blocks, whose
+                    // transactions are likely still in the peer's mempool
+                    bool fCompact = inv.type == MSG_CMPCT_BLOCK &&
+                                    mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH;
+                    bool fFullBlock = inv.type == MSG_BLOCK || (inv.type == MSG_CMPCT_BLOCK && !fCompact);
+
                     // Send block from disk
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
+                    if (fFullBlock && pLastBlockMsg && inv.hash == hashLastBlockMsg)
+                        pfrom->PushSerializedMessage(pLastBlockMsg);
+                    else if (fCompact && pLastCmpctBlockMsg && inv.hash == hashLastCmpctBlockMsg)
+                        pfrom->PushSerializedMessage(pLastCmpctBlockMsg);
+                    else if (!ReadBlockFromDisk(block, (*mi).second))
                         assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
+                    else if (fCompact)
+                    {
+                        pLastCmpctBlockMsg = MakeSerializedNetMsg("cmpctblock", CBlockHeaderAndShortTxIDs(block));
+                        hashLastCmpctBlockMsg = inv.hash;
+                        pfrom->PushSerializedMessage(pLastCmpctBlockMsg);
+                    }
+                    else if (fFullBlock)
+                    {
+                        // A new block is typically requested by many peers at
+                        // about the same time: serialize it once for all of them
+                        pLastBlockMsg = MakeSerializedNetMsg("block", block);
+                        hashLastBlockMsg = inv.hash;
+                        pfrom->PushSerializedMessage(pLastBlockMsg);
+                    }
                     else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
@@ -3381,7 +3783,7 @@ void static ProcessGetData(CNode* pfrom)
                             // however we MUST always provide at least what the remote peer needs
                             typedef std::pair<unsigned int, uint256> PairType;
                             BOOST_FOREACH(PairType& pair, merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                                if (!pfrom->filterInventoryKnown.contains(pair.second))
                                     pfrom->PushMessage("tx", block.vtx[pair.first]);
                         }
                         // else
@@ -3405,13 +3807,16 @@ void static ProcessGetData(CNode* pfrom)
             {
                 // Send stream from relay memory
                 bool pushed = false;
+                CSerializedNetMsg msg;
                 {
                     LOCK(cs_mapRelay);
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
-                    if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
-                        pushed = true;
-                    }
+                    map<CInv, CSerializedNetMsg>::iterator mi = mapRelay.find(inv);
+                    if (mi != mapRelay.end())
+                        msg = mi->second;
+                }
+                if (msg) {
+                    pfrom->PushSerializedMessage(msg);
+                    pushed = true;
                 }
                 if (!pushed && inv.type == MSG_TX) {
                     CTransaction tx;
@@ -3428,10 +3833,12 @@ void static ProcessGetData(CNode* pfrom)
                 }
             }
 
+            it++;
+
             // Track requests for our stuff.
             g_signals.Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -3450,6 +3857,34 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+/** Hand a block a peer sent us, in full or compact form, to validation. */
+void static ProcessBlockFromPeer(CNode* pfrom, CBlock& block, const string& strCommand)
+{
+    CInv inv(MSG_BLOCK, block.GetHash());
+    LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
+
+    pfrom->AddInventoryKnown(inv);
+
+    CValidationState state;
+    ProcessNewBlock(state, pfrom, &block);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+        return;
+    }
+
+    // A peer that just gave us our new tip is a good candidate for pushing
+    // the next one to us as a compact block.
+    LOCK(cs_main);
+    if (chainActive.Tip()->GetBlockHash() == inv.hash)
+        MaybeSetPeerAsAnnouncingHeaderAndIDs(pfrom);
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     RandAddSeedPerfmon();
@@ -3524,7 +3959,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         pfrom->fClient = !(pfrom->nServices & NODE_NETWORK);
 
         // Potentially mark this peer as a preferred download peer.
-        UpdatePreferredDownload(pfrom, State(pfrom->GetId()));
+        {
+            LOCK(cs_main);
+            UpdatePreferredDownload(pfrom, State(pfrom->GetId()));
+        }
 
         // Change version
         pfrom->PushMessage("verack");
@@ -3595,6 +4033,14 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     else if (strCommand == "verack")
     {
         pfrom->SetRecvVersion(min(pfrom->nVersion, PROTOCOL_VERSION));
+
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
+            // Tell the peer we can take compact blocks. Whether it should
+            // push them to us unasked is decided once it has proven useful.
+            bool fAnnounceUsingCMPCTBLOCK = false;
+            uint64_t nCMPCTBLOCKVersion = 1;
+            pfrom->PushMessage("sendcmpct", fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+        }
     }
 
 
@@ -3631,11 +4077,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     LOCK(cs_vNodes);
                     // Use deterministic randomness to send to the same nodes for 24 hours
                     // at a time so the setAddrKnowns of the chosen nodes prevent repeats
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
                     uint64_t hashAddr = addr.GetHash();
-                    uint256 hashRand = hashSalt ^ (hashAddr<<32) ^ ((GetTime()+hashAddr)/(24*60*60));
+                    uint256 hashRand = hashAddrRelaySalt ^ (hashAddr<<32) ^ ((GetTime()+hashAddr)/(24*60*60));
                     hashRand = Hash(BEGIN(hashRand), END(hashRand));
                     multimap<uint256, CNode*> mapMix;
                     BOOST_FOREACH(CNode* pnode, vNodes)
@@ -3707,7 +4150,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     CNodeState *nodestate = State(pfrom->GetId());
                     if (chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().TargetSpacing() * 20 &&
                         nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
-                        vToFetch.push_back(inv);
+                        // The headers asked for above arrive first, so a compact
+                        // block can be connected and reconstructed on arrival.
+                        vToFetch.push_back(CInv(nodestate->fProvidesHeaderAndIDs ? MSG_CMPCT_BLOCK : MSG_BLOCK, inv.hash));
                         // Mark block as in flight already, even though the actual "getdata" message only goes out
                         // later (within the same cs_main lock, though).
                         MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
@@ -3908,6 +4353,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         else if (fMissingInputs)
         {
             AddOrphanTx(tx, pfrom->GetId());
+            AddToCompactExtraTransactions(tx);
 
             // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
@@ -3923,6 +4369,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         int nDoS = 0;
         if (state.IsInvalid(nDoS))
         {
+            // Transactions rejected by policy (fee, conflicts) may still be
+            // mined by someone else.
+            if (nDoS == 0)
+                AddToCompactExtraTransactions(tx);
             LogPrint("mempool", "%s from peer=%d %s was not accepted into the memory pool: %s\n", tx.GetHash().ToString(),
                 pfrom->id, pfrom->cleanSubVer,
                 state.GetRejectReason());
@@ -3991,29 +4441,201 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         CBlock block;
         vRecv >> block;
 
-        CInv inv(MSG_BLOCK, block.GetHash());
-        LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
+        ProcessBlockFromPeer(pfrom, block, strCommand);
+    }
 
-        pfrom->AddInventoryKnown(inv);
 
-        CValidationState state;
-        ProcessNewBlock(state, pfrom, &block);
-        int nDoS;
-        if (state.IsInvalid(nDoS)) {
-            pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
+    else if (strCommand == "sendcmpct")
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 0;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        // Other versions are ignored, so that they can be negotiated in the future
+        if (nCMPCTBLOCKVersion == 1) {
+            LOCK(cs_main);
+            CNodeState *nodestate = State(pfrom->GetId());
+            nodestate->fProvidesHeaderAndIDs = true;
+            nodestate->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
+        }
+    }
+
+
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        // Validated without cs_main held, as for "block"
+        CBlock block;
+        {
+            LOCK(cs_main);
+
+            if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
+                // It doesn't connect to anything we know; catch up on headers first.
+                // If we asked this peer for the block, it is no longer coming.
+                uint256 hash = cmpctblock.header.GetHash();
+                map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+                if (itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId())
+                    MarkBlockAsReceived(hash);
+                if (!IsInitialBlockDownload())
+                    pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256(0));
+                return true;
+            }
+
+            CBlockIndex *pindex = NULL;
+            CValidationState state;
+            if (!AcceptBlockHeader(cmpctblock.header, state, &pindex)) {
+                int nDoS;
+                if (state.IsInvalid(nDoS)) {
+                    if (nDoS > 0)
+                        Misbehaving(pfrom->GetId(), nDoS);
+                    return error("invalid header received in cmpctblock");
+                }
+                return true;
+            }
+
+            CInv inv(MSG_BLOCK, pindex->GetBlockHash());
+            pfrom->AddInventoryKnown(inv);
+            UpdateBlockAvailability(pfrom->GetId(), inv.hash);
+
+            if (pindex->nStatus & BLOCK_HAVE_DATA)
+                return true;
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(inv.hash);
+            bool fInFlightFromPeer = itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId();
+            if (itInFlight != mapBlocksInFlight.end() && !fInFlightFromPeer)
+                return true; // Someone else is already sending it to us
+            CNodeState *nodestate = State(pfrom->GetId());
+            if (!fInFlightFromPeer && nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER)
+                return true;
+
+            // The transactions can only be matched against a mempool that is
+            // consistent with the block's parent, so only a block that extends
+            // our tip is reconstructed. For anything else, fall back
+            // to the full block if we asked for it, or leave it to the regular
+            // download logic if it was pushed to us.
+            if (pindex->pprev != chainActive.Tip()) {
+                if (fInFlightFromPeer) {
+                    MarkBlockAsInFlight(pfrom->GetId(), inv.hash, pindex);
+                    pfrom->PushMessage("getdata", vector<CInv>(1, inv));
+                }
+                return true;
+            }
+
+            boost::shared_ptr<PartiallyDownloadedBlock> partialBlock(new PartiallyDownloadedBlock(&mempool));
+            ReadStatus status = partialBlock->InitData(cmpctblock, vExtraTxnForCompact);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(inv.hash);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("invalid cmpctblock %s from peer=%d", inv.hash.ToString(), pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // Short IDs collided within the block: fetch it in full
+                MarkBlockAsInFlight(pfrom->GetId(), inv.hash, pindex);
+                pfrom->PushMessage("getdata", vector<CInv>(1, inv));
+                return true;
+            }
+
+            BlockTransactionsRequest req;
+            req.blockhash = inv.hash;
+            for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                if (!partialBlock->IsTxAvailable(i))
+                    req.indexes.push_back(i);
+            }
+            if (!req.indexes.empty()) {
+                MarkBlockAsInFlight(pfrom->GetId(), inv.hash, pindex, partialBlock);
+                pfrom->PushMessage("getblocktxn", req);
+                return true;
+            }
+
+            if (partialBlock->FillBlock(block, vector<CTransaction>()) != READ_STATUS_OK) {
+                MarkBlockAsInFlight(pfrom->GetId(), inv.hash, pindex);
+                pfrom->PushMessage("getdata", vector<CInv>(1, inv));
+                return true;
+            }
+        }
+        ProcessBlockFromPeer(pfrom, block, strCommand);
+    }
+
+
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator mi = mapBlockIndex.find(req.blockhash);
+        if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (mi->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            // Not worth a reconstruction attempt this far back: send the full block
+            LogPrint("net", "peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            ProcessGetData(pfrom);
+            return true;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, mi->second))
+            assert(!"cannot load block from disk");
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer %d sent us a getblocktxn with out-of-bounds tx indices", pfrom->id);
             }
+            resp.txn[i] = block.vtx[req.indexes[i]];
         }
+        pfrom->PushMessage("blocktxn", resp);
+    }
 
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        // Validated without cs_main held, as for "block"
+        CBlock block;
+        {
+            LOCK(cs_main);
+
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(resp.blockhash);
+            if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId() ||
+                !itInFlight->second.second->partialBlock) {
+                LogPrint("net", "peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            boost::shared_ptr<PartiallyDownloadedBlock> partialBlock = itInFlight->second.second->partialBlock;
+            CBlockIndex *pindex = itInFlight->second.second->pindex;
+            ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("peer %d sent us a blocktxn that does not match the cmpctblock", pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // A short ID matched the wrong mempool transaction: fetch the full block
+                CInv inv(MSG_BLOCK, resp.blockhash);
+                MarkBlockAsInFlight(pfrom->GetId(), resp.blockhash, pindex);
+                pfrom->PushMessage("getdata", vector<CInv>(1, inv));
+                return true;
+            }
+        }
+        ProcessBlockFromPeer(pfrom, block, strCommand);
     }
 
 
     else if (strCommand == "getaddr")
     {
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_vAddrToSend);
+            pfrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.GetAddr();
         BOOST_FOREACH(const CAddress &addr, vAddr)
             pfrom->PushAddress(addr);
@@ -4129,6 +4751,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         CAlert alert;
         vRecv >> alert;
 
+        // Serializes setKnown with relaying from other handler threads
+        LOCK(cs_mapAlerts);
+
         uint256 alertHash = alert.GetHash();
         if (pfrom->setKnown.count(alertHash) == 0)
         {
@@ -4243,6 +4868,19 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     return true;
 }
 
+/**
+ * Commands whose processing is mostly done under cs_main. Everything else
+ * only takes it briefly, if at all, and can proceed while a block or
+ * transaction is being validated in another message handler thread.
+ */
+static bool MessageNeedsMainLock(const string& strCommand)
+{
+    return strCommand == "inv" || strCommand == "tx" || strCommand == "block" ||
+           strCommand == "headers" || strCommand == "getblocks" || strCommand == "getheaders" ||
+           strCommand == "mempool" || strCommand == "cmpctblock" || strCommand == "getblocktxn" ||
+           strCommand == "blocktxn";
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode* pfrom)
 {
@@ -4283,6 +4921,19 @@ bool ProcessMessages(CNode* pfrom)
         if (!msg.complete())
             break;
 
+        // While another thread holds cs_main, leave such a message at the
+        // front of the queue and let this thread serve other peers first; the
+        // next attempt for this peer waits for the lock.
+        boost::scoped_ptr<CCriticalBlock> lockMain;
+        if (MessageNeedsMainLock(msg.hdr.GetCommand())) {
+            lockMain.reset(new CCriticalBlock(cs_main, "cs_main", __FILE__, __LINE__, !pfrom->fWaitingForMain));
+            if (!*lockMain) {
+                pfrom->fWaitingForMain = true;
+                break;
+            }
+            pfrom->fWaitingForMain = false;
+        }
+
         // at this point, any failure means we can delete the current message
         it++;
 
@@ -4305,11 +4956,11 @@ bool ProcessMessages(CNode* pfrom)
         // Message size
         unsigned int nMessageSize = hdr.nMessageSize;
 
-        // Checksum
+        // Checksum, of the payload hashed as it was received
         CDataStream& vRecv = msg.vRecv;
-        uint256 hash = Hash(vRecv.begin(), vRecv.begin() + nMessageSize);
+        const uint256& hash = msg.GetMessageHash();
         unsigned int nChecksum = 0;
-        memcpy(&nChecksum, &hash, sizeof(nChecksum));
+        memcpy(&nChecksum, hash.begin(), sizeof(nChecksum));
         if (nChecksum != hdr.nChecksum)
         {
             LogPrintf("ProcessMessages(%s, %u bytes) : CHECKSUM ERROR nChecksum=%08x hdr.nChecksum=%08x\n",
@@ -4365,7 +5016,7 @@ bool ProcessMessages(CNode* pfrom)
 }
 
 
-bool SendMessages(CNode* pto, bool fSendTrickle)
+bool SendMessages(CNode* pto)
 {
     {
         // Don't send anything until we get their version message
@@ -4413,8 +5064,10 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             BOOST_FOREACH(CNode* pnode, vNodes)
             {
                 // Periodically clear setAddrKnown to allow refresh broadcasts
-                if (nLastRebroadcast)
+                if (nLastRebroadcast) {
+                    LOCK(pnode->cs_vAddrToSend);
                     pnode->setAddrKnown.clear();
+                }
 
                 // Rebroadcast our address
                 AdvertizeLocal(pnode);
@@ -4426,27 +5079,28 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         // Message: addr
         //
-        if (fSendTrickle)
+        int64_t nNow = GetTimeMicros();
+        if (pto->nNextAddrSend < nNow)
         {
+            pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
             vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend)
             {
-                // returns true if wasn't already contained in the set
-                if (pto->setAddrKnown.insert(addr).second)
+                LOCK(pto->cs_vAddrToSend);
+                vAddr.reserve(pto->vAddrToSend.size());
+                BOOST_FOREACH(const CAddress& addr, pto->vAddrToSend)
                 {
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000)
-                    {
-                        pto->PushMessage("addr", vAddr);
-                        vAddr.clear();
-                    }
+                    // returns true if wasn't already contained in the set
+                    if (pto->setAddrKnown.insert(addr).second)
+                        vAddr.push_back(addr);
                 }
+                pto->vAddrToSend.clear();
+            }
+            // receiver rejects addr messages larger than 1000
+            for (size_t i = 0; i < vAddr.size(); i += 1000)
+            {
+                vector<CAddress> vBatch(vAddr.begin() + i, vAddr.begin() + min(i + 1000, vAddr.size()));
+                pto->PushMessage("addr", vBatch);
             }
-            pto->vAddrToSend.clear();
-            if (!vAddr.empty())
-                pto->PushMessage("addr", vAddr);
         }
 
         CNodeState &state = *State(pto->GetId());
@@ -4496,52 +5150,73 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         // Message: inventory
         //
         vector<CInv> vInv;
-        vector<CInv> vInvWait;
         {
             LOCK(pto->cs_inventory);
-            vInv.reserve(pto->vInventoryToSend.size());
-            vInvWait.reserve(pto->vInventoryToSend.size());
-            BOOST_FOREACH(const CInv& inv, pto->vInventoryToSend)
-            {
-                if (pto->setInventoryKnown.count(inv))
-                    continue;
+            vInv.reserve(max<size_t>(pto->vInventoryBlockToSend.size(), INVENTORY_BROADCAST_TARGET));
 
-                // trickle out tx inv to protect privacy
-                if (inv.type == MSG_TX && !fSendTrickle)
-                {
-                    // 1/4 of tx invs blast to all immediately
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
-                    uint256 hashRand = inv.hash ^ hashSalt;
-                    hashRand = Hash(BEGIN(hashRand), END(hashRand));
-                    bool fTrickleWait = ((hashRand & 3) != 0);
-
-                    if (fTrickleWait)
-                    {
-                        vInvWait.push_back(inv);
-                        continue;
-                    }
+            // Blocks are announced right away, in order
+            BOOST_FOREACH(const uint256& hash, pto->vInventoryBlockToSend) {
+                if (pto->filterInventoryKnown.contains(hash))
+                    continue;
+                pto->filterInventoryKnown.insert(hash);
+                vInv.push_back(CInv(MSG_BLOCK, hash));
+                if (vInv.size() == MAX_INV_SZ) {
+                    pto->PushMessage("inv", vInv);
+                    vInv.clear();
                 }
-
-                // returns true if wasn't already contained in the set
-                if (pto->setInventoryKnown.insert(inv).second)
+            }
+            pto->vInventoryBlockToSend.clear();
+
+            // Transactions are trickled out in batches on a Poisson timer of
+            // each peer's own, so that when a peer hears of a transaction
+            // says little about where it came from. Outbound peers, which
+            // we chose ourselves, wait half as long.
+            bool fSendTrickle = pto->fWhitelisted;
+            if (pto->nNextInvSend < nNow) {
+                fSendTrickle = true;
+                pto->nNextInvSend = PoissonNextSend(nNow, INVENTORY_BROADCAST_INTERVAL >> !pto->fInbound);
+            }
+            if (fSendTrickle && !pto->setInventoryTxToSend.empty()) {
+                // Announce the highest fee rates first. Transactions that
+                // left the mempool in the meantime aren't announced at all.
+                vector<pair<CFeeRate, uint256> > vTxToSend;
+                vTxToSend.reserve(pto->setInventoryTxToSend.size());
                 {
-                    vInv.push_back(inv);
-                    if (vInv.size() >= 1000)
-                    {
-                        pto->PushMessage("inv", vInv);
-                        vInv.clear();
+                    LOCK(mempool.cs);
+                    set<uint256>::iterator it = pto->setInventoryTxToSend.begin();
+                    while (it != pto->setInventoryTxToSend.end()) {
+                        map<uint256, CTxMemPoolEntry>::const_iterator mi = mempool.mapTx.find(*it);
+                        if (mi == mempool.mapTx.end()) {
+                            pto->setInventoryTxToSend.erase(it++);
+                            continue;
+                        }
+                        vTxToSend.push_back(make_pair(CFeeRate(mi->second.GetFee(), mi->second.GetTxSize()), *it));
+                        ++it;
                     }
                 }
+                make_heap(vTxToSend.begin(), vTxToSend.end());
+                // A fixed number per trickle would let a busy peer's queue
+                // grow without bound, so it is scaled with the queue.
+                unsigned int nBroadcastMax = min<size_t>(INVENTORY_BROADCAST_MAX, INVENTORY_BROADCAST_TARGET + vTxToSend.size() / 2);
+                unsigned int nRelayedTransactions = 0;
+                while (!vTxToSend.empty() && nRelayedTransactions < nBroadcastMax) {
+                    pop_heap(vTxToSend.begin(), vTxToSend.end());
+                    uint256 hash = vTxToSend.back().second;
+                    vTxToSend.pop_back();
+                    pto->setInventoryTxToSend.erase(hash);
+                    if (pto->filterInventoryKnown.contains(hash))
+                        continue;
+                    pto->filterInventoryKnown.insert(hash);
+                    vInv.push_back(CInv(MSG_TX, hash));
+                    nRelayedTransactions++;
+                }
             }
-            pto->vInventoryToSend = vInvWait;
         }
         if (!vInv.empty())
             pto->PushMessage("inv", vInv);
 
         // Detect whether we're stalling
-        int64_t nNow = GetTimeMicros();
+        nNow = GetTimeMicros();
         if (!pto->fDisconnect && state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
@@ -12,13 +12,18 @@
 #include "addrman.h"
 #include "chainparams.h"
 #include "clientversion.h"
+#include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "socketpoll.h"
 #include "ui_interface.h"
 
+#include <math.h>
+
 #ifdef WIN32
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_UPNP
@@ -29,6 +34,7 @@
 #endif
 
 #include <boost/filesystem.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
 
 // Dump addresses to peers.dat every 15 minutes (900s)
@@ -58,8 +64,9 @@ namespace {
     struct ListenSocket {
         SOCKET socket;
         bool whitelisted;
+        int nPollEvents;
 
-        ListenSocket(SOCKET socket, bool whitelisted) : socket(socket), whitelisted(whitelisted) {}
+        ListenSocket(SOCKET socket, bool whitelisted) : socket(socket), whitelisted(whitelisted), nPollEvents(0) {}
     };
 }
 
@@ -82,7 +89,9 @@ bool fAddressesInitialized = false;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
+// Nodes the socket handler has not watched yet; requires cs_vNodes
+static vector<CNode*> vNodesNew;
+map<CInv, CSerializedNetMsg> mapRelay;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
@@ -100,6 +109,18 @@ NodeId nLastNodeId = 0;
 CCriticalSection cs_nLastNodeId;
 
 static CSemaphore *semOutbound = NULL;
+static CSocketPoller *pSocketPoller = NULL;
+
+/** Whether the socket poller can wait for hSocket, which select() cannot beyond FD_SETSIZE */
+static bool IsPollableSocket(SOCKET hSocket)
+{
+    return !pSocketPoller->IsLimitedBySetSize() || IsSelectableSocket(hSocket);
+}
+
+// Wakes the message handler threads as soon as a complete message has been received
+static boost::condition_variable messageHandlerCondition;
+static boost::mutex mutexMsgProc;
+static bool fMsgProcWake = false;
 
 // Signals for message handling
 static CNodeSignals g_signals;
@@ -349,6 +370,30 @@ uint64_t CNode::nTotalBytesRecv = 0;
 uint64_t CNode::nTotalBytesSent = 0;
 CCriticalSection CNode::cs_totalBytesRecv;
 CCriticalSection CNode::cs_totalBytesSent;
+mapMsgCmdSize CNode::mapTotalBytesRecvPerMsgCmd;
+mapMsgCmdSize CNode::mapTotalBytesSentPerMsgCmd;
+
+uint64_t CNode::nMaxOutboundLimit = 0;
+uint64_t CNode::nMaxOutboundTotalBytesSentInCycle = 0;
+uint64_t CNode::nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
+uint64_t CNode::nMaxOutboundCycleStartTime = 0;
+
+/**
+ * Add nBytes to the counter of strCommand. Commands we don't know share a
+ * single counter, so that peers can't make the map grow.
+ */
+static void AddMsgCmdBytes(mapMsgCmdSize& mapBytes, const std::string& strCommand, uint64_t nBytes)
+{
+    if (mapBytes.empty()) {
+        BOOST_FOREACH(const std::string& strType, GetAllNetMessageTypes())
+            mapBytes[strType] = 0;
+        mapBytes[NET_MESSAGE_COMMAND_OTHER] = 0;
+    }
+    mapMsgCmdSize::iterator it = mapBytes.find(strCommand);
+    if (it == mapBytes.end())
+        it = mapBytes.find(NET_MESSAGE_COMMAND_OTHER);
+    it->second += nBytes;
+}
 
 CNode* FindNode(const CNetAddr& ip)
 {
@@ -405,6 +450,13 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
     {
         addrman.Attempt(addrConnect);
 
+        if (!IsPollableSocket(hSocket))
+        {
+            LogPrintf("connection to %s dropped: non-selectable socket\n", pszDest ? pszDest : addrConnect.ToString());
+            CloseSocket(hSocket);
+            return NULL;
+        }
+
         // Add node
         CNode* pnode = new CNode(hSocket, addrConnect, pszDest ? pszDest : "", false);
         pnode->AddRef();
@@ -412,6 +464,7 @@ CNode* ConnectNode(CAddress addrConnect, const char *pszDest)
         {
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
+            vNodesNew.push_back(pnode);
         }
 
         pnode->nTimeConnected = GetTime();
@@ -432,6 +485,8 @@ void CNode::CloseSocketDisconnect()
     if (hSocket != INVALID_SOCKET)
     {
         LogPrint("net", "disconnecting peer=%d\n", id);
+        if (pSocketPoller)
+            pSocketPoller->Unwatch(hSocket);
         CloseSocket(hSocket);
     }
 
@@ -532,6 +587,14 @@ void CNode::copyStats(CNodeStats &stats)
     X(nSendBytes);
     X(nRecvBytes);
     X(fWhitelisted);
+    {
+        LOCK(cs_vSend);
+        X(mapSendBytesPerMsgCmd);
+    }
+    {
+        LOCK(cs_vRecvMsg);
+        X(mapRecvBytesPerMsgCmd);
+    }
 
     // It is common for nodes with good ping times to suddenly become lagged,
     // due to a new block arriving or other large transfer.
@@ -578,13 +641,82 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes)
         pch += handled;
         nBytes -= handled;
 
-        if (msg.complete())
+        if (msg.complete()) {
             msg.nTime = GetTimeMicros();
+            // Finish the checksum here rather than on the handler thread
+            msg.GetMessageHash();
+            uint64_t nMsgBytes = msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+            std::string strCommand = msg.hdr.GetCommand();
+            AddMsgCmdBytes(mapRecvBytesPerMsgCmd, strCommand, nMsgBytes);
+            LOCK(cs_totalBytesRecv);
+            AddMsgCmdBytes(mapTotalBytesRecvPerMsgCmd, strCommand, nMsgBytes);
+        }
     }
 
     return true;
 }
 
+/** Most payload buffers kept for reuse */
+static const size_t MAX_RECV_BUFFER_POOL = 64;
+/** Most memory held by the buffer pool */
+static const size_t MAX_RECV_BUFFER_POOL_BYTES = 8 * MAX_BLOCK_SIZE;
+
+static CCriticalSection cs_vRecvBufferPool;
+static std::vector<CSerializeData> vRecvBufferPool;
+static size_t nRecvBufferPoolBytes = 0;
+
+/**
+ * Give vRecv the smallest pooled buffer that holds nSize bytes, or the
+ * largest one if none does. Besides saving the allocation, this saves
+ * wiping the buffer, which the zero_after_free_allocator does on every
+ * free.
+ */
+static void TakeRecvBuffer(CDataStream& vRecv, unsigned int nSize)
+{
+    LOCK(cs_vRecvBufferPool);
+    if (vRecvBufferPool.empty())
+        return;
+    size_t nBest = 0;
+    for (size_t i = 1; i < vRecvBufferPool.size(); i++) {
+        size_t nCapacity = vRecvBufferPool[i].capacity();
+        size_t nBestCapacity = vRecvBufferPool[nBest].capacity();
+        if (nBestCapacity >= nSize ? (nCapacity >= nSize && nCapacity < nBestCapacity) : nCapacity > nBestCapacity)
+            nBest = i;
+    }
+    nRecvBufferPoolBytes -= vRecvBufferPool[nBest].capacity();
+    vRecv.swapbuffer(vRecvBufferPool[nBest]);
+    vRecv.clear();
+    vRecvBufferPool[nBest].swap(vRecvBufferPool.back());
+    vRecvBufferPool.pop_back();
+}
+
+static void ReturnRecvBuffer(CDataStream& vRecv)
+{
+    CSerializeData data;
+    vRecv.swapbuffer(data);
+    if (data.capacity() == 0)
+        return;
+    LOCK(cs_vRecvBufferPool);
+    if (vRecvBufferPool.size() < MAX_RECV_BUFFER_POOL && nRecvBufferPoolBytes + data.capacity() <= MAX_RECV_BUFFER_POOL_BYTES) {
+        nRecvBufferPoolBytes += data.capacity();
+        vRecvBufferPool.push_back(CSerializeData());
+        vRecvBufferPool.back().swap(data);
+    }
+}
+
+CNetMessage::~CNetMessage()
+{
+    ReturnRecvBuffer(vRecv);
+}
+
+const uint256& CNetMessage::GetMessageHash() const
+{
+    assert(complete());
+    if (data_hash == 0)
+        hasher.Finalize(data_hash.begin());
+    return data_hash;
+}
+
 int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
@@ -612,6 +744,8 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
 
     // switch state to reading message data
     in_data = true;
+    if (hdr.nMessageSize > 0)
+        TakeRecvBuffer(vRecv, hdr.nMessageSize);
 
     return nCopy;
 }
@@ -626,6 +760,7 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
         vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
     }
 
+    hasher.Write((const unsigned char*)pch, nCopy);
     memcpy(&vRecv[nDataPos], pch, nCopy);
     nDataPos += nCopy;
 
@@ -640,25 +775,62 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
 
 
+/** Most buffers handed to the kernel in one call */
+static const int MAX_SEND_IOV = 64;
+
+/**
+ * Send from the queued messages starting at it, the first one from nOffset,
+ * in a single system call. Where scatter-gather is available, consecutive
+ * messages go out together without being copied into one buffer.
+ */
+static int SendQueuedMessages(SOCKET hSocket, std::deque<CSerializedNetMsg>::const_iterator it, std::deque<CSerializedNetMsg>::const_iterator end, size_t nOffset)
+{
+#ifdef WIN32
+    const CSerializeData& data = **it;
+    return send(hSocket, &data[nOffset], data.size() - nOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+    struct iovec iov[MAX_SEND_IOV];
+    int nIov = 0;
+    for (; it != end && nIov < MAX_SEND_IOV; ++it, nOffset = 0) {
+        const CSerializeData& data = **it;
+        iov[nIov].iov_base = (void*)&data[nOffset];
+        iov[nIov].iov_len = data.size() - nOffset;
+        nIov++;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = nIov;
+    return sendmsg(hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
+}
+
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode *pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSerializedNetMsg>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData &data = *it;
-        assert(data.size() > pnode->nSendOffset);
-        int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        assert((*it)->size() > pnode->nSendOffset);
+        int nBytes = SendQueuedMessages(pnode->hSocket, it, pnode->vSendMsg.end(), pnode->nSendOffset);
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
+            // retire the messages that went out completely
+            size_t nSent = nBytes;
+            while (nSent > 0) {
+                size_t nRemaining = (*it)->size() - pnode->nSendOffset;
+                if (nSent < nRemaining) {
+                    pnode->nSendOffset += nSent;
+                    break;
+                }
+                nSent -= nRemaining;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
+                pnode->nSendSize -= (*it)->size();
                 it++;
-            } else {
+            }
+            if (pnode->nSendOffset != 0) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -686,9 +858,161 @@ void SocketSendData(CNode *pnode)
 
 static list<CNode*> vNodesDisconnected;
 
+/** Accept one pending connection; returns false once there is nothing left to accept. */
+static bool AcceptConnection(const ListenSocket& hListenSocket)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
+    CAddress addr;
+    int nInbound = 0;
+
+    if (hSocket == INVALID_SOCKET)
+    {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
+        return false;
+    }
+
+    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+        LogPrintf("Warning: Unknown socket family\n");
+
+    bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    if (!IsPollableSocket(hSocket))
+    {
+        LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
+        CloseSocket(hSocket);
+    }
+    else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS)
+    {
+        CloseSocket(hSocket);
+    }
+    else if (CNode::IsBanned(addr) && !whitelisted)
+    {
+        LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
+        CloseSocket(hSocket);
+    }
+    else
+    {
+        CNode* pnode = new CNode(hSocket, addr, "", true);
+        pnode->AddRef();
+        pnode->fWhitelisted = whitelisted;
+
+        {
+            LOCK(cs_vNodes);
+            vNodes.push_back(pnode);
+            vNodesNew.push_back(pnode);
+        }
+    }
+    return true;
+}
+
+// requires LOCK(cs_vRecvMsg)
+static void ReceiveSocketData(CNode *pnode)
+{
+    // Read until the socket would block, or the receive buffer is full; in
+    // the latter case fPollRecv stays set so that we resume without waiting
+    // for another readiness report.
+    while (pnode->fPollRecv && (
+           pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+           pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
+    {
+        // typical socket buffer is 8K-64K
+        char pchBuf[0x10000];
+        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        if (nBytes > 0)
+        {
+            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+                pnode->CloseSocketDisconnect();
+            pnode->nLastRecv = GetTime();
+            pnode->nRecvBytes += nBytes;
+            pnode->RecordBytesRecv(nBytes);
+            // a short read means the kernel buffer is empty
+            if (nBytes < (int)sizeof(pchBuf))
+                pnode->fPollRecv = false;
+        }
+        else if (nBytes == 0)
+        {
+            // socket closed gracefully
+            if (!pnode->fDisconnect)
+                LogPrint("net", "socket closed\n");
+            pnode->CloseSocketDisconnect();
+        }
+        else if (nBytes < 0)
+        {
+            // error
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
+            {
+                if (!pnode->fDisconnect)
+                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+                pnode->CloseSocketDisconnect();
+            }
+            else if (nErr != WSAEINTR)
+                pnode->fPollRecv = false;
+        }
+        if (pnode->hSocket == INVALID_SOCKET)
+            pnode->fPollRecv = false;
+    }
+}
+
+/** Disconnect pnode if it has been quiet for too long */
+static void InactivityCheck(CNode *pnode, int64_t nTime)
+{
+    if (pnode->hSocket == INVALID_SOCKET || nTime - pnode->nTimeConnected <= 60)
+        return;
+    if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
+    {
+        LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+        pnode->fDisconnect = true;
+    }
+    else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
+    {
+        LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+        pnode->fDisconnect = true;
+    }
+    else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
+    {
+        LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+        pnode->fDisconnect = true;
+    }
+    else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+    {
+        LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+        pnode->fDisconnect = true;
+    }
+}
+
+static void WakeMessageHandler()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutexMsgProc);
+        fMsgProcWake = true;
+    }
+    messageHandlerCondition.notify_all();
+}
+
+static void WakeSocketHandler()
+{
+    if (pSocketPoller)
+        pSocketPoller->Interrupt();
+}
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    vector<CSocketPoller::Event> vEvents;
+    // Nodes left readable or with unsent data, to revisit next round; holds a reference
+    vector<CNode*> vNodesPending;
+    int64_t nLastInactivityCheck = 0;
     while (true)
     {
         //
@@ -755,45 +1079,51 @@ void ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Declare which sockets we are interested in
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+        const bool fEdgeTriggered = pSocketPoller->IsEdgeTriggered();
+        const int nEventsAll = CSocketPoller::POLL_RECV | CSocketPoller::POLL_SEND | CSocketPoller::POLL_ERR;
+        BOOST_FOREACH(ListenSocket& hListenSocket, vhListenSocket) {
+            if (hListenSocket.socket == INVALID_SOCKET)
+                continue;
+            int nEvents = CSocketPoller::POLL_RECV | CSocketPoller::POLL_ERR;
+            pSocketPoller->Watch(hListenSocket.socket, hListenSocket.nPollEvents, nEvents, &hListenSocket);
+            hListenSocket.nPollEvents = nEvents;
         }
 
+        if (fEdgeTriggered)
         {
+            // The poller keeps the interest list, so only new sockets need
+            // declaring, with everything we may wait for. Whether to act on
+            // a report is decided when servicing the node.
             LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodesNew)
+            {
+                if (pnode->hSocket == INVALID_SOCKET)
+                    continue;
+                pSocketPoller->Watch(pnode->hSocket, pnode->nPollEvents, nEventsAll, pnode);
+                pnode->nPollEvents = nEventsAll;
+            }
+            vNodesNew.clear();
+        }
+        else
+        {
+            LOCK(cs_vNodes);
+            vNodesNew.clear();
             BOOST_FOREACH(CNode* pnode, vNodes)
             {
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
+                int nEvents = CSocketPoller::POLL_ERR;
 
                 // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
+                // * If there is data to send, wait for sending data. As this only
                 //   happens when optimistic write failed, we choose to first drain the
                 //   write buffer in this case before receiving more. This avoids
                 //   needlessly queueing received data, if the remote peer is not themselves
                 //   receiving data. This means properly utilizing TCP flow control signalling.
                 // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
+                //   or there is space left in the buffer, wait for receiving data.
                 // * (if neither of the above applies, there is certainly one message
                 //   in the receiver buffer ready to be processed).
                 // Together, that means that at least one of the following is always possible,
@@ -801,39 +1131,38 @@ void ThreadSocketHandler()
                 // * We send some data.
                 // * We wait for data to be received (and disconnect after timeout).
                 // * We process a message in the buffer (message handler thread).
+                bool fSend = false;
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
                     if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
+                        nEvents |= CSocketPoller::POLL_SEND;
+                        fSend = true;
                     }
                 }
+                if (!fSend)
                 {
                     TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
                     if (lockRecv && (
                         pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
                         pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
+                        nEvents |= CSocketPoller::POLL_RECV;
                 }
+
+                pSocketPoller->Watch(pnode->hSocket, pnode->nPollEvents, nEvents, pnode);
+                pnode->nPollEvents = nEvents;
             }
         }
 
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        // Readiness is remembered on the node until a read or write would
+        // block, as edge-triggered pollers report each change only once.
+        bool fPollError = !pSocketPoller->Wait(50, vEvents); // frequency to check timeouts
         boost::this_thread::interruption_point();
 
-        if (nSelect == SOCKET_ERROR)
+        if (fPollError)
         {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec/1000);
+            int nErr = WSAGetLastError();
+            LogPrintf("socket %s error %s\n", pSocketPoller->GetName(), NetworkErrorString(nErr));
+            MilliSleep(50);
         }
 
         //
@@ -841,158 +1170,136 @@ void ThreadSocketHandler()
         //
         BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket == INVALID_SOCKET)
+                continue;
+            bool fReady = fPollError;
+            BOOST_FOREACH(const CSocketPoller::Event& ev, vEvents)
+                if (ev.pContext == &hListenSocket)
+                    fReady = true;
+            if (fReady)
             {
-                struct sockaddr_storage sockaddr;
-                socklen_t len = sizeof(sockaddr);
-                SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        LogPrintf("Warning: Unknown socket family\n");
-
-                bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
-                {
-                    LOCK(cs_vNodes);
-                    BOOST_FOREACH(CNode* pnode, vNodes)
-                        if (pnode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET)
-                {
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-                }
-                else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS)
-                {
-                    CloseSocket(hSocket);
-                }
-                else if (CNode::IsBanned(addr) && !whitelisted)
-                {
-                    LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
-                    CloseSocket(hSocket);
-                }
-                else
-                {
-                    CNode* pnode = new CNode(hSocket, addr, "", true);
-                    pnode->AddRef();
-                    pnode->fWhitelisted = whitelisted;
-
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pnode);
-                    }
-                }
+                // Accept until the backlog is drained
+                while (AcceptConnection(hListenSocket)) {}
             }
         }
 
         //
-        // Service each socket
+        // Service the nodes that were reported ready, or still had work
+        // left over from the previous round. Nobody else is visited.
         //
+        map<CNode*, int> mapNodeEvents;
+        BOOST_FOREACH(CNode* pnode, vNodesPending)
+            mapNodeEvents[pnode] |= 0;
+        BOOST_FOREACH(const CSocketPoller::Event& ev, vEvents)
+        {
+            bool fListen = false;
+            BOOST_FOREACH(const ListenSocket& hListenSocket, vhListenSocket)
+                if (ev.pContext == &hListenSocket)
+                    fListen = true;
+            if (!fListen)
+                mapNodeEvents[(CNode*)ev.pContext] |= ev.nEvents;
+        }
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH(CNode* pnode, vNodesCopy)
-                pnode->AddRef();
+            if (fPollError) {
+                // Nothing is known; try reading from everyone
+                BOOST_FOREACH(CNode* pnode, vNodes)
+                    mapNodeEvents[pnode] |= CSocketPoller::POLL_RECV;
+            }
+            // Only reports for connected nodes are acted on: one for a node
+            // that has gone since may refer to one deleted already.
+            set<CNode*> setNodes(vNodes.begin(), vNodes.end());
+            for (map<CNode*, int>::iterator it = mapNodeEvents.begin(); it != mapNodeEvents.end(); ++it) {
+                if (!setNodes.count(it->first))
+                    continue;
+                it->first->AddRef();
+                vNodesCopy.push_back(it->first);
+            }
+            BOOST_FOREACH(CNode* pnode, vNodesPending)
+                pnode->Release();
         }
+        vNodesPending.clear();
+        bool fWakeMessageHandler = false;
         BOOST_FOREACH(CNode* pnode, vNodesCopy)
         {
             boost::this_thread::interruption_point();
 
-            //
-            // Receive
-            //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
-            {
-                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv)
-                {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0)
-                        {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
-                        }
-                        else if (nBytes == 0)
-                        {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        }
-                        else if (nBytes < 0)
-                        {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
-                            {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
-            }
+            int nEvents = mapNodeEvents[pnode];
+            if (nEvents & (CSocketPoller::POLL_RECV | CSocketPoller::POLL_ERR))
+                pnode->fPollRecv = true;
+            if (nEvents & CSocketPoller::POLL_SEND)
+                pnode->fPollSend = true;
+            bool fPending = false;
 
             //
             // Send
             //
-            if (pnode->hSocket == INVALID_SOCKET)
-                continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend))
+            // Queued data is drained before reading more from the peer, so
+            // that a peer that does not read does not get us to buffer what
+            // it sends (see the interest declared for level-triggered pollers).
+            bool fSendQueued = false;
+            if (pnode->fPollSend && (pnode->nPollEvents & CSocketPoller::POLL_SEND))
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    SocketSendData(pnode);
+                if (lockSend) {
+                    if (!pnode->vSendMsg.empty())
+                        SocketSendData(pnode);
+                    if (!pnode->vSendMsg.empty()) {
+                        pnode->fPollSend = false;
+                        fSendQueued = true;
+                    }
+                } else if (pnode->nSendSize > 0) {
+                    fPending = true;
+                }
             }
 
             //
-            // Inactivity checking
+            // Receive
             //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60)
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            if (pnode->fPollRecv && (!fSendQueued || (nEvents & CSocketPoller::POLL_ERR)) &&
+                ((pnode->nPollEvents & CSocketPoller::POLL_RECV) || (nEvents & CSocketPoller::POLL_ERR)))
             {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0)
-                {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL)
-                {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                }
-                else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90*60))
-                {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                }
-                else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros())
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                if (lockRecv)
                 {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
+                    ReceiveSocketData(pnode);
+                    if (!pnode->vRecvMsg.empty() && pnode->vRecvMsg.front().complete())
+                        fWakeMessageHandler = true;
                 }
+                // Still readable: the receive buffer is full, or was busy
+                if (pnode->fPollRecv)
+                    fPending = true;
             }
+
+            if (fPending && fEdgeTriggered)
+                vNodesPending.push_back(pnode);
         }
         {
             LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodesPending)
+                pnode->AddRef();
             BOOST_FOREACH(CNode* pnode, vNodesCopy)
                 pnode->Release();
         }
+        if (fWakeMessageHandler)
+            WakeMessageHandler();
+
+        //
+        // Inactivity checking, once a second
+        //
+        int64_t nTime = GetTime();
+        if (nTime != nLastInactivityCheck)
+        {
+            nLastInactivityCheck = nTime;
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodes)
+                InactivityCheck(pnode, nTime);
+        }
     }
 }
 
@@ -1403,7 +1710,7 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 }
 
 
-void ThreadMessageHandler()
+void ThreadMessageHandler(int nThread, int nThreads)
 {
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
     while (true)
@@ -1418,17 +1725,23 @@ void ThreadMessageHandler()
         }
 
         // Poll the connected nodes for messages
-        CNode* pnodeTrickle = NULL;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
-
         bool fSleep = true;
 
-        BOOST_FOREACH(CNode* pnode, vNodesCopy)
+        // Each thread starts at a different node, so that they spread out
+        // rather than all contending for the first ones.
+        size_t nStart = vNodesCopy.size() * nThread / nThreads;
+        for (size_t i = 0; i < vNodesCopy.size(); i++)
         {
+            CNode* pnode = vNodesCopy[(nStart + i) % vNodesCopy.size()];
             if (pnode->fDisconnect)
                 continue;
 
+            // A node busy in another thread is simply skipped; that thread
+            // will see its remaining messages, in order.
+            TRY_LOCK(pnode->cs_msgHandler, lockHandler);
+            if (!lockHandler)
+                continue;
+
             // Receive messages
             {
                 TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
@@ -1452,7 +1765,7 @@ void ThreadMessageHandler()
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
-                    g_signals.SendMessages(pnode, pnode == pnodeTrickle);
+                    g_signals.SendMessages(pnode);
             }
             boost::this_thread::interruption_point();
         }
@@ -1463,8 +1776,12 @@ void ThreadMessageHandler()
                 pnode->Release();
         }
 
-        if (fSleep)
-            MilliSleep(100);
+        if (fSleep) {
+            boost::unique_lock<boost::mutex> lock(mutexMsgProc);
+            if (!fMsgProcWake)
+                messageHandlerCondition.timed_wait(lock, boost::posix_time::milliseconds(100));
+            fMsgProcWake = false;
+        }
     }
 }
 
@@ -1495,6 +1812,13 @@ bool BindListenPort(const CService &addrBind, string& strError, bool fWhiteliste
         LogPrintf("%s\n", strError);
         return false;
     }
+    if (!IsPollableSocket(hListenSocket))
+    {
+        strError = "Error: Couldn't create a listenable socket for incoming connections (non-selectable socket)";
+        LogPrintf("%s\n", strError);
+        CloseSocket(hListenSocket);
+        return false;
+    }
 
 #ifndef WIN32
 #ifdef SO_NOSIGPIPE
@@ -1610,6 +1934,12 @@ void static Discover(boost::thread_group& threadGroup)
 #endif
 }
 
+void SetSocketPoller(CSocketPoller* pPoller)
+{
+    delete pSocketPoller;
+    pSocketPoller = pPoller;
+}
+
 void StartNode(boost::thread_group& threadGroup)
 {
     uiInterface.InitMessage(_("Loading addresses..."));
@@ -1647,6 +1977,9 @@ void StartNode(boost::thread_group& threadGroup)
     // Map ports with UPnP
     MapPort(GetBoolArg("-upnp", DEFAULT_UPNP));
 
+    assert(pSocketPoller != NULL); // see SetSocketPoller
+    LogPrintf("Using %s to wait for sockets\n", pSocketPoller->GetName());
+
     // Send and receive from sockets, accept connections
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "net", &ThreadSocketHandler));
 
@@ -1657,7 +1990,12 @@ void StartNode(boost::thread_group& threadGroup)
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    int nMsgHandThreads = GetArg("-msghandthreads", DEFAULT_MSGHAND_THREADS);
+    nMsgHandThreads = std::max(std::min(nMsgHandThreads, MAX_MSGHAND_THREADS), 1);
+    for (int i = 0; i < nMsgHandThreads; i++) {
+        boost::function<void()> fn = boost::bind(&ThreadMessageHandler, i, nMsgHandThreads);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand", fn));
+    }
 
     // Dump network addresses
     threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "dumpaddr", &DumpAddresses, DUMP_ADDRESSES_INTERVAL * 1000));
@@ -1703,9 +2041,12 @@ public:
             delete pnode;
         vNodes.clear();
         vNodesDisconnected.clear();
+        vNodesNew.clear();
         vhListenSocket.clear();
         delete semOutbound;
         semOutbound = NULL;
+        delete pSocketPoller;
+        pSocketPoller = NULL;
         delete pnodeLocalHost;
         pnodeLocalHost = NULL;
 
@@ -1743,8 +2084,9 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
             vRelayExpiration.pop_front();
         }
 
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
+        // Save original serialized message so newer versions are preserved;
+        // every peer that asks for it is sent this same buffer
+        mapRelay.insert(std::make_pair(inv, MakeSerializedNetMsg(inv.GetCommand(), ss)));
         vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
     }
     LOCK(cs_vNodes);
@@ -1762,6 +2104,12 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
     }
 }
 
+int64_t PoissonNextSend(int64_t nNow, int average_interval_seconds)
+{
+    // -log(U) * average for U uniform in (0, 1]
+    return nNow + (int64_t)(log1p(GetRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * average_interval_seconds * -1000000.0 + 0.5);
+}
+
 void CNode::RecordBytesRecv(uint64_t bytes)
 {
     LOCK(cs_totalBytesRecv);
@@ -1772,6 +2120,89 @@ void CNode::RecordBytesSent(uint64_t bytes)
 {
     LOCK(cs_totalBytesSent);
     nTotalBytesSent += bytes;
+
+    uint64_t now = GetTime();
+    if (nMaxOutboundCycleStartTime + nMaxOutboundTimeframe < now)
+    {
+        // timeframe expired, reset cycle
+        nMaxOutboundCycleStartTime = now;
+        nMaxOutboundTotalBytesSentInCycle = 0;
+    }
+
+    nMaxOutboundTotalBytesSentInCycle += bytes;
+}
+
+void CNode::SetMaxOutboundTarget(uint64_t limit)
+{
+    LOCK(cs_totalBytesSent);
+    nMaxOutboundLimit = limit;
+}
+
+uint64_t CNode::GetMaxOutboundTarget()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundLimit;
+}
+
+void CNode::SetMaxOutboundTimeframe(uint64_t timeframe)
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundTimeframe != timeframe)
+    {
+        // reset measure-cycle in case of changing
+        // the timeframe
+        nMaxOutboundCycleStartTime = GetTime();
+    }
+    nMaxOutboundTimeframe = timeframe;
+}
+
+uint64_t CNode::GetMaxOutboundTimeframe()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundTimeframe;
+}
+
+uint64_t CNode::GetMaxOutboundTimeLeftInCycle()
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    if (nMaxOutboundCycleStartTime == 0)
+        return nMaxOutboundTimeframe;
+
+    uint64_t cycleEndTime = nMaxOutboundCycleStartTime + nMaxOutboundTimeframe;
+    uint64_t now = GetTime();
+    return (cycleEndTime < now) ? 0 : cycleEndTime - now;
+}
+
+bool CNode::OutboundTargetReached(bool historicalBlockServingLimit)
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return false;
+
+    if (historicalBlockServingLimit)
+    {
+        // keep a large enough buffer to at least relay each block once
+        uint64_t timeLeftInCycle = GetMaxOutboundTimeLeftInCycle();
+        uint64_t buffer = timeLeftInCycle / (uint64_t)Params().TargetSpacing() * MAX_BLOCK_SIZE;
+        if (buffer >= nMaxOutboundLimit || nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit - buffer)
+            return true;
+    }
+    else if (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit)
+        return true;
+
+    return false;
+}
+
+uint64_t CNode::GetOutboundTargetBytesLeft()
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
 }
 
 uint64_t CNode::GetTotalBytesRecv()
@@ -1786,6 +2217,18 @@ uint64_t CNode::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+mapMsgCmdSize CNode::GetTotalBytesRecvPerMsgCmd()
+{
+    LOCK(cs_totalBytesRecv);
+    return mapTotalBytesRecvPerMsgCmd;
+}
+
+mapMsgCmdSize CNode::GetTotalBytesSentPerMsgCmd()
+{
+    LOCK(cs_totalBytesSent);
+    return mapTotalBytesSentPerMsgCmd;
+}
+
 void CNode::Fuzz(int nChance)
 {
     if (!fSuccessfullyConnected) return; // Don't fuzz initial handshake
@@ -1925,7 +2368,8 @@ bool CAddrDB::Read(CAddrMan& addr)
 unsigned int ReceiveFloodSize() { return 1000*GetArg("-maxreceivebuffer", 5*1000); }
 unsigned int SendBufferSize() { return 1000*GetArg("-maxsendbuffer", 1*1000); }
 
-CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000)
+CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000),
+    filterInventoryKnown(INVENTORY_KNOWN_FILTER_SIZE, 0.000001)
 {
     nServices = 0;
     hSocket = hSocketIn;
@@ -1950,11 +2394,16 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    fWaitingForMain = false;
+    nPollEvents = 0;
+    fPollRecv = false;
+    fPollSend = false;
     hashContinue = 0;
     nStartingHeight = -1;
     fGetAddr = false;
     fRelayTxes = false;
-    setInventoryKnown.max_size(SendBufferSize() / 1000);
+    nNextAddrSend = 0;
+    nNextInvSend = 0;
     pfilter = new CBloomFilter();
     nPingNonceSent = 0;
     nPingUsecStart = 0;
@@ -2035,6 +2484,78 @@ void CNode::AbortMessage() UNLOCK_FUNCTION(cs_vSend)
     LogPrint("net", "(aborted)\n");
 }
 
+/** Fill in the size and checksum of the message in ss, which starts with its header */
+static void SetMessageSizeAndChecksum(CDataStream& ss)
+{
+    // Set the size
+    unsigned int nSize = ss.size() - CMessageHeader::HEADER_SIZE;
+    memcpy((char*)&ss[CMessageHeader::MESSAGE_SIZE_OFFSET], &nSize, sizeof(nSize));
+
+    // Set the checksum
+    uint256 hash = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    assert(ss.size () >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
+    memcpy((char*)&ss[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+}
+
+CSerializedNetMsg MakeSerializedNetMsg(const char* pszCommand, const CDataStream& ssPayload)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(CMessageHeader::HEADER_SIZE + ssPayload.size());
+    ss << CMessageHeader(pszCommand, 0) << ssPayload;
+    SetMessageSizeAndChecksum(ss);
+
+    boost::shared_ptr<CSerializeData> msg = boost::make_shared<CSerializeData>();
+    ss.GetAndClear(*msg);
+    return msg;
+}
+
+void CNode::QueueSendMessage(const CSerializedNetMsg& msg)
+{
+    vSendMsg.push_back(msg);
+    nSendSize += msg->size();
+
+    const char* pszCommand = &(*msg)[MESSAGE_START_SIZE];
+    std::string strCommand(pszCommand, strnlen(pszCommand, CMessageHeader::COMMAND_SIZE));
+    AddMsgCmdBytes(mapSendBytesPerMsgCmd, strCommand, msg->size());
+    {
+        LOCK(cs_totalBytesSent);
+        AddMsgCmdBytes(mapTotalBytesSentPerMsgCmd, strCommand, msg->size());
+    }
+
+    // If write queue empty, attempt "optimistic write", and make the socket
+    // handler wait for writability if that did not send everything. Nodes
+    // without a socket keep their messages for TakeSendQueue().
+    if (vSendMsg.size() == 1 && hSocket != INVALID_SOCKET) {
+        SocketSendData(this);
+        if (!vSendMsg.empty())
+            WakeSocketHandler();
+    }
+}
+
+void CNode::PushSerializedMessage(const CSerializedNetMsg& msg)
+{
+    LOCK(cs_vSend);
+    LogPrint("net", "sending: shared message (%d bytes) peer=%d\n", msg->size() - CMessageHeader::HEADER_SIZE, id);
+    QueueSendMessage(msg);
+}
+
+void CNode::TakeSendQueue(std::deque<CSerializedNetMsg>& vMsgOut)
+{
+    LOCK(cs_vSend);
+    assert(nSendOffset == 0);
+    BOOST_FOREACH(const CSerializedNetMsg& msg, vSendMsg) {
+        nSendBytes += msg->size();
+        RecordBytesSent(msg->size());
+    }
+    if (!vSendMsg.empty())
+        nLastSend = GetTime();
+    vMsgOut.insert(vMsgOut.end(), vSendMsg.begin(), vSendMsg.end());
+    vSendMsg.clear();
+    nSendSize = 0;
+}
+
 void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
 {
     // The -*messagestest options are intentionally not documented in the help message,
@@ -2052,26 +2573,13 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
     if (ssSend.size() == 0)
         return;
 
-    // Set the size
-    unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
-    memcpy((char*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], &nSize, sizeof(nSize));
+    SetMessageSizeAndChecksum(ssSend);
 
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    unsigned int nChecksum = 0;
-    memcpy(&nChecksum, &hash, sizeof(nChecksum));
-    assert(ssSend.size () >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
-    memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
-
-    LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
+    LogPrint("net", "(%d bytes) peer=%d\n", ssSend.size() - CMessageHeader::HEADER_SIZE, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
-
-    // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
-        SocketSendData(this);
+    boost::shared_ptr<CSerializeData> msg = boost::make_shared<CSerializeData>();
+    ssSend.GetAndClear(*msg);
+    QueueSendMessage(msg);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
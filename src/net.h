@@ -20,6 +20,7 @@
 #include "utilstrencodings.h"
 
 #include <deque>
+#include <map>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -28,11 +29,13 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/signals2/signal.hpp>
 
 class CAddrMan;
 class CBlockIndex;
 class CNode;
+class CSocketPoller;
 
 namespace boost {
     class thread_group;
@@ -54,12 +57,39 @@ static const bool DEFAULT_UPNP = USE_UPNP;
 #else
 static const bool DEFAULT_UPNP = false;
 #endif
+/** The number of most recently announced inventory items remembered per peer */
+static const unsigned int INVENTORY_KNOWN_FILTER_SIZE = 20000;
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** -maxuploadtarget default: the upload target in MiB per timeframe, 0 = no limit */
+static const uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
+/** Length of an upload target cycle, in seconds */
+static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
+/** -msghandthreads default */
+static const int DEFAULT_MSGHAND_THREADS = 4;
+/** Maximum number of message handler threads */
+static const int MAX_MSGHAND_THREADS = 16;
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
 
+/**
+ * A complete message as sent on the wire, header included. It is never
+ * modified once built, so one copy can be queued on any number of peers.
+ */
+typedef boost::shared_ptr<const CSerializeData> CSerializedNetMsg;
+
+/** Build a message from an already serialized payload */
+CSerializedNetMsg MakeSerializedNetMsg(const char* pszCommand, const CDataStream& ssPayload);
+
+template<typename T>
+CSerializedNetMsg MakeSerializedNetMsg(const char* pszCommand, const T& payload)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << payload;
+    return MakeSerializedNetMsg(pszCommand, ss);
+}
+
 void AddOneShot(std::string strDest);
 bool RecvLine(SOCKET hSocket, std::string& strLine);
 void AddressCurrentlyConnected(const CService& addr);
@@ -71,6 +101,8 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant *grantOu
 void MapPort(bool fUseUPnP);
 unsigned short GetListenPort();
 bool BindListenPort(const CService &bindAddr, std::string& strError, bool fWhitelisted = false);
+/** Hand the socket poller to use over to the network code, which then owns it; required before StartNode */
+void SetSocketPoller(CSocketPoller* pPoller);
 void StartNode(boost::thread_group& threadGroup);
 bool StopNode();
 void SocketSendData(CNode *pnode);
@@ -82,7 +114,7 @@ struct CNodeSignals
 {
     boost::signals2::signal<int ()> GetHeight;
     boost::signals2::signal<bool (CNode*)> ProcessMessages;
-    boost::signals2::signal<bool (CNode*, bool)> SendMessages;
+    boost::signals2::signal<bool (CNode*)> SendMessages;
     boost::signals2::signal<void (NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void (NodeId)> FinalizeNode;
 };
@@ -127,7 +159,7 @@ extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+extern std::map<CInv, CSerializedNetMsg> mapRelay;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
@@ -146,6 +178,8 @@ struct LocalServiceInfo {
 extern CCriticalSection cs_mapLocalHost;
 extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost;
 
+typedef std::map<std::string, uint64_t> mapMsgCmdSize; //! command, total bytes
+
 class CNodeStats
 {
 public:
@@ -166,12 +200,24 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    mapMsgCmdSize mapSendBytesPerMsgCmd;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd;
 };
 
 
 
 
+/**
+ * A message being received. The payload is hashed as it arrives, on the
+ * socket thread, so that checking the checksum takes no second pass over
+ * it. Payload buffers come from, and go back to, a pool shared by all
+ * peers.
+ */
 class CNetMessage {
+private:
+    mutable CHash256 hasher;
+    mutable uint256 data_hash;
+
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
@@ -192,6 +238,8 @@ public:
         nTime = 0;
     }
 
+    ~CNetMessage();
+
     bool complete() const
     {
         if (!in_data)
@@ -205,6 +253,9 @@ public:
         vRecv.SetVersion(nVersionIn);
     }
 
+    //! Double-SHA256 of the payload; only valid once the message is complete
+    const uint256& GetMessageHash() const;
+
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
 };
@@ -224,13 +275,26 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSerializedNetMsg> vSendMsg;
     CCriticalSection cs_vSend;
+    mapMsgCmdSize mapSendBytesPerMsgCmd; // requires cs_vSend
+
+    // only used by the socket handler thread
+    int nPollEvents; // interest last declared to the socket poller, and for which reports are acted on
+    bool fPollRecv; // reported readable, and not yet read until it would block
+    bool fPollSend; // reported writable, and not yet written until it would block
 
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
+    // Held by the message handler thread servicing this node, so that its
+    // messages are processed in order even with several handler threads.
+    CCriticalSection cs_msgHandler;
+    // A message that needs cs_main was put back because another thread held
+    // it; the next attempt waits for cs_main instead.
+    bool fWaitingForMain;
     uint64_t nRecvBytes;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd; // requires cs_vRecvMsg
     int nRecvVersion;
 
     int64_t nLastSend;
@@ -285,14 +349,20 @@ public:
     // flood relay
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
+    CCriticalSection cs_vAddrToSend; // also guards setAddrKnown
     bool fGetAddr;
     std::set<uint256> setKnown;
+    int64_t nNextAddrSend;
 
     // inventory based relay
-    mruset<CInv> setInventoryKnown;
-    std::vector<CInv> vInventoryToSend;
-    CCriticalSection cs_inventory;
+    CRollingBloomFilter filterInventoryKnown;
+    // Transactions still to be announced; sorted by fee rate when sent out
+    std::set<uint256> setInventoryTxToSend;
+    // Blocks still to be announced, in order; these are sent right away
+    std::vector<uint256> vInventoryBlockToSend;
+    CCriticalSection cs_inventory; // guards the above
     std::multimap<int64_t, CInv> mapAskFor;
+    int64_t nNextInvSend;
 
     // Ping time measurement:
     // The pong reply we're expecting, or 0 if no pong expected.
@@ -313,6 +383,14 @@ private:
     static CCriticalSection cs_totalBytesSent;
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
+    static mapMsgCmdSize mapTotalBytesRecvPerMsgCmd; // requires cs_totalBytesRecv
+    static mapMsgCmdSize mapTotalBytesSentPerMsgCmd; // requires cs_totalBytesSent
+
+    // Upload target, all require cs_totalBytesSent
+    static uint64_t nMaxOutboundTotalBytesSentInCycle;
+    static uint64_t nMaxOutboundCycleStartTime;
+    static uint64_t nMaxOutboundLimit;
+    static uint64_t nMaxOutboundTimeframe;
 
     CNode(const CNode&);
     void operator=(const CNode&);
@@ -364,6 +442,7 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
+        LOCK(cs_vAddrToSend);
         setAddrKnown.insert(addr);
     }
 
@@ -372,6 +451,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_vAddrToSend);
         if (addr.IsValid() && !setAddrKnown.count(addr)) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand() % vAddrToSend.size()] = addr;
@@ -386,21 +466,29 @@ public:
     {
         {
             LOCK(cs_inventory);
-            setInventoryKnown.insert(inv);
+            filterInventoryKnown.insert(inv.hash);
         }
     }
 
     void PushInventory(const CInv& inv)
     {
-        {
-            LOCK(cs_inventory);
-            if (!setInventoryKnown.count(inv))
-                vInventoryToSend.push_back(inv);
+        LOCK(cs_inventory);
+        if (inv.type == MSG_TX) {
+            if (!filterInventoryKnown.contains(inv.hash))
+                setInventoryTxToSend.insert(inv.hash);
+        } else if (inv.type == MSG_BLOCK) {
+            vInventoryBlockToSend.push_back(inv.hash);
         }
     }
 
     void AskFor(const CInv& inv);
 
+private:
+    // requires LOCK(cs_vSend)
+    void QueueSendMessage(const CSerializedNetMsg& msg);
+
+public:
+
     // TODO: Document the postcondition of this function.  Is cs_vSend locked?
     void BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend);
 
@@ -410,6 +498,15 @@ public:
     // TODO: Document the precondition of this function.  Is cs_vSend locked?
     void EndMessage() UNLOCK_FUNCTION(cs_vSend);
 
+    /** Queue a message built with MakeSerializedNetMsg, without copying it */
+    void PushSerializedMessage(const CSerializedNetMsg& msg);
+
+    /**
+     * Take all queued messages as if they had been sent. For nodes without a
+     * socket, whose messages an in-process transport carries instead.
+     */
+    void TakeSendQueue(std::deque<CSerializedNetMsg>& vMsgOut);
+
     void PushVersion();
 
 
@@ -604,6 +701,26 @@ public:
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+    static mapMsgCmdSize GetTotalBytesRecvPerMsgCmd();
+    static mapMsgCmdSize GetTotalBytesSentPerMsgCmd();
+
+    //! set the max outbound target in bytes, 0 = no limit
+    static void SetMaxOutboundTarget(uint64_t limit);
+    static uint64_t GetMaxOutboundTarget();
+
+    //! set the timeframe for the max outbound target, in seconds
+    static void SetMaxOutboundTimeframe(uint64_t timeframe);
+    static uint64_t GetMaxOutboundTimeframe();
+
+    //! check if the outbound target is reached; if historicalBlockServingLimit
+    //! is set, keep room for serving a recent block until the cycle ends
+    static bool OutboundTargetReached(bool historicalBlockServingLimit);
+
+    //! bytes that can still be sent in the current cycle, 0 if no limit
+    static uint64_t GetOutboundTargetBytesLeft();
+
+    //! seconds left in the current cycle, 0 if no limit
+    static uint64_t GetMaxOutboundTimeLeftInCycle();
 };
 
 
@@ -612,6 +729,9 @@ class CTransaction;
 void RelayTransaction(const CTransaction& tx);
 void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
 
+/** Return a timestamp in the future (in microseconds) for exponentially distributed events. */
+int64_t PoissonNextSend(int64_t nNow, int average_interval_seconds);
+
 /** Access to the (IP) address database (peers.dat) */
 class CAddrDB
 {
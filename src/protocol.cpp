@@ -18,9 +18,46 @@ static const char* ppszTypeName[] =
     "ERROR",
     "tx",
     "block",
-    "filtered block"
+    "filtered block",
+    "compact block"
 };
 
+const char* NET_MESSAGE_COMMAND_OTHER = "*other*";
+
+static const char* allNetMessageTypes[] = {
+    "version",
+    "verack",
+    "addr",
+    "inv",
+    "getdata",
+    "merkleblock",
+    "getblocks",
+    "getheaders",
+    "tx",
+    "headers",
+    "block",
+    "getaddr",
+    "mempool",
+    "ping",
+    "pong",
+    "alert",
+    "notfound",
+    "filterload",
+    "filteradd",
+    "filterclear",
+    "reject",
+    "sendcmpct",
+    "cmpctblock",
+    "getblocktxn",
+    "blocktxn"
+};
+static const std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes + ARRAYLEN(allNetMessageTypes));
+
+const std::vector<std::string>& GetAllNetMessageTypes()
+{
+    return allNetMessageTypesVec;
+}
+
 CMessageHeader::CMessageHeader()
 {
     memcpy(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE);
@@ -17,6 +17,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #define MESSAGE_START_SIZE 4
 
@@ -147,6 +148,15 @@ enum {
     // Nodes may always request a MSG_FILTERED_BLOCK in a getdata, however,
     // MSG_FILTERED_BLOCK should not appear in any invs except as a part of getdata.
     MSG_FILTERED_BLOCK,
+    // Nodes that negotiated compact blocks with sendcmpct may request a
+    // MSG_CMPCT_BLOCK in a getdata; like MSG_FILTERED_BLOCK it is never announced.
+    MSG_CMPCT_BLOCK,
 };
 
+/** Bucket for byte counters of messages whose command is not in GetAllNetMessageTypes() */
+extern const char* NET_MESSAGE_COMMAND_OTHER;
+
+/** The commands of all messages this node sends or handles */
+const std::vector<std::string>& GetAllNetMessageTypes();
+
 #endif // BITCOIN_PROTOCOL_H
@@ -0,0 +1,409 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pushnotify.h"
+
+#include "chain.h"
+#include "netbase.h"
+#include "primitives/block.h"
+#include "socketpoll.h"
+#include "streams.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "version.h"
+
+#include <algorithm>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+/** Topics, as named in the messages and in the -pub<topic> options */
+static const char* const PUB_TOPICS[] = { "hashblock", "hashtx", "rawblock", "rawtx" };
+
+/** Milliseconds the publishing thread waits when there is nothing to do */
+static const int PUB_POLL_TIMEOUT = 1000;
+
+/** A hash as a message body: in the byte order RPC shows it in */
+static vector<unsigned char> HashBody(const uint256& hash)
+{
+    vector<unsigned char> vBody(hash.begin(), hash.end());
+    reverse(vBody.begin(), vBody.end());
+    return vBody;
+}
+
+template <typename T>
+static vector<unsigned char> SerializeBody(const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    return vector<unsigned char>(ss.begin(), ss.end());
+}
+
+CPushNotifier::CPushNotifier() : nMaxBuffer(DEFAULT_PUB_BUFFER * 1024 * 1024), poller(NULL), pthread(NULL), pindexLastTip(NULL)
+{
+}
+
+CPushNotifier::~CPushNotifier()
+{
+    Stop();
+    delete poller;
+}
+
+CPushNotifier* CPushNotifier::Create(string& strError)
+{
+    strError = "";
+    CPushNotifier* pnotifier = new CPushNotifier();
+    for (unsigned int i = 0; i < ARRAYLEN(PUB_TOPICS); i++) {
+        const string strTopic = PUB_TOPICS[i];
+        BOOST_FOREACH(const string& strAddress, mapMultiArgs["-pub" + strTopic]) {
+            vector<Endpoint>::iterator it = pnotifier->vEndpoints.begin();
+            while (it != pnotifier->vEndpoints.end() && it->strAddress != strAddress)
+                ++it;
+            if (it == pnotifier->vEndpoints.end()) {
+                Endpoint endpoint;
+                endpoint.strAddress = strAddress;
+                endpoint.hListenSocket = INVALID_SOCKET;
+                endpoint.nWatched = 0;
+                it = pnotifier->vEndpoints.insert(it, endpoint);
+            }
+            it->setTopics.insert(strTopic);
+        }
+    }
+    if (pnotifier->vEndpoints.empty()) {
+        delete pnotifier;
+        return NULL;
+    }
+
+    int64_t nBufferMiB = GetArg("-pubbuffer", DEFAULT_PUB_BUFFER);
+    if (nBufferMiB <= 0) {
+        strError = strprintf(_("Invalid amount for -pubbuffer=<n>: '%s'"), mapArgs["-pubbuffer"]);
+        delete pnotifier;
+        return NULL;
+    }
+    pnotifier->nMaxBuffer = nBufferMiB * 1024 * 1024;
+
+    string strPoller = GetArg("-socketpoller", DEFAULT_SOCKET_POLLER);
+    pnotifier->poller = CreateSocketPoller(strPoller);
+    if (!pnotifier->poller) {
+        strError = strprintf(_("Unsupported -socketpoller: '%s'"), strPoller);
+        delete pnotifier;
+        return NULL;
+    }
+    BOOST_FOREACH(Endpoint& endpoint, pnotifier->vEndpoints) {
+        if (!pnotifier->Bind(endpoint, strError)) {
+            delete pnotifier;
+            return NULL;
+        }
+    }
+
+    pnotifier->pthread = new boost::thread(boost::bind(&TraceThread<boost::function<void()> >, "publish",
+                                                       boost::function<void()>(boost::bind(&CPushNotifier::ThreadPublish, pnotifier))));
+    return pnotifier;
+}
+
+bool CPushNotifier::Bind(Endpoint& endpoint, string& strError)
+{
+    const string& strAddress = endpoint.strAddress;
+    string strPath;
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    memset(&sockaddr, 0, sizeof(sockaddr));
+
+    if (boost::algorithm::starts_with(strAddress, "unix:")) {
+#ifdef WIN32
+        strError = strprintf(_("Unix sockets are not supported on this system: '%s'"), strAddress);
+        return false;
+#else
+        strPath = strAddress.substr(5);
+        struct sockaddr_un* paddr = (struct sockaddr_un*)&sockaddr;
+        if (strPath.empty() || strPath.size() >= sizeof(paddr->sun_path)) {
+            strError = strprintf(_("Invalid socket path: '%s'"), strAddress);
+            return false;
+        }
+        paddr->sun_family = AF_UNIX;
+        strcpy(paddr->sun_path, strPath.c_str());
+        len = sizeof(struct sockaddr_un);
+
+        // Remove the socket of a node that did not shut down cleanly, but
+        // not one that is still served
+        struct stat st;
+        if (lstat(strPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            SOCKET hProbe = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (hProbe != INVALID_SOCKET) {
+                if (connect(hProbe, (struct sockaddr*)&sockaddr, len) == SOCKET_ERROR && errno == ECONNREFUSED)
+                    unlink(strPath.c_str());
+                CloseSocket(hProbe);
+            }
+        }
+#endif
+    } else if (boost::algorithm::starts_with(strAddress, "tcp://")) {
+        CService addr;
+        if (!Lookup(strAddress.substr(6).c_str(), addr, 0, fNameLookup) || addr.GetPort() == 0 ||
+            !addr.GetSockAddr((struct sockaddr*)&sockaddr, &len)) {
+            strError = strprintf(_("Invalid address to publish on: '%s'"), strAddress);
+            return false;
+        }
+    } else {
+        strError = strprintf(_("Invalid address to publish on: '%s' (expected unix:<path> or tcp://<host>:<port>)"), strAddress);
+        return false;
+    }
+
+    SOCKET hSocket = socket(((struct sockaddr*)&sockaddr)->sa_family, SOCK_STREAM, 0);
+    if (hSocket == INVALID_SOCKET) {
+        strError = strprintf(_("Couldn't open socket to publish on %s (socket returned error %s)"), strAddress, NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    if (poller->IsLimitedBySetSize() && !IsSelectableSocket(hSocket)) {
+        strError = strprintf(_("Couldn't open socket to publish on %s (non-selectable socket)"), strAddress);
+        CloseSocket(hSocket);
+        return false;
+    }
+#ifndef WIN32
+    if (((struct sockaddr*)&sockaddr)->sa_family != AF_UNIX) {
+        int nOne = 1;
+        setsockopt(hSocket, SOL_SOCKET, SO_REUSEADDR, (void*)&nOne, sizeof(int));
+    }
+#endif
+    if (::bind(hSocket, (struct sockaddr*)&sockaddr, len) == SOCKET_ERROR) {
+        strError = strprintf(_("Unable to bind to %s on this computer (bind returned error %s)"), strAddress, NetworkErrorString(WSAGetLastError()));
+        CloseSocket(hSocket);
+        return false;
+    }
+    endpoint.strPath = strPath;
+    if (listen(hSocket, SOMAXCONN) == SOCKET_ERROR || !SetSocketNonBlocking(hSocket, true)) {
+        strError = strprintf(_("Error: Listening on %s failed (error %s)"), strAddress, NetworkErrorString(WSAGetLastError()));
+        CloseSocket(hSocket);
+        return false;
+    }
+    endpoint.hListenSocket = hSocket;
+
+    string strTopics;
+    BOOST_FOREACH(const string& strTopic, endpoint.setTopics)
+        strTopics += (strTopics.empty() ? "" : ", ") + strTopic;
+    LogPrintf("Publishing %s on %s\n", strTopics, strAddress);
+    return true;
+}
+
+void CPushNotifier::Stop()
+{
+    if (pthread) {
+        pthread->interrupt();
+        poller->Interrupt();
+        pthread->join();
+        delete pthread;
+        pthread = NULL;
+    }
+
+    LOCK(cs);
+    BOOST_FOREACH(Endpoint& endpoint, vEndpoints) {
+        BOOST_FOREACH(Subscriber& subscriber, endpoint.vSubscribers)
+            CloseSocket(subscriber.hSocket);
+        endpoint.vSubscribers.clear();
+        CloseSocket(endpoint.hListenSocket);
+#ifndef WIN32
+        if (!endpoint.strPath.empty())
+            unlink(endpoint.strPath.c_str());
+#endif
+        endpoint.strPath.clear();
+    }
+}
+
+bool CPushNotifier::HasSubscribers(const string& strTopic)
+{
+    LOCK(cs);
+    BOOST_FOREACH(const Endpoint& endpoint, vEndpoints) {
+        if (!endpoint.vSubscribers.empty() && endpoint.setTopics.count(strTopic))
+            return true;
+    }
+    return false;
+}
+
+void CPushNotifier::Publish(const string& strTopic, const vector<unsigned char>& vBody)
+{
+    LOCK(cs);
+    uint32_t nSequence = mapSequence[strTopic]++;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << strTopic << vBody << nSequence;
+
+    bool fQueued = false;
+    BOOST_FOREACH(Endpoint& endpoint, vEndpoints) {
+        if (!endpoint.setTopics.count(strTopic))
+            continue;
+        BOOST_FOREACH(Subscriber& subscriber, endpoint.vSubscribers) {
+            if (subscriber.vSend.size() - subscriber.nSendOffset + ss.size() > nMaxBuffer) {
+                if (subscriber.nDropped++ == 0)
+                    LogPrintf("A subscriber to %s reads too slowly; dropping messages\n", endpoint.strAddress);
+                continue;
+            }
+            if (subscriber.nDropped) {
+                LogPrintf("A subscriber to %s missed %u messages\n", endpoint.strAddress, subscriber.nDropped);
+                subscriber.nDropped = 0;
+            }
+            // Drop what was sent before it is worth moving the rest
+            if (subscriber.nSendOffset > 0 && subscriber.nSendOffset >= subscriber.vSend.size() / 2) {
+                subscriber.vSend.erase(subscriber.vSend.begin(), subscriber.vSend.begin() + subscriber.nSendOffset);
+                subscriber.nSendOffset = 0;
+            }
+            subscriber.vSend.insert(subscriber.vSend.end(), ss.begin(), ss.end());
+            fQueued = true;
+        }
+    }
+    if (fQueued)
+        poller->Interrupt();
+}
+
+void CPushNotifier::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    if (HasSubscribers("hashtx"))
+        Publish("hashtx", HashBody(tx.GetHash()));
+    if (HasSubscribers("rawtx"))
+        Publish("rawtx", SerializeBody(tx));
+}
+
+void CPushNotifier::UpdatedBlockTip(const CBlockIndex* pindexNew)
+{
+    bool fHash = HasSubscribers("hashblock");
+    bool fRaw = HasSubscribers("rawblock");
+
+    // The blocks connected since the tip last published, newest first
+    vector<pair<uint256, CDiskBlockPos> > vBlocks;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexFork = pindexLastTip;
+        if (pindexFork && pindexFork->nHeight > pindexNew->nHeight)
+            pindexFork = pindexFork->GetAncestor(pindexNew->nHeight);
+        while (pindexFork && pindexNew->GetAncestor(pindexFork->nHeight) != pindexFork)
+            pindexFork = pindexFork->pprev;
+        size_t nMaxBlocks = pindexLastTip ? PUB_MAX_BLOCKS_PER_TIP : 1;
+        for (const CBlockIndex* pindex = pindexNew; (fHash || fRaw) && pindex && pindex != pindexFork && vBlocks.size() < nMaxBlocks; pindex = pindex->pprev)
+            vBlocks.push_back(make_pair(pindex->GetBlockHash(), pindex->GetBlockPos()));
+        pindexLastTip = pindexNew;
+    }
+
+    for (vector<pair<uint256, CDiskBlockPos> >::reverse_iterator it = vBlocks.rbegin(); it != vBlocks.rend(); ++it) {
+        if (fHash)
+            Publish("hashblock", HashBody(it->first));
+        if (fRaw) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, it->second)) {
+                LogPrintf("%s : failed to read block %s\n", __func__, it->first.ToString());
+                continue;
+            }
+            Publish("rawblock", SerializeBody(block));
+        }
+    }
+}
+
+void CPushNotifier::AcceptSubscribers(Endpoint& endpoint)
+{
+    while (true) {
+        struct sockaddr_storage sockaddr;
+        socklen_t len = sizeof(sockaddr);
+        SOCKET hSocket = accept(endpoint.hListenSocket, (struct sockaddr*)&sockaddr, &len);
+        if (hSocket == INVALID_SOCKET) {
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEINTR)
+                LogPrintf("Accepting a subscriber to %s failed: %s\n", endpoint.strAddress, NetworkErrorString(nErr));
+            return;
+        }
+        if (poller->IsLimitedBySetSize() && !IsSelectableSocket(hSocket)) {
+            LogPrintf("Subscriber to %s dropped: non-selectable socket\n", endpoint.strAddress);
+            CloseSocket(hSocket);
+            continue;
+        }
+        if (!SetSocketNonBlocking(hSocket, true))
+            continue;
+#ifdef SO_NOSIGPIPE
+        int nOne = 1;
+        setsockopt(hSocket, SOL_SOCKET, SO_NOSIGPIPE, (void*)&nOne, sizeof(int));
+#endif
+        Subscriber subscriber;
+        subscriber.hSocket = hSocket;
+        subscriber.nWatched = 0;
+        subscriber.nSendOffset = 0;
+        subscriber.nDropped = 0;
+        endpoint.vSubscribers.push_back(subscriber);
+        LogPrint("pushnotify", "New subscriber to %s\n", endpoint.strAddress);
+    }
+}
+
+bool CPushNotifier::ServiceSubscriber(Subscriber& subscriber)
+{
+    // Subscribers have nothing to say; read only to notice when they leave
+    char buf[256];
+    while (true) {
+        int nBytes = recv(subscriber.hSocket, buf, sizeof(buf), MSG_DONTWAIT);
+        if (nBytes > 0)
+            continue;
+        if (nBytes == 0)
+            return false;
+        int nErr = WSAGetLastError();
+        if (nErr == WSAEWOULDBLOCK || nErr == WSAEMSGSIZE || nErr == WSAEINTR || nErr == WSAEINPROGRESS)
+            break;
+        return false;
+    }
+
+    while (subscriber.nSendOffset < subscriber.vSend.size()) {
+        int nBytes = send(subscriber.hSocket, &subscriber.vSend[subscriber.nSendOffset], subscriber.vSend.size() - subscriber.nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (nBytes > 0) {
+            subscriber.nSendOffset += nBytes;
+            continue;
+        }
+        int nErr = WSAGetLastError();
+        if (nBytes < 0 && (nErr == WSAEWOULDBLOCK || nErr == WSAEMSGSIZE || nErr == WSAEINTR || nErr == WSAEINPROGRESS))
+            break;
+        return false;
+    }
+    if (subscriber.nSendOffset == subscriber.vSend.size()) {
+        subscriber.vSend.clear();
+        subscriber.nSendOffset = 0;
+    }
+    return true;
+}
+
+void CPushNotifier::ThreadPublish()
+{
+    vector<CSocketPoller::Event> vEvents;
+    while (true) {
+        boost::this_thread::interruption_point();
+        {
+            // Serve every socket before waiting, as the poller may only
+            // report sockets that became ready since
+            LOCK(cs);
+            BOOST_FOREACH(Endpoint& endpoint, vEndpoints) {
+                AcceptSubscribers(endpoint);
+                int nListenEvents = CSocketPoller::POLL_RECV | CSocketPoller::POLL_ERR;
+                poller->Watch(endpoint.hListenSocket, endpoint.nWatched, nListenEvents, &endpoint);
+                endpoint.nWatched = nListenEvents;
+
+                list<Subscriber>::iterator it = endpoint.vSubscribers.begin();
+                while (it != endpoint.vSubscribers.end()) {
+                    if (!ServiceSubscriber(*it)) {
+                        LogPrint("pushnotify", "A subscriber to %s left\n", endpoint.strAddress);
+                        poller->Unwatch(it->hSocket);
+                        CloseSocket(it->hSocket);
+                        it = endpoint.vSubscribers.erase(it);
+                        continue;
+                    }
+                    int nEvents = CSocketPoller::POLL_RECV | CSocketPoller::POLL_ERR;
+                    if (it->nSendOffset < it->vSend.size())
+                        nEvents |= CSocketPoller::POLL_SEND;
+                    poller->Watch(it->hSocket, it->nWatched, nEvents, &*it);
+                    it->nWatched = nEvents;
+                    ++it;
+                }
+            }
+        }
+        if (!poller->Wait(PUB_POLL_TIMEOUT, vEvents))
+            MilliSleep(100);
+    }
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_PUSHNOTIFY_H
+#define BITCOIN_PUSHNOTIFY_H
+
+#include "compat.h"
+#include "main.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace boost {
+class thread;
+}
+
+class CBlockIndex;
+class CSocketPoller;
+
+/** Default for -pubbuffer: MiB of messages kept for a subscriber that reads too slowly; newer ones are dropped */
+static const unsigned int DEFAULT_PUB_BUFFER = 16;
+/** Blocks published at most when the tip moves by more at once, as after a long reorganization */
+static const int PUB_MAX_BLOCKS_PER_TIP = 100;
+
+/**
+ * Publishes the blocks and transactions the node accepts to subscribers
+ * connected to Unix or TCP sockets (-pubhashblock=<address> and so on). A
+ * topic may share its address with others. Subscribers get every message
+ * of the topics of the address they connected to, each framed as
+ *
+ *   topic (string), body (byte vector), sequence (uint32)
+ *
+ * serialized the way the P2P protocol serializes them. Sequence numbers
+ * count the messages of each topic, so a subscriber notices those it
+ * missed. Messages are queued, and written by a thread of the publisher's
+ * own, so the validation code never waits for a subscriber; one that
+ * falls more than -pubbuffer behind misses messages rather than holding
+ * them up for the others.
+ */
+class CPushNotifier : public CValidationInterface
+{
+public:
+    ~CPushNotifier();
+
+    /**
+     * Create a publisher from the -pub<topic> options and bind its sockets.
+     * Returns NULL with strError empty if none is set, and NULL with
+     * strError set if one cannot be bound.
+     */
+    static CPushNotifier* Create(std::string& strError);
+
+    /** Stop publishing and close the sockets */
+    void Stop();
+
+protected:
+    // CValidationInterface
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+
+private:
+    struct Subscriber
+    {
+        SOCKET hSocket;
+        int nWatched;               //!< Poller interest last declared
+        std::vector<char> vSend;    //!< Messages queued, of which the first nSendOffset bytes were sent
+        size_t nSendOffset;
+        uint64_t nDropped;          //!< Messages dropped because vSend was full
+    };
+
+    struct Endpoint
+    {
+        std::string strAddress;
+        std::string strPath;        //!< Of a Unix socket, to remove when done
+        SOCKET hListenSocket;
+        int nWatched;
+        std::set<std::string> setTopics;
+        std::list<Subscriber> vSubscribers;
+    };
+
+    CCriticalSection cs;
+    std::vector<Endpoint> vEndpoints;
+    //! Messages published so far per topic
+    std::map<std::string, uint32_t> mapSequence;
+    size_t nMaxBuffer;
+    CSocketPoller* poller;
+    boost::thread* pthread;
+    //! The tip blocks were last published for; guarded by cs_main
+    const CBlockIndex* pindexLastTip;
+
+    CPushNotifier();
+    CPushNotifier(const CPushNotifier&);
+    void operator=(const CPushNotifier&);
+
+    bool Bind(Endpoint& endpoint, std::string& strError);
+    bool HasSubscribers(const std::string& strTopic);
+    void Publish(const std::string& strTopic, const std::vector<unsigned char>& vBody);
+
+    void ThreadPublish();
+    void AcceptSubscribers(Endpoint& endpoint);
+    /** Read and write what the subscriber's socket allows; false if it is gone */
+    bool ServiceSubscriber(Subscriber& subscriber);
+};
+
+#endif // BITCOIN_PUSHNOTIFY_H
@@ -3,19 +3,21 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockfilterindex.h"
+#include "jsonwriter.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
 #include "rpcserver.h"
 #include "streams.h"
 #include "sync.h"
+#include "txmempool.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
 
 using namespace std;
-using namespace json_spirit;
 
 enum RetFormat {
     RF_UNDEF,
@@ -34,6 +36,9 @@ static const struct {
       {RF_JSON, "json"},
 };
 
+static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const long MAX_REST_HEADERS_RESULTS = 2000;
+
 class RestErr
 {
 public:
@@ -41,8 +46,30 @@ public:
     string message;
 };
 
-extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, Object& entry);
-extern Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+struct CCoin {
+    uint32_t nTxVer; // Don't call this nVersion, that name has a special meaning inside IMPLEMENT_SERIALIZE
+    uint32_t nHeight;
+    CTxOut out;
+    CAmount nInterest; //!< Accrued on out.nValue up to the current height
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nTxVer);
+        READWRITE(nHeight);
+        READWRITE(out);
+        READWRITE(nInterest);
+    }
+};
+
+extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, CJSONWriter& entry);
+extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, CJSONWriter& out, bool fIncludeHex);
+extern void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, CJSONWriter& result, bool txDetails = false);
+extern void blockheaderToJSON(const CBlockIndex* blockindex, CJSONWriter& result);
+extern void mempoolToJSON(CJSONWriter& result, bool fVerbose);
+extern double GetDifficulty(const CBlockIndex* blockindex, int algo);
 
 static RestErr RESTERR(enum HTTPStatusCode status, string message)
 {
@@ -103,38 +130,48 @@ static bool rest_block(AcceptedConnection* conn,
     if (!ParseHashStr(hashStr, hash))
         throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
-        if (mapBlockIndex.count(hash) == 0)
-            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
-
-        pblockindex = mapBlockIndex[hash];
-        if (!ReadBlockFromDisk(block, pblockindex))
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
             throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        pblockindex = mi->second;
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
-        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryBlock.size(), "application/octet-stream") << binaryBlock << std::flush;
+        // Sent as stored in the block file, without deserializing it
+        vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, vchBlock.size(), "application/octet-stream"));
+        conn->write(string(vchBlock.begin(), vchBlock.end()));
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+        vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        string strHex = HexStr(vchBlock.begin(), vchBlock.end()) + "\n";
+        conn->write(HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain"));
         return true;
     }
 
     case RF_JSON: {
-        Object objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = write_string(Value(objBlock), false) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pblockindex))
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        string strJSON;
+        CJSONStringWriter writer(strJSON);
+        {
+            LOCK(cs_main);
+            blockToJSON(block, pblockindex, writer, showTxDetails);
+        }
+        strJSON += "\n";
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, strJSON.size()));
+        conn->write_swap(strJSON);
         return true;
     }
 
@@ -163,6 +200,80 @@ static bool rest_block_notxdetails(AcceptedConnection* conn,
     return rest_block(conn, strReq, mapHeaders, fRun, false);
 }
 
+static bool rest_blockfilter(AcceptedConnection* conn,
+                             string& strReq,
+                             map<string, string>& mapHeaders,
+                             bool fRun)
+{
+    // <filtertype>/<hash>.<ext>
+    size_t nSlash = strReq.find('/');
+    if (nSlash == string::npos)
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilter/<filtertype>/<blockhash>.<ext>");
+    string strFilterType = strReq.substr(0, nSlash);
+
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq.substr(nSlash + 1));
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(strFilterType, filterType))
+        throw RESTERR(HTTP_BAD_REQUEST, "Unknown filtertype " + strFilterType);
+
+    string hashStr = params[0];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    if (!pblockfilterindex || pblockfilterindex->GetFilterType() != filterType)
+        throw RESTERR(HTTP_BAD_REQUEST, "Index is not enabled for filtertype " + strFilterType);
+
+    CBlockIndex* pblockindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+        pblockindex = mi->second;
+    }
+
+    BlockFilter filter;
+    uint256 hashHeader;
+    if (!pblockfilterindex->LookupFilter(pblockindex, filter, hashHeader))
+        throw RESTERR(HTTP_NOT_FOUND, "Filter of " + hashStr + " not found" + (pblockfilterindex->IsSynced() ? "" : " (the index is still being built)"));
+
+    CDataStream ssFilter(SER_NETWORK, PROTOCOL_VERSION);
+    ssFilter << filter;
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryFilter = ssFilter.str();
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, binaryFilter.size(), "application/octet-stream") + binaryFilter);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssFilter.begin(), ssFilter.end()) + "\n";
+        conn->write(HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain"));
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue objFilter(UniValue::VOBJ);
+        objFilter.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+        objFilter.pushKV("header", hashHeader.GetHex());
+        string strJSON = objFilter.write() + "\n";
+        conn->write(HTTPReply(HTTP_OK, strJSON, fRun));
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_tx(AcceptedConnection* conn,
                     string& strReq,
                     map<string, string>& mapHeaders,
@@ -187,21 +298,350 @@ static bool rest_tx(AcceptedConnection* conn,
     switch (rf) {
     case RF_BINARY: {
         string binaryTx = ssTx.str();
-        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryTx.size(), "application/octet-stream") << binaryTx << std::flush;
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, binaryTx.size(), "application/octet-stream") + binaryTx);
         return true;
     }
 
     case RF_HEX: {
         string strHex = HexStr(ssTx.begin(), ssTx.end()) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+        conn->write(HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain"));
+        return true;
+    }
+
+    case RF_JSON: {
+        string strJSON;
+        CJSONStringWriter writer(strJSON);
+        writer.BeginObject();
+        TxToJSON(tx, hashBlock, writer);
+        writer.EndObject();
+        strJSON += "\n";
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, strJSON.size()));
+        conn->write_swap(strJSON);
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_headers(AcceptedConnection* conn,
+                         string& strReq,
+                         map<string, string>& mapHeaders,
+                         bool fRun)
+{
+    // <count>/<hash>.<ext>
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        throw RESTERR(HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext>.");
+
+    long count = strtol(path[0].c_str(), NULL, 10);
+    if (count < 1 || count > MAX_REST_HEADERS_RESULTS)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Header count out of range: %s", path[0]));
+
+    string hashStr = path[1];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    // The headers come from the block index: no block file is read
+    LOCK(cs_main);
+    std::vector<const CBlockIndex*> headers;
+    headers.reserve(count);
+    BlockMap::const_iterator it = mapBlockIndex.find(hash);
+    const CBlockIndex* pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
+    while (pindex != NULL && chainActive.Contains(pindex)) {
+        headers.push_back(pindex);
+        if (headers.size() == (size_t)count)
+            break;
+        pindex = chainActive.Next(pindex);
+    }
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH(const CBlockIndex* pindex, headers)
+        ssHeader << pindex->GetBlockHeader();
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryHeader = ssHeader.str();
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, binaryHeader.size(), "application/octet-stream") + binaryHeader);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        conn->write(HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain"));
+        return true;
+    }
+
+    case RF_JSON: {
+        string strJSON;
+        CJSONStringWriter writer(strJSON);
+        writer.BeginArray();
+        BOOST_FOREACH(const CBlockIndex* pindex, headers)
+            blockheaderToJSON(pindex, writer);
+        writer.EndArray();
+        strJSON += "\n";
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, strJSON.size()));
+        conn->write_swap(strJSON);
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: .bin, .hex, .json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_chaininfo(AcceptedConnection* conn,
+                           string& strReq,
+                           map<string, string>& mapHeaders,
+                           bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    switch (rf) {
+    case RF_JSON: {
+        UniValue chainInfoObject;
+        {
+            LOCK(cs_main);
+            chainInfoObject = getblockchaininfo(UniValue(UniValue::VARR), false);
+        }
+        string strJSON = chainInfoObject.write() + "\n";
+        conn->write(HTTPReply(HTTP_OK, strJSON, fRun));
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_difficulty(AcceptedConnection* conn,
+                            string& strReq,
+                            map<string, string>& mapHeaders,
+                            bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    switch (rf) {
+    case RF_JSON: {
+        // Each algorithm has its own difficulty, set by its own last block
+        UniValue objDifficulty(UniValue::VOBJ);
+        {
+            LOCK(cs_main);
+            for (int algo = 0; algo < NUM_ALGOS; algo++)
+                objDifficulty.pushKV(GetAlgoName(algo), ValueFromDouble(GetDifficulty(NULL, algo)));
+        }
+        string strJSON = objDifficulty.write() + "\n";
+        conn->write(HTTPReply(HTTP_OK, strJSON, fRun));
         return true;
     }
 
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_mempool_info(AcceptedConnection* conn,
+                              string& strReq,
+                              map<string, string>& mapHeaders,
+                              bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    switch (rf) {
     case RF_JSON: {
-        Object objTx;
-        TxToJSON(tx, hashBlock, objTx);
-        string strJSON = write_string(Value(objTx), false) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        UniValue mempoolInfoObject = getmempoolinfo(UniValue(UniValue::VARR), false);
+        string strJSON = mempoolInfoObject.write() + "\n";
+        conn->write(HTTPReply(HTTP_OK, strJSON, fRun));
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_mempool_contents(AcceptedConnection* conn,
+                                  string& strReq,
+                                  map<string, string>& mapHeaders,
+                                  bool fRun)
+{
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    switch (rf) {
+    case RF_JSON: {
+        string strJSON;
+        CJSONStringWriter writer(strJSON);
+        mempoolToJSON(writer, true);
+        strJSON += "\n";
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, strJSON.size()));
+        conn->write_swap(strJSON);
+        return true;
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_getutxos(AcceptedConnection* conn,
+                          string& strReq,
+                          map<string, string>& mapHeaders,
+                          bool fRun)
+{
+    // [/checkmempool]/<txid>-<n>/<txid>-<n>/....<ext>
+    vector<string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    vector<string> uriParts;
+    if (params.size() > 0 && params[0].length() > 1) {
+        string strUriParams = params[0].substr(1);
+        boost::split(uriParts, strUriParams, boost::is_any_of("/"));
+    }
+
+    bool fCheckMemPool = false;
+    if (uriParts.size() > 0 && uriParts[0] == "checkmempool") {
+        fCheckMemPool = true;
+        uriParts.erase(uriParts.begin());
+    }
+
+    if (uriParts.empty())
+        throw RESTERR(HTTP_BAD_REQUEST, "Empty request. Use /rest/getutxos/[checkmempool/]<txid>-<n>/....<ext>");
+
+    if (uriParts.size() > MAX_GETUTXOS_OUTPOINTS)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_GETUTXOS_OUTPOINTS, uriParts.size()));
+
+    vector<COutPoint> vOutPoints;
+    BOOST_FOREACH(const string& strOutPoint, uriParts) {
+        size_t nDash = strOutPoint.find('-');
+        if (nDash == string::npos)
+            throw RESTERR(HTTP_BAD_REQUEST, "Parse error: " + strOutPoint);
+        string strTxid = strOutPoint.substr(0, nDash);
+        string strOutput = strOutPoint.substr(nDash + 1);
+        uint256 txid;
+        int32_t nOutput;
+        if (!ParseHashStr(strTxid, txid) || !ParseInt32(strOutput, &nOutput) || nOutput < 0)
+            throw RESTERR(HTTP_BAD_REQUEST, "Parse error: " + strOutPoint);
+        vOutPoints.push_back(COutPoint(txid, (uint32_t)nOutput));
+    }
+
+    // The outputs are looked up in the coins cache in place; only the ones
+    // found are copied out
+    vector<unsigned char> bitmap((vOutPoints.size() + 7) / 8);
+    string bitmapStringRepresentation;
+    vector<CCoin> outs;
+    int nHeight;
+    uint256 hashTip;
+    {
+        LOCK2(cs_main, mempool.cs);
+        nHeight = chainActive.Height();
+        hashTip = chainActive.Tip()->GetBlockHash();
+        CCoinsViewMemPool viewMempool(pcoinsTip, mempool);
+
+        for (size_t i = 0; i < vOutPoints.size(); i++) {
+            const COutPoint& outpoint = vOutPoints[i];
+            const CCoins* coins;
+            CCoins coinsMempool;
+            if (fCheckMemPool) {
+                coins = NULL;
+                if (viewMempool.GetCoins(outpoint.hash, coinsMempool)) {
+                    mempool.pruneSpent(outpoint.hash, coinsMempool);
+                    coins = &coinsMempool;
+                }
+            } else {
+                coins = pcoinsTip->AccessCoins(outpoint.hash);
+            }
+
+            bool fHit = coins != NULL && coins->IsAvailable(outpoint.n);
+            if (fHit) {
+                CCoin coin;
+                coin.nTxVer = coins->nVersion;
+                coin.nHeight = coins->nHeight;
+                coin.out = coins->vout[outpoint.n];
+                // As CheckInputs() counts it: nothing while in the mempool
+                coin.nInterest = coins->nHeight == MEMPOOL_HEIGHT ? 0 : ComputeInterest(nHeight - coins->nHeight, coin.out);
+                outs.push_back(coin);
+                bitmap[i / 8] |= ((unsigned char)1 << (i % 8));
+            }
+            bitmapStringRepresentation.append(fHit ? "1" : "0"); // form a binary string representation (human-readable for json output)
+        }
+    }
+
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        // The BIP64 layout, with each coin's accrued interest after its output
+        CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
+        ssGetUTXOResponse << nHeight << hashTip << bitmap << outs;
+        if (rf == RF_BINARY) {
+            string ssGetUTXOResponseString = ssGetUTXOResponse.str();
+            conn->write(HTTPReplyHeader(HTTP_OK, fRun, ssGetUTXOResponseString.size(), "application/octet-stream") + ssGetUTXOResponseString);
+        } else {
+            string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
+            conn->write(HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain"));
+        }
+        return true;
+    }
+
+    case RF_JSON: {
+        string strJSON;
+        CJSONStringWriter writer(strJSON);
+        writer.BeginObject();
+        writer.KeyValue("chainHeight", nHeight);
+        writer.KeyValue("chaintipHash", hashTip.GetHex());
+        writer.KeyValue("bitmap", bitmapStringRepresentation);
+        writer.Key("utxos");
+        writer.BeginArray();
+        BOOST_FOREACH(const CCoin& coin, outs) {
+            writer.BeginObject();
+            writer.KeyValue("txvers", (int32_t)coin.nTxVer);
+            writer.KeyValue("height", (int32_t)coin.nHeight);
+            writer.KeyValue("value", ValueFromAmount(coin.out.nValue));
+            writer.KeyValue("interest", ValueFromAmount(coin.nInterest));
+            writer.Key("scriptPubKey");
+            writer.BeginObject();
+            ScriptPubKeyToJSON(coin.out.scriptPubKey, writer, true);
+            writer.EndObject();
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+        strJSON += "\n";
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, strJSON.size()));
+        conn->write_swap(strJSON);
         return true;
     }
 
@@ -224,6 +664,13 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blockfilter/", rest_blockfilter},
+      {"/rest/headers/", rest_headers},
+      {"/rest/chaininfo", rest_chaininfo},
+      {"/rest/difficulty", rest_difficulty},
+      {"/rest/mempool/info", rest_mempool_info},
+      {"/rest/mempool/contents", rest_mempool_contents},
+      {"/rest/getutxos", rest_getutxos},
 };
 
 bool HTTPReq_REST(AcceptedConnection* conn,
@@ -244,10 +691,10 @@ bool HTTPReq_REST(AcceptedConnection* conn,
             }
         }
     } catch (RestErr& re) {
-        conn->stream() << HTTPReply(re.status, re.message + "\r\n", false, false, "text/plain") << std::flush;
+        conn->write(HTTPReply(re.status, re.message + "\r\n", false, false, "text/plain"));
         return false;
     }
 
-    conn->stream() << HTTPError(HTTP_NOT_FOUND, false) << std::flush;
+    conn->write(HTTPError(HTTP_NOT_FOUND, false));
     return false;
 }
@@ -17,7 +17,6 @@
 using namespace std;
 using namespace boost;
 using namespace boost::asio;
-using namespace json_spirit;
 
 std::string HelpMessageCli()
 {
@@ -98,7 +97,7 @@ static bool AppInitRPC(int argc, char* argv[])
     return true;
 }
 
-Object CallRPC(const string& strMethod, const Array& params)
+UniValue CallRPC(const string& strMethod, const UniValue& params)
 {
     if (mapArgs["-rpcuser"] == "" && mapArgs["-rpcpassword"] == "")
         throw runtime_error(strprintf(
@@ -146,10 +145,10 @@ Object CallRPC(const string& strMethod, const Array& params)
         throw runtime_error("no response from server");
 
     // Parse reply
-    Value valReply;
-    if (!read_string(strReply, valReply))
+    UniValue valReply;
+    if (!valReply.read(strReply))
         throw runtime_error("couldn't parse reply from server");
-    const Object& reply = valReply.get_obj();
+    const UniValue& reply = get_obj(valReply);
     if (reply.empty())
         throw runtime_error("expected reply to have result, error and id properties");
 
@@ -174,33 +173,33 @@ int CommandLineRPC(int argc, char *argv[])
 
         // Parameters default to strings
         std::vector<std::string> strParams(&argv[2], &argv[argc]);
-        Array params = RPCConvertValues(strMethod, strParams);
+        UniValue params = RPCConvertValues(strMethod, strParams);
 
         // Execute and handle connection failures with -rpcwait
         const bool fWait = GetBoolArg("-rpcwait", false);
         do {
             try {
-                const Object reply = CallRPC(strMethod, params);
+                const UniValue reply = CallRPC(strMethod, params);
 
                 // Parse reply
-                const Value& result = find_value(reply, "result");
-                const Value& error  = find_value(reply, "error");
+                const UniValue& result = find_value(reply, "result");
+                const UniValue& error  = find_value(reply, "error");
 
-                if (error.type() != null_type) {
+                if (error.getType() != UniValue::VNULL) {
                     // Error
-                    const int code = find_value(error.get_obj(), "code").get_int();
+                    const int code = get_int(find_value(get_obj(error), "code"));
                     if (fWait && code == RPC_IN_WARMUP)
                         throw CConnectionFailed("server in warmup");
-                    strPrint = "error: " + write_string(error, false);
+                    strPrint = "error: " + error.write();
                     nRet = abs(code);
                 } else {
                     // Result
-                    if (result.type() == null_type)
+                    if (result.getType() == UniValue::VNULL)
                         strPrint = "";
-                    else if (result.type() == str_type)
-                        strPrint = result.get_str();
+                    else if (result.getType() == UniValue::VSTR)
+                        strPrint = get_str(result);
                     else
-                        strPrint = write_string(result, true);
+                        strPrint = result.write(4);
                 }
 
                 // Connection succeeded, no need to retry.
@@ -3,21 +3,24 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addressindex.h"
+#include "base58.h"
+#include "blockfilterindex.h"
 #include "checkpoints.h"
+#include "jsonwriter.h"
 #include "main.h"
 #include "rpcserver.h"
 #include "sync.h"
+#include "txdb.h"
 #include "util.h"
 
+#include <limits>
 #include <stdint.h>
 
-#include "json/json_spirit_value.h"
-
-using namespace json_spirit;
 using namespace std;
 
-extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, Object& entry);
-void ScriptPubKeyToJSON(const CScript& scriptPubKey, Object& out, bool fIncludeHex);
+extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, CJSONWriter& entry);
+void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 
 double GetDifficulty(const CBlockIndex* blockindex, int algo)
 {
@@ -61,54 +64,142 @@ double GetDifficulty(const CBlockIndex* blockindex, int algo)
     return dDiff;
 }
 
-Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, CJSONWriter& result, bool txDetails = false)
 {
-    Object result;
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    result.BeginObject();
+    result.KeyValue("hash", block.GetHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
+    result.KeyValue("confirmations", confirmations);
+    result.KeyValue("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    result.KeyValue("height", blockindex->nHeight);
+    result.KeyValue("version", block.nVersion);
     int algo = block.GetAlgo();
-    result.push_back(Pair("pow_algo_id", algo));
-    result.push_back(Pair("pow_algo", GetAlgoName(algo)));
-    result.push_back(Pair("pow_hash", block.GetHash(algo).GetHex()));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    Array txs;
+    result.KeyValue("pow_algo_id", algo);
+    result.KeyValue("pow_algo", GetAlgoName(algo));
+    result.KeyValue("pow_hash", block.GetHash(algo).GetHex());
+    result.KeyValue("merkleroot", block.hashMerkleRoot.GetHex());
+    result.Key("tx");
+    result.BeginArray();
     BOOST_FOREACH(const CTransaction&tx, block.vtx)
     {
         if(txDetails)
         {
-            Object objTx;
-            TxToJSON(tx, uint256(0), objTx);
-            txs.push_back(objTx);
+            result.BeginObject();
+            TxToJSON(tx, uint256(0), result);
+            result.EndObject();
         }
         else
-            txs.push_back(tx.GetHash().GetHex());
+            result.Value(tx.GetHash().GetHex());
     }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex, algo)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    result.EndArray();
+    result.KeyValue("time", block.GetBlockTime());
+    result.KeyValue("nonce", (uint64_t)block.nNonce);
+    result.KeyValue("bits", strprintf("%08x", block.nBits));
+    result.KeyValue("difficulty", ValueFromDouble(GetDifficulty(blockindex, algo)));
+    result.KeyValue("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        result.KeyValue("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     CBlockIndex *pnext = chainActive.Next(blockindex);
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-    return result;
+        result.KeyValue("nextblockhash", pnext->GetBlockHash().GetHex());
+    result.EndObject();
 }
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    CJSONTreeWriter writer;
+    blockToJSON(block, blockindex, writer, txDetails);
+    return writer.Get();
+}
 
-Value getblockcount(const Array& params, bool fHelp)
+/** The header fields of blockToJSON, from the block index alone */
+void blockheaderToJSON(const CBlockIndex* blockindex, CJSONWriter& result)
 {
-    if (fHelp || params.size() != 0)
+    CBlockHeader header = blockindex->GetBlockHeader();
+    result.BeginObject();
+    result.KeyValue("hash", blockindex->GetBlockHash().GetHex());
+    int confirmations = -1;
+    if (chainActive.Contains(blockindex))
+        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    result.KeyValue("confirmations", confirmations);
+    result.KeyValue("height", blockindex->nHeight);
+    result.KeyValue("version", header.nVersion);
+    int algo = header.GetAlgo();
+    result.KeyValue("pow_algo_id", algo);
+    result.KeyValue("pow_algo", GetAlgoName(algo));
+    result.KeyValue("pow_hash", header.GetHash(algo).GetHex());
+    result.KeyValue("merkleroot", header.hashMerkleRoot.GetHex());
+    result.KeyValue("time", header.GetBlockTime());
+    result.KeyValue("nonce", (uint64_t)header.nNonce);
+    result.KeyValue("bits", strprintf("%08x", header.nBits));
+    result.KeyValue("difficulty", ValueFromDouble(GetDifficulty(blockindex, algo)));
+    result.KeyValue("chainwork", blockindex->nChainWork.GetHex());
+
+    if (blockindex->pprev)
+        result.KeyValue("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+    CBlockIndex *pnext = chainActive.Next(blockindex);
+    if (pnext)
+        result.KeyValue("nextblockhash", pnext->GetBlockHash().GetHex());
+    result.EndObject();
+}
+
+void mempoolToJSON(CJSONWriter& result, bool fVerbose)
+{
+    if (fVerbose)
+    {
+        // Copy the entries out and write them with no lock held, so a big
+        // pool does not hold up validation or the other calls
+        int nHeight;
+        {
+            LOCK(cs_main);
+            nHeight = chainActive.Height();
+        }
+        vector<CTxMemPoolEntryInfo> vInfo;
+        mempool.queryEntries(vInfo, nHeight);
+
+        result.BeginObject();
+        BOOST_FOREACH(const CTxMemPoolEntryInfo& info, vInfo)
+        {
+            result.Key(info.hash.ToString());
+            result.BeginObject();
+            result.KeyValue("size", (int)info.nTxSize);
+            result.KeyValue("fee", ValueFromAmount(info.nFee));
+            result.KeyValue("time", info.nTime);
+            result.KeyValue("height", (int)info.nHeight);
+            result.KeyValue("startingpriority", ValueFromDouble(info.dStartingPriority));
+            result.KeyValue("currentpriority", ValueFromDouble(info.dCurrentPriority));
+            set<string> setDepends;
+            BOOST_FOREACH(const uint256& hashDepend, info.vDepends)
+                setDepends.insert(hashDepend.ToString());
+            result.Key("depends");
+            result.BeginArray();
+            BOOST_FOREACH(const string& dep, setDepends)
+                result.Value(dep);
+            result.EndArray();
+            result.EndObject();
+        }
+        result.EndObject();
+    }
+    else
+    {
+        vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        result.BeginArray();
+        BOOST_FOREACH(const uint256& hash, vtxid)
+            result.Value(hash.ToString());
+        result.EndArray();
+    }
+}
+
+
+UniValue getblockcount(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getblockcount\n"
             "\nReturns the number of blocks in the longest block chain.\n"
@@ -122,9 +213,9 @@ Value getblockcount(const Array& params, bool fHelp)
     return chainActive.Height();
 }
 
-Value getbestblockhash(const Array& params, bool fHelp)
+UniValue getbestblockhash(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getbestblockhash\n"
             "\nReturns the hash of the best (tip) block in the longest block chain.\n"
@@ -138,9 +229,9 @@ Value getbestblockhash(const Array& params, bool fHelp)
     return chainActive.Tip()->GetBlockHash().GetHex();
 }
 
-Value getdifficulty(const Array& params, bool fHelp)
+UniValue getdifficulty(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 1)
+    if (fHelp || params.count() > 1)
         throw runtime_error(
             "getdifficulty ( algorithm )\n"
             "\nReturns the proof-of-work difficulty as a multiple of the minimum difficulty.\n"
@@ -153,13 +244,13 @@ Value getdifficulty(const Array& params, bool fHelp)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    return GetDifficulty(NULL, (params.size()>0)?params[0].get_int():ALGO_SHA256D);
+    return ValueFromDouble(GetDifficulty(NULL, (params.count()>0)?get_int(params[0]):ALGO_SHA256D));
 }
 
 
-Value getrawmempool(const Array& params, bool fHelp)
+UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 1)
+    if (fHelp || params.count() > 1)
         throw runtime_error(
             "getrawmempool ( verbose )\n"
             "\nReturns all transaction ids in memory pool as a json array of string transaction ids.\n"
@@ -190,53 +281,27 @@ Value getrawmempool(const Array& params, bool fHelp)
         );
 
     bool fVerbose = false;
-    if (params.size() > 0)
-        fVerbose = params[0].get_bool();
+    if (params.count() > 0)
+        fVerbose = get_bool(params[0]);
 
-    if (fVerbose)
-    {
-        LOCK(mempool.cs);
-        Object o;
-        BOOST_FOREACH(const PAIRTYPE(uint256, CTxMemPoolEntry)& entry, mempool.mapTx)
-        {
-            const uint256& hash = entry.first;
-            const CTxMemPoolEntry& e = entry.second;
-            Object info;
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-            Array depends(setDepends.begin(), setDepends.end());
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
-        }
-        return o;
-    }
-    else
-    {
-        vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
+    CJSONTreeWriter writer;
+    mempoolToJSON(writer, fVerbose);
+    return writer.Get();
+}
 
-        Array a;
-        BOOST_FOREACH(const uint256& hash, vtxid)
-            a.push_back(hash.ToString());
+bool getrawmempool_streamed(const UniValue& params, CJSONWriter& result)
+{
+    // Usage errors are left to getrawmempool
+    if (params.count() > 1)
+        return false;
 
-        return a;
-    }
+    mempoolToJSON(result, params.count() > 0 && get_bool(params[0]));
+    return true;
 }
 
-Value getblockhash(const Array& params, bool fHelp)
+UniValue getblockhash(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 1)
+    if (fHelp || params.count() != 1)
         throw runtime_error(
             "getblockhash index\n"
             "\nReturns hash of block in best-block-chain at index provided.\n"
@@ -249,7 +314,9 @@ Value getblockhash(const Array& params, bool fHelp)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    int nHeight = params[0].get_int();
+    LOCK(cs_main);
+
+    int nHeight = get_int(params[0]);
     if (nHeight < 0 || nHeight > chainActive.Height())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
@@ -257,9 +324,71 @@ Value getblockhash(const Array& params, bool fHelp)
     return pblockindex->GetBlockHash().GetHex();
 }
 
-Value getblock(const Array& params, bool fHelp)
+UniValue getblockhashes(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 2)
+        throw runtime_error(
+            "getblockhashes high low\n"
+            "\nReturns the hashes of the blocks in the best block chain with a timestamp from low up to, not including, high,\n"
+            "in timestamp order (requires -timestampindex).\n"
+            "\nArguments:\n"
+            "1. high          (numeric, required) The timestamp the blocks are before\n"
+            "2. low           (numeric, required) The earliest timestamp of the blocks\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"hash\"        (string) The block hash\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockhashes", "1231614698 1231024505")
+            + HelpExampleRpc("getblockhashes", "1231614698, 1231024505")
+        );
+
+    if (!fTimestampIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Timestamp index not enabled (use -timestampindex)");
+
+    int64_t nHigh = get_int64(params[0]);
+    int64_t nLow = get_int64(params[1]);
+    if (nLow < 0 || nHigh > std::numeric_limits<unsigned int>::max() || nHigh < nLow)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Timestamps out of range");
+
+    vector<uint256> vHashes;
+    if (!pblocktree->ReadTimestampIndex((unsigned int)nHigh, (unsigned int)nLow, vHashes))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the timestamp index");
+
+    UniValue result(UniValue::VARR);
+    BOOST_FOREACH(const uint256& hash, vHashes)
+        result.push_back(hash.GetHex());
+    return result;
+}
+
+static bool GetBlockVerbose(const UniValue& params)
+{
+    return params.count() > 1 ? get_bool(params[1]) : true;
+}
+
+/** Read the block the first parameter of getblock names */
+static CBlockIndex* ReadBlockParam(const UniValue& params, CBlock& block)
+{
+    std::string strHash = get_str(params[0]);
+    uint256 hash(strHash);
+
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mapBlockIndex[hash];
+    }
+
+    if(!ReadBlockFromDisk(block, pblockindex))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    return pblockindex;
+}
+
+UniValue getblock(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() < 1 || params.size() > 2)
+    if (fHelp || params.count() < 1 || params.count() > 2)
         throw runtime_error(
             "getblock \"hash\" ( verbose )\n"
             "\nIf verbose is false, returns a string that is serialized, hex-encoded data for block 'hash'.\n"
@@ -293,23 +422,10 @@ Value getblock(const Array& params, bool fHelp)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    std::string strHash = params[0].get_str();
-    uint256 hash(strHash);
-
-    bool fVerbose = true;
-    if (params.size() > 1)
-        fVerbose = params[1].get_bool();
-
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex = ReadBlockParam(params, block);
 
-    if(!ReadBlockFromDisk(block, pblockindex))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
-
-    if (!fVerbose)
+    if (!GetBlockVerbose(params))
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
         ssBlock << block;
@@ -317,50 +433,119 @@ Value getblock(const Array& params, bool fHelp)
         return strHex;
     }
 
+    LOCK(cs_main);
     return blockToJSON(block, pblockindex);
 }
 
-Value gettxoutsetinfo(const Array& params, bool fHelp)
+bool getblock_streamed(const UniValue& params, CJSONWriter& result)
+{
+    // Usage errors and the hex encoding are left to getblock
+    if (params.count() < 1 || params.count() > 2 || !GetBlockVerbose(params))
+        return false;
+
+    CBlock block;
+    CBlockIndex* pblockindex = ReadBlockParam(params, block);
+
+    LOCK(cs_main);
+    blockToJSON(block, pblockindex, result);
+    return true;
+}
+
+UniValue getblockfilter(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() < 1 || params.count() > 2)
+        throw runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 158 content filter for a particular block.\n"
+            "Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"     (string, required) The hash of the block\n"
+            "2. \"filtertype\"    (string, optional, default=basic) The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",  (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hex\"   (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 hash(get_str(params[0]));
+    string strFilterType = "basic";
+    if (params.count() > 1)
+        strFilterType = get_str(params[1]);
+
+    BlockFilterType filterType;
+    if (!BlockFilterTypeByName(strFilterType, filterType))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+
+    if (!pblockfilterindex || pblockfilterindex->GetFilterType() != filterType)
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + strFilterType);
+
+    CBlockIndex* pblockindex = NULL;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+    }
+
+    BlockFilter filter;
+    uint256 hashHeader;
+    if (!pblockfilterindex->LookupFilter(pblockindex, filter, hashHeader)) {
+        if (!pblockfilterindex->IsSynced())
+            throw JSONRPCError(RPC_MISC_ERROR, "Filter not found. Block filters are still in the process of being indexed.");
+        throw JSONRPCError(RPC_MISC_ERROR, "Filter not found. The block is not on the active chain.");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", hashHeader.GetHex());
+    return ret;
+}
+
+UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "gettxoutsetinfo\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note the first call counts them, which may take some time; they are kept up to date from then on.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"hash_serialized\": \"hash\",   (string) The MuHash3072 set hash of the serialized outputs\n"
+            "  \"total_amount\": x.xxx,         (numeric) The total amount\n"
+            "  \"total_interest\": x.xxx        (numeric) The interest accrued on the total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
-    Object ret;
+    UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (pcoinsTip->GetStats(stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    if (GetUTXOStats(stats)) {
+        ret.pushKV("height", (int64_t)stats.nHeight);
+        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+        ret.pushKV("transactions", (int64_t)stats.nTransactions);
+        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+        ret.pushKV("hash_serialized", stats.GetHashSerialized().GetHex());
+        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+        ret.pushKV("total_interest", ValueFromAmount(stats.GetAccruedInterest()));
     }
     return ret;
 }
 
-Value gettxout(const Array& params, bool fHelp)
+UniValue gettxout(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() < 2 || params.size() > 3)
+    if (fHelp || params.count() < 2 || params.count() > 3)
         throw runtime_error(
             "gettxout \"txid\" n ( includemempool )\n"
             "\nReturns details about an unspent transaction output.\n"
@@ -396,49 +581,102 @@ Value gettxout(const Array& params, bool fHelp)
             + HelpExampleRpc("gettxout", "\"txid\", 1")
         );
 
-    Object ret;
+    UniValue ret(UniValue::VOBJ);
 
-    std::string strHash = params[0].get_str();
+    std::string strHash = get_str(params[0]);
     uint256 hash(strHash);
-    int n = params[1].get_int();
+    int n = get_int(params[1]);
     bool fMempool = true;
-    if (params.size() > 2)
-        fMempool = params[2].get_bool();
+    if (params.count() > 2)
+        fMempool = get_bool(params[2]);
 
     CCoins coins;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
         if (!view.GetCoins(hash, coins))
-            return Value::null;
+            return NullUniValue;
         mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
     } else {
         if (!pcoinsTip->GetCoins(hash, coins))
-            return Value::null;
+            return NullUniValue;
     }
     if (n<0 || (unsigned int)n>=coins.vout.size() || coins.vout[n].IsNull())
-        return Value::null;
+        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex *pindex = it->second;
-    ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
+    ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
     if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
-        ret.push_back(Pair("confirmations", 0));
+        ret.pushKV("confirmations", 0);
     else
-        ret.push_back(Pair("confirmations", pindex->nHeight - coins.nHeight + 1));
-    ret.push_back(Pair("value", ValueFromAmount(coins.vout[n].nValue)));
-    Object o;
+        ret.pushKV("confirmations", pindex->nHeight - coins.nHeight + 1);
+    ret.pushKV("value", ValueFromAmount(coins.vout[n].nValue));
+    UniValue o(UniValue::VOBJ);
     ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
-    ret.push_back(Pair("scriptPubKey", o));
-    ret.push_back(Pair("version", coins.nVersion));
-    ret.push_back(Pair("coinbase", coins.fCoinBase));
+    ret.pushKV("scriptPubKey", o);
+    ret.pushKV("version", coins.nVersion);
+    ret.pushKV("coinbase", ValueFromBool(coins.fCoinBase));
 
     return ret;
 }
 
-Value verifychain(const Array& params, bool fHelp)
+UniValue getspentinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 1 || !params[0].isObject())
+        throw runtime_error(
+            "getspentinfo {\"txid\": \"hash\", \"index\": n}\n"
+            "\nReturns the input of the best block chain that spent an output (requires -spentindex).\n"
+            "\nArguments:\n"
+            "1. {\n"
+            "     \"txid\": \"hash\",  (string, required) The id of the transaction of the output\n"
+            "     \"index\": n       (numeric, required) The output index\n"
+            "   }\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"hash\",     (string) The id of the spending transaction\n"
+            "  \"index\": n,          (numeric) The spending input\n"
+            "  \"height\": n,         (numeric) The height of the block it is in\n"
+            "  \"value\": x.xxx,      (numeric) The amount paid to the output\n"
+            "  \"interest\": x.xxx,   (numeric) The interest it had accrued when spent\n"
+            "  \"address\": \"address\" (string, optional) The address the output paid to\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'")
+            + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
+        );
+
+    if (!fSpentIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled (use -spentindex)");
+
+    const UniValue& txid = find_value(get_obj(params[0]), "txid");
+    const UniValue& index = find_value(get_obj(params[0]), "index");
+    if (!txid.isStr() || !index.isNum())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected a txid and an index");
+    int n = get_int(index);
+    if (n < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Index out of range");
+
+    CSpentIndexValue value;
+    if (!pblocktree->ReadSpentIndex(CSpentIndexKey(uint256(get_str(txid)), n), value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("txid", value.txid.GetHex());
+    result.pushKV("index", (int)value.inputIndex);
+    result.pushKV("height", value.blockHeight);
+    result.pushKV("value", ValueFromAmount(value.satoshis));
+    result.pushKV("interest", ValueFromAmount(value.interest));
+    if (value.addressType == ADDRESSINDEX_PUBKEYHASH)
+        result.pushKV("address", CBitcoinAddress(CKeyID(value.addressHash)).ToString());
+    else if (value.addressType == ADDRESSINDEX_SCRIPTHASH)
+        result.pushKV("address", CBitcoinAddress(CScriptID(value.addressHash)).ToString());
+    return result;
+}
+
+UniValue verifychain(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 2)
+    if (fHelp || params.count() > 2)
         throw runtime_error(
             "verifychain ( checklevel numblocks )\n"
             "\nVerifies blockchain database.\n"
@@ -454,17 +692,17 @@ Value verifychain(const Array& params, bool fHelp)
 
     int nCheckLevel = GetArg("-checklevel", 3);
     int nCheckDepth = GetArg("-checkblocks", 288);
-    if (params.size() > 0)
-        nCheckLevel = params[0].get_int();
-    if (params.size() > 1)
-        nCheckDepth = params[1].get_int();
+    if (params.count() > 0)
+        nCheckLevel = get_int(params[0]);
+    if (params.count() > 1)
+        nCheckDepth = get_int(params[1]);
 
-    return CVerifyDB().VerifyDB(pcoinsTip, nCheckLevel, nCheckDepth);
+    return ValueFromBool(CVerifyDB().VerifyDB(pcoinsTip, nCheckLevel, nCheckDepth));
 }
 
-Value getblockchaininfo(const Array& params, bool fHelp)
+UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getblockchaininfo\n"
             "Returns an object containing various state info regarding block chain processing.\n"
@@ -484,17 +722,17 @@ Value getblockchaininfo(const Array& params, bool fHelp)
             + HelpExampleRpc("getblockchaininfo", "")
         );
 
-    Object obj;
-    obj.push_back(Pair("chain",                 Params().NetworkIDString()));
-    obj.push_back(Pair("blocks",                (int)chainActive.Height()));
-    obj.push_back(Pair("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1));
-    obj.push_back(Pair("bestblockhash",         chainActive.Tip()->GetBlockHash().GetHex()));
-    obj.push_back(Pair("difficulty",            (double)GetDifficulty(NULL, ALGO_SHA256D)));
-    Array difficulties;
-    for(int i=0;i<NUM_ALGOS;i++) difficulties.push_back((double)GetDifficulty(NULL, i));
-    obj.push_back(Pair("difficulties",          difficulties));
-    obj.push_back(Pair("verificationprogress",  Checkpoints::GuessVerificationProgress(chainActive.Tip())));
-    obj.push_back(Pair("chainwork",             chainActive.Tip()->nChainWork.GetHex()));
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("chain",                 Params().NetworkIDString());
+    obj.pushKV("blocks",                (int)chainActive.Height());
+    obj.pushKV("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1);
+    obj.pushKV("bestblockhash",         chainActive.Tip()->GetBlockHash().GetHex());
+    obj.pushKV("difficulty",            ValueFromDouble(GetDifficulty(NULL, ALGO_SHA256D)));
+    UniValue difficulties(UniValue::VARR);
+    for(int i=0;i<NUM_ALGOS;i++) difficulties.push_back(ValueFromDouble(GetDifficulty(NULL, i)));
+    obj.pushKV("difficulties",          difficulties);
+    obj.pushKV("verificationprogress",  ValueFromDouble(Checkpoints::GuessVerificationProgress(chainActive.Tip())));
+    obj.pushKV("chainwork",             chainActive.Tip()->nChainWork.GetHex());
     return obj;
 }
 
@@ -513,9 +751,9 @@ struct CompareBlocksByHeight
     }
 };
 
-Value getchaintips(const Array& params, bool fHelp)
+UniValue getchaintips(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getchaintips\n"
             "Return information about all known tips in the block tree,"
@@ -563,15 +801,15 @@ Value getchaintips(const Array& params, bool fHelp)
     setTips.insert(chainActive.Tip());
 
     /* Construct the output array.  */
-    Array res;
+    UniValue res(UniValue::VARR);
     BOOST_FOREACH(const CBlockIndex* block, setTips)
     {
-        Object obj;
-        obj.push_back(Pair("height", block->nHeight));
-        obj.push_back(Pair("hash", block->phashBlock->GetHex()));
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("height", block->nHeight);
+        obj.pushKV("hash", block->phashBlock->GetHex());
 
         const int branchLen = block->nHeight - chainActive.FindFork(block)->nHeight;
-        obj.push_back(Pair("branchlen", branchLen));
+        obj.pushKV("branchlen", branchLen);
 
         string status;
         if (chainActive.Contains(block)) {
@@ -593,7 +831,7 @@ Value getchaintips(const Array& params, bool fHelp)
             // No clue.
             status = "unknown";
         }
-        obj.push_back(Pair("status", status));
+        obj.pushKV("status", status);
 
         res.push_back(obj);
     }
@@ -601,9 +839,9 @@ Value getchaintips(const Array& params, bool fHelp)
     return res;
 }
 
-Value getmempoolinfo(const Array& params, bool fHelp)
+UniValue getmempoolinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getmempoolinfo\n"
             "\nReturns details on the active state of the TX memory pool.\n"
@@ -611,22 +849,41 @@ Value getmempoolinfo(const Array& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"sigcache\": {                (object) Signature cache usage\n"
+            "    \"bytes\": xxxxx             (numeric) Memory allocated to the cache\n"
+            "    \"capacity\": xxxxx          (numeric) Maximum number of entries\n"
+            "    \"hits\": xxxxx              (numeric) Lookups that found a cached signature\n"
+            "    \"misses\": xxxxx            (numeric) Lookups that had to verify the signature\n"
+            "    \"hitrate\": x.xxx           (numeric) hits / (hits + misses)\n"
+            "    \"evictions\": xxxxx         (numeric) Entries dropped to make room for new ones\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
             + HelpExampleRpc("getmempoolinfo", "")
         );
 
-    Object ret;
-    ret.push_back(Pair("size", (int64_t) mempool.size()));
-    ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("size", (int64_t) mempool.size());
+    ret.pushKV("bytes", (int64_t) mempool.GetTotalTxSize());
+
+    CSignatureCacheStats stats = GetSignatureCacheStats();
+    UniValue sigcache(UniValue::VOBJ);
+    sigcache.pushKV("bytes", (uint64_t) stats.nBytes);
+    sigcache.pushKV("capacity", (uint64_t) stats.nSlots);
+    sigcache.pushKV("hits", stats.nHits);
+    sigcache.pushKV("misses", stats.nMisses);
+    uint64_t nLookups = stats.nHits + stats.nMisses;
+    sigcache.pushKV("hitrate", ValueFromDouble(nLookups ? (double)stats.nHits / nLookups : 0.0));
+    sigcache.pushKV("evictions", stats.nEvictions);
+    ret.pushKV("sigcache", sigcache);
 
     return ret;
 }
 
-Value invalidateblock(const Array& params, bool fHelp)
+UniValue invalidateblock(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 1)
+    if (fHelp || params.count() != 1)
         throw runtime_error(
             "invalidateblock \"hash\"\n"
             "\nPermanently marks a block as invalid, as if it violated a consensus rule.\n"
@@ -638,7 +895,7 @@ Value invalidateblock(const Array& params, bool fHelp)
             + HelpExampleRpc("invalidateblock", "\"blockhash\"")
         );
 
-    std::string strHash = params[0].get_str();
+    std::string strHash = get_str(params[0]);
     uint256 hash(strHash);
     CValidationState state;
 
@@ -659,12 +916,12 @@ Value invalidateblock(const Array& params, bool fHelp)
         throw JSONRPCError(RPC_DATABASE_ERROR, state.GetRejectReason());
     }
 
-    return Value::null;
+    return NullUniValue;
 }
 
-Value reconsiderblock(const Array& params, bool fHelp)
+UniValue reconsiderblock(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 1)
+    if (fHelp || params.count() != 1)
         throw runtime_error(
             "reconsiderblock \"hash\"\n"
             "\nRemoves invalidity status of a block and its descendants, reconsider them for activation.\n"
@@ -677,7 +934,7 @@ Value reconsiderblock(const Array& params, bool fHelp)
             + HelpExampleRpc("reconsiderblock", "\"blockhash\"")
         );
 
-    std::string strHash = params[0].get_str();
+    std::string strHash = get_str(params[0]);
     uint256 hash(strHash);
     CValidationState state;
 
@@ -698,5 +955,5 @@ Value reconsiderblock(const Array& params, bool fHelp)
         throw JSONRPCError(RPC_DATABASE_ERROR, state.GetRejectReason());
     }
 
-    return Value::null;
+    return NullUniValue;
 }
@@ -13,7 +13,6 @@
 #include <stdint.h>
 
 using namespace std;
-using namespace json_spirit;
 
 class CRPCConvertParam
 {
@@ -26,6 +25,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
 {
     { "stop", 0 },
     { "setmocktime", 0 },
+    { "getaddressbalance", 0 },
+    { "getaddressutxos", 0 },
+    { "getaddresstxids", 0 },
+    { "getaddressdeltas", 0 },
     { "getaddednodeinfo", 0 },
     { "setgenerate", 0 },
     { "setgenerate", 1 },
@@ -44,6 +47,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getbalance", 1 },
     { "getbalance", 2 },
     { "getblockhash", 0 },
+    { "getblockhashes", 0 },
+    { "getblockhashes", 1 },
+    { "getspentinfo", 0 },
     { "move", 2 },
     { "move", 3 },
     { "sendfrom", 2 },
@@ -69,6 +75,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblock", 1 },
     { "gettransaction", 1 },
     { "getrawtransaction", 1 },
+    { "getrawtransactions", 0 },
+    { "getrawtransactions", 1 },
     { "createrawtransaction", 0 },
     { "createrawtransaction", 1 },
     { "signrawtransaction", 1 },
@@ -118,10 +126,19 @@ CRPCConvertTable::CRPCConvertTable()
 
 static CRPCConvertTable rpcCvtTable;
 
+UniValue ParseNonRFCJSONValue(const std::string& strVal)
+{
+    UniValue jVal;
+    if (!jVal.read(std::string("[")+strVal+std::string("]")) ||
+        !jVal.isArray() || jVal.count()!=1)
+        throw runtime_error(string("Error parsing JSON:")+strVal);
+    return jVal[0];
+}
+
 /** Convert strings to command-specific RPC representation */
-Array RPCConvertValues(const std::string &strMethod, const std::vector<std::string> &strParams)
+UniValue RPCConvertValues(const std::string &strMethod, const std::vector<std::string> &strParams)
 {
-    Array params;
+    UniValue params(UniValue::VARR);
 
     for (unsigned int idx = 0; idx < strParams.size(); idx++) {
         const std::string& strVal = strParams[idx];
@@ -133,10 +150,7 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
 
         // parse string as JSON, insert bool/number/object/etc. value
         else {
-            Value jVal;
-            if (!read_string(strVal, jVal))
-                throw runtime_error(string("Error parsing JSON:")+strVal);
-            params.push_back(jVal);
+            params.push_back(ParseNonRFCJSONValue(strVal));
         }
     }
 
@@ -6,10 +6,13 @@
 #ifndef BITCOIN_RPCCLIENT_H
 #define BITCOIN_RPCCLIENT_H
 
-#include "json/json_spirit_reader_template.h"
-#include "json/json_spirit_utils.h"
-#include "json/json_spirit_writer_template.h"
+#include "univalue_compat.h"
 
-json_spirit::Array RPCConvertValues(const std::string& strMethod, const std::vector<std::string>& strParams);
+#include <string>
+#include <vector>
+
+UniValue RPCConvertValues(const std::string& strMethod, const std::vector<std::string>& strParams);
+/** Parse any JSON value, not only the objects and arrays RFC 4627 allows at the top level */
+UniValue ParseNonRFCJSONValue(const std::string& strVal);
 
 #endif // BITCOIN_RPCCLIENT_H
@@ -3,14 +3,17 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addressindex.h"
 #include "base58.h"
 #include "clientversion.h"
 #include "init.h"
+#include "interest.h"
 #include "main.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpcserver.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
 #include "wallet.h"
@@ -20,12 +23,10 @@
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp>
-#include "json/json_spirit_utils.h"
-#include "json/json_spirit_value.h"
+#include "univalue_compat.h"
 
 using namespace boost;
 using namespace boost::assign;
-using namespace json_spirit;
 using namespace std;
 
 /**
@@ -41,9 +42,9 @@ using namespace std;
  *
  * Or alternatively, create a specific query method for the information.
  **/
-Value getinfo(const Array& params, bool fHelp)
+UniValue getinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getinfo\n"
             "Returns an object containing various state info.\n"
@@ -74,37 +75,37 @@ Value getinfo(const Array& params, bool fHelp)
     proxyType proxy;
     GetProxy(NET_IPV4, proxy);
 
-    Object obj;
-    obj.push_back(Pair("version", CLIENT_VERSION));
-    obj.push_back(Pair("protocolversion", PROTOCOL_VERSION));
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("version", CLIENT_VERSION);
+    obj.pushKV("protocolversion", PROTOCOL_VERSION);
 #ifdef ENABLE_WALLET
     if (pwalletMain) {
-        obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
-        obj.push_back(Pair("balance",       ValueFromAmount(pwalletMain->GetBalance())));
+        obj.pushKV("walletversion", pwalletMain->GetVersion());
+        obj.pushKV("balance",       ValueFromAmount(pwalletMain->GetBalance()));
     }
 #endif
-    obj.push_back(Pair("blocks",        (int)chainActive.Height()));
-    obj.push_back(Pair("timeoffset",    GetTimeOffset()));
-    obj.push_back(Pair("connections",   (int)vNodes.size()));
-    obj.push_back(Pair("proxy",         (proxy.IsValid() ? proxy.ToStringIPPort() : string())));
-    obj.push_back(Pair("difficulty",    (double)GetDifficulty(NULL, miningAlgo)));
-    obj.push_back(Pair("testnet",       Params().TestnetToBeDeprecatedFieldRPC()));
+    obj.pushKV("blocks",        (int)chainActive.Height());
+    obj.pushKV("timeoffset",    GetTimeOffset());
+    obj.pushKV("connections",   (int)vNodes.size());
+    obj.pushKV("proxy",         (proxy.IsValid() ? proxy.ToStringIPPort() : string()));
+    obj.pushKV("difficulty",    ValueFromDouble(GetDifficulty(NULL, miningAlgo)));
+    obj.pushKV("testnet",       ValueFromBool(Params().TestnetToBeDeprecatedFieldRPC()));
 #ifdef ENABLE_WALLET
     if (pwalletMain) {
-        obj.push_back(Pair("keypoololdest", pwalletMain->GetOldestKeyPoolTime()));
-        obj.push_back(Pair("keypoolsize",   (int)pwalletMain->GetKeyPoolSize()));
+        obj.pushKV("keypoololdest", pwalletMain->GetOldestKeyPoolTime());
+        obj.pushKV("keypoolsize",   (int)pwalletMain->GetKeyPoolSize());
     }
     if (pwalletMain && pwalletMain->IsCrypted())
-        obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
-    obj.push_back(Pair("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK())));
+        obj.pushKV("unlocked_until", nWalletUnlockTime);
+    obj.pushKV("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK()));
 #endif
-    obj.push_back(Pair("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK())));
-    obj.push_back(Pair("errors",        GetWarnings("statusbar")));
+    obj.pushKV("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    obj.pushKV("errors",        GetWarnings("statusbar"));
     return obj;
 }
 
 #ifdef ENABLE_WALLET
-class DescribeAddressVisitor : public boost::static_visitor<Object>
+class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
 private:
     isminetype mine;
@@ -112,23 +113,23 @@ private:
 public:
     DescribeAddressVisitor(isminetype mineIn) : mine(mineIn) {}
 
-    Object operator()(const CNoDestination &dest) const { return Object(); }
+    UniValue operator()(const CNoDestination &dest) const { return UniValue(UniValue::VOBJ); }
 
-    Object operator()(const CKeyID &keyID) const {
-        Object obj;
+    UniValue operator()(const CKeyID &keyID) const {
+        UniValue obj(UniValue::VOBJ);
         CPubKey vchPubKey;
-        obj.push_back(Pair("isscript", false));
+        obj.pushKV("isscript", false);
         if (mine == ISMINE_SPENDABLE) {
             pwalletMain->GetPubKey(keyID, vchPubKey);
-            obj.push_back(Pair("pubkey", HexStr(vchPubKey)));
-            obj.push_back(Pair("iscompressed", vchPubKey.IsCompressed()));
+            obj.pushKV("pubkey", HexStr(vchPubKey));
+            obj.pushKV("iscompressed", vchPubKey.IsCompressed());
         }
         return obj;
     }
 
-    Object operator()(const CScriptID &scriptID) const {
-        Object obj;
-        obj.push_back(Pair("isscript", true));
+    UniValue operator()(const CScriptID &scriptID) const {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("isscript", true);
         if (mine != ISMINE_NO) {
             CScript subscript;
             pwalletMain->GetCScript(scriptID, subscript);
@@ -136,23 +137,23 @@ public:
             txnouttype whichType;
             int nRequired;
             ExtractDestinations(subscript, whichType, addresses, nRequired);
-            obj.push_back(Pair("script", GetTxnOutputType(whichType)));
-            obj.push_back(Pair("hex", HexStr(subscript.begin(), subscript.end())));
-            Array a;
+            obj.pushKV("script", GetTxnOutputType(whichType));
+            obj.pushKV("hex", HexStr(subscript.begin(), subscript.end()));
+            UniValue a(UniValue::VARR);
             BOOST_FOREACH(const CTxDestination& addr, addresses)
                 a.push_back(CBitcoinAddress(addr).ToString());
-            obj.push_back(Pair("addresses", a));
+            obj.pushKV("addresses", a);
             if (whichType == TX_MULTISIG)
-                obj.push_back(Pair("sigsrequired", nRequired));
+                obj.pushKV("sigsrequired", nRequired);
         }
         return obj;
     }
 };
 #endif
 
-Value validateaddress(const Array& params, bool fHelp)
+UniValue validateaddress(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 1)
+    if (fHelp || params.count() != 1)
         throw runtime_error(
             "validateaddress \"bitcoinaddress\"\n"
             "\nReturn information about the given bitcoin address.\n"
@@ -173,26 +174,26 @@ Value validateaddress(const Array& params, bool fHelp)
             + HelpExampleRpc("validateaddress", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
         );
 
-    CBitcoinAddress address(params[0].get_str());
+    CBitcoinAddress address(get_str(params[0]));
     bool isValid = address.IsValid();
 
-    Object ret;
-    ret.push_back(Pair("isvalid", isValid));
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("isvalid", ValueFromBool(isValid));
     if (isValid)
     {
         CTxDestination dest = address.Get();
         string currentAddress = address.ToString();
-        ret.push_back(Pair("address", currentAddress));
+        ret.pushKV("address", currentAddress);
 #ifdef ENABLE_WALLET
         isminetype mine = pwalletMain ? IsMine(*pwalletMain, dest) : ISMINE_NO;
-        ret.push_back(Pair("ismine", (mine & ISMINE_SPENDABLE) ? true : false));
+        ret.pushKV("ismine", (mine & ISMINE_SPENDABLE) ? true : false);
         if (mine != ISMINE_NO) {
-            ret.push_back(Pair("iswatchonly", (mine & ISMINE_WATCH_ONLY) ? true: false));
-            Object detail = boost::apply_visitor(DescribeAddressVisitor(mine), dest);
-            ret.insert(ret.end(), detail.begin(), detail.end());
+            ret.pushKV("iswatchonly", (mine & ISMINE_WATCH_ONLY) ? true: false);
+            UniValue detail = boost::apply_visitor(DescribeAddressVisitor(mine), dest);
+            ret.pushKVs(detail);
         }
         if (pwalletMain && pwalletMain->mapAddressBook.count(dest))
-            ret.push_back(Pair("account", pwalletMain->mapAddressBook[dest].name));
+            ret.pushKV("account", pwalletMain->mapAddressBook[dest].name);
 #endif
     }
     return ret;
@@ -201,23 +202,23 @@ Value validateaddress(const Array& params, bool fHelp)
 /**
  * Used by addmultisigaddress / createmultisig:
  */
-CScript _createmultisig_redeemScript(const Array& params)
+CScript _createmultisig_redeemScript(const UniValue& params)
 {
-    int nRequired = params[0].get_int();
-    const Array& keys = params[1].get_array();
+    int nRequired = get_int(params[0]);
+    const UniValue& keys = get_array(params[1]);
 
     // Gather public keys
     if (nRequired < 1)
         throw runtime_error("a multisignature address must require at least one key to redeem");
-    if ((int)keys.size() < nRequired)
+    if ((int)keys.count() < nRequired)
         throw runtime_error(
             strprintf("not enough keys supplied "
-                      "(got %u keys, but need at least %d to redeem)", keys.size(), nRequired));
+                      "(got %u keys, but need at least %d to redeem)", keys.count(), nRequired));
     std::vector<CPubKey> pubkeys;
-    pubkeys.resize(keys.size());
-    for (unsigned int i = 0; i < keys.size(); i++)
+    pubkeys.resize(keys.count());
+    for (unsigned int i = 0; i < keys.count(); i++)
     {
-        const std::string& ks = keys[i].get_str();
+        const std::string& ks = get_str(keys[i]);
 #ifdef ENABLE_WALLET
         // Case 1: Bitcoin address and we have full public key:
         CBitcoinAddress address(ks);
@@ -260,9 +261,9 @@ CScript _createmultisig_redeemScript(const Array& params)
     return result;
 }
 
-Value createmultisig(const Array& params, bool fHelp)
+UniValue createmultisig(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() < 2 || params.size() > 2)
+    if (fHelp || params.count() < 2 || params.count() > 2)
     {
         string msg = "createmultisig nrequired [\"key\",...]\n"
             "\nCreates a multi-signature address with n signature of m keys required.\n"
@@ -296,16 +297,16 @@ Value createmultisig(const Array& params, bool fHelp)
     CScriptID innerID(inner);
     CBitcoinAddress address(innerID);
 
-    Object result;
-    result.push_back(Pair("address", address.ToString()));
-    result.push_back(Pair("redeemScript", HexStr(inner.begin(), inner.end())));
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("address", address.ToString());
+    result.pushKV("redeemScript", HexStr(inner.begin(), inner.end()));
 
     return result;
 }
 
-Value verifymessage(const Array& params, bool fHelp)
+UniValue verifymessage(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 3)
+    if (fHelp || params.count() != 3)
         throw runtime_error(
             "verifymessage \"bitcoinaddress\" \"signature\" \"message\"\n"
             "\nVerify a signed message\n"
@@ -326,9 +327,9 @@ Value verifymessage(const Array& params, bool fHelp)
             + HelpExampleRpc("verifymessage", "\"1D1ZrZNe3JUo7ZycKEYQQiQAWd9y54F4XZ\", \"signature\", \"my message\"")
         );
 
-    string strAddress  = params[0].get_str();
-    string strSign     = params[1].get_str();
-    string strMessage  = params[2].get_str();
+    string strAddress  = get_str(params[0]);
+    string strSign     = get_str(params[1]);
+    string strMessage  = get_str(params[2]);
 
     CBitcoinAddress addr(strAddress);
     if (!addr.IsValid())
@@ -350,14 +351,333 @@ Value verifymessage(const Array& params, bool fHelp)
 
     CPubKey pubkey;
     if (!pubkey.RecoverCompact(ss.GetHash(), vchSig))
-        return false;
+        return ValueFromBool(false);
 
-    return (pubkey.GetID() == keyID);
+    return ValueFromBool(pubkey.GetID() == keyID);
 }
 
-Value setmocktime(const Array& params, bool fHelp)
+/** The addresses asked for: one address, or an object with an "addresses" array */
+static void ParseAddressIndexParams(const UniValue& param, vector<pair<unsigned char, uint160> >& vAddresses)
 {
-    if (fHelp || params.size() != 1)
+    vector<UniValue> vValues;
+    if (param.isStr()) {
+        vValues.push_back(param);
+    } else if (param.isObject()) {
+        const UniValue& addresses = find_value(get_obj(param), "addresses");
+        if (!addresses.isArray())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        vValues = getValues(addresses);
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an addresses array");
+    }
+
+    BOOST_FOREACH(const UniValue& value, vValues) {
+        CBitcoinAddress address(get_str(value));
+        if (!address.IsValid())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + get_str(value));
+        CTxDestination dest = address.Get();
+        if (const CKeyID* keyID = boost::get<CKeyID>(&dest))
+            vAddresses.push_back(make_pair((unsigned char)ADDRESSINDEX_PUBKEYHASH, (uint160)*keyID));
+        else if (const CScriptID* scriptID = boost::get<CScriptID>(&dest))
+            vAddresses.push_back(make_pair((unsigned char)ADDRESSINDEX_SCRIPTHASH, (uint160)*scriptID));
+    }
+}
+
+static string AddressIndexAddress(unsigned char type, const uint160& hashBytes)
+{
+    if (type == ADDRESSINDEX_SCRIPTHASH)
+        return CBitcoinAddress(CScriptID(hashBytes)).ToString();
+    return CBitcoinAddress(CKeyID(hashBytes)).ToString();
+}
+
+static void CheckAddressIndex()
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled (use -addressindex)");
+    int nHeight, nEndHeight;
+    if (IsAddressIndexBackfilling(&nHeight, &nEndHeight))
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Address index is still being built (at height %d of %d)", nHeight, nEndHeight));
+}
+
+/** The optional "start" and "end" heights of the object of addresses */
+static void ParseAddressIndexRange(const UniValue& param, int& nStart, int& nEnd)
+{
+    nStart = nEnd = 0;
+    if (!param.isObject())
+        return;
+    const UniValue& start = find_value(get_obj(param), "start");
+    const UniValue& end = find_value(get_obj(param), "end");
+    if (start.isNull() && end.isNull())
+        return;
+    if (!start.isNum() || !end.isNum())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be given together, as heights");
+    nStart = get_int(start);
+    nEnd = get_int(end);
+    if (nStart <= 0 || nEnd < nStart)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Start must be at least 1, and end at least start");
+}
+
+/** The unspent outputs of the addresses, with the interest each has accrued by the tip, computed all at once */
+static void GetAddressUnspent(const vector<pair<unsigned char, uint160> >& vAddresses, vector<CAddressUnspentEntry>& vUnspent, vector<CAmount>& vInterest)
+{
+    // Blocks update the index as they are connected and disconnected, under
+    // cs_main: holding it, the outputs read are those of the tip read
+    int nTipHeight;
+    {
+        LOCK(cs_main);
+        for (unsigned int i = 0; i < vAddresses.size(); i++) {
+            if (!pblocktree->ReadAddressUnspentIndex(vAddresses[i].first, vAddresses[i].second, vUnspent))
+                throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+        }
+        nTipHeight = chainActive.Height();
+    }
+    vector<pair<int, CAmount> > vPeriodsValue;
+    vPeriodsValue.reserve(vUnspent.size());
+    BOOST_FOREACH(const CAddressUnspentEntry& entry, vUnspent)
+        vPeriodsValue.push_back(make_pair(nTipHeight - entry.second.blockHeight, entry.second.satoshis));
+    ComputeInterest(vPeriodsValue, vInterest);
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 1)
+        throw runtime_error(
+            "getaddressbalance \"address\"|{\"addresses\": [\"address\",...]}\n"
+            "\nReturns the balance of addresses, with the interest their unspent outputs have accrued by the tip (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"           (string) The address, or\n"
+            "   {\n"
+            "     \"addresses\": [    (array of strings) The addresses\n"
+            "       \"address\"       (string) An address\n"
+            "       ,...\n"
+            "     ]\n"
+            "   }\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": x.xxx,    (numeric) The unspent amount, with its interest\n"
+            "  \"principal\": x.xxx,  (numeric) The unspent amount as paid\n"
+            "  \"interest\": x.xxx,   (numeric) The interest it has accrued\n"
+            "  \"received\": x.xxx    (numeric) The total amount ever paid to the addresses\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}'")
+            + HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}")
+        );
+
+    CheckAddressIndex();
+    vector<pair<unsigned char, uint160> > vAddresses;
+    ParseAddressIndexParams(params[0], vAddresses);
+
+    vector<CAddressUnspentEntry> vUnspent;
+    vector<CAmount> vInterest;
+    GetAddressUnspent(vAddresses, vUnspent, vInterest);
+    CAmount nPrincipal = 0, nInterest = 0;
+    for (unsigned int i = 0; i < vUnspent.size(); i++) {
+        nPrincipal += vUnspent[i].second.satoshis;
+        nInterest += vInterest[i];
+    }
+
+    CAmount nReceived = 0;
+    for (unsigned int i = 0; i < vAddresses.size(); i++) {
+        vector<CAddressIndexEntry> vEntries;
+        if (!pblocktree->ReadAddressIndex(vAddresses[i].first, vAddresses[i].second, vEntries))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+        BOOST_FOREACH(const CAddressIndexEntry& entry, vEntries) {
+            if (entry.second > 0)
+                nReceived += entry.second;
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("balance", ValueFromAmount(nPrincipal + nInterest));
+    result.pushKV("principal", ValueFromAmount(nPrincipal));
+    result.pushKV("interest", ValueFromAmount(nInterest));
+    result.pushKV("received", ValueFromAmount(nReceived));
+    return result;
+}
+
+static bool CompareUnspentByHeight(const pair<CAddressUnspentEntry, CAmount>& a, const pair<CAddressUnspentEntry, CAmount>& b)
+{
+    return a.first.second.blockHeight < b.first.second.blockHeight;
+}
+
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 1)
+        throw runtime_error(
+            "getaddressutxos \"address\"|{\"addresses\": [\"address\",...]}\n"
+            "\nReturns the unspent outputs of addresses, oldest first (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"           (string) The address, or\n"
+            "   {\n"
+            "     \"addresses\": [    (array of strings) The addresses\n"
+            "       \"address\"       (string) An address\n"
+            "       ,...\n"
+            "     ]\n"
+            "   }\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\", (string) The address paid to\n"
+            "    \"txid\": \"hash\",       (string) The transaction id\n"
+            "    \"outputIndex\": n,     (numeric) The output index\n"
+            "    \"script\": \"hex\",      (string) The script, hex encoded\n"
+            "    \"amount\": x.xxx,      (numeric) The amount paid\n"
+            "    \"interest\": x.xxx,    (numeric) The interest accrued by the tip\n"
+            "    \"height\": n           (numeric) The height of the block paying it\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}'")
+            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}")
+        );
+
+    CheckAddressIndex();
+    vector<pair<unsigned char, uint160> > vAddresses;
+    ParseAddressIndexParams(params[0], vAddresses);
+
+    vector<CAddressUnspentEntry> vUnspent;
+    vector<CAmount> vInterest;
+    GetAddressUnspent(vAddresses, vUnspent, vInterest);
+    vector<pair<CAddressUnspentEntry, CAmount> > vSorted;
+    vSorted.reserve(vUnspent.size());
+    for (unsigned int i = 0; i < vUnspent.size(); i++)
+        vSorted.push_back(make_pair(vUnspent[i], vInterest[i]));
+    stable_sort(vSorted.begin(), vSorted.end(), CompareUnspentByHeight);
+
+    UniValue result(UniValue::VARR);
+    for (unsigned int i = 0; i < vSorted.size(); i++) {
+        const CAddressUnspentKey& key = vSorted[i].first.first;
+        const CAddressUnspentValue& value = vSorted[i].first.second;
+        UniValue output(UniValue::VOBJ);
+        output.pushKV("address", AddressIndexAddress(key.type, key.hashBytes));
+        output.pushKV("txid", key.txhash.GetHex());
+        output.pushKV("outputIndex", (int)key.index);
+        output.pushKV("script", HexStr(value.script.begin(), value.script.end()));
+        output.pushKV("amount", ValueFromAmount(value.satoshis));
+        output.pushKV("interest", ValueFromAmount(vSorted[i].second));
+        output.pushKV("height", value.blockHeight);
+        result.push_back(output);
+    }
+    return result;
+}
+
+/** The entries of the addresses within the optional range of params[0], by height and then position in the block */
+static void GetAddressDeltas(const UniValue& params, vector<CAddressIndexEntry>& vEntries)
+{
+    CheckAddressIndex();
+    vector<pair<unsigned char, uint160> > vAddresses;
+    ParseAddressIndexParams(params[0], vAddresses);
+    int nStart, nEnd;
+    ParseAddressIndexRange(params[0], nStart, nEnd);
+
+    for (unsigned int i = 0; i < vAddresses.size(); i++) {
+        if (!pblocktree->ReadAddressIndex(vAddresses[i].first, vAddresses[i].second, vEntries, nStart, nEnd))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+    }
+}
+
+static bool CompareDeltasByPosition(const CAddressIndexEntry& a, const CAddressIndexEntry& b)
+{
+    if (a.first.blockHeight != b.first.blockHeight)
+        return a.first.blockHeight < b.first.blockHeight;
+    return a.first.txindex < b.first.txindex;
+}
+
+UniValue getaddresstxids(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 1)
+        throw runtime_error(
+            "getaddresstxids \"address\"|{\"addresses\": [\"address\",...], \"start\": n, \"end\": n}\n"
+            "\nReturns the ids of the transactions paying to or spending from addresses, in chain order (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"           (string) The address, or\n"
+            "   {\n"
+            "     \"addresses\": [    (array of strings) The addresses\n"
+            "       \"address\"       (string) An address\n"
+            "       ,...\n"
+            "     ],\n"
+            "     \"start\": n,       (numeric, optional) The first block height\n"
+            "     \"end\": n          (numeric, optional) The last block height\n"
+            "   }\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"      (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}'")
+            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}")
+        );
+
+    vector<CAddressIndexEntry> vEntries;
+    GetAddressDeltas(params, vEntries);
+    stable_sort(vEntries.begin(), vEntries.end(), CompareDeltasByPosition);
+
+    set<uint256> setSeen;
+    UniValue result(UniValue::VARR);
+    BOOST_FOREACH(const CAddressIndexEntry& entry, vEntries) {
+        if (setSeen.insert(entry.first.txhash).second)
+            result.push_back(entry.first.txhash.GetHex());
+    }
+    return result;
+}
+
+UniValue getaddressdeltas(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 1)
+        throw runtime_error(
+            "getaddressdeltas \"address\"|{\"addresses\": [\"address\",...], \"start\": n, \"end\": n}\n"
+            "\nReturns the amounts paid to and spent from addresses, in chain order (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"           (string) The address, or\n"
+            "   {\n"
+            "     \"addresses\": [    (array of strings) The addresses\n"
+            "       \"address\"       (string) An address\n"
+            "       ,...\n"
+            "     ],\n"
+            "     \"start\": n,       (numeric, optional) The first block height\n"
+            "     \"end\": n          (numeric, optional) The last block height\n"
+            "   }\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"amount\": x.xxx,      (numeric) Paid to the address, or (negative) spent from it\n"
+            "    \"txid\": \"hash\",       (string) The transaction id\n"
+            "    \"index\": n,           (numeric) The output paid to, or the input spending\n"
+            "    \"blockindex\": n,      (numeric) The position of the transaction in its block\n"
+            "    \"height\": n,          (numeric) The block height\n"
+            "    \"address\": \"address\"  (string) The address\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}'")
+            + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"RwSqvmHHgyzoHzDRgpDk4bRS1hvufWdnhg\"]}")
+        );
+
+    vector<CAddressIndexEntry> vEntries;
+    GetAddressDeltas(params, vEntries);
+    stable_sort(vEntries.begin(), vEntries.end(), CompareDeltasByPosition);
+
+    UniValue result(UniValue::VARR);
+    BOOST_FOREACH(const CAddressIndexEntry& entry, vEntries) {
+        UniValue delta(UniValue::VOBJ);
+        delta.pushKV("amount", ValueFromAmount(entry.second));
+        delta.pushKV("txid", entry.first.txhash.GetHex());
+        delta.pushKV("index", (int)entry.first.index);
+        delta.pushKV("blockindex", (int)entry.first.txindex);
+        delta.pushKV("height", entry.first.blockHeight);
+        delta.pushKV("address", AddressIndexAddress(entry.first.type, entry.first.hashBytes));
+        result.push_back(delta);
+    }
+    return result;
+}
+
+UniValue setmocktime(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 1)
         throw runtime_error(
             "setmocktime timestamp\n"
             "\nSet the local time to given timestamp (-regtest only)\n"
@@ -369,8 +689,8 @@ Value setmocktime(const Array& params, bool fHelp)
     if (!Params().MineBlocksOnDemand())
         throw runtime_error("setmocktime for regression testing (-regtest mode) only");
 
-    RPCTypeCheck(params, boost::assign::list_of(int_type));
-    SetMockTime(params[0].get_int64());
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VNUM));
+    SetMockTime(get_int64(params[0]));
 
-    return Value::null;
+    return NullUniValue;
 }
@@ -16,14 +16,13 @@
 
 #include <boost/foreach.hpp>
 
-#include "json/json_spirit_value.h"
+#include "univalue_compat.h"
 
-using namespace json_spirit;
 using namespace std;
 
-Value getconnectioncount(const Array& params, bool fHelp)
+UniValue getconnectioncount(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getconnectioncount\n"
             "\nReturns the number of connections to other nodes.\n"
@@ -38,9 +37,9 @@ Value getconnectioncount(const Array& params, bool fHelp)
     return (int)vNodes.size();
 }
 
-Value ping(const Array& params, bool fHelp)
+UniValue ping(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "ping\n"
             "\nRequests that a ping be sent to all other nodes, to measure ping time.\n"
@@ -57,7 +56,7 @@ Value ping(const Array& params, bool fHelp)
         pNode->fPingQueued = true;
     }
 
-    return Value::null;
+    return NullUniValue;
 }
 
 static void CopyNodeStats(std::vector<CNodeStats>& vstats)
@@ -73,9 +72,20 @@ static void CopyNodeStats(std::vector<CNodeStats>& vstats)
     }
 }
 
-Value getpeerinfo(const Array& params, bool fHelp)
+/** Byte counters by message command, leaving out commands that were never seen. */
+static UniValue MsgCmdBytesToJSON(const mapMsgCmdSize& mapBytes)
 {
-    if (fHelp || params.size() != 0)
+    UniValue obj(UniValue::VOBJ);
+    BOOST_FOREACH(const mapMsgCmdSize::value_type& item, mapBytes) {
+        if (item.second > 0)
+            obj.pushKV(item.first, item.second);
+    }
+    return obj;
+}
+
+UniValue getpeerinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getpeerinfo\n"
             "\nReturns data about each connected network node as a json array of objects.\n"
@@ -104,7 +114,16 @@ Value getpeerinfo(const Array& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
+            "    \"bytessent_per_msg\": {\n"
+            "       \"cmd\": n,              (numeric) The total bytes sent aggregated by message command\n"
+            "       ...\n"
+            "    },\n"
+            "    \"bytesrecv_per_msg\": {\n"
+            "       \"cmd\": n,              (numeric) The total bytes received aggregated by message command\n"
+            "       ...\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -116,44 +135,46 @@ Value getpeerinfo(const Array& params, bool fHelp)
     vector<CNodeStats> vstats;
     CopyNodeStats(vstats);
 
-    Array ret;
+    UniValue ret(UniValue::VARR);
 
     BOOST_FOREACH(const CNodeStats& stats, vstats) {
-        Object obj;
+        UniValue obj(UniValue::VOBJ);
         CNodeStateStats statestats;
         bool fStateStats = GetNodeStateStats(stats.nodeid, statestats);
-        obj.push_back(Pair("id", stats.nodeid));
-        obj.push_back(Pair("addr", stats.addrName));
+        obj.pushKV("id", stats.nodeid);
+        obj.pushKV("addr", stats.addrName);
         if (!(stats.addrLocal.empty()))
-            obj.push_back(Pair("addrlocal", stats.addrLocal));
-        obj.push_back(Pair("services", strprintf("%016x", stats.nServices)));
-        obj.push_back(Pair("lastsend", stats.nLastSend));
-        obj.push_back(Pair("lastrecv", stats.nLastRecv));
-        obj.push_back(Pair("bytessent", stats.nSendBytes));
-        obj.push_back(Pair("bytesrecv", stats.nRecvBytes));
-        obj.push_back(Pair("conntime", stats.nTimeConnected));
-        obj.push_back(Pair("timeoffset", stats.nTimeOffset));
-        obj.push_back(Pair("pingtime", stats.dPingTime));
+            obj.pushKV("addrlocal", stats.addrLocal);
+        obj.pushKV("services", strprintf("%016x", stats.nServices));
+        obj.pushKV("lastsend", stats.nLastSend);
+        obj.pushKV("lastrecv", stats.nLastRecv);
+        obj.pushKV("bytessent", stats.nSendBytes);
+        obj.pushKV("bytesrecv", stats.nRecvBytes);
+        obj.pushKV("conntime", stats.nTimeConnected);
+        obj.pushKV("timeoffset", stats.nTimeOffset);
+        obj.pushKV("pingtime", ValueFromDouble(stats.dPingTime));
         if (stats.dPingWait > 0.0)
-            obj.push_back(Pair("pingwait", stats.dPingWait));
-        obj.push_back(Pair("version", stats.nVersion));
+            obj.pushKV("pingwait", ValueFromDouble(stats.dPingWait));
+        obj.pushKV("version", stats.nVersion);
         // Use the sanitized form of subver here, to avoid tricksy remote peers from
         // corrupting or modifiying the JSON output by putting special characters in
         // their ver message.
-        obj.push_back(Pair("subver", stats.cleanSubVer));
-        obj.push_back(Pair("inbound", stats.fInbound));
-        obj.push_back(Pair("startingheight", stats.nStartingHeight));
+        obj.pushKV("subver", stats.cleanSubVer);
+        obj.pushKV("inbound", ValueFromBool(stats.fInbound));
+        obj.pushKV("startingheight", stats.nStartingHeight);
         if (fStateStats) {
-            obj.push_back(Pair("banscore", statestats.nMisbehavior));
-            obj.push_back(Pair("synced_headers", statestats.nSyncHeight));
-            obj.push_back(Pair("synced_blocks", statestats.nCommonHeight));
-            Array heights;
+            obj.pushKV("banscore", statestats.nMisbehavior);
+            obj.pushKV("synced_headers", statestats.nSyncHeight);
+            obj.pushKV("synced_blocks", statestats.nCommonHeight);
+            UniValue heights(UniValue::VARR);
             BOOST_FOREACH(int height, statestats.vHeightInFlight) {
                 heights.push_back(height);
             }
-            obj.push_back(Pair("inflight", heights));
+            obj.pushKV("inflight", heights);
         }
-        obj.push_back(Pair("whitelisted", stats.fWhitelisted));
+        obj.pushKV("whitelisted", ValueFromBool(stats.fWhitelisted));
+        obj.pushKV("bytessent_per_msg", MsgCmdBytesToJSON(stats.mapSendBytesPerMsgCmd));
+        obj.pushKV("bytesrecv_per_msg", MsgCmdBytesToJSON(stats.mapRecvBytesPerMsgCmd));
 
         ret.push_back(obj);
     }
@@ -161,12 +182,12 @@ Value getpeerinfo(const Array& params, bool fHelp)
     return ret;
 }
 
-Value addnode(const Array& params, bool fHelp)
+UniValue addnode(const UniValue& params, bool fHelp)
 {
     string strCommand;
-    if (params.size() == 2)
-        strCommand = params[1].get_str();
-    if (fHelp || params.size() != 2 ||
+    if (params.count() == 2)
+        strCommand = get_str(params[1]);
+    if (fHelp || params.count() != 2 ||
         (strCommand != "onetry" && strCommand != "add" && strCommand != "remove"))
         throw runtime_error(
             "addnode \"node\" \"add|remove|onetry\"\n"
@@ -180,13 +201,13 @@ Value addnode(const Array& params, bool fHelp)
             + HelpExampleRpc("addnode", "\"192.168.0.6:3764\", \"onetry\"")
         );
 
-    string strNode = params[0].get_str();
+    string strNode = get_str(params[0]);
 
     if (strCommand == "onetry")
     {
         CAddress addr;
         OpenNetworkConnection(addr, NULL, strNode.c_str());
-        return Value::null;
+        return NullUniValue;
     }
 
     LOCK(cs_vAddedNodes);
@@ -208,12 +229,12 @@ Value addnode(const Array& params, bool fHelp)
         vAddedNodes.erase(it);
     }
 
-    return Value::null;
+    return NullUniValue;
 }
 
-Value getaddednodeinfo(const Array& params, bool fHelp)
+UniValue getaddednodeinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() < 1 || params.size() > 2)
+    if (fHelp || params.count() < 1 || params.count() > 2)
         throw runtime_error(
             "getaddednodeinfo dns ( \"node\" )\n"
             "\nReturns information about the given added node, or all added nodes\n"
@@ -244,10 +265,10 @@ Value getaddednodeinfo(const Array& params, bool fHelp)
             + HelpExampleRpc("getaddednodeinfo", "true, \"192.168.0.201\"")
         );
 
-    bool fDns = params[0].get_bool();
+    bool fDns = get_bool(params[0]);
 
     list<string> laddedNodes(0);
-    if (params.size() == 1)
+    if (params.count() == 1)
     {
         LOCK(cs_vAddedNodes);
         BOOST_FOREACH(string& strAddNode, vAddedNodes)
@@ -255,7 +276,7 @@ Value getaddednodeinfo(const Array& params, bool fHelp)
     }
     else
     {
-        string strNode = params[1].get_str();
+        string strNode = get_str(params[1]);
         LOCK(cs_vAddedNodes);
         BOOST_FOREACH(string& strAddNode, vAddedNodes)
             if (strAddNode == strNode)
@@ -267,13 +288,13 @@ Value getaddednodeinfo(const Array& params, bool fHelp)
             throw JSONRPCError(RPC_CLIENT_NODE_NOT_ADDED, "Error: Node has not been added.");
     }
 
-    Array ret;
+    UniValue ret(UniValue::VARR);
     if (!fDns)
     {
         BOOST_FOREACH(string& strAddNode, laddedNodes)
         {
-            Object obj;
-            obj.push_back(Pair("addednode", strAddNode));
+            UniValue obj(UniValue::VOBJ);
+            obj.pushKV("addednode", strAddNode);
             ret.push_back(obj);
         }
         return ret;
@@ -287,50 +308,50 @@ Value getaddednodeinfo(const Array& params, bool fHelp)
             laddedAddreses.push_back(make_pair(strAddNode, vservNode));
         else
         {
-            Object obj;
-            obj.push_back(Pair("addednode", strAddNode));
-            obj.push_back(Pair("connected", false));
-            Array addresses;
-            obj.push_back(Pair("addresses", addresses));
+            UniValue obj(UniValue::VOBJ);
+            obj.pushKV("addednode", strAddNode);
+            obj.pushKV("connected", ValueFromBool(false));
+            UniValue addresses(UniValue::VARR);
+            obj.pushKV("addresses", addresses);
         }
     }
 
     LOCK(cs_vNodes);
     for (list<pair<string, vector<CService> > >::iterator it = laddedAddreses.begin(); it != laddedAddreses.end(); it++)
     {
-        Object obj;
-        obj.push_back(Pair("addednode", it->first));
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("addednode", it->first);
 
-        Array addresses;
+        UniValue addresses(UniValue::VARR);
         bool fConnected = false;
         BOOST_FOREACH(CService& addrNode, it->second)
         {
             bool fFound = false;
-            Object node;
-            node.push_back(Pair("address", addrNode.ToString()));
+            UniValue node(UniValue::VOBJ);
+            node.pushKV("address", addrNode.ToString());
             BOOST_FOREACH(CNode* pnode, vNodes)
                 if (pnode->addr == addrNode)
                 {
                     fFound = true;
                     fConnected = true;
-                    node.push_back(Pair("connected", pnode->fInbound ? "inbound" : "outbound"));
+                    node.pushKV("connected", pnode->fInbound ? "inbound" : "outbound");
                     break;
                 }
             if (!fFound)
-                node.push_back(Pair("connected", "false"));
+                node.pushKV("connected", "false");
             addresses.push_back(node);
         }
-        obj.push_back(Pair("connected", fConnected));
-        obj.push_back(Pair("addresses", addresses));
+        obj.pushKV("connected", ValueFromBool(fConnected));
+        obj.pushKV("addresses", addresses);
         ret.push_back(obj);
     }
 
     return ret;
 }
 
-Value getnettotals(const Array& params, bool fHelp)
+UniValue getnettotals(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 0)
+    if (fHelp || params.count() > 0)
         throw runtime_error(
             "getnettotals\n"
             "\nReturns information about network traffic, including bytes in, bytes out,\n"
@@ -339,43 +360,70 @@ Value getnettotals(const Array& params, bool fHelp)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
-            "  \"timemillis\": t        (numeric) Total cpu time\n"
+            "  \"timemillis\": t,       (numeric) Total cpu time\n"
+            "  \"uploadtarget\": {\n"
+            "    \"timeframe\": n,                (numeric) Length of the measuring timeframe in seconds\n"
+            "    \"target\": n,                   (numeric) Target in bytes, 0 = no limit\n"
+            "    \"target_reached\": true|false,  (boolean) True if target is reached\n"
+            "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
+            "    \"bytes_left_in_cycle\": t,      (numeric) Bytes left in current time cycle\n"
+            "    \"time_left_in_cycle\": t        (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"bytessent_per_msg\": {\n"
+            "    \"cmd\": n,                      (numeric) Total bytes sent aggregated by message command\n"
+            "    ...\n"
+            "  },\n"
+            "  \"bytesrecv_per_msg\": {\n"
+            "    \"cmd\": n,                      (numeric) Total bytes received aggregated by message command\n"
+            "    ...\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getnettotals", "")
             + HelpExampleRpc("getnettotals", "")
        );
 
-    Object obj;
-    obj.push_back(Pair("totalbytesrecv", CNode::GetTotalBytesRecv()));
-    obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
-    obj.push_back(Pair("timemillis", GetTimeMillis()));
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("totalbytesrecv", CNode::GetTotalBytesRecv());
+    obj.pushKV("totalbytessent", CNode::GetTotalBytesSent());
+    obj.pushKV("timemillis", GetTimeMillis());
+
+    UniValue outboundLimit(UniValue::VOBJ);
+    outboundLimit.pushKV("timeframe", CNode::GetMaxOutboundTimeframe());
+    outboundLimit.pushKV("target", CNode::GetMaxOutboundTarget());
+    outboundLimit.pushKV("target_reached", ValueFromBool(CNode::OutboundTargetReached(false)));
+    outboundLimit.pushKV("serve_historical_blocks", ValueFromBool(!CNode::OutboundTargetReached(true)));
+    outboundLimit.pushKV("bytes_left_in_cycle", CNode::GetOutboundTargetBytesLeft());
+    outboundLimit.pushKV("time_left_in_cycle", CNode::GetMaxOutboundTimeLeftInCycle());
+    obj.pushKV("uploadtarget", outboundLimit);
+    obj.pushKV("bytessent_per_msg", MsgCmdBytesToJSON(CNode::GetTotalBytesSentPerMsgCmd()));
+    obj.pushKV("bytesrecv_per_msg", MsgCmdBytesToJSON(CNode::GetTotalBytesRecvPerMsgCmd()));
     return obj;
 }
 
-static Array GetNetworksInfo()
+static UniValue GetNetworksInfo()
 {
-    Array networks;
+    UniValue networks(UniValue::VARR);
     for(int n=0; n<NET_MAX; ++n)
     {
         enum Network network = static_cast<enum Network>(n);
         if(network == NET_UNROUTABLE)
             continue;
         proxyType proxy;
-        Object obj;
+        UniValue obj(UniValue::VOBJ);
         GetProxy(network, proxy);
-        obj.push_back(Pair("name", GetNetworkName(network)));
-        obj.push_back(Pair("limited", IsLimited(network)));
-        obj.push_back(Pair("reachable", IsReachable(network)));
-        obj.push_back(Pair("proxy", proxy.IsValid() ? proxy.ToStringIPPort() : string()));
+        obj.pushKV("name", GetNetworkName(network));
+        obj.pushKV("limited", ValueFromBool(IsLimited(network)));
+        obj.pushKV("reachable", ValueFromBool(IsReachable(network)));
+        obj.pushKV("proxy", proxy.IsValid() ? proxy.ToStringIPPort() : string());
         networks.push_back(obj);
     }
     return networks;
 }
 
-Value getnetworkinfo(const Array& params, bool fHelp)
+UniValue getnetworkinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.count() != 0)
         throw runtime_error(
             "getnetworkinfo\n"
             "Returns an object containing various state info regarding P2P networking.\n"
@@ -411,28 +459,28 @@ Value getnetworkinfo(const Array& params, bool fHelp)
             + HelpExampleRpc("getnetworkinfo", "")
         );
 
-    Object obj;
-    obj.push_back(Pair("version",       CLIENT_VERSION));
-    obj.push_back(Pair("subversion",
-        FormatSubVersion(CLIENT_NAME, CLIENT_VERSION, std::vector<string>())));
-    obj.push_back(Pair("protocolversion",PROTOCOL_VERSION));
-    obj.push_back(Pair("localservices",       strprintf("%016x", nLocalServices)));
-    obj.push_back(Pair("timeoffset",    GetTimeOffset()));
-    obj.push_back(Pair("connections",   (int)vNodes.size()));
-    obj.push_back(Pair("networks",      GetNetworksInfo()));
-    obj.push_back(Pair("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK())));
-    Array localAddresses;
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("version",       CLIENT_VERSION);
+    obj.pushKV("subversion",
+        FormatSubVersion(CLIENT_NAME, CLIENT_VERSION, std::vector<string>()));
+    obj.pushKV("protocolversion",PROTOCOL_VERSION);
+    obj.pushKV("localservices",       strprintf("%016x", nLocalServices));
+    obj.pushKV("timeoffset",    GetTimeOffset());
+    obj.pushKV("connections",   (int)vNodes.size());
+    obj.pushKV("networks",      GetNetworksInfo());
+    obj.pushKV("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    UniValue localAddresses(UniValue::VARR);
     {
         LOCK(cs_mapLocalHost);
         BOOST_FOREACH(const PAIRTYPE(CNetAddr, LocalServiceInfo) &item, mapLocalHost)
         {
-            Object rec;
-            rec.push_back(Pair("address", item.first.ToString()));
-            rec.push_back(Pair("port", item.second.nPort));
-            rec.push_back(Pair("score", item.second.nScore));
+            UniValue rec(UniValue::VOBJ);
+            rec.pushKV("address", item.first.ToString());
+            rec.pushKV("port", item.second.nPort);
+            rec.pushKV("score", item.second.nScore);
             localAddresses.push_back(rec);
         }
     }
-    obj.push_back(Pair("localaddresses", localAddresses));
+    obj.pushKV("localaddresses", localAddresses);
     return obj;
 }
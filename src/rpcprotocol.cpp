@@ -23,12 +23,10 @@
 #include <boost/iostreams/concepts.hpp>
 #include <boost/iostreams/stream.hpp>
 #include <boost/shared_ptr.hpp>
-#include "json/json_spirit_writer_template.h"
 
 using namespace std;
 using namespace boost;
 using namespace boost::asio;
-using namespace json_spirit;
 
 //! Number of bytes to allocate and read at most at once in post data
 const size_t POST_READ_SIZE = 256 * 1024;
@@ -70,6 +68,7 @@ static const char *httpStatusDescription(int nStatus)
         case HTTP_FORBIDDEN: return "Forbidden";
         case HTTP_NOT_FOUND: return "Not Found";
         case HTTP_INTERNAL_SERVER_ERROR: return "Internal Server Error";
+        case HTTP_SERVICE_UNAVAILABLE: return "Service Unavailable";
         default: return "";
     }
 }
@@ -128,41 +127,6 @@ string HTTPReply(int nStatus, const string& strMsg, bool keepalive,
     }
 }
 
-bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int &proto,
-                         string& http_method, string& http_uri)
-{
-    string str;
-    getline(stream, str);
-
-    // HTTP request line is space-delimited
-    vector<string> vWords;
-    boost::split(vWords, str, boost::is_any_of(" "));
-    if (vWords.size() < 2)
-        return false;
-
-    // HTTP methods permitted: GET, POST
-    http_method = vWords[0];
-    if (http_method != "GET" && http_method != "POST")
-        return false;
-
-    // HTTP URI must be an absolute path, relative to current host
-    http_uri = vWords[1];
-    if (http_uri.size() == 0 || http_uri[0] != '/')
-        return false;
-
-    // parse proto, if present
-    string strProto = "";
-    if (vWords.size() > 2)
-        strProto = vWords[2];
-
-    proto = 0;
-    const char *ver = strstr(strProto.c_str(), "HTTP/1.");
-    if (ver != NULL)
-        proto = atoi(ver+7);
-
-    return true;
-}
-
 int ReadHTTPStatus(std::basic_istream<char>& stream, int &proto)
 {
     string str;
@@ -178,29 +142,48 @@ int ReadHTTPStatus(std::basic_istream<char>& stream, int &proto)
     return atoi(vWords[1].c_str());
 }
 
+static void ParseHTTPHeader(const string& str, map<string, string>& mapHeadersRet)
+{
+    string::size_type nColon = str.find(":");
+    if (nColon != string::npos)
+    {
+        string strHeader = str.substr(0, nColon);
+        boost::trim(strHeader);
+        boost::to_lower(strHeader);
+        string strValue = str.substr(nColon+1);
+        boost::trim(strValue);
+        mapHeadersRet[strHeader] = strValue;
+    }
+}
+
+/** Fill in the "connection" header from the protocol version, if the client did not say */
+static bool HTTPKeepAlive(map<string, string>& mapHeaders, int nProto)
+{
+    string sConHdr = mapHeaders["connection"];
+
+    if ((sConHdr != "close") && (sConHdr != "keep-alive"))
+    {
+        if (nProto >= 1)
+            mapHeaders["connection"] = "keep-alive";
+        else
+            mapHeaders["connection"] = "close";
+    }
+    return mapHeaders["connection"] == "keep-alive";
+}
+
 int ReadHTTPHeaders(std::basic_istream<char>& stream, map<string, string>& mapHeadersRet)
 {
-    int nLen = 0;
     while (true)
     {
         string str;
         std::getline(stream, str);
         if (str.empty() || str == "\r")
             break;
-        string::size_type nColon = str.find(":");
-        if (nColon != string::npos)
-        {
-            string strHeader = str.substr(0, nColon);
-            boost::trim(strHeader);
-            boost::to_lower(strHeader);
-            string strValue = str.substr(nColon+1);
-            boost::trim(strValue);
-            mapHeadersRet[strHeader] = strValue;
-            if (strHeader == "content-length")
-                nLen = atoi(strValue.c_str());
-        }
+        ParseHTTPHeader(str, mapHeadersRet);
     }
-    return nLen;
+    if (mapHeadersRet.count("content-length"))
+        return atoi(mapHeadersRet["content-length"].c_str());
+    return 0;
 }
 
 
@@ -233,17 +216,120 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string,
         strMessageRet = string(vch.begin(), vch.end());
     }
 
-    string sConHdr = mapHeadersRet["connection"];
+    HTTPKeepAlive(mapHeadersRet, nProto);
 
-    if ((sConHdr != "close") && (sConHdr != "keep-alive"))
+    return HTTP_OK;
+}
+
+HTTPRequestParser::HTTPRequestParser(size_t nMaxHeadersSizeIn, size_t nMaxBodySizeIn) :
+    nMaxHeadersSize(nMaxHeadersSizeIn), nMaxBodySize(nMaxBodySizeIn)
+{
+    Reset();
+}
+
+void HTTPRequestParser::Reset()
+{
+    nProto = 0;
+    strMethod.clear();
+    strURI.clear();
+    mapHeaders.clear();
+    strBody.clear();
+    fKeepAlive = false;
+    state = STATE_REQUEST_LINE;
+    nHeadersSize = 0;
+    nBodySize = 0;
+    strLine.clear();
+}
+
+size_t HTTPRequestParser::Feed(const char* pch, size_t nSize)
+{
+    size_t nUsed = 0;
+    while (nUsed < nSize && (state == STATE_REQUEST_LINE || state == STATE_HEADERS || state == STATE_BODY))
     {
-        if (nProto >= 1)
-            mapHeadersRet["connection"] = "keep-alive";
-        else
-            mapHeadersRet["connection"] = "close";
+        if (state == STATE_BODY)
+        {
+            size_t nBytes = std::min(nSize - nUsed, nBodySize - strBody.size());
+            strBody.append(pch + nUsed, nBytes);
+            nUsed += nBytes;
+            if (strBody.size() == nBodySize)
+                state = STATE_COMPLETE;
+            continue;
+        }
+
+        const char* pchEnd = (const char*)memchr(pch + nUsed, '\n', nSize - nUsed);
+        size_t nBytes = pchEnd ? pchEnd - (pch + nUsed) + 1 : nSize - nUsed;
+        nHeadersSize += nBytes;
+        nUsed += nBytes;
+        if (nHeadersSize > nMaxHeadersSize)
+        {
+            state = STATE_FAILED;
+            break;
+        }
+        strLine.append(pch + nUsed - nBytes, nBytes);
+        if (pchEnd)
+        {
+            ParseLine();
+            strLine.clear();
+        }
     }
+    return nUsed;
+}
 
-    return HTTP_OK;
+void HTTPRequestParser::ParseLine()
+{
+    string str = strLine;
+    boost::trim_right_if(str, boost::is_any_of("\r\n"));
+
+    if (state == STATE_REQUEST_LINE)
+    {
+        // Tolerate empty lines ahead of the request
+        if (str.empty())
+            return;
+
+        // HTTP request line is space-delimited
+        vector<string> vWords;
+        boost::split(vWords, str, boost::is_any_of(" "));
+
+        // HTTP methods permitted: GET, POST
+        // HTTP URI must be an absolute path, relative to current host
+        if (vWords.size() < 2 || (vWords[0] != "GET" && vWords[0] != "POST") ||
+            vWords[1].empty() || vWords[1][0] != '/')
+        {
+            state = STATE_FAILED;
+            return;
+        }
+        strMethod = vWords[0];
+        strURI = vWords[1];
+
+        // parse proto, if present
+        if (vWords.size() > 2)
+        {
+            const char *ver = strstr(vWords[2].c_str(), "HTTP/1.");
+            if (ver != NULL)
+                nProto = atoi(ver+7);
+        }
+        state = STATE_HEADERS;
+        return;
+    }
+
+    if (!str.empty())
+    {
+        ParseHTTPHeader(str, mapHeaders);
+        return;
+    }
+
+    // End of the headers
+    fKeepAlive = HTTPKeepAlive(mapHeaders, nProto);
+    int64_t nLen = 0;
+    if (mapHeaders.count("content-length"))
+        nLen = atoi64(mapHeaders["content-length"]);
+    if (nLen < 0 || (uint64_t)nLen > nMaxBodySize)
+    {
+        state = STATE_FAILED;
+        return;
+    }
+    nBodySize = nLen;
+    state = nBodySize > 0 ? STATE_BODY : STATE_COMPLETE;
 }
 
 /**
@@ -253,40 +339,39 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string,
  * 
  * 1.0 spec: http://json-rpc.org/wiki/specification
  * 1.2 spec: http://jsonrpc.org/historical/json-rpc-over-http.html
- * http://www.codeproject.com/KB/recipes/JSON_Spirit.aspx
  */
 
-string JSONRPCRequest(const string& strMethod, const Array& params, const Value& id)
+string JSONRPCRequest(const string& strMethod, const UniValue& params, const UniValue& id)
 {
-    Object request;
-    request.push_back(Pair("method", strMethod));
-    request.push_back(Pair("params", params));
-    request.push_back(Pair("id", id));
-    return write_string(Value(request), false) + "\n";
+    UniValue request(UniValue::VOBJ);
+    request.pushKV("method", strMethod);
+    request.pushKV("params", params);
+    request.pushKV("id", id);
+    return request.write() + "\n";
 }
 
-Object JSONRPCReplyObj(const Value& result, const Value& error, const Value& id)
+UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id)
 {
-    Object reply;
-    if (error.type() != null_type)
-        reply.push_back(Pair("result", Value::null));
+    UniValue reply(UniValue::VOBJ);
+    if (!error.isNull())
+        reply.pushKV("result", NullUniValue);
     else
-        reply.push_back(Pair("result", result));
-    reply.push_back(Pair("error", error));
-    reply.push_back(Pair("id", id));
+        reply.pushKV("result", result);
+    reply.pushKV("error", error);
+    reply.pushKV("id", id);
     return reply;
 }
 
-string JSONRPCReply(const Value& result, const Value& error, const Value& id)
+string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id)
 {
-    Object reply = JSONRPCReplyObj(result, error, id);
-    return write_string(Value(reply), false) + "\n";
+    UniValue reply = JSONRPCReplyObj(result, error, id);
+    return reply.write() + "\n";
 }
 
-Object JSONRPCError(int code, const string& message)
+UniValue JSONRPCError(int code, const string& message)
 {
-    Object error;
-    error.push_back(Pair("code", code));
-    error.push_back(Pair("message", message));
+    UniValue error(UniValue::VOBJ);
+    error.pushKV("code", code);
+    error.pushKV("message", message);
     return error;
 }
@@ -15,9 +15,7 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
-#include "json/json_spirit_reader_template.h"
-#include "json/json_spirit_utils.h"
-#include "json/json_spirit_writer_template.h"
+#include "univalue_compat.h"
 
 //! HTTP status codes
 enum HTTPStatusCode
@@ -147,6 +145,52 @@ private:
     boost::asio::ssl::stream<typename Protocol::socket>& stream;
 };
 
+/**
+ * Incremental parser for HTTP requests. Feed() it the bytes as they come off
+ * a connection, in pieces of any size, until IsComplete() or IsFailed().
+ * Parsing stops at the end of a request: the bytes after it belong to the
+ * next request on the connection, to be fed in after Reset().
+ */
+class HTTPRequestParser
+{
+public:
+    HTTPRequestParser(size_t nMaxHeadersSizeIn, size_t nMaxBodySizeIn);
+
+    /** Parse up to nSize bytes; returns how many were used. */
+    size_t Feed(const char* pch, size_t nSize);
+
+    bool IsComplete() const { return state == STATE_COMPLETE; }
+    bool IsFailed() const { return state == STATE_FAILED; }
+    /** Get ready for the next request */
+    void Reset();
+
+    int nProto;                                    //!< Minor version of HTTP/1.x
+    std::string strMethod;
+    std::string strURI;
+    std::map<std::string, std::string> mapHeaders; //!< Names in lower case
+    std::string strBody;
+    bool fKeepAlive;                               //!< Whether the client wants the connection kept open
+
+private:
+    enum State
+    {
+        STATE_REQUEST_LINE,
+        STATE_HEADERS,
+        STATE_BODY,
+        STATE_COMPLETE,
+        STATE_FAILED,
+    };
+
+    State state;
+    size_t nMaxHeadersSize;
+    size_t nMaxBodySize;
+    size_t nHeadersSize;
+    size_t nBodySize;
+    std::string strLine; //!< The line being read, up to its newline
+
+    void ParseLine();
+};
+
 std::string HTTPPost(const std::string& strMsg, const std::map<std::string,std::string>& mapRequestHeaders);
 std::string HTTPError(int nStatus, bool keepalive,
                       bool headerOnly = false);
@@ -155,15 +199,13 @@ std::string HTTPReplyHeader(int nStatus, bool keepalive, size_t contentLength,
 std::string HTTPReply(int nStatus, const std::string& strMsg, bool keepalive,
                       bool headerOnly = false,
                       const char *contentType = "application/json");
-bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int &proto,
-                         std::string& http_method, std::string& http_uri);
 int ReadHTTPStatus(std::basic_istream<char>& stream, int &proto);
 int ReadHTTPHeaders(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet);
 int ReadHTTPMessage(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet,
                     std::string& strMessageRet, int nProto, size_t max_size);
-std::string JSONRPCRequest(const std::string& strMethod, const json_spirit::Array& params, const json_spirit::Value& id);
-json_spirit::Object JSONRPCReplyObj(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
-std::string JSONRPCReply(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
-json_spirit::Object JSONRPCError(int code, const std::string& message);
+std::string JSONRPCRequest(const std::string& strMethod, const UniValue& params, const UniValue& id);
+UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const UniValue& id);
+std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
+UniValue JSONRPCError(int code, const std::string& message);
 
 #endif // BITCOIN_RPCPROTOCOL_H
@@ -7,6 +7,7 @@
 
 #include "base58.h"
 #include "init.h"
+#include "jsonwriter.h"
 #include "main.h"
 #include "ui_interface.h"
 #include "util.h"
@@ -20,15 +21,12 @@
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
-#include <boost/iostreams/concepts.hpp>
-#include <boost/iostreams/stream.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
-#include "json/json_spirit_writer_template.h"
 
 using namespace boost;
 using namespace boost::asio;
-using namespace json_spirit;
 using namespace std;
 
 static std::string strRPCUserColonPass;
@@ -43,45 +41,48 @@ static asio::io_service* rpc_io_service = NULL;
 static map<string, boost::shared_ptr<deadline_timer> > deadlineTimers;
 static ssl::context* rpc_ssl_context = NULL;
 static boost::thread_group* rpc_worker_group = NULL;
+class WorkQueue;
+static WorkQueue* rpc_work_queue = NULL;
+static WorkQueue* rpc_batch_queue = NULL; //!< Helps with the calls of batch requests
 static boost::asio::io_service::work *rpc_dummy_work = NULL;
 static std::vector<CSubNet> rpc_allow_subnets; //!< List of subnets to allow RPC connections from
 static std::vector< boost::shared_ptr<ip::tcp::acceptor> > rpc_acceptors;
 
-void RPCTypeCheck(const Array& params,
-                  const list<Value_type>& typesExpected,
+void RPCTypeCheck(const UniValue& params,
+                  const list<UniValue::VType>& typesExpected,
                   bool fAllowNull)
 {
     unsigned int i = 0;
-    BOOST_FOREACH(Value_type t, typesExpected)
+    BOOST_FOREACH(UniValue::VType t, typesExpected)
     {
-        if (params.size() <= i)
+        if (params.count() <= i)
             break;
 
-        const Value& v = params[i];
-        if (!((v.type() == t) || (fAllowNull && (v.type() == null_type))))
+        const UniValue& v = params[i];
+        if (!((v.getType() == t) || (fAllowNull && (v.getType() == UniValue::VNULL))))
         {
             string err = strprintf("Expected type %s, got %s",
-                                   Value_type_name[t], Value_type_name[v.type()]);
+                                   uvTypeName(t), uvTypeName(v.getType()));
             throw JSONRPCError(RPC_TYPE_ERROR, err);
         }
         i++;
     }
 }
 
-void RPCTypeCheck(const Object& o,
-                  const map<string, Value_type>& typesExpected,
+void RPCTypeCheckObj(const UniValue& o,
+                  const map<string, UniValue::VType>& typesExpected,
                   bool fAllowNull)
 {
-    BOOST_FOREACH(const PAIRTYPE(string, Value_type)& t, typesExpected)
+    BOOST_FOREACH(const PAIRTYPE(string, UniValue::VType)& t, typesExpected)
     {
-        const Value& v = find_value(o, t.first);
-        if (!fAllowNull && v.type() == null_type)
+        const UniValue& v = find_value(o, t.first);
+        if (!fAllowNull && v.getType() == UniValue::VNULL)
             throw JSONRPCError(RPC_TYPE_ERROR, strprintf("Missing %s", t.first));
 
-        if (!((v.type() == t.second) || (fAllowNull && (v.type() == null_type))))
+        if (!((v.getType() == t.second) || (fAllowNull && (v.getType() == UniValue::VNULL))))
         {
             string err = strprintf("Expected type %s for %s, got %s",
-                                   Value_type_name[t.second], t.first, Value_type_name[v.type()]);
+                                   uvTypeName(t.second), t.first, uvTypeName(v.getType()));
             throw JSONRPCError(RPC_TYPE_ERROR, err);
         }
     }
@@ -92,44 +93,47 @@ static inline int64_t roundint64(double d)
     return (int64_t)(d > 0 ? d + 0.5 : d - 0.5);
 }
 
-CAmount AmountFromValue(const Value& value)
+CAmount AmountFromValue(const UniValue& value)
 {
-    CAmount nAmount = roundint64(value.get_real() * COIN);
+    CAmount nAmount = roundint64(get_real(value) * COIN);
     if (!MoneyRange(nAmount))
         throw JSONRPCError(RPC_TYPE_ERROR, "Invalid amount");
     return nAmount;
 }
 
-Value ValueFromAmount(const CAmount& amount)
+UniValue ValueFromAmount(const CAmount& amount)
 {
-    return (double)amount / (double)COIN;
+    // Written out exactly, with all eight decimals
+    bool fNegative = amount < 0;
+    int64_t nAbs = fNegative ? -amount : amount;
+    return UniValue(UniValue::VNUM, strprintf("%s%d.%08d", fNegative ? "-" : "", nAbs / COIN, nAbs % COIN));
 }
 
-uint256 ParseHashV(const Value& v, string strName)
+uint256 ParseHashV(const UniValue& v, string strName)
 {
     string strHex;
-    if (v.type() == str_type)
-        strHex = v.get_str();
+    if (v.getType() == UniValue::VSTR)
+        strHex = get_str(v);
     if (!IsHex(strHex)) // Note: IsHex("") is false
         throw JSONRPCError(RPC_INVALID_PARAMETER, strName+" must be hexadecimal string (not '"+strHex+"')");
     uint256 result;
     result.SetHex(strHex);
     return result;
 }
-uint256 ParseHashO(const Object& o, string strKey)
+uint256 ParseHashO(const UniValue& o, string strKey)
 {
     return ParseHashV(find_value(o, strKey), strKey);
 }
-vector<unsigned char> ParseHexV(const Value& v, string strName)
+vector<unsigned char> ParseHexV(const UniValue& v, string strName)
 {
     string strHex;
-    if (v.type() == str_type)
-        strHex = v.get_str();
+    if (v.getType() == UniValue::VSTR)
+        strHex = get_str(v);
     if (!IsHex(strHex))
         throw JSONRPCError(RPC_INVALID_PARAMETER, strName+" must be hexadecimal string (not '"+strHex+"')");
     return ParseHex(strHex);
 }
-vector<unsigned char> ParseHexO(const Object& o, string strKey)
+vector<unsigned char> ParseHexO(const UniValue& o, string strKey)
 {
     return ParseHexV(find_value(o, strKey), strKey);
 }
@@ -166,7 +170,7 @@ string CRPCTable::help(string strCommand) const
 
         try
         {
-            Array params;
+            UniValue params(UniValue::VARR);
             rpcfn_type pfn = pcmd->actor;
             if (setDone.insert(pfn).second)
                 (*pfn)(params, true);
@@ -199,9 +203,9 @@ string CRPCTable::help(string strCommand) const
     return strRet;
 }
 
-Value help(const Array& params, bool fHelp)
+UniValue help(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 1)
+    if (fHelp || params.count() > 1)
         throw runtime_error(
             "help ( \"command\" )\n"
             "\nList all commands, or get help for a specified command.\n"
@@ -212,17 +216,17 @@ Value help(const Array& params, bool fHelp)
         );
 
     string strCommand;
-    if (params.size() > 0)
-        strCommand = params[0].get_str();
+    if (params.count() > 0)
+        strCommand = get_str(params[0]);
 
     return tableRPC.help(strCommand);
 }
 
 
-Value stop(const Array& params, bool fHelp)
+UniValue stop(const UniValue& params, bool fHelp)
 {
     // Accept the deprecated and ignored 'detach' boolean argument
-    if (fHelp || params.size() > 1)
+    if (fHelp || params.count() > 1)
         throw runtime_error(
             "stop\n"
             "\nStop RibbitRewards server.");
@@ -233,117 +237,170 @@ Value stop(const Array& params, bool fHelp)
 
 
 
+UniValue getrpcinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.count() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "\nReturns the RPC calls being executed, and the latencies of the methods called since the server started.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"active_commands\": [      (array) The calls being executed, longest running first\n"
+            "    {\n"
+            "      \"id\": n,              (numeric) The number of the call\n"
+            "      \"method\": \"name\",     (string) The method called\n"
+            "      \"duration_ms\": x.xxx  (numeric) How long it has been running\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"methods\": {              (object) Per method called so far\n"
+            "    \"name\": {\n"
+            "      \"calls\": n,           (numeric) Calls made\n"
+            "      \"errors\": n,          (numeric) Calls that failed\n"
+            "      \"total_ms\": x.xxx,    (numeric) Time spent in all calls\n"
+            "      \"mean_ms\": x.xxx,     (numeric) Mean latency\n"
+            "      \"p50_ms\": x.xxx,      (numeric) Median latency, within 25%\n"
+            "      \"p99_ms\": x.xxx,      (numeric) 99th percentile latency, within 25%\n"
+            "      \"max_ms\": x.xxx,      (numeric) Highest latency\n"
+            "      \"lockwait_ms\": x.xxx, (numeric) Time spent in all calls waiting for locks held by other threads\n"
+            "      \"max_lockwait_ms\": x.xxx (numeric) Most time a call waited for locks\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcinfo", "")
+            + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    return tableRPC.getStats();
+}
+
+void LogRPCStats()
+{
+    tableRPC.logStats();
+}
+
 /**
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode threadSafe reqWallet
-  //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
+{ //  category              name                      actor (function)         okSafeMode threadSafe reqWallet  parallelSafe streamActor
+  //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------  ------------ -----------
     /* Overall control/query calls */
-    { "control",            "getinfo",                &getinfo,                true,      false,      false }, /* uses wallet if enabled */
-    { "control",            "help",                   &help,                   true,      true,       false },
-    { "control",            "stop",                   &stop,                   true,      true,       false },
+    { "control",            "getinfo",                &getinfo,                true,      false,      false,     false,       NULL }, /* uses wallet if enabled */
+    { "control",            "help",                   &help,                   true,      true,       false,     true,        NULL },
+    { "control",            "getrpcinfo",             &getrpcinfo,             true,      true,       false,     true,        NULL },
+    { "control",            "stop",                   &stop,                   true,      true,       false,     false,       NULL },
 
     /* P2P networking */
-    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,      false,      false },
-    { "network",            "addnode",                &addnode,                true,      true,       false },
-    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,      true,       false },
-    { "network",            "getconnectioncount",     &getconnectioncount,     true,      false,      false },
-    { "network",            "getnettotals",           &getnettotals,           true,      true,       false },
-    { "network",            "getpeerinfo",            &getpeerinfo,            true,      false,      false },
-    { "network",            "ping",                   &ping,                   true,      false,      false },
+    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,      false,      false,     false,       NULL },
+    { "network",            "addnode",                &addnode,                true,      true,       false,     false,       NULL },
+    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,      true,       false,     true,        NULL },
+    { "network",            "getconnectioncount",     &getconnectioncount,     true,      false,      false,     false,       NULL },
+    { "network",            "getnettotals",           &getnettotals,           true,      true,       false,     true,        NULL },
+    { "network",            "getpeerinfo",            &getpeerinfo,            true,      false,      false,     false,       NULL },
+    { "network",            "ping",                   &ping,                   true,      false,      false,     false,       NULL },
 
     /* Block chain and UTXO */
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,      false,      false },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,      false,      false },
-    { "blockchain",         "getblockcount",          &getblockcount,          true,      false,      false },
-    { "blockchain",         "getblock",               &getblock,               true,      false,      false },
-    { "blockchain",         "getblockhash",           &getblockhash,           true,      false,      false },
-    { "blockchain",         "getchaintips",           &getchaintips,           true,      false,      false },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true,      false,      false },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,      true,       false },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true,      false,      false },
-    { "blockchain",         "gettxout",               &gettxout,               true,      false,      false },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,      false,      false },
-    { "blockchain",         "verifychain",            &verifychain,            true,      false,      false },
-    { "blockchain",         "invalidateblock",        &invalidateblock,        true,      true,       false },
-    { "blockchain",         "reconsiderblock",        &reconsiderblock,        true,      true,       false },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,      false,      false,     false,       NULL },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,      false,      false,     false,       NULL },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,      false,      false,     false,       NULL },
+    { "blockchain",         "getblock",               &getblock,               true,      true,       false,     true,        &getblock_streamed },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         true,      false,      false,     false,       NULL },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,      true,       false,     true,        NULL },
+    { "blockchain",         "getblockhashes",         &getblockhashes,         true,      true,       false,     true,        NULL },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,      false,      false,     false,       NULL },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,      false,      false,     false,       NULL },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,      true,       false,     true,        NULL },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,      true,       false,     true,        &getrawmempool_streamed },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           true,      true,       false,     true,        NULL },
+    { "blockchain",         "gettxout",               &gettxout,               true,      false,      false,     false,       NULL },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,      true,       false,     true,        NULL },
+    { "blockchain",         "verifychain",            &verifychain,            true,      false,      false,     false,       NULL },
+    { "blockchain",         "invalidateblock",        &invalidateblock,        true,      true,       false,     false,       NULL },
+    { "blockchain",         "reconsiderblock",        &reconsiderblock,        true,      true,       false,     false,       NULL },
+
+    /* Address index */
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      true,      true,       false,     true,        NULL },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       true,      true,       false,     true,        NULL },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        true,      true,       false,     true,        NULL },
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        true,      true,       false,     true,        NULL },
 
     /* Mining */
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true,      false,      false },
-    { "mining",             "getmininginfo",          &getmininginfo,          true,      false,      false },
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,      false,      false },
-    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,      false,      false },
-    { "mining",             "submitblock",            &submitblock,            true,      true,       false },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,      false,      false,     false,       NULL },
+    { "mining",             "getmininginfo",          &getmininginfo,          true,      false,      false,     false,       NULL },
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,      false,      false,     false,       NULL },
+    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,      false,      false,     false,       NULL },
+    { "mining",             "submitblock",            &submitblock,            true,      true,       false,     false,       NULL },
 
 #ifdef ENABLE_WALLET
     /* Coin generation */
-    { "generating",         "getgenerate",            &getgenerate,            true,      false,      false },
-    { "generating",         "gethashespersec",        &gethashespersec,        true,      false,      false },
-    { "generating",         "setgenerate",            &setgenerate,            true,      true,       false },
+    { "generating",         "getgenerate",            &getgenerate,            true,      false,      false,     false,       NULL },
+    { "generating",         "gethashespersec",        &gethashespersec,        true,      false,      false,     false,       NULL },
+    { "generating",         "setgenerate",            &setgenerate,            true,      true,       false,     false,       NULL },
 #endif
 
     /* Raw transactions */
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,      false,      false },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,      false,      false },
-    { "rawtransactions",    "decodescript",           &decodescript,           true,      false,      false },
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,      false,      false },
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false,     false,      false },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false,     false,      false }, /* uses wallet if enabled */
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,      false,      false,     false,       NULL },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,      false,      false,     false,       NULL },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,      false,      false,     false,       NULL },
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,      true,       false,     true,        NULL },
+    { "rawtransactions",    "getrawtransactions",     &getrawtransactions,     true,      true,       false,     true,        NULL },
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false,     false,      false,     false,       NULL },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false,     false,      false,     false,       NULL }, /* uses wallet if enabled */
 
     /* Utility functions */
-    { "util",               "createmultisig",         &createmultisig,         true,      true ,      false },
-    { "util",               "validateaddress",        &validateaddress,        true,      false,      false }, /* uses wallet if enabled */
-    { "util",               "verifymessage",          &verifymessage,          true,      false,      false },
-    { "util",               "estimatefee",            &estimatefee,            true,      true,       false },
-    { "util",               "estimatepriority",       &estimatepriority,       true,      true,       false },
+    { "util",               "createmultisig",         &createmultisig,         true,      true ,      false,     true,        NULL },
+    { "util",               "validateaddress",        &validateaddress,        true,      false,      false,     false,       NULL }, /* uses wallet if enabled */
+    { "util",               "verifymessage",          &verifymessage,          true,      false,      false,     false,       NULL },
+    { "util",               "estimatefee",            &estimatefee,            true,      true,       false,     true,        NULL },
+    { "util",               "estimatepriority",       &estimatepriority,       true,      true,       false,     true,        NULL },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true,      true,       false },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,      true,       false },
-    { "hidden",             "setmocktime",            &setmocktime,            true,      false,      false },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,      true,       false,     false,       NULL },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,      true,       false,     false,       NULL },
+    { "hidden",             "setmocktime",            &setmocktime,            true,      false,      false,     false,       NULL },
 
 #ifdef ENABLE_WALLET
     /* Wallet */
-    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true,      false,      true },
-    { "wallet",             "backupwallet",           &backupwallet,           true,      false,      true },
-    { "wallet",             "dumpprivkey",            &dumpprivkey,            true,      false,      true },
-    { "wallet",             "dumpwallet",             &dumpwallet,             true,      false,      true },
-    { "wallet",             "encryptwallet",          &encryptwallet,          true,      false,      true },
-    { "wallet",             "getaccountaddress",      &getaccountaddress,      true,      false,      true },
-    { "wallet",             "getaccount",             &getaccount,             true,      false,      true },
-    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true,      false,      true },
-    { "wallet",             "getbalance",             &getbalance,             false,     false,      true },
-    { "wallet",             "getnewaddress",          &getnewaddress,          true,      false,      true },
-    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true,      false,      true },
-    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false,     false,      true },
-    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false,     false,      true },
-    { "wallet",             "gettransaction",         &gettransaction,         false,     false,      true },
-    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false,     false,      true },
-    { "wallet",             "getwalletinfo",          &getwalletinfo,          false,     false,      true },
-    { "wallet",             "importprivkey",          &importprivkey,          true,      false,      true },
-    { "wallet",             "importwallet",           &importwallet,           true,      false,      true },
-    { "wallet",             "importaddress",          &importaddress,          true,      false,      true },
-    { "wallet",             "keypoolrefill",          &keypoolrefill,          true,      false,      true },
-    { "wallet",             "listaccounts",           &listaccounts,           false,     false,      true },
-    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false,     false,      true },
-    { "wallet",             "listlockunspent",        &listlockunspent,        false,     false,      true },
-    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false,     false,      true },
-    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false,     false,      true },
-    { "wallet",             "listsinceblock",         &listsinceblock,         false,     false,      true },
-    { "wallet",             "listtransactions",       &listtransactions,       false,     false,      true },
-    { "wallet",             "listunspent",            &listunspent,            false,     false,      true },
-    { "wallet",             "lockunspent",            &lockunspent,            true,      false,      true },
-    { "wallet",             "move",                   &movecmd,                false,     false,      true },
-    { "wallet",             "sendfrom",               &sendfrom,               false,     false,      true },
-    { "wallet",             "sendmany",               &sendmany,               false,     false,      true },
-    { "wallet",             "sendtoaddress",          &sendtoaddress,          false,     false,      true },
-    { "wallet",             "setaccount",             &setaccount,             true,      false,      true },
-    { "wallet",             "settxfee",               &settxfee,               true,      false,      true },
-    { "wallet",             "signmessage",            &signmessage,            true,      false,      true },
-    { "wallet",             "walletlock",             &walletlock,             true,      false,      true },
-    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true,      false,      true },
-    { "wallet",             "walletpassphrase",       &walletpassphrase,       true,      false,      true },
+    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true,      false,      true,      false,       NULL },
+    { "wallet",             "backupwallet",           &backupwallet,           true,      false,      true,      false,       NULL },
+    { "wallet",             "dumpprivkey",            &dumpprivkey,            true,      false,      true,      false,       NULL },
+    { "wallet",             "dumpwallet",             &dumpwallet,             true,      false,      true,      false,       NULL },
+    { "wallet",             "encryptwallet",          &encryptwallet,          true,      false,      true,      false,       NULL },
+    { "wallet",             "getaccountaddress",      &getaccountaddress,      true,      false,      true,      false,       NULL },
+    { "wallet",             "getaccount",             &getaccount,             true,      false,      true,      false,       NULL },
+    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true,      false,      true,      false,       NULL },
+    { "wallet",             "getbalance",             &getbalance,             false,     false,      true,      false,       NULL },
+    { "wallet",             "getnewaddress",          &getnewaddress,          true,      false,      true,      false,       NULL },
+    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true,      false,      true,      false,       NULL },
+    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false,     false,      true,      false,       NULL },
+    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false,     false,      true,      false,       NULL },
+    { "wallet",             "gettransaction",         &gettransaction,         false,     false,      true,      false,       NULL },
+    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false,     false,      true,      false,       NULL },
+    { "wallet",             "getwalletinfo",          &getwalletinfo,          false,     false,      true,      false,       NULL },
+    { "wallet",             "importprivkey",          &importprivkey,          true,      false,      true,      false,       NULL },
+    { "wallet",             "importwallet",           &importwallet,           true,      false,      true,      false,       NULL },
+    { "wallet",             "importaddress",          &importaddress,          true,      false,      true,      false,       NULL },
+    { "wallet",             "keypoolrefill",          &keypoolrefill,          true,      false,      true,      false,       NULL },
+    { "wallet",             "listaccounts",           &listaccounts,           false,     false,      true,      false,       NULL },
+    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false,     false,      true,      false,       NULL },
+    { "wallet",             "listlockunspent",        &listlockunspent,        false,     false,      true,      false,       NULL },
+    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false,     false,      true,      false,       NULL },
+    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false,     false,      true,      false,       NULL },
+    { "wallet",             "listsinceblock",         &listsinceblock,         false,     false,      true,      false,       NULL },
+    { "wallet",             "listtransactions",       &listtransactions,       false,     false,      true,      false,       NULL },
+    { "wallet",             "listunspent",            &listunspent,            false,     false,      true,      false,       NULL },
+    { "wallet",             "lockunspent",            &lockunspent,            true,      false,      true,      false,       NULL },
+    { "wallet",             "move",                   &movecmd,                false,     false,      true,      false,       NULL },
+    { "wallet",             "sendfrom",               &sendfrom,               false,     false,      true,      false,       NULL },
+    { "wallet",             "sendmany",               &sendmany,               false,     false,      true,      false,       NULL },
+    { "wallet",             "sendtoaddress",          &sendtoaddress,          false,     false,      true,      false,       NULL },
+    { "wallet",             "setaccount",             &setaccount,             true,      false,      true,      false,       NULL },
+    { "wallet",             "settxfee",               &settxfee,               true,      false,      true,      false,       NULL },
+    { "wallet",             "signmessage",            &signmessage,            true,      false,      true,      false,       NULL },
+    { "wallet",             "walletlock",             &walletlock,             true,      false,      true,      false,       NULL },
+    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true,      false,      true,      false,       NULL },
+    { "wallet",             "walletpassphrase",       &walletpassphrase,       true,      false,      true,      false,       NULL },
 #endif // ENABLE_WALLET
 };
 
@@ -356,6 +413,7 @@ CRPCTable::CRPCTable()
 
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
+        stats.AddMethod(pcmd->name);
     }
 }
 
@@ -378,15 +436,15 @@ bool HTTPAuthorized(map<string, string>& mapHeaders)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
-void ErrorReply(std::ostream& stream, const Object& objError, const Value& id)
+void ErrorReply(AcceptedConnection* conn, const UniValue& objError, const UniValue& id)
 {
     // Send error reply from json-rpc error object
     int nStatus = HTTP_INTERNAL_SERVER_ERROR;
-    int code = find_value(objError, "code").get_int();
+    int code = get_int(find_value(objError, "code"));
     if (code == RPC_INVALID_REQUEST) nStatus = HTTP_BAD_REQUEST;
     else if (code == RPC_METHOD_NOT_FOUND) nStatus = HTTP_NOT_FOUND;
-    string strReply = JSONRPCReply(Value::null, objError, id);
-    stream << HTTPReply(nStatus, strReply, false) << std::flush;
+    string strReply = JSONRPCReply(NullUniValue, objError, id);
+    conn->write(HTTPReply(nStatus, strReply, false));
 }
 
 CNetAddr BoostAsioToCNetAddr(boost::asio::ip::address address)
@@ -420,23 +478,94 @@ bool ClientAllowed(const boost::asio::ip::address& address)
     return false;
 }
 
-template <typename Protocol>
-class AcceptedConnectionImpl : public AcceptedConnection
+/**
+ * Work waiting for a pool of threads. The queue is bounded: when it is full,
+ * the HTTP server answers new requests with a 503 straight away instead of
+ * letting them pile up behind slow calls.
+ */
+class WorkQueue
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<boost::function<void()> > queue;
+    size_t nMaxDepth;
+    bool fRunning;
+
+public:
+    WorkQueue(size_t nMaxDepthIn) : nMaxDepth(nMaxDepthIn), fRunning(true) {}
+
+    /** Queue a request; false if the queue is full or shutting down. */
+    bool Enqueue(const boost::function<void()>& item)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (!fRunning || queue.size() >= nMaxDepth)
+            return false;
+        queue.push_back(item);
+        cond.notify_one();
+        return true;
+    }
+
+    /** Worker thread loop */
+    void Run()
+    {
+        while (true) {
+            boost::function<void()> item;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (!fRunning)
+                    break;
+                item = queue.front();
+                queue.pop_front();
+            }
+            item();
+        }
+    }
+
+    /** Make the workers exit once they are done with their current request */
+    void Interrupt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fRunning = false;
+        cond.notify_all();
+    }
+};
+
+static bool ServiceRequest(AcceptedConnection* conn, HTTPRequestParser& req);
+
+/**
+ * A client connection. Everything but the handling of its requests runs on
+ * the I/O thread, driven by asio: the request is parsed as its bytes arrive,
+ * so idle and slow clients do not hold a thread, and once complete it goes to
+ * the work queue. A connection has one request in progress at a time; any
+ * pipelined after it wait in the read buffer, so replies go out in order.
+ */
+class HTTPConnection : public AcceptedConnection, public boost::enable_shared_from_this<HTTPConnection>
 {
 public:
-    AcceptedConnectionImpl(
-            asio::io_service& io_service,
-            ssl::context &context,
-            bool fUseSSL) :
-        sslStream(io_service, context),
-        _d(sslStream, fUseSSL),
-        _stream(_d)
+    HTTPConnection(asio::io_service& io_serviceIn, ssl::context& context, bool fUseSSLIn) :
+        sslStream(io_serviceIn, context),
+        io_service(io_serviceIn),
+        timer(io_serviceIn),
+        fUseSSL(fUseSSLIn),
+        parser(MAX_HTTP_HEADERS_SIZE, MAX_SIZE),
+        nReadPos(0),
+        nReadEnd(0),
+        nReadSequence(0)
+    {
+    }
+
+    virtual void write(const std::string& str)
     {
+        vReply.push_back(str);
     }
 
-    virtual std::iostream& stream()
+    virtual void write_swap(std::string& str)
     {
-        return _stream;
+        vReply.push_back(std::string());
+        vReply.back().swap(str);
     }
 
     virtual std::string peer_address_to_string() const
@@ -444,44 +573,171 @@ public:
         return peer.address().to_string();
     }
 
-    virtual void close()
+    void Start()
     {
-        _stream.close();
+        if (fUseSSL)
+            sslStream.async_handshake(ssl::stream_base::server,
+                boost::bind(&HTTPConnection::HandleHandshake, shared_from_this(), asio::placeholders::error));
+        else
+            ReadRequest();
     }
 
-    typename Protocol::endpoint peer;
-    asio::ssl::stream<typename Protocol::socket> sslStream;
+    /** Send a reply to a request that was never read, and close */
+    void Reject(const std::string& str)
+    {
+        vReply.assign(1, str);
+        SendReply(false);
+    }
+
+    void Close()
+    {
+        boost::system::error_code ec;
+        timer.cancel(ec);
+        sslStream.lowest_layer().close(ec);
+    }
+
+    /** Called on a worker thread once the handler is done */
+    void Finish(bool fKeepOpen)
+    {
+        io_service.post(boost::bind(&HTTPConnection::SendReply, shared_from_this(), fKeepOpen));
+    }
+
+    ip::tcp::endpoint peer;
+    asio::ssl::stream<ip::tcp::socket> sslStream;
 
 private:
-    SSLIOStreamDevice<Protocol> _d;
-    iostreams::stream< SSLIOStreamDevice<Protocol> > _stream;
-};
+    asio::io_service& io_service;
+    deadline_timer timer;
+    const bool fUseSSL;
+    HTTPRequestParser parser;
+    char pchRead[4096];
+    size_t nReadPos;   //!< Start of the bytes in pchRead not parsed yet
+    size_t nReadEnd;
+    uint64_t nReadSequence; //!< Tells the idle timeout which read it was set for
+    std::vector<std::string> vReply; //!< The reply, sent as one write of these parts
+
+    void HandleHandshake(const boost::system::error_code& error)
+    {
+        if (error)
+            Close();
+        else
+            ReadRequest();
+    }
 
-void ServiceConnection(AcceptedConnection *conn);
+    void ReadRequest()
+    {
+        // Pipelined requests may already be here
+        nReadPos += parser.Feed(pchRead + nReadPos, nReadEnd - nReadPos);
+        if (parser.IsComplete() || parser.IsFailed()) {
+            HandleRequest();
+            return;
+        }
+        nReadPos = nReadEnd = 0;
+
+        // Idle clients get a while to send the next request, and as long again
+        // for each part of one
+        nReadSequence++;
+        timer.expires_from_now(posix_time::seconds(GetArg("-rpcservertimeout", DEFAULT_RPC_SERVER_TIMEOUT)));
+        timer.async_wait(boost::bind(&HTTPConnection::HandleTimeout, shared_from_this(), nReadSequence, asio::placeholders::error));
+        if (fUseSSL)
+            sslStream.async_read_some(asio::buffer(pchRead),
+                boost::bind(&HTTPConnection::HandleRead, shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
+        else
+            sslStream.next_layer().async_read_some(asio::buffer(pchRead),
+                boost::bind(&HTTPConnection::HandleRead, shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
+    }
+
+    void HandleRead(const boost::system::error_code& error, size_t nBytes)
+    {
+        nReadSequence++;
+        boost::system::error_code ec;
+        timer.cancel(ec);
+        if (error) {
+            Close();
+            return;
+        }
+        nReadEnd = nBytes;
+        ReadRequest();
+    }
+
+    void HandleTimeout(uint64_t nSequence, const boost::system::error_code& error)
+    {
+        if (!error && nSequence == nReadSequence)
+            Close();
+    }
+
+    void HandleRequest()
+    {
+        if (parser.IsFailed()) {
+            Reject(HTTPError(HTTP_BAD_REQUEST, false));
+            return;
+        }
+        if (!rpc_work_queue || !rpc_work_queue->Enqueue(boost::bind(&HTTPConnection::Process, shared_from_this()))) {
+            LogPrint("rpc", "RPC work queue full, refusing request from %s\n", peer_address_to_string());
+            vReply.assign(1, HTTPReply(HTTP_SERVICE_UNAVAILABLE, "Work queue depth exceeded", parser.fKeepAlive, false, "text/plain"));
+            SendReply(parser.fKeepAlive);
+        }
+    }
+
+    /** Runs on a worker thread, while the I/O thread leaves the connection alone */
+    void Process()
+    {
+        bool fKeepOpen = false;
+        try {
+            fKeepOpen = ServiceRequest(this, parser);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+            vReply.assign(1, HTTPError(HTTP_INTERNAL_SERVER_ERROR, false));
+        }
+        Finish(fKeepOpen);
+    }
+
+    void SendReply(bool fKeepOpen)
+    {
+        std::vector<asio::const_buffer> vBuffers;
+        BOOST_FOREACH(const std::string& str, vReply)
+            vBuffers.push_back(asio::buffer(str));
+        if (fUseSSL)
+            asio::async_write(sslStream, vBuffers,
+                boost::bind(&HTTPConnection::HandleWrite, shared_from_this(), fKeepOpen, asio::placeholders::error));
+        else
+            asio::async_write(sslStream.next_layer(), vBuffers,
+                boost::bind(&HTTPConnection::HandleWrite, shared_from_this(), fKeepOpen, asio::placeholders::error));
+    }
+
+    void HandleWrite(bool fKeepOpen, const boost::system::error_code& error)
+    {
+        if (error || !fKeepOpen || ShutdownRequested()) {
+            Close();
+            return;
+        }
+        vReply.clear();
+        parser.Reset();
+        ReadRequest();
+    }
+};
 
 //! Forward declaration required for RPCListen
-template <typename Protocol, typename SocketAcceptorService>
-static void RPCAcceptHandler(boost::shared_ptr< basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
+static void RPCAcceptHandler(boost::shared_ptr<ip::tcp::acceptor> acceptor,
                              ssl::context& context,
                              bool fUseSSL,
-                             boost::shared_ptr< AcceptedConnection > conn,
+                             boost::shared_ptr<HTTPConnection> conn,
                              const boost::system::error_code& error);
 
 /**
  * Sets up I/O resources to accept and handle a new connection.
  */
-template <typename Protocol, typename SocketAcceptorService>
-static void RPCListen(boost::shared_ptr< basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
+static void RPCListen(boost::shared_ptr<ip::tcp::acceptor> acceptor,
                    ssl::context& context,
                    const bool fUseSSL)
 {
     // Accept connection
-    boost::shared_ptr< AcceptedConnectionImpl<Protocol> > conn(new AcceptedConnectionImpl<Protocol>(acceptor->get_io_service(), context, fUseSSL));
+    boost::shared_ptr<HTTPConnection> conn(new HTTPConnection(acceptor->get_io_service(), context, fUseSSL));
 
     acceptor->async_accept(
             conn->sslStream.lowest_layer(),
             conn->peer,
-            boost::bind(&RPCAcceptHandler<Protocol, SocketAcceptorService>,
+            boost::bind(&RPCAcceptHandler,
                 acceptor,
                 boost::ref(context),
                 fUseSSL,
@@ -493,37 +749,34 @@ static void RPCListen(boost::shared_ptr< basic_socket_acceptor<Protocol, SocketA
 /**
  * Accept and handle incoming connection.
  */
-template <typename Protocol, typename SocketAcceptorService>
-static void RPCAcceptHandler(boost::shared_ptr< basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
+static void RPCAcceptHandler(boost::shared_ptr<ip::tcp::acceptor> acceptor,
                              ssl::context& context,
                              const bool fUseSSL,
-                             boost::shared_ptr< AcceptedConnection > conn,
+                             boost::shared_ptr<HTTPConnection> conn,
                              const boost::system::error_code& error)
 {
     // Immediately start accepting new connections, except when we're cancelled or our socket is closed.
     if (error != asio::error::operation_aborted && acceptor->is_open())
         RPCListen(acceptor, context, fUseSSL);
 
-    AcceptedConnectionImpl<ip::tcp>* tcp_conn = dynamic_cast< AcceptedConnectionImpl<ip::tcp>* >(conn.get());
-
     if (error)
     {
         // TODO: Actually handle errors
         LogPrintf("%s: Error: %s\n", __func__, error.message());
     }
     // Restrict callers by IP.  It is important to
-    // do this before starting client thread, to filter out
+    // do this before reading anything, to filter out
     // certain DoS and misbehaving clients.
-    else if (tcp_conn && !ClientAllowed(tcp_conn->peer.address()))
+    else if (!ClientAllowed(conn->peer.address()))
     {
         // Only send a 403 if we're not using SSL to prevent a DoS during the SSL handshake.
         if (!fUseSSL)
-            conn->stream() << HTTPError(HTTP_FORBIDDEN, false) << std::flush;
-        conn->close();
+            conn->Reject(HTTPError(HTTP_FORBIDDEN, false));
+        else
+            conn->Close();
     }
     else {
-        ServiceConnection(conn.get());
-        conn->close();
+        conn->Start();
     }
 }
 
@@ -688,9 +941,18 @@ void StartRPCThreads()
         return;
     }
 
+    // One thread does all the network I/O, and hands complete requests to the workers
+    int nWorkQueueDepth = std::max((int)GetArg("-rpcworkqueue", DEFAULT_RPC_WORKQUEUE), 1);
+    rpc_work_queue = new WorkQueue(nWorkQueueDepth);
     rpc_worker_group = new boost::thread_group();
-    for (int i = 0; i < GetArg("-rpcthreads", 8); i++)
-        rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    int nThreads = std::max((int)GetArg("-rpcthreads", 8), 1);
+    for (int i = 0; i < nThreads; i++)
+        rpc_worker_group->create_thread(boost::bind(&WorkQueue::Run, rpc_work_queue));
+    // As many again to run the calls of batch requests side by side
+    rpc_batch_queue = new WorkQueue(nThreads);
+    for (int i = 0; i < nThreads; i++)
+        rpc_worker_group->create_thread(boost::bind(&WorkQueue::Run, rpc_batch_queue));
     fRPCRunning = true;
 }
 
@@ -734,13 +996,21 @@ void StopRPCThreads()
     deadlineTimers.clear();
 
     rpc_io_service->stop();
+    if (rpc_work_queue != NULL)
+        rpc_work_queue->Interrupt();
+    if (rpc_batch_queue != NULL)
+        rpc_batch_queue->Interrupt();
     cvBlockChange.notify_all();
     if (rpc_worker_group != NULL)
         rpc_worker_group->join_all();
     delete rpc_dummy_work; rpc_dummy_work = NULL;
     delete rpc_worker_group; rpc_worker_group = NULL;
-    delete rpc_ssl_context; rpc_ssl_context = NULL;
+    // Connections still open go with the handlers queued on the io_service,
+    // and those waiting for a worker with the work queue
+    delete rpc_work_queue; rpc_work_queue = NULL;
+    delete rpc_batch_queue; rpc_batch_queue = NULL;
     delete rpc_io_service; rpc_io_service = NULL;
+    delete rpc_ssl_context; rpc_ssl_context = NULL;
 }
 
 bool IsRPCRunning()
@@ -791,76 +1061,200 @@ void RPCRunLater(const std::string& name, boost::function<void(void)> func, int6
 class JSONRequest
 {
 public:
-    Value id;
+    UniValue id;
     string strMethod;
-    Array params;
+    UniValue params;
 
-    JSONRequest() { id = Value::null; }
-    void parse(const Value& valRequest);
+    JSONRequest() : params(UniValue::VARR) { id = NullUniValue; }
+    void parse(const UniValue& valRequest);
 };
 
-void JSONRequest::parse(const Value& valRequest)
+void JSONRequest::parse(const UniValue& valRequest)
 {
     // Parse request
-    if (valRequest.type() != obj_type)
+    if (valRequest.getType() != UniValue::VOBJ)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Invalid Request object");
-    const Object& request = valRequest.get_obj();
+    const UniValue& request = get_obj(valRequest);
 
     // Parse id now so errors from here on will have the id
     id = find_value(request, "id");
 
     // Parse method
-    Value valMethod = find_value(request, "method");
-    if (valMethod.type() == null_type)
+    UniValue valMethod = find_value(request, "method");
+    if (valMethod.getType() == UniValue::VNULL)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Missing method");
-    if (valMethod.type() != str_type)
+    if (valMethod.getType() != UniValue::VSTR)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Method must be a string");
-    strMethod = valMethod.get_str();
+    strMethod = get_str(valMethod);
     if (strMethod != "getblocktemplate")
         LogPrint("rpc", "ThreadRPCServer method=%s\n", strMethod);
 
     // Parse params
-    Value valParams = find_value(request, "params");
-    if (valParams.type() == array_type)
-        params = valParams.get_array();
-    else if (valParams.type() == null_type)
-        params = Array();
+    UniValue valParams = find_value(request, "params");
+    if (valParams.getType() == UniValue::VARR)
+        params = get_array(valParams);
+    else if (valParams.getType() == UniValue::VNULL)
+        params = UniValue(UniValue::VARR);
     else
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array");
 }
 
 
-static Object JSONRPCExecOne(const Value& req)
+static UniValue JSONRPCExecOne(const UniValue& req, int64_t nDeadline)
 {
-    Object rpc_result;
+    UniValue rpc_result(UniValue::VOBJ);
 
     JSONRequest jreq;
     try {
         jreq.parse(req);
+        if (GetTimeMillis() > nDeadline)
+            throw JSONRPCError(RPC_MISC_ERROR, "Batch time limit exceeded");
 
-        Value result = tableRPC.execute(jreq.strMethod, jreq.params);
-        rpc_result = JSONRPCReplyObj(result, Value::null, jreq.id);
+        UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+        rpc_result = JSONRPCReplyObj(result, NullUniValue, jreq.id);
     }
-    catch (Object& objError)
+    catch (UniValue& objError)
     {
-        rpc_result = JSONRPCReplyObj(Value::null, objError, jreq.id);
+        rpc_result = JSONRPCReplyObj(NullUniValue, objError, jreq.id);
     }
     catch (std::exception& e)
     {
-        rpc_result = JSONRPCReplyObj(Value::null,
+        rpc_result = JSONRPCReplyObj(NullUniValue,
                                      JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
     }
 
     return rpc_result;
 }
 
-static string JSONRPCExecBatch(const Array& vReq)
+/**
+ * Write the reply to a call with a streamActor as the result is produced,
+ * rather than building a UniValue of it first.
+ */
+static bool JSONRPCExecStreamed(const JSONRequest& jreq, string& strReply)
+{
+    CJSONStringWriter writer(strReply);
+    writer.BeginObject();
+    writer.Key("result");
+    if (!tableRPC.executeStreamed(jreq.strMethod, jreq.params, writer)) {
+        strReply.clear();
+        return false;
+    }
+    writer.KeyValue("error", NullUniValue);
+    writer.KeyValue("id", jreq.id);
+    writer.EndObject();
+    strReply += "\n";
+    return true;
+}
+
+/** Whether a call may run alongside others: its command takes the locks it needs itself */
+static bool IsParallelSafeCall(const UniValue& req)
+{
+    if (req.getType() != UniValue::VOBJ)
+        return false;
+    const UniValue& valMethod = find_value(get_obj(req), "method");
+    if (valMethod.getType() != UniValue::VSTR)
+        return false;
+    const CRPCCommand *pcmd = tableRPC[get_str(valMethod)];
+    return pcmd && pcmd->parallelSafe;
+}
+
+/**
+ * Calls of a batch request that run side by side. They are claimed one at a
+ * time by the thread serving the request and by whichever batch workers are
+ * free, so a batch gets done even when all the workers are busy.
+ */
+class JSONRPCBatchRun
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable cond;
+    const UniValue& vReq;
+    std::vector<size_t> vIndex; //!< Positions in the batch of the calls to run
+    std::vector<UniValue> vResult;
+    size_t nNext;
+    size_t nRunning;
+    int64_t nDeadline;
+
+public:
+    JSONRPCBatchRun(const UniValue& vReqIn, const std::vector<size_t>& vIndexIn, int64_t nDeadlineIn) :
+        vReq(vReqIn), vIndex(vIndexIn), vResult(vIndexIn.size()), nNext(0), nRunning(0), nDeadline(nDeadlineIn) {}
+
+    /** Run calls until there are none left to claim */
+    void Work()
+    {
+        while (true) {
+            size_t i;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (nNext == vIndex.size())
+                    return;
+                i = nNext++;
+                nRunning++;
+            }
+            vResult[i] = JSONRPCExecOne(vReq[vIndex[i]], nDeadline);
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (--nRunning == 0 && nNext == vIndex.size())
+                    cond.notify_all();
+            }
+        }
+    }
+
+    /** Wait for the calls other threads claimed, and put the results in place */
+    void Finish(std::vector<UniValue>& ret)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (nRunning > 0 || nNext < vIndex.size())
+            cond.wait(lock);
+        for (size_t i = 0; i < vIndex.size(); i++)
+            ret[vIndex[i]] = vResult[i];
+    }
+};
+
+static void JSONRPCBatchWork(boost::shared_ptr<JSONRPCBatchRun> run)
+{
+    run->Work();
+}
+
+/**
+ * Execute a batch request. Each run of consecutive parallel safe calls goes
+ * out to the batch workers; any other call runs on its own, in order, so
+ * that calls with side effects see those of the calls before them.
+ */
+static string JSONRPCExecBatch(const UniValue& vReq)
 {
-    Array ret;
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    unsigned int nMaxBatchSize = std::max((int)GetArg("-rpcmaxbatchsize", DEFAULT_RPC_MAX_BATCH_SIZE), 1);
+    if (vReq.count() > nMaxBatchSize)
+        throw JSONRPCError(RPC_INVALID_REQUEST, strprintf("Batch of %u calls exceeds the limit of %u", vReq.count(), nMaxBatchSize));
+    int64_t nDeadline = GetTimeMillis() + GetArg("-rpcbatchtimeout", DEFAULT_RPC_BATCH_TIMEOUT) * 1000;
+
+    std::vector<UniValue> ret(vReq.count());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.count()) {
+        std::vector<size_t> vIndex;
+        while (reqIdx < vReq.count() && IsParallelSafeCall(vReq[reqIdx]))
+            vIndex.push_back(reqIdx++);
+
+        if (vIndex.size() > 1 && rpc_batch_queue) {
+            boost::shared_ptr<JSONRPCBatchRun> run(new JSONRPCBatchRun(vReq, vIndex, nDeadline));
+            // Workers that only get to it once it is done find nothing to do
+            for (size_t i = 1; i < vIndex.size() && rpc_batch_queue->Enqueue(boost::bind(&JSONRPCBatchWork, run)); i++) {}
+            run->Work();
+            run->Finish(ret);
+        } else {
+            BOOST_FOREACH(size_t i, vIndex)
+                ret[i] = JSONRPCExecOne(vReq[i], nDeadline);
+        }
 
-    return write_string(Value(ret), false) + "\n";
+        if (reqIdx < vReq.count()) {
+            ret[reqIdx] = JSONRPCExecOne(vReq[reqIdx], nDeadline);
+            reqIdx++;
+        }
+    }
+
+    UniValue valReply(UniValue::VARR);
+    valReply.push_backV(ret);
+    return valReply.write() + "\n";
 }
 
 static bool HTTPReq_JSONRPC(AcceptedConnection *conn,
@@ -871,7 +1265,7 @@ static bool HTTPReq_JSONRPC(AcceptedConnection *conn,
     // Check authorization
     if (mapHeaders.count("authorization") == 0)
     {
-        conn->stream() << HTTPError(HTTP_UNAUTHORIZED, false) << std::flush;
+        conn->write(HTTPError(HTTP_UNAUTHORIZED, false));
         return false;
     }
 
@@ -883,7 +1277,7 @@ static bool HTTPReq_JSONRPC(AcceptedConnection *conn,
            shouldn't have their RPC port exposed. */
         MilliSleep(250);
 
-        conn->stream() << HTTPError(HTTP_UNAUTHORIZED, false) << std::flush;
+        conn->write(HTTPError(HTTP_UNAUTHORIZED, false));
         return false;
     }
 
@@ -891,8 +1285,8 @@ static bool HTTPReq_JSONRPC(AcceptedConnection *conn,
     try
     {
         // Parse request
-        Value valRequest;
-        if (!read_string(strRequest, valRequest))
+        UniValue valRequest;
+        if (!valRequest.read(strRequest))
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
         // Return immediately if in warmup
@@ -905,73 +1299,60 @@ static bool HTTPReq_JSONRPC(AcceptedConnection *conn,
         string strReply;
 
         // singleton request
-        if (valRequest.type() == obj_type) {
+        if (valRequest.getType() == UniValue::VOBJ) {
             jreq.parse(valRequest);
 
-            Value result = tableRPC.execute(jreq.strMethod, jreq.params);
-
             // Send reply
-            strReply = JSONRPCReply(result, Value::null, jreq.id);
+            if (!JSONRPCExecStreamed(jreq, strReply)) {
+                UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+                strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            }
 
         // array of requests
-        } else if (valRequest.type() == array_type)
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+        } else if (valRequest.getType() == UniValue::VARR)
+            strReply = JSONRPCExecBatch(get_array(valRequest));
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
-        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, strReply.size()) << strReply << std::flush;
+        conn->write(HTTPReplyHeader(HTTP_OK, fRun, strReply.size()));
+        conn->write_swap(strReply);
     }
-    catch (Object& objError)
+    catch (UniValue& objError)
     {
-        ErrorReply(conn->stream(), objError, jreq.id);
+        ErrorReply(conn, objError, jreq.id);
         return false;
     }
     catch (std::exception& e)
     {
-        ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        ErrorReply(conn, JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
     return true;
 }
 
-void ServiceConnection(AcceptedConnection *conn)
+/** Answer a request, on a worker thread. Returns whether to keep the connection open for the next. */
+static bool ServiceRequest(AcceptedConnection* conn, HTTPRequestParser& req)
 {
-    bool fRun = true;
-    while (fRun && !ShutdownRequested())
-    {
-        int nProto = 0;
-        map<string, string> mapHeaders;
-        string strRequest, strMethod, strURI;
-
-        // Read HTTP request line
-        if (!ReadHTTPRequestLine(conn->stream(), nProto, strMethod, strURI))
-            break;
-
-        // Read HTTP message headers and body
-        ReadHTTPMessage(conn->stream(), mapHeaders, strRequest, nProto, MAX_SIZE);
+    if (ShutdownRequested())
+        return false;
 
-        // HTTP Keep-Alive is false; close connection immediately
-        if (mapHeaders["connection"] == "close")
-            fRun = false;
+    // HTTP Keep-Alive is false; close connection after the reply
+    bool fRun = req.fKeepAlive;
 
-        // Process via JSON-RPC API
-        if (strURI == "/") {
-            if (!HTTPReq_JSONRPC(conn, strRequest, mapHeaders, fRun))
-                break;
+    // Process via JSON-RPC API
+    if (req.strURI == "/") {
+        return HTTPReq_JSONRPC(conn, req.strBody, req.mapHeaders, fRun) && fRun;
 
-        // Process via HTTP REST API
-        } else if (strURI.substr(0, 6) == "/rest/" && GetBoolArg("-rest", false)) {
-            if (!HTTPReq_REST(conn, strURI, mapHeaders, fRun))
-                break;
-
-        } else {
-            conn->stream() << HTTPError(HTTP_NOT_FOUND, false) << std::flush;
-            break;
-        }
+    // Process via HTTP REST API
+    } else if (req.strURI.substr(0, 6) == "/rest/" && GetBoolArg("-rest", false)) {
+        return HTTPReq_REST(conn, req.strURI, req.mapHeaders, fRun) && fRun;
     }
+
+    conn->write(HTTPError(HTTP_NOT_FOUND, false));
+    return false;
 }
 
-json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_spirit::Array &params) const
+const CRPCCommand* CRPCTable::find(const std::string &strMethod) const
 {
     // Find method
     const CRPCCommand *pcmd = tableRPC[strMethod];
@@ -987,11 +1368,36 @@ json_spirit::Value CRPCTable::execute(const std::string &strMethod, const json_s
     if (strWarning != "" && !GetBoolArg("-disablesafemode", false) &&
         !pcmd->okSafeMode)
         throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
+    return pcmd;
+}
+
+bool CRPCTable::executeStreamed(const std::string &strMethod, const UniValue &params, CJSONWriter& result) const
+{
+    const CRPCCommand *pcmd = find(strMethod);
+    if (!pcmd->streamActor)
+        return false;
+
+    CRPCStats::Call call(stats, strMethod);
+    try
+    {
+        return pcmd->streamActor(params, result);
+    }
+    catch (std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+}
+
+UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
+{
+    const CRPCCommand *pcmd = find(strMethod);
 
+    // Timed with the wait for cs_main and cs_wallet below
+    CRPCStats::Call call(stats, strMethod);
     try
     {
         // Execute
-        Value result;
+        UniValue result;
         {
             if (pcmd->threadSafe)
                 result = pcmd->actor(params, false);
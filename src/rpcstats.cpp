@@ -0,0 +1,173 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpcstats.h"
+
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace std;
+
+static void SetMax(boost::atomic<uint64_t>& nMax, uint64_t n)
+{
+    uint64_t nPrev = nMax.load(boost::memory_order_relaxed);
+    while (n > nPrev && !nMax.compare_exchange_weak(nPrev, n, boost::memory_order_relaxed))
+        ;
+}
+
+static double ToMillis(uint64_t nMicros)
+{
+    return nMicros / 1000.0;
+}
+
+CRPCMethodStats::CRPCMethodStats() :
+    nCalls(0), nErrors(0), nMicros(0), nMaxMicros(0), nLockWaitMicros(0), nMaxLockWaitMicros(0)
+{
+    for (int i = 0; i < RPC_LATENCY_BUCKETS; i++)
+        vBuckets[i].store(0, boost::memory_order_relaxed);
+}
+
+int CRPCMethodStats::GetBucket(uint64_t n)
+{
+    if (n < 4)
+        return n;
+    int nBits = 0;
+    while ((n >> nBits) > 1)
+        nBits++;
+    int nBucket = 4 * (nBits - 1) + ((n >> (nBits - 2)) & 3);
+    return min(nBucket, RPC_LATENCY_BUCKETS - 1);
+}
+
+uint64_t CRPCMethodStats::GetBucketEnd(int nBucket)
+{
+    if (nBucket < 4)
+        return nBucket + 1;
+    return (uint64_t)(5 + nBucket % 4) << (nBucket / 4 - 1);
+}
+
+void CRPCMethodStats::Record(int64_t nCallMicros, int64_t nCallLockWaitMicros, bool fError)
+{
+    uint64_t n = max(nCallMicros, (int64_t)0);
+    uint64_t nWait = max(nCallLockWaitMicros, (int64_t)0);
+    nCalls.fetch_add(1, boost::memory_order_relaxed);
+    if (fError)
+        nErrors.fetch_add(1, boost::memory_order_relaxed);
+    nMicros.fetch_add(n, boost::memory_order_relaxed);
+    SetMax(nMaxMicros, n);
+    nLockWaitMicros.fetch_add(nWait, boost::memory_order_relaxed);
+    SetMax(nMaxLockWaitMicros, nWait);
+    vBuckets[GetBucket(n)].fetch_add(1, boost::memory_order_relaxed);
+}
+
+UniValue CRPCMethodStats::ToJSON() const
+{
+    // The counters may move on while they are read; the histogram is the reference
+    uint64_t vCounts[RPC_LATENCY_BUCKETS];
+    uint64_t nTotal = 0;
+    for (int i = 0; i < RPC_LATENCY_BUCKETS; i++) {
+        vCounts[i] = vBuckets[i].load(boost::memory_order_relaxed);
+        nTotal += vCounts[i];
+    }
+    uint64_t nMax = nMaxMicros.load(boost::memory_order_relaxed);
+    uint64_t nP50 = 0, nP99 = 0;
+    uint64_t nSeen = 0;
+    for (int i = 0; i < RPC_LATENCY_BUCKETS && nTotal > 0; i++) {
+        nSeen += vCounts[i];
+        uint64_t nEnd = min(GetBucketEnd(i), nMax);
+        if (nP50 == 0 && nSeen * 2 >= nTotal)
+            nP50 = nEnd;
+        if (nSeen * 100 >= nTotal * 99) {
+            nP99 = nEnd;
+            break;
+        }
+    }
+    uint64_t nSum = nMicros.load(boost::memory_order_relaxed);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("calls", nCalls.load(boost::memory_order_relaxed));
+    obj.pushKV("errors", nErrors.load(boost::memory_order_relaxed));
+    obj.pushKV("total_ms", ValueFromDouble(ToMillis(nSum)));
+    obj.pushKV("mean_ms", ValueFromDouble(nTotal ? ToMillis(nSum / nTotal) : 0.0));
+    obj.pushKV("p50_ms", ValueFromDouble(ToMillis(nP50)));
+    obj.pushKV("p99_ms", ValueFromDouble(ToMillis(nP99)));
+    obj.pushKV("max_ms", ValueFromDouble(ToMillis(nMax)));
+    obj.pushKV("lockwait_ms", ValueFromDouble(ToMillis(nLockWaitMicros.load(boost::memory_order_relaxed))));
+    obj.pushKV("max_lockwait_ms", ValueFromDouble(ToMillis(nMaxLockWaitMicros.load(boost::memory_order_relaxed))));
+    return obj;
+}
+
+CRPCStats::CRPCStats() : nNextId(0)
+{
+}
+
+CRPCStats::~CRPCStats()
+{
+    for (map<string, CRPCMethodStats*>::iterator it = mapMethods.begin(); it != mapMethods.end(); ++it)
+        delete it->second;
+}
+
+void CRPCStats::AddMethod(const string& strMethod)
+{
+    if (!mapMethods.count(strMethod))
+        mapMethods[strMethod] = new CRPCMethodStats();
+}
+
+CRPCStats::Call::Call(CRPCStats& statsIn, const string& strMethod) :
+    stats(statsIn), pmethodStats(NULL), nStart(GetTimeMicros())
+{
+    map<string, CRPCMethodStats*>::const_iterator it = stats.mapMethods.find(strMethod);
+    if (it != stats.mapMethods.end())
+        pmethodStats = it->second;
+    LOCK(stats.cs_active);
+    nId = stats.nNextId++;
+    stats.mapActive[nId] = make_pair(strMethod, nStart);
+}
+
+CRPCStats::Call::~Call()
+{
+    {
+        LOCK(stats.cs_active);
+        stats.mapActive.erase(nId);
+    }
+    if (pmethodStats)
+        pmethodStats->Record(GetTimeMicros() - nStart, lockWait.GetMicros(), std::uncaught_exception());
+}
+
+UniValue CRPCStats::ToJSON() const
+{
+    int64_t nNow = GetTimeMicros();
+    UniValue active(UniValue::VARR);
+    {
+        LOCK(cs_active);
+        for (map<uint64_t, pair<string, int64_t> >::const_iterator it = mapActive.begin(); it != mapActive.end(); ++it) {
+            UniValue call(UniValue::VOBJ);
+            call.pushKV("id", it->first);
+            call.pushKV("method", it->second.first);
+            call.pushKV("duration_ms", ValueFromDouble(ToMillis(max(nNow - it->second.second, (int64_t)0))));
+            active.push_back(call);
+        }
+    }
+
+    UniValue methods(UniValue::VOBJ);
+    for (map<string, CRPCMethodStats*>::const_iterator it = mapMethods.begin(); it != mapMethods.end(); ++it) {
+        if (it->second->GetCalls() > 0)
+            methods.pushKV(it->first, it->second->ToJSON());
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("active_commands", active);
+    obj.pushKV("methods", methods);
+    return obj;
+}
+
+void CRPCStats::Log() const
+{
+    for (map<string, CRPCMethodStats*>::const_iterator it = mapMethods.begin(); it != mapMethods.end(); ++it) {
+        if (it->second->GetCalls() > 0)
+            LogPrintf("RPC stats %s: %s\n", it->first, it->second->ToJSON().write());
+    }
+}
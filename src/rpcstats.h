@@ -0,0 +1,105 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPCSTATS_H
+#define BITCOIN_RPCSTATS_H
+
+#include "sync.h"
+
+#include "univalue_compat.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+#include <boost/atomic.hpp>
+
+/** Buckets of the latency histograms: four per power of two microseconds, up to 2^36 us */
+static const int RPC_LATENCY_BUCKETS = 4 * 35;
+
+/** -rpcstatsinterval default: seconds between writing the statistics to the log, 0 for never */
+static const int DEFAULT_RPC_STATS_INTERVAL = 0;
+
+/**
+ * The calls made to one RPC method so far: how many, how many failed, and
+ * how long they took, of which how long they waited for locks. Recording
+ * a call takes no lock.
+ */
+class CRPCMethodStats
+{
+public:
+    CRPCMethodStats();
+
+    void Record(int64_t nMicros, int64_t nLockWaitMicros, bool fError);
+
+    uint64_t GetCalls() const { return nCalls.load(boost::memory_order_relaxed); }
+
+    /** Latencies in milliseconds; the percentiles are the upper bounds of their buckets, so within 25% */
+    UniValue ToJSON() const;
+
+    /** The bucket of a latency, and the least latency of the next bucket */
+    static int GetBucket(uint64_t nMicros);
+    static uint64_t GetBucketEnd(int nBucket);
+
+private:
+    boost::atomic<uint64_t> nCalls;
+    boost::atomic<uint64_t> nErrors;
+    boost::atomic<uint64_t> nMicros;
+    boost::atomic<uint64_t> nMaxMicros;
+    boost::atomic<uint64_t> nLockWaitMicros;
+    boost::atomic<uint64_t> nMaxLockWaitMicros;
+    boost::atomic<uint64_t> vBuckets[RPC_LATENCY_BUCKETS];
+
+    CRPCMethodStats(const CRPCMethodStats&);
+    void operator=(const CRPCMethodStats&);
+};
+
+/** Statistics of every RPC method, and the calls being executed */
+class CRPCStats
+{
+public:
+    CRPCStats();
+    ~CRPCStats();
+
+    /** Keep statistics of a method; all are added before any call is made */
+    void AddMethod(const std::string& strMethod);
+
+    /** Tracks a call while it is executed, and records it when done */
+    class Call
+    {
+    public:
+        Call(CRPCStats& statsIn, const std::string& strMethod);
+        ~Call();
+
+    private:
+        CRPCStats& stats;
+        CRPCMethodStats* pmethodStats;
+        uint64_t nId;
+        int64_t nStart;
+        CLockWaitCounter lockWait;
+
+        Call(const Call&);
+        void operator=(const Call&);
+    };
+
+    /** The calls being executed, longest running first, and the methods called so far */
+    UniValue ToJSON() const;
+
+    /** Write the statistics of the methods called so far to the log */
+    void Log() const;
+
+private:
+    std::map<std::string, CRPCMethodStats*> mapMethods;
+
+    mutable CCriticalSection cs_active;
+    uint64_t nNextId;
+    //! Per call being executed, by the order they began in: the method and when it began
+    std::map<uint64_t, std::pair<std::string, int64_t> > mapActive;
+
+    CRPCStats(const CRPCStats&);
+    void operator=(const CRPCStats&);
+};
+
+#endif // BITCOIN_RPCSTATS_H
@@ -9,6 +9,11 @@
 #include "script/interpreter.h"
 #include "version.h"
 
+#include <algorithm>
+#include <vector>
+
+#include <pthread.h>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -60,8 +65,111 @@ inline int set_error(bitcoinconsensus_error* ret, bitcoinconsensus_error serror)
     return 0;
 }
 
+/** The inputs of one transaction, checked by one or more threads. */
+struct TxVerifyJob
+{
+    const CTransaction* tx;
+    const PrecomputedTransactionData* txdata;
+    const unsigned char * const *scriptPubKeys;
+    const unsigned int *scriptPubKeyLens;
+    unsigned int flags;
+    unsigned int nStride;
+    std::vector<int> vResults;
+};
+
+struct TxVerifyWorker
+{
+    TxVerifyJob* job;
+    unsigned int nFirst;
+};
+
+/** Check inputs nFirst, nFirst + nStride, ...; each result is written by exactly one thread. */
+void* VerifyInputs(void* arg)
+{
+    const TxVerifyWorker& worker = *(const TxVerifyWorker*)arg;
+    TxVerifyJob& job = *worker.job;
+    for (unsigned int i = worker.nFirst; i < job.vResults.size(); i += job.nStride) {
+        try {
+            CScript scriptPubKey(job.scriptPubKeys[i], job.scriptPubKeys[i] + job.scriptPubKeyLens[i]);
+            job.vResults[i] = VerifyScript(job.tx->vin[i].scriptSig, scriptPubKey, job.flags, SignatureChecker(*job.tx, i, job.txdata), NULL);
+        } catch (...) {
+            job.vResults[i] = 0;
+        }
+    }
+    return NULL;
+}
+
 } // anon namespace
 
+int bitcoinconsensus_verify_transaction(const unsigned char *txTo, unsigned int txToLen,
+                                    const unsigned char * const *scriptPubKeys, const unsigned int *scriptPubKeyLens,
+                                    const int64_t *amounts, unsigned int nInputs,
+                                    unsigned int flags, unsigned int nThreads,
+                                    int *results, bitcoinconsensus_error* err)
+{
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        CTransaction tx;
+        stream >> tx;
+        if (nInputs != tx.vin.size())
+            return set_error(err, bitcoinconsensus_ERR_TX_INDEX);
+        if (tx.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+            return set_error(err, bitcoinconsensus_ERR_TX_SIZE_MISMATCH);
+        if (amounts) {
+            CAmount nValueIn = 0;
+            for (unsigned int i = 0; i < nInputs; i++) {
+                if (!MoneyRange(amounts[i]) || amounts[i] > MAX_MONEY - nValueIn)
+                    return set_error(err, bitcoinconsensus_ERR_AMOUNT);
+                nValueIn += amounts[i];
+            }
+        }
+
+        PrecomputedTransactionData txdata(tx);
+        TxVerifyJob job;
+        job.tx = &tx;
+        job.txdata = &txdata;
+        job.scriptPubKeys = scriptPubKeys;
+        job.scriptPubKeyLens = scriptPubKeyLens;
+        job.flags = flags;
+        job.nStride = std::max(1U, std::min(nThreads, nInputs));
+        job.vResults.assign(nInputs, 0);
+
+        // The calling thread takes the first share; if a thread can't be
+        // started, its share is done by the caller too.
+        std::vector<TxVerifyWorker> vWorkers(job.nStride);
+        std::vector<pthread_t> vThreads;
+        std::vector<unsigned int> vLocal(1, 0);
+        for (unsigned int i = 0; i < job.nStride; i++) {
+            vWorkers[i].job = &job;
+            vWorkers[i].nFirst = i;
+            if (i == 0)
+                continue;
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, VerifyInputs, &vWorkers[i]) == 0)
+                vThreads.push_back(thread);
+            else
+                vLocal.push_back(i);
+        }
+        for (unsigned int i = 0; i < vLocal.size(); i++)
+            VerifyInputs(&vWorkers[vLocal[i]]);
+        for (unsigned int i = 0; i < vThreads.size(); i++)
+            pthread_join(vThreads[i], NULL);
+
+        // Regardless of the verification result, the tx did not error.
+        set_error(err, bitcoinconsensus_ERR_OK);
+
+        int fAllValid = 1;
+        for (unsigned int i = 0; i < nInputs; i++) {
+            if (results)
+                results[i] = job.vResults[i];
+            fAllValid &= job.vResults[i];
+        }
+        return fAllValid;
+    } catch (std::exception &e) {
+        return set_error(err, bitcoinconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
 int bitcoinconsensus_verify_script(const unsigned char *scriptPubKey, unsigned int scriptPubKeyLen,
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, bitcoinconsensus_error* err)
@@ -27,11 +27,13 @@
   #define EXPORT_SYMBOL
 #endif
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 0
+#define BITCOINCONSENSUS_API_VER 1
 
 typedef enum bitcoinconsensus_error_t
 {
@@ -39,6 +41,7 @@ typedef enum bitcoinconsensus_error_t
     bitcoinconsensus_ERR_TX_INDEX,
     bitcoinconsensus_ERR_TX_SIZE_MISMATCH,
     bitcoinconsensus_ERR_TX_DESERIALIZE,
+    bitcoinconsensus_ERR_AMOUNT,
 } bitcoinconsensus_error;
 
 /** Script verification flags */
@@ -56,6 +59,26 @@ EXPORT_SYMBOL int bitcoinconsensus_verify_script(const unsigned char *scriptPubK
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, bitcoinconsensus_error* err);
 
+/// Verifies every input of the serialized transaction pointed to by txTo in
+/// one call. The transaction is deserialized and its signature hash data
+/// precomputed once, instead of once per input.
+/// scriptPubKeys and scriptPubKeyLens give the scriptPubKey spent by each of
+/// the nInputs inputs, which must match the number of inputs of the
+/// transaction. amounts, if not NULL, gives the value of each spent output;
+/// they are checked to be in range, so that callers tracking values (e.g.
+/// interest) can rely on them.
+/// Inputs are spread over up to nThreads threads (0 or 1: the calling
+/// thread only). If results is not NULL, results[i] is set to 1 if input i
+/// is valid and 0 otherwise.
+/// Returns 1 if all inputs are valid. If not NULL, err will contain an
+/// error/success code for the operation; results are only set when it is
+/// bitcoinconsensus_ERR_OK.
+EXPORT_SYMBOL int bitcoinconsensus_verify_transaction(const unsigned char *txTo, unsigned int txToLen,
+                                    const unsigned char * const *scriptPubKeys, const unsigned int *scriptPubKeyLens,
+                                    const int64_t *amounts, unsigned int nInputs,
+                                    unsigned int flags, unsigned int nThreads,
+                                    int *results, bitcoinconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int bitcoinconsensus_version();
 
 #ifdef __cplusplus
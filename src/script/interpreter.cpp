@@ -6,12 +6,14 @@
 #include "interpreter.h"
 
 #include "primitives/transaction.h"
+#include "crypto/common.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "eccryptoverify.h"
 #include "pubkey.h"
 #include "script/script.h"
+#include "streams.h"
 #include "uint256.h"
 
 using namespace std;
@@ -36,34 +38,6 @@ inline bool set_error(ScriptError* ret, const ScriptError serror)
 
 } // anon namespace
 
-bool CastToBool(const valtype& vch)
-{
-    for (unsigned int i = 0; i < vch.size(); i++)
-    {
-        if (vch[i] != 0)
-        {
-            // Can be negative zero
-            if (i == vch.size()-1 && vch[i] == 0x80)
-                return false;
-            return true;
-        }
-    }
-    return false;
-}
-
-/**
- * Script is a stack machine (like Forth) that evaluates a predicate
- * returning a bool indicating valid or not.  There are no loops.
- */
-#define stacktop(i)  (stack.at(stack.size()+(i)))
-#define altstacktop(i)  (altstack.at(altstack.size()+(i)))
-static inline void popstack(vector<valtype>& stack)
-{
-    if (stack.empty())
-        throw runtime_error("popstack() : stack empty");
-    stack.pop_back();
-}
-
 bool static IsCompressedOrUncompressedPubKey(const valtype &vchPubKey) {
     if (vchPubKey.size() < 33) {
         //  Non-canonical public key: too short
@@ -207,64 +181,346 @@ bool static CheckPubKeyEncoding(const valtype &vchSig, unsigned int flags, Scrip
     return true;
 }
 
-bool static CheckMinimalPush(const valtype& data, opcodetype opcode) {
-    if (data.size() == 0) {
+bool static CheckMinimalPush(const unsigned char* data, unsigned int nSize, opcodetype opcode) {
+    if (nSize == 0) {
         // Could have used OP_0.
         return opcode == OP_0;
-    } else if (data.size() == 1 && data[0] >= 1 && data[0] <= 16) {
+    } else if (nSize == 1 && data[0] >= 1 && data[0] <= 16) {
         // Could have used OP_1 .. OP_16.
         return opcode == OP_1 + (data[0] - 1);
-    } else if (data.size() == 1 && data[0] == 0x81) {
+    } else if (nSize == 1 && data[0] == 0x81) {
         // Could have used OP_1NEGATE.
         return opcode == OP_1NEGATE;
-    } else if (data.size() <= 75) {
+    } else if (nSize <= 75) {
         // Could have used a direct push (opcode indicating number of bytes pushed + those bytes).
-        return opcode == data.size();
-    } else if (data.size() <= 255) {
+        return opcode == nSize;
+    } else if (nSize <= 255) {
         // Could have used OP_PUSHDATA.
         return opcode == OP_PUSHDATA1;
-    } else if (data.size() <= 65535) {
+    } else if (nSize <= 65535) {
         // Could have used OP_PUSHDATA2.
         return opcode == OP_PUSHDATA2;
     }
     return true;
 }
 
-bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+namespace {
+
+/** A stack element that points into the script or stack arena holding it. */
+struct StackSpan
+{
+    const unsigned char* begin;
+    unsigned int size;
+
+    valtype ToVector() const { return valtype(begin, begin + size); }
+};
+
+bool CastToBool(const StackSpan& vch)
+{
+    for (unsigned int i = 0; i < vch.size; i++)
+    {
+        if (vch.begin[i] != 0)
+        {
+            // Can be negative zero
+            if (i == vch.size-1 && vch.begin[i] == 0x80)
+                return false;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A vector of plain-old-data elements that keeps its first N elements
+ * inline and only goes to the heap beyond that. Elements are moved with
+ * memcpy and are left uninitialized by resize().
+ */
+template <typename T, unsigned int N>
+class CSmallVector
+{
+private:
+    T* pbegin;
+    unsigned int nSize;
+    unsigned int nCapacity;
+    T inlineData[N];
+
+    // Not copyable; use assign()
+    CSmallVector(const CSmallVector&);
+    CSmallVector& operator=(const CSmallVector&);
+
+public:
+    CSmallVector() : pbegin(inlineData), nSize(0), nCapacity(N) {}
+
+    ~CSmallVector()
+    {
+        if (pbegin != inlineData)
+            free(pbegin);
+    }
+
+    unsigned int size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+    T& operator[](unsigned int i) { return pbegin[i]; }
+    const T& operator[](unsigned int i) const { return pbegin[i]; }
+    T& back() { return pbegin[nSize - 1]; }
+
+    void reserve(unsigned int n)
+    {
+        if (n <= nCapacity)
+            return;
+        unsigned int nNewCapacity = std::max(n, nCapacity * 2);
+        T* pnew = (T*)malloc(nNewCapacity * sizeof(T));
+        if (!pnew)
+            throw std::bad_alloc();
+        memcpy(pnew, pbegin, nSize * sizeof(T));
+        if (pbegin != inlineData)
+            free(pbegin);
+        pbegin = pnew;
+        nCapacity = nNewCapacity;
+    }
+
+    void resize(unsigned int n)
+    {
+        reserve(n);
+        nSize = n;
+    }
+
+    void push_back(const T& value)
+    {
+        // value may live in this vector; copy it before growing
+        T copy = value;
+        reserve(nSize + 1);
+        pbegin[nSize++] = copy;
+    }
+
+    void pop_back() { nSize--; }
+    void clear() { nSize = 0; }
+
+    void erase(unsigned int i)
+    {
+        memmove(pbegin + i, pbegin + i + 1, (nSize - i - 1) * sizeof(T));
+        nSize--;
+    }
+
+    void insert(unsigned int i, const T& value)
+    {
+        T copy = value;
+        reserve(nSize + 1);
+        memmove(pbegin + i + 1, pbegin + i, (nSize - i) * sizeof(T));
+        pbegin[i] = copy;
+        nSize++;
+    }
+
+    void assign(const CSmallVector& other)
+    {
+        resize(other.nSize);
+        memcpy(pbegin, other.pbegin, nSize * sizeof(T));
+    }
+};
+
+/** One decoded instruction; offsets are into the script it came from. */
+struct CScriptInstruction
+{
+    opcodetype opcode;
+    unsigned int nDataBegin; //!< start of the pushed data
+    unsigned int nDataSize;  //!< number of bytes pushed, 0 for non-push opcodes
+    unsigned int nEnd;       //!< start of the next instruction
+};
+
+/**
+ * A script split into instructions once, so that EvalScript does not
+ * have to re-parse opcodes or copy push data out of the script.
+ */
+class CDecodedScript
+{
+public:
+    CSmallVector<CScriptInstruction, 64> vInstructions;
+    //! Decoding stopped at an instruction GetOp could not read. EvalScript
+    //! only fails there once it has run everything before it.
+    bool fBadOpcode;
+
+    explicit CDecodedScript(const CScript& script) : fBadOpcode(false)
+    {
+        CScript::const_iterator pc = script.begin();
+        while (pc < script.end())
+        {
+            CScriptInstruction ins;
+            unsigned int nBegin = pc - script.begin();
+            if (!script.GetOp(pc, ins.opcode)) {
+                fBadOpcode = true;
+                break;
+            }
+            unsigned int nHeader = 1;
+            if (ins.opcode == OP_PUSHDATA1)
+                nHeader = 2;
+            else if (ins.opcode == OP_PUSHDATA2)
+                nHeader = 3;
+            else if (ins.opcode == OP_PUSHDATA4)
+                nHeader = 5;
+            ins.nEnd = pc - script.begin();
+            ins.nDataBegin = std::min(nBegin + nHeader, ins.nEnd);
+            ins.nDataSize = ins.opcode <= OP_PUSHDATA4 ? ins.nEnd - ins.nDataBegin : 0;
+            vInstructions.push_back(ins);
+        }
+    }
+};
+
+/**
+ * The interpreter's stack. Element bytes live in one arena and the stack
+ * itself only holds offsets into it, so pushing does not allocate until
+ * the inline buffers are outgrown. Elements are never modified in place,
+ * which lets duplicates share their bytes: OP_DUP, OP_PICK, OP_ROLL,
+ * OP_SWAP and the like only move offsets around. The arena is not
+ * compacted until the stack empties; what a script can push is bounded by
+ * its size and opcode limits.
+ */
+class CScriptStack
+{
+private:
+    struct Element
+    {
+        unsigned int nOffset;
+        unsigned int nSize;
+    };
+
+    CSmallVector<unsigned char, 1024> vArena;
+    CSmallVector<Element, 32> vElements;
+
+    //! Position of element i counted from the top (-1 is the top), checked like vector::at
+    unsigned int Position(int i) const
+    {
+        if (i >= 0 || (unsigned int)-i > vElements.size())
+            throw std::out_of_range("CScriptStack : index out of range");
+        return vElements.size() + i;
+    }
+
+    void ReleaseIfEmpty()
+    {
+        if (vElements.empty())
+            vArena.clear();
+    }
+
+public:
+    unsigned int size() const { return vElements.size(); }
+    bool empty() const { return vElements.empty(); }
+
+    //! Element i counted from the top (-1 is the top); valid until the next push
+    StackSpan top(int i) const
+    {
+        const Element& e = vElements[Position(i)];
+        StackSpan span = { e.nSize ? &vArena[e.nOffset] : NULL, e.nSize };
+        return span;
+    }
+
+    //! Push a copy of nSize bytes, which must not point into this stack
+    void push(const unsigned char* pch, unsigned int nSize)
+    {
+        Element e = { vArena.size(), nSize };
+        vArena.resize(e.nOffset + nSize);
+        if (nSize)
+            memcpy(&vArena[e.nOffset], pch, nSize);
+        vElements.push_back(e);
+    }
+
+    void push(const StackSpan& span) { push(span.begin, span.size); }
+
+    void push_bool(bool fValue)
+    {
+        static const unsigned char vchTrue = 1;
+        push(&vchTrue, fValue ? 1 : 0);
+    }
+
+    void push_num(const CScriptNum& bn)
+    {
+        unsigned char vch[CScriptNum::MAX_SERIALIZED_SIZE];
+        push(vch, bn.getvch(vch));
+    }
+
+    //! Push element i again
+    void dup(int i) { vElements.push_back(vElements[Position(i)]); }
+
+    void pop()
+    {
+        if (vElements.empty())
+            throw std::runtime_error("CScriptStack::pop() : stack empty");
+        vElements.pop_back();
+        ReleaseIfEmpty();
+    }
+
+    void erase(int i)
+    {
+        vElements.erase(Position(i));
+        ReleaseIfEmpty();
+    }
+
+    //! Move element i to the top
+    void roll(int i)
+    {
+        unsigned int nPos = Position(i);
+        Element e = vElements[nPos];
+        vElements.erase(nPos);
+        vElements.push_back(e);
+    }
+
+    void swap(int i, int j) { std::swap(vElements[Position(i)], vElements[Position(j)]); }
+
+    //! Insert a copy of element iFrom below element iWhere
+    void insert(int iWhere, int iFrom) { vElements.insert(Position(iWhere), vElements[Position(iFrom)]); }
+
+    void assign(const CScriptStack& other)
+    {
+        vArena.assign(other.vArena);
+        vElements.assign(other.vElements);
+    }
+
+    void assign(const vector<valtype>& stack)
+    {
+        vArena.clear();
+        vElements.clear();
+        for (unsigned int i = 0; i < stack.size(); i++)
+            push(begin_ptr(stack[i]), stack[i].size());
+    }
+
+    void get(vector<valtype>& stack) const
+    {
+        stack.resize(vElements.size());
+        for (unsigned int i = 0; i < vElements.size(); i++) {
+            const unsigned char* pch = &vArena[0] + vElements[i].nOffset;
+            stack[i].assign(pch, pch + vElements[i].nSize);
+        }
+    }
+};
+
+} // anon namespace
+
+namespace {
+
+bool ExecuteScript(CScriptStack& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     static const CScriptNum bnZero(0);
     static const CScriptNum bnOne(1);
-    static const CScriptNum bnFalse(0);
-    static const CScriptNum bnTrue(1);
-    static const valtype vchFalse(0);
-    static const valtype vchZero(0);
-    static const valtype vchTrue(1, 1);
 
-    CScript::const_iterator pc = script.begin();
-    CScript::const_iterator pend = script.end();
-    CScript::const_iterator pbegincodehash = script.begin();
-    opcodetype opcode;
-    valtype vchPushValue;
-    vector<bool> vfExec;
-    vector<valtype> altstack;
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
     if (script.size() > 10000)
         return set_error(serror, SCRIPT_ERR_SCRIPT_SIZE);
+    const CDecodedScript decoded(script);
+    const unsigned char* pscript = script.empty() ? NULL : &script[0];
+    unsigned int nCodeHashBegin = 0;
+    CScriptStack altstack;
+    // vfExec as a stack of flags, plus how many of them are false
+    CSmallVector<bool, 16> vfExec;
+    unsigned int nExecFalse = 0;
     int nOpCount = 0;
     bool fRequireMinimal = (flags & SCRIPT_VERIFY_MINIMALDATA) != 0;
 
     try
     {
-        while (pc < pend)
+        for (unsigned int nInstruction = 0; nInstruction < decoded.vInstructions.size(); nInstruction++)
         {
-            bool fExec = !count(vfExec.begin(), vfExec.end(), false);
-
-            //
-            // Read instruction
-            //
-            if (!script.GetOp(pc, opcode, vchPushValue))
-                return set_error(serror, SCRIPT_ERR_BAD_OPCODE);
-            if (vchPushValue.size() > MAX_SCRIPT_ELEMENT_SIZE)
+            const CScriptInstruction& ins = decoded.vInstructions[nInstruction];
+            const opcodetype opcode = ins.opcode;
+            bool fExec = nExecFalse == 0;
+
+            if (ins.nDataSize > MAX_SCRIPT_ELEMENT_SIZE)
                 return set_error(serror, SCRIPT_ERR_PUSH_SIZE);
 
             // Note how OP_RESERVED does not count towards the opcode limit.
@@ -289,10 +545,11 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 return set_error(serror, SCRIPT_ERR_DISABLED_OPCODE); // Disabled opcodes.
 
             if (fExec && 0 <= opcode && opcode <= OP_PUSHDATA4) {
-                if (fRequireMinimal && !CheckMinimalPush(vchPushValue, opcode)) {
+                const unsigned char* pchPush = ins.nDataSize ? pscript + ins.nDataBegin : NULL;
+                if (fRequireMinimal && !CheckMinimalPush(pchPush, ins.nDataSize, opcode)) {
                     return set_error(serror, SCRIPT_ERR_MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                stack.push(pchPush, ins.nDataSize);
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF))
             switch (opcode)
             {
@@ -319,7 +576,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     // ( -- value)
                     CScriptNum bn((int)opcode - (int)(OP_1 - 1));
-                    stack.push_back(bn.getvch());
+                    stack.push_num(bn);
                     // The result of these opcodes should always be the minimal way to push the data
                     // they push, so no need for a CheckMinimalPush here.
                 }
@@ -349,13 +606,14 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     {
                         if (stack.size() < 1)
                             return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
-                        valtype& vch = stacktop(-1);
-                        fValue = CastToBool(vch);
+                        fValue = CastToBool(stack.top(-1));
                         if (opcode == OP_NOTIF)
                             fValue = !fValue;
-                        popstack(stack);
+                        stack.pop();
                     }
                     vfExec.push_back(fValue);
+                    if (!fValue)
+                        nExecFalse++;
                 }
                 break;
 
@@ -363,6 +621,10 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     if (vfExec.empty())
                         return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                    if (vfExec.back())
+                        nExecFalse++;
+                    else
+                        nExecFalse--;
                     vfExec.back() = !vfExec.back();
                 }
                 break;
@@ -371,6 +633,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     if (vfExec.empty())
                         return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                    if (!vfExec.back())
+                        nExecFalse--;
                     vfExec.pop_back();
                 }
                 break;
@@ -381,9 +645,9 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (false -- false) and return
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    bool fValue = CastToBool(stacktop(-1));
+                    bool fValue = CastToBool(stack.top(-1));
                     if (fValue)
-                        popstack(stack);
+                        stack.pop();
                     else
                         return set_error(serror, SCRIPT_ERR_VERIFY);
                 }
@@ -403,8 +667,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    altstack.push_back(stacktop(-1));
-                    popstack(stack);
+                    altstack.push(stack.top(-1));
+                    stack.pop();
                 }
                 break;
 
@@ -412,8 +676,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     if (altstack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_ALTSTACK_OPERATION);
-                    stack.push_back(altstacktop(-1));
-                    popstack(altstack);
+                    stack.push(altstack.top(-1));
+                    altstack.pop();
                 }
                 break;
 
@@ -422,8 +686,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- )
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    popstack(stack);
-                    popstack(stack);
+                    stack.pop();
+                    stack.pop();
                 }
                 break;
 
@@ -432,10 +696,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x1 x2 x1 x2)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-2);
-                    valtype vch2 = stacktop(-1);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
+                    stack.dup(-2);
+                    stack.dup(-2);
                 }
                 break;
 
@@ -444,12 +706,9 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 -- x1 x2 x3 x1 x2 x3)
                     if (stack.size() < 3)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-3);
-                    valtype vch2 = stacktop(-2);
-                    valtype vch3 = stacktop(-1);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
-                    stack.push_back(vch3);
+                    stack.dup(-3);
+                    stack.dup(-3);
+                    stack.dup(-3);
                 }
                 break;
 
@@ -458,10 +717,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 x4 -- x1 x2 x3 x4 x1 x2)
                     if (stack.size() < 4)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-4);
-                    valtype vch2 = stacktop(-3);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
+                    stack.dup(-4);
+                    stack.dup(-4);
                 }
                 break;
 
@@ -470,11 +727,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 x4 x5 x6 -- x3 x4 x5 x6 x1 x2)
                     if (stack.size() < 6)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-6);
-                    valtype vch2 = stacktop(-5);
-                    stack.erase(stack.end()-6, stack.end()-4);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
+                    stack.roll(-6);
+                    stack.roll(-6);
                 }
                 break;
 
@@ -483,8 +737,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 x4 -- x3 x4 x1 x2)
                     if (stack.size() < 4)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    swap(stacktop(-4), stacktop(-2));
-                    swap(stacktop(-3), stacktop(-1));
+                    stack.swap(-4, -2);
+                    stack.swap(-3, -1);
                 }
                 break;
 
@@ -493,9 +747,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x - 0 | x x)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    if (CastToBool(vch))
-                        stack.push_back(vch);
+                    if (CastToBool(stack.top(-1)))
+                        stack.dup(-1);
                 }
                 break;
 
@@ -503,7 +756,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                 {
                     // -- stacksize
                     CScriptNum bn(stack.size());
-                    stack.push_back(bn.getvch());
+                    stack.push_num(bn);
                 }
                 break;
 
@@ -512,7 +765,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x -- )
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    popstack(stack);
+                    stack.pop();
                 }
                 break;
 
@@ -521,8 +774,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x -- x x)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    stack.push_back(vch);
+                    stack.dup(-1);
                 }
                 break;
 
@@ -531,7 +783,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x2)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    stack.erase(stack.end() - 2);
+                    stack.erase(-2);
                 }
                 break;
 
@@ -540,8 +792,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x1 x2 x1)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-2);
-                    stack.push_back(vch);
+                    stack.dup(-2);
                 }
                 break;
 
@@ -552,14 +803,15 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (xn ... x2 x1 x0 n - ... x2 x1 x0 xn)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    int n = CScriptNum(stacktop(-1), fRequireMinimal).getint();
-                    popstack(stack);
+                    StackSpan vch = stack.top(-1);
+                    int n = CScriptNum(vch.begin, vch.size, fRequireMinimal).getint();
+                    stack.pop();
                     if (n < 0 || n >= (int)stack.size())
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-n-1);
                     if (opcode == OP_ROLL)
-                        stack.erase(stack.end()-n-1);
-                    stack.push_back(vch);
+                        stack.roll(-n-1);
+                    else
+                        stack.dup(-n-1);
                 }
                 break;
 
@@ -570,8 +822,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     //  x2 x3 x1  after second swap
                     if (stack.size() < 3)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    swap(stacktop(-3), stacktop(-2));
-                    swap(stacktop(-2), stacktop(-1));
+                    stack.swap(-3, -2);
+                    stack.swap(-2, -1);
                 }
                 break;
 
@@ -580,7 +832,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x2 x1)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    swap(stacktop(-2), stacktop(-1));
+                    stack.swap(-2, -1);
                 }
                 break;
 
@@ -589,8 +841,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x2 x1 x2)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    stack.insert(stack.end()-2, vch);
+                    stack.insert(-2, -1);
                 }
                 break;
 
@@ -600,8 +851,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (in -- in size)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    CScriptNum bn(stacktop(-1).size());
-                    stack.push_back(bn.getvch());
+                    CScriptNum bn(stack.top(-1).size);
+                    stack.push_num(bn);
                 }
                 break;
 
@@ -616,21 +867,21 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 - bool)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype& vch1 = stacktop(-2);
-                    valtype& vch2 = stacktop(-1);
-                    bool fEqual = (vch1 == vch2);
+                    StackSpan vch1 = stack.top(-2);
+                    StackSpan vch2 = stack.top(-1);
+                    bool fEqual = (vch1.size == vch2.size && (vch1.size == 0 || memcmp(vch1.begin, vch2.begin, vch1.size) == 0));
                     // OP_NOTEQUAL is disabled because it would be too easy to say
                     // something like n != 1 and have some wiseguy pass in 1 with extra
                     // zero bytes after it (numerically, 0x01 == 0x0001 == 0x000001)
                     //if (opcode == OP_NOTEQUAL)
                     //    fEqual = !fEqual;
-                    popstack(stack);
-                    popstack(stack);
-                    stack.push_back(fEqual ? vchTrue : vchFalse);
+                    stack.pop();
+                    stack.pop();
+                    stack.push_bool(fEqual);
                     if (opcode == OP_EQUALVERIFY)
                     {
                         if (fEqual)
-                            popstack(stack);
+                            stack.pop();
                         else
                             return set_error(serror, SCRIPT_ERR_EQUALVERIFY);
                     }
@@ -651,7 +902,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (in -- out)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    CScriptNum bn(stacktop(-1), fRequireMinimal);
+                    StackSpan vch = stack.top(-1);
+                    CScriptNum bn(vch.begin, vch.size, fRequireMinimal);
                     switch (opcode)
                     {
                     case OP_1ADD:       bn += bnOne; break;
@@ -662,8 +914,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     case OP_0NOTEQUAL:  bn = (bn != bnZero); break;
                     default:            assert(!"invalid opcode"); break;
                     }
-                    popstack(stack);
-                    stack.push_back(bn.getvch());
+                    stack.pop();
+                    stack.push_num(bn);
                 }
                 break;
 
@@ -684,8 +936,10 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- out)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    CScriptNum bn1(stacktop(-2), fRequireMinimal);
-                    CScriptNum bn2(stacktop(-1), fRequireMinimal);
+                    StackSpan vch1 = stack.top(-2);
+                    StackSpan vch2 = stack.top(-1);
+                    CScriptNum bn1(vch1.begin, vch1.size, fRequireMinimal);
+                    CScriptNum bn2(vch2.begin, vch2.size, fRequireMinimal);
                     CScriptNum bn(0);
                     switch (opcode)
                     {
@@ -710,14 +964,14 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     case OP_MAX:                 bn = (bn1 > bn2 ? bn1 : bn2); break;
                     default:                     assert(!"invalid opcode"); break;
                     }
-                    popstack(stack);
-                    popstack(stack);
-                    stack.push_back(bn.getvch());
+                    stack.pop();
+                    stack.pop();
+                    stack.push_num(bn);
 
                     if (opcode == OP_NUMEQUALVERIFY)
                     {
-                        if (CastToBool(stacktop(-1)))
-                            popstack(stack);
+                        if (CastToBool(stack.top(-1)))
+                            stack.pop();
                         else
                             return set_error(serror, SCRIPT_ERR_NUMEQUALVERIFY);
                     }
@@ -729,14 +983,17 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x min max -- out)
                     if (stack.size() < 3)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    CScriptNum bn1(stacktop(-3), fRequireMinimal);
-                    CScriptNum bn2(stacktop(-2), fRequireMinimal);
-                    CScriptNum bn3(stacktop(-1), fRequireMinimal);
+                    StackSpan vch1 = stack.top(-3);
+                    StackSpan vch2 = stack.top(-2);
+                    StackSpan vch3 = stack.top(-1);
+                    CScriptNum bn1(vch1.begin, vch1.size, fRequireMinimal);
+                    CScriptNum bn2(vch2.begin, vch2.size, fRequireMinimal);
+                    CScriptNum bn3(vch3.begin, vch3.size, fRequireMinimal);
                     bool fValue = (bn2 <= bn1 && bn1 < bn3);
-                    popstack(stack);
-                    popstack(stack);
-                    popstack(stack);
-                    stack.push_back(fValue ? vchTrue : vchFalse);
+                    stack.pop();
+                    stack.pop();
+                    stack.pop();
+                    stack.push_bool(fValue);
                 }
                 break;
 
@@ -753,27 +1010,28 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (in -- hash)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype& vch = stacktop(-1);
-                    valtype vchHash((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
+                    StackSpan vch = stack.top(-1);
+                    unsigned char vchHash[32];
+                    unsigned int nHashSize = (opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32;
                     if (opcode == OP_RIPEMD160)
-                        CRIPEMD160().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CRIPEMD160().Write(vch.begin, vch.size).Finalize(vchHash);
                     else if (opcode == OP_SHA1)
-                        CSHA1().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CSHA1().Write(vch.begin, vch.size).Finalize(vchHash);
                     else if (opcode == OP_SHA256)
-                        CSHA256().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CSHA256().Write(vch.begin, vch.size).Finalize(vchHash);
                     else if (opcode == OP_HASH160)
-                        CHash160().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CHash160().Write(vch.begin, vch.size).Finalize(vchHash);
                     else if (opcode == OP_HASH256)
-                        CHash256().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
-                    popstack(stack);
-                    stack.push_back(vchHash);
+                        CHash256().Write(vch.begin, vch.size).Finalize(vchHash);
+                    stack.pop();
+                    stack.push(vchHash, nHashSize);
                 }
                 break;                                   
 
                 case OP_CODESEPARATOR:
                 {
                     // Hash starts after the code separator
-                    pbegincodehash = pc;
+                    nCodeHashBegin = ins.nEnd;
                 }
                 break;
 
@@ -784,11 +1042,11 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
 
-                    valtype& vchSig    = stacktop(-2);
-                    valtype& vchPubKey = stacktop(-1);
+                    valtype vchSig(stack.top(-2).ToVector());
+                    valtype vchPubKey(stack.top(-1).ToVector());
 
                     // Subset of script starting at the most recent codeseparator
-                    CScript scriptCode(pbegincodehash, pend);
+                    CScript scriptCode(script.begin() + nCodeHashBegin, script.end());
 
                     // Drop the signature, since there's no way for a signature to sign itself
                     scriptCode.FindAndDelete(CScript(vchSig));
@@ -799,13 +1057,13 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     }
                     bool fSuccess = checker.CheckSig(vchSig, vchPubKey, scriptCode);
 
-                    popstack(stack);
-                    popstack(stack);
-                    stack.push_back(fSuccess ? vchTrue : vchFalse);
+                    stack.pop();
+                    stack.pop();
+                    stack.push_bool(fSuccess);
                     if (opcode == OP_CHECKSIGVERIFY)
                     {
                         if (fSuccess)
-                            popstack(stack);
+                            stack.pop();
                         else
                             return set_error(serror, SCRIPT_ERR_CHECKSIGVERIFY);
                     }
@@ -821,7 +1079,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     if ((int)stack.size() < i)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
 
-                    int nKeysCount = CScriptNum(stacktop(-i), fRequireMinimal).getint();
+                    StackSpan vchKeysCount = stack.top(-i);
+                    int nKeysCount = CScriptNum(vchKeysCount.begin, vchKeysCount.size, fRequireMinimal).getint();
                     if (nKeysCount < 0 || nKeysCount > 20)
                         return set_error(serror, SCRIPT_ERR_PUBKEY_COUNT);
                     nOpCount += nKeysCount;
@@ -832,7 +1091,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     if ((int)stack.size() < i)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
 
-                    int nSigsCount = CScriptNum(stacktop(-i), fRequireMinimal).getint();
+                    StackSpan vchSigsCount = stack.top(-i);
+                    int nSigsCount = CScriptNum(vchSigsCount.begin, vchSigsCount.size, fRequireMinimal).getint();
                     if (nSigsCount < 0 || nSigsCount > nKeysCount)
                         return set_error(serror, SCRIPT_ERR_SIG_COUNT);
                     int isig = ++i;
@@ -841,20 +1101,20 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
 
                     // Subset of script starting at the most recent codeseparator
-                    CScript scriptCode(pbegincodehash, pend);
+                    CScript scriptCode(script.begin() + nCodeHashBegin, script.end());
 
                     // Drop the signatures, since there's no way for a signature to sign itself
                     for (int k = 0; k < nSigsCount; k++)
                     {
-                        valtype& vchSig = stacktop(-isig-k);
+                        valtype vchSig(stack.top(-isig-k).ToVector());
                         scriptCode.FindAndDelete(CScript(vchSig));
                     }
 
                     bool fSuccess = true;
                     while (fSuccess && nSigsCount > 0)
                     {
-                        valtype& vchSig    = stacktop(-isig);
-                        valtype& vchPubKey = stacktop(-ikey);
+                        valtype vchSig(stack.top(-isig).ToVector());
+                        valtype vchPubKey(stack.top(-ikey).ToVector());
 
                         // Note how this makes the exact order of pubkey/signature evaluation
                         // distinguishable by CHECKMULTISIG NOT if the STRICTENC flag is set.
@@ -883,7 +1143,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
 
                     // Clean up stack of actual arguments
                     while (i-- > 1)
-                        popstack(stack);
+                        stack.pop();
 
                     // A bug causes CHECKMULTISIG to consume one extra argument
                     // whose contents were not checked in any way.
@@ -893,16 +1153,16 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // to removing it from the stack.
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    if ((flags & SCRIPT_VERIFY_NULLDUMMY) && stacktop(-1).size())
+                    if ((flags & SCRIPT_VERIFY_NULLDUMMY) && stack.top(-1).size)
                         return set_error(serror, SCRIPT_ERR_SIG_NULLDUMMY);
-                    popstack(stack);
+                    stack.pop();
 
-                    stack.push_back(fSuccess ? vchTrue : vchFalse);
+                    stack.push_bool(fSuccess);
 
                     if (opcode == OP_CHECKMULTISIGVERIFY)
                     {
                         if (fSuccess)
-                            popstack(stack);
+                            stack.pop();
                         else
                             return set_error(serror, SCRIPT_ERR_CHECKMULTISIGVERIFY);
                     }
@@ -923,12 +1183,26 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
         return set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
     }
 
+    if (decoded.fBadOpcode)
+        return set_error(serror, SCRIPT_ERR_BAD_OPCODE);
+
     if (!vfExec.empty())
         return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
 
     return set_success(serror);
 }
 
+} // anon namespace
+
+bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    CScriptStack stackEval;
+    stackEval.assign(stack);
+    bool fSuccess = ExecuteScript(stackEval, script, flags, checker, serror);
+    stackEval.get(stack);
+    return fSuccess;
+}
+
 namespace {
 
 /**
@@ -1028,7 +1302,31 @@ public:
 
 } // anon namespace
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    CHashWriter ssPrefix(SER_GETHASH, 0);
+    ssPrefix << txTo.nVersion;
+    ::WriteCompactSize(ssPrefix, txTo.vin.size());
+    CHash256 ctx = ssPrefix.GetState();
+
+    CDataStream ssInputs(SER_GETHASH, 0);
+    vPrefixState.reserve(txTo.vin.size());
+    vBlankedInputEnd.reserve(txTo.vin.size());
+    for (unsigned int i = 0; i < txTo.vin.size(); i++) {
+        vPrefixState.push_back(ctx);
+        unsigned int nBegin = ssInputs.size();
+        ssInputs << txTo.vin[i].prevout << CScript() << txTo.vin[i].nSequence;
+        ctx.Write((const unsigned char*)&ssInputs[nBegin], ssInputs.size() - nBegin);
+        vBlankedInputEnd.push_back(ssInputs.size());
+    }
+    vBlankedInputs.assign(ssInputs.begin(), ssInputs.end());
+
+    CDataStream ssOutputs(SER_GETHASH, 0);
+    ssOutputs << txTo.vout << txTo.nLockTime;
+    vOutputsAndLockTime.assign(ssOutputs.begin(), ssOutputs.end());
+}
+
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache)
 {
     if (nIn >= txTo.vin.size()) {
         //  nIn out of range
@@ -1046,6 +1344,23 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    if (cache && !(nHashType & SIGHASH_ANYONECANPAY) &&
+        (nHashType & 0x1f) != SIGHASH_NONE && (nHashType & 0x1f) != SIGHASH_SINGLE) {
+        // SIGHASH_ALL: resume from the state after the inputs before nIn and
+        // append the precomputed serialization of everything after it.
+        assert(cache->vPrefixState.size() == txTo.vin.size());
+        CHashWriter ss(SER_GETHASH, 0, cache->vPrefixState[nIn]);
+        ss << txTo.vin[nIn].prevout;
+        txTmp.SerializeScriptCode(ss, SER_GETHASH, 0);
+        ss << txTo.vin[nIn].nSequence;
+        unsigned int nEnd = cache->vBlankedInputEnd[nIn];
+        if (nEnd < cache->vBlankedInputs.size())
+            ss.write((const char*)&cache->vBlankedInputs[nEnd], cache->vBlankedInputs.size() - nEnd);
+        ss.write((const char*)&cache->vOutputsAndLockTime[0], cache->vOutputsAndLockTime.size());
+        ss << nHashType;
+        return ss.GetHash();
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1070,7 +1385,7 @@ bool SignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn, const vec
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -1078,6 +1393,244 @@ bool SignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn, const vec
     return true;
 }
 
+namespace {
+
+/**
+ * Fast paths for the standard script templates.
+ *
+ * Nearly every script validated is pay-to-pubkey-hash, pay-to-pubkey, bare
+ * multisig or one of those wrapped in pay-to-script-hash. For those, even
+ * the decoded interpreter spends most of its time decoding, moving stack
+ * elements and building temporary vectors. The functions below
+ * recognise the templates by their exact byte layout and evaluate them
+ * directly on pointers into the scriptSig.
+ *
+ * They must give exactly the same result as EvalScript. Whenever a script
+ * does something unusual before reaching a signature check (non-minimal
+ * pushes, too few stack items, a hash mismatch, a badly encoded signature
+ * or key...) they bail out and VerifyScript runs the interpreter instead,
+ * which then reports the precise error. Once signatures have been checked
+ * the outcome is reported directly, so no signature is verified twice.
+ */
+
+//! Largest number of scriptSig pushes handled without the interpreter
+static const unsigned int MAX_FAST_STACK = 24;
+
+enum TemplateResult
+{
+    TEMPLATE_UNHANDLED, //!< not a template, or needs the interpreter's exact error reporting
+    TEMPLATE_ERROR,     //!< failed; serror is set
+    TEMPLATE_EVALUATED, //!< ran to completion; fSuccess is the value left on top of the stack
+};
+
+/**
+ * Split a scriptSig made only of data pushes into the stack EvalScript
+ * would produce, without copying. Returns false if the script contains
+ * anything else, or anything EvalScript might reject.
+ */
+bool GetPushSpans(const CScript& script, unsigned int flags, StackSpan* stack, unsigned int& nStack)
+{
+    CScript::const_iterator pc = script.begin();
+    CScript::const_iterator pend = script.end();
+    bool fRequireMinimal = (flags & SCRIPT_VERIFY_MINIMALDATA) != 0;
+    nStack = 0;
+    while (pc < pend) {
+        opcodetype opcode = (opcodetype)*pc++;
+        unsigned int nSize;
+        if (opcode < OP_PUSHDATA1) {
+            nSize = opcode;
+        } else if (opcode == OP_PUSHDATA1) {
+            if (pend - pc < 1)
+                return false;
+            nSize = *pc++;
+        } else if (opcode == OP_PUSHDATA2) {
+            if (pend - pc < 2)
+                return false;
+            nSize = ReadLE16(&pc[0]);
+            pc += 2;
+        } else {
+            // OP_PUSHDATA4 is never needed for elements of at most
+            // MAX_SCRIPT_ELEMENT_SIZE bytes; leave it to the interpreter.
+            return false;
+        }
+        if ((unsigned int)(pend - pc) < nSize || nSize > MAX_SCRIPT_ELEMENT_SIZE || nStack == MAX_FAST_STACK)
+            return false;
+        if (fRequireMinimal && !CheckMinimalPush(&pc[0], nSize, opcode))
+            return false;
+        stack[nStack].begin = nSize ? &pc[0] : NULL;
+        stack[nStack].size = nSize;
+        nStack++;
+        pc += nSize;
+    }
+    return true;
+}
+
+bool IsSmallIntOpcode(unsigned char opcode)
+{
+    return opcode >= OP_1 && opcode <= OP_16;
+}
+
+bool IsPubKeyPush(const unsigned char* pc)
+{
+    return *pc == 33 || *pc == 65;
+}
+
+/** OP_CHECKSIG of sig against pubkey, as EvalScript does it, with scriptCode the whole script. */
+TemplateResult CheckSigTemplate(const CScript& script, const StackSpan& sig, const StackSpan& pubkey, unsigned int flags, const BaseSignatureChecker& checker, bool& fSuccess, ScriptError* serror)
+{
+    valtype vchSig(sig.ToVector());
+    valtype vchPubKey(pubkey.ToVector());
+    if (!CheckSignatureEncoding(vchSig, flags, NULL) || !CheckPubKeyEncoding(vchPubKey, flags, NULL))
+        return TEMPLATE_UNHANDLED;
+
+    // Drop the signature, since there's no way for a signature to sign itself
+    CScript scriptCode(script);
+    scriptCode.FindAndDelete(CScript(vchSig));
+
+    fSuccess = checker.CheckSig(vchSig, vchPubKey, scriptCode);
+    return TEMPLATE_EVALUATED;
+}
+
+/**
+ * Run a standard template script on top of the given stack. On
+ * TEMPLATE_EVALUATED, nStack is the number of untouched elements that
+ * remain below the result.
+ */
+TemplateResult EvalTemplate(const CScript& script, const StackSpan* stack, unsigned int& nStack, unsigned int flags, const BaseSignatureChecker& checker, bool& fSuccess, ScriptError* serror)
+{
+    const unsigned int nSize = script.size();
+    const unsigned char* p = nSize ? &script[0] : NULL;
+
+    // Pay-to-pubkey-hash: OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+    if (nSize == 25 && p[0] == OP_DUP && p[1] == OP_HASH160 && p[2] == 20 &&
+        p[23] == OP_EQUALVERIFY && p[24] == OP_CHECKSIG) {
+        if (nStack < 2)
+            return TEMPLATE_UNHANDLED;
+        const StackSpan& sig = stack[nStack - 2];
+        const StackSpan& pubkey = stack[nStack - 1];
+        unsigned char vchHash[CHash160::OUTPUT_SIZE];
+        CHash160().Write(pubkey.begin, pubkey.size).Finalize(vchHash);
+        if (memcmp(vchHash, &p[3], sizeof(vchHash)) != 0)
+            return TEMPLATE_UNHANDLED;
+        TemplateResult ret = CheckSigTemplate(script, sig, pubkey, flags, checker, fSuccess, serror);
+        if (ret == TEMPLATE_EVALUATED)
+            nStack -= 2;
+        return ret;
+    }
+
+    // Pay-to-pubkey: <33 or 65 byte pubkey> OP_CHECKSIG
+    if ((nSize == 35 || nSize == 67) && p[0] == nSize - 2 && p[nSize - 1] == OP_CHECKSIG) {
+        if (nStack < 1)
+            return TEMPLATE_UNHANDLED;
+        StackSpan pubkey = { &p[1], nSize - 2 };
+        TemplateResult ret = CheckSigTemplate(script, stack[nStack - 1], pubkey, flags, checker, fSuccess, serror);
+        if (ret == TEMPLATE_EVALUATED)
+            nStack -= 1;
+        return ret;
+    }
+
+    // Bare multisig: OP_m <pubkey>... OP_n OP_CHECKMULTISIG
+    if (nSize >= 37 && IsSmallIntOpcode(p[0]) && p[nSize - 1] == OP_CHECKMULTISIG && IsSmallIntOpcode(p[nSize - 2])) {
+        StackSpan keys[16];
+        int nKeysCount = 0;
+        unsigned int pos = 1;
+        while (pos < nSize - 2 && nKeysCount < 16 && IsPubKeyPush(&p[pos]) && pos + 1 + p[pos] <= nSize - 2) {
+            keys[nKeysCount].begin = &p[pos + 1];
+            keys[nKeysCount].size = p[pos];
+            nKeysCount++;
+            pos += 1 + p[pos];
+        }
+        int nSigsCount = p[0] - (OP_1 - 1);
+        if (pos != nSize - 2 || nKeysCount != p[nSize - 2] - (OP_1 - 1) || nSigsCount > nKeysCount)
+            return TEMPLATE_UNHANDLED;
+        // The signatures plus the dummy element must already be on the stack
+        if (nStack < (unsigned int)nSigsCount + 1)
+            return TEMPLATE_UNHANDLED;
+
+        std::vector<valtype> vchSigs(nSigsCount);
+        CScript scriptCode(script);
+        for (int k = 0; k < nSigsCount; k++) {
+            vchSigs[k] = stack[nStack - 1 - k].ToVector();
+            scriptCode.FindAndDelete(CScript(vchSigs[k]));
+        }
+
+        // Same order as EvalScript: from the last signature and key down
+        int isig = 0, ikey = nKeysCount - 1;
+        int nSigsLeft = nSigsCount, nKeysLeft = nKeysCount;
+        fSuccess = true;
+        while (fSuccess && nSigsLeft > 0) {
+            const valtype& vchSig = vchSigs[isig];
+            valtype vchPubKey(keys[ikey].ToVector());
+            if (!CheckSignatureEncoding(vchSig, flags, serror) || !CheckPubKeyEncoding(vchPubKey, flags, serror))
+                return TEMPLATE_ERROR;
+
+            if (checker.CheckSig(vchSig, vchPubKey, scriptCode)) {
+                isig++;
+                nSigsLeft--;
+            }
+            ikey--;
+            nKeysLeft--;
+
+            if (nSigsLeft > nKeysLeft)
+                fSuccess = false;
+        }
+
+        const StackSpan& dummy = stack[nStack - 1 - nSigsCount];
+        if ((flags & SCRIPT_VERIFY_NULLDUMMY) && dummy.size) {
+            set_error(serror, SCRIPT_ERR_SIG_NULLDUMMY);
+            return TEMPLATE_ERROR;
+        }
+        nStack -= nSigsCount + 1;
+        return TEMPLATE_EVALUATED;
+    }
+
+    return TEMPLATE_UNHANDLED;
+}
+
+/** VerifyScript for the standard templates; TEMPLATE_UNHANDLED means the interpreter must run. */
+TemplateResult VerifyTemplate(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    StackSpan stack[MAX_FAST_STACK];
+    unsigned int nStack;
+    if (scriptSig.size() > 10000 || scriptPubKey.size() > 10000 || !GetPushSpans(scriptSig, flags, stack, nStack))
+        return TEMPLATE_UNHANDLED;
+
+    bool fSuccess;
+    if (scriptPubKey.IsPayToScriptHash()) {
+        // OP_HASH160 <20 bytes> OP_EQUAL
+        if (nStack < 1)
+            return TEMPLATE_UNHANDLED;
+        const StackSpan& redeem = stack[nStack - 1];
+        unsigned char vchHash[CHash160::OUTPUT_SIZE];
+        CHash160().Write(redeem.begin, redeem.size).Finalize(vchHash);
+        if (memcmp(vchHash, &scriptPubKey[2], sizeof(vchHash)) != 0)
+            return TEMPLATE_UNHANDLED;
+        if (!(flags & SCRIPT_VERIFY_P2SH)) {
+            set_success(serror);
+            return TEMPLATE_EVALUATED;
+        }
+
+        CScript redeemScript(redeem.begin, redeem.begin + redeem.size);
+        nStack--;
+        TemplateResult ret = EvalTemplate(redeemScript, stack, nStack, flags, checker, fSuccess, serror);
+        if (ret != TEMPLATE_EVALUATED)
+            return ret;
+    } else {
+        TemplateResult ret = EvalTemplate(scriptPubKey, stack, nStack, flags, checker, fSuccess, serror);
+        if (ret != TEMPLATE_EVALUATED)
+            return ret;
+    }
+
+    if (!fSuccess) {
+        set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+        return TEMPLATE_ERROR;
+    }
+    set_success(serror);
+    return TEMPLATE_EVALUATED;
+}
+
+} // anon namespace
+
 bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
@@ -1086,19 +1639,25 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         return set_error(serror, SCRIPT_ERR_SIG_PUSHONLY);
     }
 
-    vector<vector<unsigned char> > stack, stackCopy;
-    if (!EvalScript(stack, scriptSig, flags, checker, serror))
+    switch (VerifyTemplate(scriptSig, scriptPubKey, flags, checker, serror)) {
+    case TEMPLATE_EVALUATED: return true;
+    case TEMPLATE_ERROR: return false;
+    case TEMPLATE_UNHANDLED: break;
+    }
+
+    CScriptStack stack, stackCopy;
+    if (!ExecuteScript(stack, scriptSig, flags, checker, serror))
         // serror is set
         return false;
     if (flags & SCRIPT_VERIFY_P2SH)
-        stackCopy = stack;
-    if (!EvalScript(stack, scriptPubKey, flags, checker, serror))
+        stackCopy.assign(stack);
+    if (!ExecuteScript(stack, scriptPubKey, flags, checker, serror))
         // serror is set
         return false;
     if (stack.empty())
         return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
 
-    if (CastToBool(stack.back()) == false)
+    if (CastToBool(stack.top(-1)) == false)
         return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
 
     // Additional validation for spend-to-script-hash transactions:
@@ -1113,16 +1672,16 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         // an empty stack and the EvalScript above would return false.
         assert(!stackCopy.empty());
 
-        const valtype& pubKeySerialized = stackCopy.back();
-        CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
-        popstack(stackCopy);
+        StackSpan pubKeySerialized = stackCopy.top(-1);
+        CScript pubKey2(pubKeySerialized.begin, pubKeySerialized.begin + pubKeySerialized.size);
+        stackCopy.pop();
 
-        if (!EvalScript(stackCopy, pubKey2, flags, checker, serror))
+        if (!ExecuteScript(stackCopy, pubKey2, flags, checker, serror))
             // serror is set
             return false;
         if (stackCopy.empty())
             return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
-        if (!CastToBool(stackCopy.back()))
+        if (!CastToBool(stackCopy.top(-1)))
             return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
         else
             return set_success(serror);
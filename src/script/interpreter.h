@@ -6,6 +6,7 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "hash.h"
 #include "script_error.h"
 
 #include <vector>
@@ -71,7 +72,30 @@ enum
 
 };
 
-uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+/**
+ * Parts of a transaction's signature hash preimage that are shared by all of
+ * its inputs, so that checking N inputs does not re-serialize the whole
+ * transaction N times. Only SIGHASH_ALL without SIGHASH_ANYONECANPAY uses
+ * it; the other hash types blank out different parts of the transaction and
+ * take the generic path.
+ */
+class PrecomputedTransactionData
+{
+public:
+    //! Hasher state after nVersion, the input count and the blanked inputs before each input
+    std::vector<CHash256> vPrefixState;
+    //! All inputs serialized with an empty scriptSig, back to back
+    std::vector<unsigned char> vBlankedInputs;
+    //! End offset of each input in vBlankedInputs
+    std::vector<unsigned int> vBlankedInputEnd;
+    //! Output count, outputs and nLockTime, serialized
+    std::vector<unsigned char> vOutputsAndLockTime;
+
+    PrecomputedTransactionData() {}
+    explicit PrecomputedTransactionData(const CTransaction& txTo);
+};
+
+uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* cache = NULL);
 
 class BaseSignatureChecker
 {
@@ -89,12 +113,13 @@ class SignatureChecker : public BaseSignatureChecker
 private:
     const CTransaction& txTo;
     unsigned int nIn;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    SignatureChecker(const CTransaction& txToIn, unsigned int nInIn) : txTo(txToIn), nIn(nInIn) {}
+    SignatureChecker(const CTransaction& txToIn, unsigned int nInIn, const PrecomputedTransactionData* txdataIn = NULL) : txTo(txToIn), nIn(nInIn), txdata(txdataIn) {}
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const;
 };
 
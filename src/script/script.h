@@ -196,28 +196,13 @@ public:
 
     explicit CScriptNum(const std::vector<unsigned char>& vch, bool fRequireMinimal)
     {
-        if (vch.size() > nMaxNumSize) {
-            throw scriptnum_error("script number overflow");
-        }
-        if (fRequireMinimal && vch.size() > 0) {
-            // Check that the number is encoded with the minimum possible
-            // number of bytes.
-            //
-            // If the most-significant-byte - excluding the sign bit - is zero
-            // then we're not minimal. Note how this test also rejects the
-            // negative-zero encoding, 0x80.
-            if ((vch.back() & 0x7f) == 0) {
-                // One exception: if there's more than one byte and the most
-                // significant bit of the second-most-significant-byte is set
-                // it would conflict with the sign bit. An example of this case
-                // is +-255, which encode to 0xff00 and 0xff80 respectively.
-                // (big-endian).
-                if (vch.size() <= 1 || (vch[vch.size() - 2] & 0x80) == 0) {
-                    throw scriptnum_error("non-minimally encoded script number");
-                }
-            }
-        }
-        m_value = set_vch(vch);
+        m_value = decode(vch.empty() ? NULL : &vch[0], vch.size(), fRequireMinimal);
+    }
+
+    //! As above, for the nSize bytes at pch
+    CScriptNum(const unsigned char* pch, size_t nSize, bool fRequireMinimal)
+    {
+        m_value = decode(pch, nSize, fRequireMinimal);
     }
 
     inline bool operator==(const int64_t& rhs) const    { return m_value == rhs; }
@@ -284,18 +269,32 @@ public:
         return serialize(m_value);
     }
 
+    //! Write the number to pch, which has room for MAX_SERIALIZED_SIZE bytes, and return how many it takes
+    unsigned int getvch(unsigned char* pch) const
+    {
+        return serialize(m_value, pch);
+    }
+
     static std::vector<unsigned char> serialize(const int64_t& value)
+    {
+        unsigned char vch[MAX_SERIALIZED_SIZE];
+        return std::vector<unsigned char>(vch, vch + serialize(value, vch));
+    }
+
+    static const unsigned int MAX_SERIALIZED_SIZE = 9;
+
+    static unsigned int serialize(const int64_t& value, unsigned char* result)
     {
         if(value == 0)
-            return std::vector<unsigned char>();
+            return 0;
 
-        std::vector<unsigned char> result;
+        unsigned int size = 0;
         const bool neg = value < 0;
         uint64_t absvalue = neg ? -value : value;
 
         while(absvalue)
         {
-            result.push_back(absvalue & 0xff);
+            result[size++] = absvalue & 0xff;
             absvalue >>= 8;
         }
 
@@ -309,32 +308,54 @@ public:
 //    0x80 to it, since it will be subtracted and interpreted as a negative when
 //    converting to an integral.
 
-        if (result.back() & 0x80)
-            result.push_back(neg ? 0x80 : 0);
+        if (result[size - 1] & 0x80)
+            result[size++] = neg ? 0x80 : 0;
         else if (neg)
-            result.back() |= 0x80;
+            result[size - 1] |= 0x80;
 
-        return result;
+        return size;
     }
 
     static const size_t nMaxNumSize = 4;
 
 private:
-    static int64_t set_vch(const std::vector<unsigned char>& vch)
+    static int64_t decode(const unsigned char* vch, size_t size, bool fRequireMinimal)
     {
-      if (vch.empty())
-          return 0;
+        if (size > nMaxNumSize) {
+            throw scriptnum_error("script number overflow");
+        }
+        if (fRequireMinimal && size > 0) {
+            // Check that the number is encoded with the minimum possible
+            // number of bytes.
+            //
+            // If the most-significant-byte - excluding the sign bit - is zero
+            // then we're not minimal. Note how this test also rejects the
+            // negative-zero encoding, 0x80.
+            if ((vch[size - 1] & 0x7f) == 0) {
+                // One exception: if there's more than one byte and the most
+                // significant bit of the second-most-significant-byte is set
+                // it would conflict with the sign bit. An example of this case
+                // is +-255, which encode to 0xff00 and 0xff80 respectively.
+                // (big-endian).
+                if (size <= 1 || (vch[size - 2] & 0x80) == 0) {
+                    throw scriptnum_error("non-minimally encoded script number");
+                }
+            }
+        }
 
-      int64_t result = 0;
-      for (size_t i = 0; i != vch.size(); ++i)
-          result |= static_cast<int64_t>(vch[i]) << 8*i;
+        if (size == 0)
+            return 0;
+
+        int64_t result = 0;
+        for (size_t i = 0; i != size; ++i)
+            result |= static_cast<int64_t>(vch[i]) << 8*i;
 
-      // If the input vector's most significant byte is 0x80, remove it from
-      // the result's msb and return a negative.
-      if (vch.back() & 0x80)
-          return -((int64_t)(result & ~(0x80ULL << (8 * (vch.size() - 1)))));
+        // If the input vector's most significant byte is 0x80, remove it from
+        // the result's msb and return a negative.
+        if (vch[size - 1] & 0x80)
+            return -((int64_t)(result & ~(0x80ULL << (8 * (size - 1)))));
 
-      return result;
+        return result;
     }
 
     int64_t m_value;
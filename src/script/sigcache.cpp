@@ -5,14 +5,13 @@
 
 #include "sigcache.h"
 
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
-
 namespace {
 
 /**
@@ -23,68 +22,87 @@ namespace {
 class CSignatureCache
 {
 private:
-     //! sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
-    boost::shared_mutex cs_sigcache;
+    //! Entries are SHA256(nonce || signature hash || public key || signature):
+    uint256 nonce;
+    CCuckooCache setValid;
 
 public:
+    CSignatureCache()
+    {
+        // The nonce keeps the slots an entry lands in unpredictable, so an
+        // attacker cannot craft signatures that collide in the cache.
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
+    {
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size());
+        if (!vchSig.empty())
+            hasher.Write(&vchSig[0], vchSig.size());
+        hasher.Finalize(entry.begin());
+    }
+
     bool
-    Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    Get(const uint256& entry, bool erase)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.Contains(entry, erase);
+    }
 
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
-        return false;
+    void Set(const uint256& entry)
+    {
+        setValid.Insert(entry);
     }
 
-    void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
+    uint32_t Setup(size_t nBytes)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize)
-        {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256 randomHash = GetRandHash();
-            std::vector<unsigned char> unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
-        }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        return setValid.Setup(nBytes);
+    }
+
+    CCuckooCacheStats GetStats() const
+    {
+        return setValid.GetStats();
     }
 };
 
+//! Sized by InitSignatureCache before any script verification thread starts
+CSignatureCache signatureCache;
+
+}
+
+void InitSignatureCache()
+{
+    int64_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE);
+    if (nMaxCacheSize < 0)
+        nMaxCacheSize = 0;
+    else if (nMaxCacheSize > MAX_MAX_SIG_CACHE_SIZE)
+        nMaxCacheSize = MAX_MAX_SIG_CACHE_SIZE;
+    size_t nBytes = (size_t)nMaxCacheSize << 20;
+    uint32_t nElems = signatureCache.Setup(nBytes);
+    LogPrintf("Using %u MiB out of %d requested for signature cache, able to store %u elements\n",
+              (unsigned int)(signatureCache.GetStats().nBytes >> 20), nMaxCacheSize, nElems);
+}
+
+CSignatureCacheStats GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
 }
 
 bool CachingSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    uint256 entry;
+    signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
 
-    if (signatureCache.Get(sighash, vchSig, pubkey))
+    // Entries checked during block validation (!store) will not be needed
+    // again, so they are erased to make room for new mempool transactions.
+    if (signatureCache.Get(entry, !store))
         return true;
 
     if (!SignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
 
     if (store)
-        signatureCache.Set(sighash, vchSig, pubkey);
+        signatureCache.Set(entry);
     return true;
 }
@@ -6,21 +6,34 @@
 #ifndef BITCOIN_SCRIPT_SIGCACHE_H
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
+#include "cuckoocache.h"
 #include "script/interpreter.h"
 
 #include <vector>
 
+/** Default for -maxsigcachesize, in MiB */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Maximum -maxsigcachesize, in MiB; larger values are likely entry counts, its unit until 0.10 */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 256;
+
 class CPubKey;
 
+typedef CCuckooCacheStats CSignatureCacheStats;
+
 class CachingSignatureChecker : public SignatureChecker
 {
 private:
     bool store;
 
 public:
-    CachingSignatureChecker(const CTransaction& txToIn, unsigned int nInIn, bool storeIn=true) : SignatureChecker(txToIn, nInIn), store(storeIn) {}
+    CachingSignatureChecker(const CTransaction& txToIn, unsigned int nInIn, bool storeIn=true, const PrecomputedTransactionData* txdataIn=NULL) : SignatureChecker(txToIn, nInIn, txdataIn), store(storeIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/** Size the signature cache according to -maxsigcachesize; call once at startup. */
+void InitSignatureCache();
+/** Hit, miss and eviction counters of the signature cache */
+CSignatureCacheStats GetSignatureCacheStats();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -10,6 +10,9 @@
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <assert.h>
+#include <string.h>
+
 #include <boost/foreach.hpp>
 
 using namespace std;
@@ -34,129 +37,173 @@ const char* GetTxnOutputType(txnouttype t)
     return NULL;
 }
 
+uint160 CScriptSpan::ToHash160() const
+{
+    assert(size == sizeof(uint160));
+    uint160 hash;
+    memcpy(hash.begin(), begin, sizeof(uint160));
+    return hash;
+}
+
+namespace {
+
 /**
- * Return public keys or hashes from scriptPubKey, for 'standard' transaction types.
+ * Read the next operation of script, like CScript::GetOp, but without
+ * copying: span is set to the pushed data, or left empty for operations
+ * that are not pushes.
  */
-bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet)
+bool GetOpSpan(const CScript& script, CScript::const_iterator& pc, opcodetype& opcodeRet, CScriptSpan& spanRet)
 {
-    // Templates
-    static multimap<txnouttype, CScript> mTemplates;
-    if (mTemplates.empty())
-    {
-        // Standard tx, sender provides pubkey, receiver adds signature
-        mTemplates.insert(make_pair(TX_PUBKEY, CScript() << OP_PUBKEY << OP_CHECKSIG));
+    CScript::const_iterator start = pc;
+    if (!script.GetOp(pc, opcodeRet))
+        return false;
+    unsigned int nHeader = 1;
+    if (opcodeRet == OP_PUSHDATA1)
+        nHeader = 2;
+    else if (opcodeRet == OP_PUSHDATA2)
+        nHeader = 3;
+    else if (opcodeRet == OP_PUSHDATA4)
+        nHeader = 5;
+    spanRet.begin = begin_ptr(script) + (start - script.begin()) + nHeader;
+    spanRet.size = opcodeRet <= OP_PUSHDATA4 ? (pc - start) - nHeader : 0;
+    return true;
+}
 
-        // Bitcoin address tx, sender provides hash of pubkey, receiver provides signature and pubkey
-        mTemplates.insert(make_pair(TX_PUBKEYHASH, CScript() << OP_DUP << OP_HASH160 << OP_PUBKEYHASH << OP_EQUALVERIFY << OP_CHECKSIG));
+bool IsPubKeySize(const CScriptSpan& span)
+{
+    return span.size >= 33 && span.size <= 65;
+}
 
-        // Sender provides N pubkeys, receivers provides M signatures
-        mTemplates.insert(make_pair(TX_MULTISIG, CScript() << OP_SMALLINTEGER << OP_PUBKEYS << OP_SMALLINTEGER << OP_CHECKMULTISIG));
+bool IsSmallInteger(opcodetype opcode)
+{
+    return opcode == OP_0 || (opcode >= OP_1 && opcode <= OP_16);
+}
 
-        // Empty, provably prunable, data-carrying output
-        if (GetBoolArg("-datacarrier", true))
-            mTemplates.insert(make_pair(TX_NULL_DATA, CScript() << OP_RETURN << OP_SMALLDATA));
-        mTemplates.insert(make_pair(TX_NULL_DATA, CScript() << OP_RETURN));
-    }
+} // anon namespace
+
+/**
+ * Recognise the standard transaction types and locate their public keys or
+ * hashes in scriptPubKey, without allocating.
+ *
+ * Pushes may use any encoding, and pushed public keys are only checked for
+ * their size (33 to 65 bytes), not their validity.
+ */
+bool MatchTemplate(const CScript& scriptPubKey, CTemplateMatch& matchRet)
+{
+    static const bool fAcceptDatacarrier = GetBoolArg("-datacarrier", true);
+
+    matchRet.type = TX_NONSTANDARD;
+    matchRet.nRequired = 0;
+    matchRet.nSpans = 0;
 
     // Shortcut for pay-to-script-hash, which are more constrained than the other types:
     // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
     if (scriptPubKey.IsPayToScriptHash())
     {
-        typeRet = TX_SCRIPTHASH;
-        vector<unsigned char> hashBytes(scriptPubKey.begin()+2, scriptPubKey.begin()+22);
-        vSolutionsRet.push_back(hashBytes);
+        matchRet.type = TX_SCRIPTHASH;
+        matchRet.spans[0].begin = begin_ptr(scriptPubKey) + 2;
+        matchRet.spans[0].size = 20;
+        matchRet.nSpans = 1;
         return true;
     }
 
-    // Scan templates
-    const CScript& script1 = scriptPubKey;
-    BOOST_FOREACH(const PAIRTYPE(txnouttype, CScript)& tplate, mTemplates)
-    {
-        const CScript& script2 = tplate.second;
-        vSolutionsRet.clear();
-
-        opcodetype opcode1, opcode2;
-        vector<unsigned char> vch1, vch2;
+    CScript::const_iterator pc = scriptPubKey.begin();
+    CScript::const_iterator pend = scriptPubKey.end();
+    opcodetype opcode;
+    CScriptSpan span;
+    if (!GetOpSpan(scriptPubKey, pc, opcode, span))
+        return false;
 
-        // Compare
-        CScript::const_iterator pc1 = script1.begin();
-        CScript::const_iterator pc2 = script2.begin();
-        while (true)
+    txnouttype type = TX_NONSTANDARD;
+    if (IsPubKeySize(span))
+    {
+        // Standard tx, sender provides pubkey, receiver adds signature:
+        // <pubkey> OP_CHECKSIG
+        matchRet.spans[matchRet.nSpans++] = span;
+        if (GetOpSpan(scriptPubKey, pc, opcode, span) && opcode == OP_CHECKSIG)
+            type = TX_PUBKEY;
+    }
+    else if (opcode == OP_DUP)
+    {
+        // Bitcoin address tx, sender provides hash of pubkey, receiver provides signature and pubkey:
+        // OP_DUP OP_HASH160 <pubkey hash> OP_EQUALVERIFY OP_CHECKSIG
+        if (GetOpSpan(scriptPubKey, pc, opcode, span) && opcode == OP_HASH160 &&
+            GetOpSpan(scriptPubKey, pc, opcode, span) && span.size == sizeof(uint160))
         {
-            if (pc1 == script1.end() && pc2 == script2.end())
+            matchRet.spans[matchRet.nSpans++] = span;
+            if (GetOpSpan(scriptPubKey, pc, opcode, span) && opcode == OP_EQUALVERIFY &&
+                GetOpSpan(scriptPubKey, pc, opcode, span) && opcode == OP_CHECKSIG)
+                type = TX_PUBKEYHASH;
+        }
+    }
+    else if (IsSmallInteger(opcode))
+    {
+        // Sender provides N pubkeys, receivers provides M signatures:
+        // OP_m <pubkey>... OP_n OP_CHECKMULTISIG
+        unsigned int m = CScript::DecodeOP_N(opcode);
+        bool fOk = GetOpSpan(scriptPubKey, pc, opcode, span);
+        while (fOk && IsPubKeySize(span))
+        {
+            if (matchRet.nSpans == CTemplateMatch::MAX_SPANS)
             {
-                // Found a match
-                typeRet = tplate.first;
-                if (typeRet == TX_MULTISIG)
-                {
-                    // Additional checks for TX_MULTISIG:
-                    unsigned char m = vSolutionsRet.front()[0];
-                    unsigned char n = vSolutionsRet.back()[0];
-                    if (m < 1 || n < 1 || m > n || vSolutionsRet.size()-2 != n)
-                        return false;
-                }
-                return true;
-            }
-            if (!script1.GetOp(pc1, opcode1, vch1))
-                break;
-            if (!script2.GetOp(pc2, opcode2, vch2))
+                // More keys than OP_16 can count
+                fOk = false;
                 break;
-
-            // Template matching opcodes:
-            if (opcode2 == OP_PUBKEYS)
-            {
-                while (vch1.size() >= 33 && vch1.size() <= 65)
-                {
-                    vSolutionsRet.push_back(vch1);
-                    if (!script1.GetOp(pc1, opcode1, vch1))
-                        break;
-                }
-                if (!script2.GetOp(pc2, opcode2, vch2))
-                    break;
-                // Normal situation is to fall through
-                // to other if/else statements
-            }
-
-            if (opcode2 == OP_PUBKEY)
-            {
-                if (vch1.size() < 33 || vch1.size() > 65)
-                    break;
-                vSolutionsRet.push_back(vch1);
-            }
-            else if (opcode2 == OP_PUBKEYHASH)
-            {
-                if (vch1.size() != sizeof(uint160))
-                    break;
-                vSolutionsRet.push_back(vch1);
-            }
-            else if (opcode2 == OP_SMALLINTEGER)
-            {   // Single-byte small integer pushed onto vSolutions
-                if (opcode1 == OP_0 ||
-                    (opcode1 >= OP_1 && opcode1 <= OP_16))
-                {
-                    char n = (char)CScript::DecodeOP_N(opcode1);
-                    vSolutionsRet.push_back(valtype(1, n));
-                }
-                else
-                    break;
-            }
-            else if (opcode2 == OP_SMALLDATA)
-            {
-                // small pushdata, <= nMaxDatacarrierBytes
-                if (vch1.size() > nMaxDatacarrierBytes)
-                    break;
             }
-            else if (opcode1 != opcode2 || vch1 != vch2)
+            matchRet.spans[matchRet.nSpans++] = span;
+            fOk = GetOpSpan(scriptPubKey, pc, opcode, span);
+        }
+        if (fOk && IsSmallInteger(opcode))
+        {
+            unsigned int n = CScript::DecodeOP_N(opcode);
+            if (GetOpSpan(scriptPubKey, pc, opcode, span) && opcode == OP_CHECKMULTISIG && pc == pend &&
+                m >= 1 && n >= 1 && m <= n && matchRet.nSpans == n)
             {
-                // Others must match exactly
-                break;
+                matchRet.nRequired = m;
+                type = TX_MULTISIG;
             }
         }
     }
+    else if (opcode == OP_RETURN)
+    {
+        // Empty, provably prunable, data-carrying output:
+        // OP_RETURN, optionally followed by a single small push if -datacarrier
+        if (pc == pend)
+            type = TX_NULL_DATA;
+        else if (fAcceptDatacarrier && GetOpSpan(scriptPubKey, pc, opcode, span) && span.size <= nMaxDatacarrierBytes)
+            type = TX_NULL_DATA;
+    }
+
+    if (type == TX_NONSTANDARD || pc != pend)
+    {
+        matchRet.nRequired = 0;
+        matchRet.nSpans = 0;
+        return false;
+    }
+    matchRet.type = type;
+    return true;
+}
 
+/**
+ * Return public keys or hashes from scriptPubKey, for 'standard' transaction types.
+ */
+bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, vector<vector<unsigned char> >& vSolutionsRet)
+{
     vSolutionsRet.clear();
-    typeRet = TX_NONSTANDARD;
-    return false;
+
+    CTemplateMatch match;
+    bool fMatch = MatchTemplate(scriptPubKey, match);
+    typeRet = match.type;
+    if (!fMatch)
+        return false;
+
+    if (typeRet == TX_MULTISIG)
+        vSolutionsRet.push_back(valtype(1, (unsigned char)match.nRequired));
+    for (unsigned int i = 0; i < match.nSpans; i++)
+        vSolutionsRet.push_back(match.spans[i].ToVector());
+    if (typeRet == TX_MULTISIG)
+        vSolutionsRet.push_back(valtype(1, (unsigned char)match.nSpans));
+    return true;
 }
 
 int ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned char> >& vSolutions)
@@ -180,20 +227,41 @@ int ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned c
     return -1;
 }
 
+int ScriptSigArgsExpected(const CTemplateMatch& match)
+{
+    switch (match.type)
+    {
+    case TX_NONSTANDARD:
+    case TX_NULL_DATA:
+        return -1;
+    case TX_PUBKEY:
+        return 1;
+    case TX_PUBKEYHASH:
+        return 2;
+    case TX_MULTISIG:
+        return match.nRequired + 1;
+    case TX_SCRIPTHASH:
+        return 1; // doesn't include args needed by the script
+    }
+    return -1;
+}
+
 bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType)
 {
-    vector<valtype> vSolutions;
-    if (!Solver(scriptPubKey, whichType, vSolutions))
+    CTemplateMatch match;
+    if (!MatchTemplate(scriptPubKey, match))
+    {
+        whichType = TX_NONSTANDARD;
         return false;
+    }
+    whichType = match.type;
 
     if (whichType == TX_MULTISIG)
     {
-        unsigned char m = vSolutions.front()[0];
-        unsigned char n = vSolutions.back()[0];
         // Support up to x-of-3 multisig txns as standard
-        if (n < 1 || n > 3)
+        if (match.nSpans < 1 || match.nSpans > 3)
             return false;
-        if (m < 1 || m > n)
+        if (match.nRequired < 1 || match.nRequired > match.nSpans)
             return false;
     }
 
@@ -202,28 +270,27 @@ bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType)
 
 bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet)
 {
-    vector<valtype> vSolutions;
-    txnouttype whichType;
-    if (!Solver(scriptPubKey, whichType, vSolutions))
+    CTemplateMatch match;
+    if (!MatchTemplate(scriptPubKey, match))
         return false;
 
-    if (whichType == TX_PUBKEY)
+    if (match.type == TX_PUBKEY)
     {
-        CPubKey pubKey(vSolutions[0]);
+        CPubKey pubKey(match.spans[0].begin, match.spans[0].begin + match.spans[0].size);
         if (!pubKey.IsValid())
             return false;
 
         addressRet = pubKey.GetID();
         return true;
     }
-    else if (whichType == TX_PUBKEYHASH)
+    else if (match.type == TX_PUBKEYHASH)
     {
-        addressRet = CKeyID(uint160(vSolutions[0]));
+        addressRet = CKeyID(match.spans[0].ToHash160());
         return true;
     }
-    else if (whichType == TX_SCRIPTHASH)
+    else if (match.type == TX_SCRIPTHASH)
     {
-        addressRet = CScriptID(uint160(vSolutions[0]));
+        addressRet = CScriptID(match.spans[0].ToHash160());
         return true;
     }
     // Multisig txns have more than one address...
@@ -234,9 +301,10 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, vecto
 {
     addressRet.clear();
     typeRet = TX_NONSTANDARD;
-    vector<valtype> vSolutions;
-    if (!Solver(scriptPubKey, typeRet, vSolutions))
+    CTemplateMatch match;
+    if (!MatchTemplate(scriptPubKey, match))
         return false;
+    typeRet = match.type;
     if (typeRet == TX_NULL_DATA){
         // This is data, not addresses
         return false;
@@ -244,10 +312,10 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, vecto
 
     if (typeRet == TX_MULTISIG)
     {
-        nRequiredRet = vSolutions.front()[0];
-        for (unsigned int i = 1; i < vSolutions.size()-1; i++)
+        nRequiredRet = match.nRequired;
+        for (unsigned int i = 0; i < match.nSpans; i++)
         {
-            CPubKey pubKey(vSolutions[i]);
+            CPubKey pubKey(match.spans[i].begin, match.spans[i].begin + match.spans[i].size);
             if (!pubKey.IsValid())
                 continue;
 
@@ -12,6 +12,7 @@
 #include <boost/variant.hpp>
 
 #include <stdint.h>
+#include <vector>
 
 class CKeyID;
 class CScript;
@@ -79,10 +80,38 @@ public:
  */
 typedef boost::variant<CNoDestination, CKeyID, CScriptID> CTxDestination;
 
+/** A run of bytes inside a script, such as a pushed public key or hash. */
+struct CScriptSpan
+{
+    const unsigned char* begin;
+    unsigned int size;
+
+    std::vector<unsigned char> ToVector() const { return std::vector<unsigned char>(begin, begin + size); }
+    uint160 ToHash160() const;
+};
+
+/**
+ * A scriptPubKey recognised by MatchTemplate. The spans point into the
+ * matched script, and are only valid as long as it is not modified.
+ */
+struct CTemplateMatch
+{
+    static const unsigned int MAX_SPANS = 16;
+
+    txnouttype type;
+    //! Number of signatures required (TX_MULTISIG only)
+    unsigned int nRequired;
+    //! Public keys for TX_PUBKEY and TX_MULTISIG, or the hash for TX_PUBKEYHASH and TX_SCRIPTHASH
+    unsigned int nSpans;
+    CScriptSpan spans[MAX_SPANS];
+};
+
 const char* GetTxnOutputType(txnouttype t);
 
+bool MatchTemplate(const CScript& scriptPubKey, CTemplateMatch& matchRet);
 bool Solver(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<std::vector<unsigned char> >& vSolutionsRet);
 int ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned char> >& vSolutions);
+int ScriptSigArgsExpected(const CTemplateMatch& match);
 bool IsStandard(const CScript& scriptPubKey, txnouttype& whichType);
 bool ExtractDestination(const CScript& scriptPubKey, CTxDestination& addressRet);
 bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet, std::vector<CTxDestination>& addressRet, int& nRequiredRet);
@@ -0,0 +1,339 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "socketpoll.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/atomic.hpp>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
+#ifndef WIN32
+#include <fcntl.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+/**
+ * Self-pipe used to interrupt a blocking wait. Writes are coalesced: only
+ * the first Interrupt() after a Wait() touches the pipe.
+ */
+class CWakeupPipe
+{
+private:
+    int fds[2];
+    boost::atomic<bool> fPending;
+
+public:
+    CWakeupPipe() : fPending(false)
+    {
+        fds[0] = fds[1] = -1;
+#ifndef WIN32
+        if (pipe(fds) != 0) {
+            LogPrintf("CWakeupPipe: pipe failed: %s\n", strerror(errno));
+            fds[0] = fds[1] = -1;
+            return;
+        }
+        for (int i = 0; i < 2; i++) {
+            fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL, 0) | O_NONBLOCK);
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        }
+#endif
+    }
+
+    ~CWakeupPipe()
+    {
+#ifndef WIN32
+        for (int i = 0; i < 2; i++)
+            if (fds[i] != -1)
+                close(fds[i]);
+#endif
+    }
+
+    /** Descriptor that becomes readable on Signal(), or -1 if unavailable. */
+    int GetReadFd() const { return fds[0]; }
+
+    void Signal()
+    {
+#ifndef WIN32
+        if (fds[1] == -1 || fPending.exchange(true))
+            return;
+        char c = 0;
+        if (write(fds[1], &c, 1) < 0 && errno != EAGAIN)
+            LogPrintf("CWakeupPipe: write failed: %s\n", strerror(errno));
+#endif
+    }
+
+    void Drain()
+    {
+#ifndef WIN32
+        if (fds[0] == -1)
+            return;
+        fPending.store(false);
+        char buf[64];
+        while (read(fds[0], buf, sizeof(buf)) > 0) {}
+#endif
+    }
+};
+
+/** Level-triggered poller on top of select(); limited to FD_SETSIZE descriptors. */
+class CSelectPoller : public CSocketPoller
+{
+private:
+    struct Watched
+    {
+        SOCKET hSocket;
+        int nEvents;
+        void* pContext;
+    };
+
+    std::vector<Watched> vWatched;
+    CWakeupPipe wakeup;
+
+public:
+    const char* GetName() const { return "select"; }
+    bool IsLimitedBySetSize() const { return true; }
+    bool IsEdgeTriggered() const { return false; }
+
+    void Watch(SOCKET hSocket, int nEventsOld, int nEvents, void* pContext)
+    {
+        // FD_SET on a descriptor beyond the set is undefined behaviour;
+        // callers refuse such sockets up front
+        if (!IsSelectableSocket(hSocket)) {
+            LogPrintf("CSelectPoller: cannot wait for socket %d beyond FD_SETSIZE\n", hSocket);
+            return;
+        }
+        Watched watched;
+        watched.hSocket = hSocket;
+        watched.nEvents = nEvents;
+        watched.pContext = pContext;
+        vWatched.push_back(watched);
+    }
+
+    void Unwatch(SOCKET hSocket)
+    {
+        // Sockets are only watched for the round they were declared in
+    }
+
+    bool Wait(int nTimeoutMs, std::vector<Event>& vEvents)
+    {
+        vEvents.clear();
+
+        struct timeval timeout;
+        timeout.tv_sec  = nTimeoutMs / 1000;
+        timeout.tv_usec = (nTimeoutMs % 1000) * 1000;
+
+        fd_set fdsetRecv;
+        fd_set fdsetSend;
+        fd_set fdsetError;
+        FD_ZERO(&fdsetRecv);
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        SOCKET hSocketMax = 0;
+        bool have_fds = false;
+
+        for (size_t i = 0; i < vWatched.size(); i++) {
+            const Watched& ev = vWatched[i];
+            if (ev.nEvents & POLL_RECV)
+                FD_SET(ev.hSocket, &fdsetRecv);
+            if (ev.nEvents & POLL_SEND)
+                FD_SET(ev.hSocket, &fdsetSend);
+            FD_SET(ev.hSocket, &fdsetError);
+            hSocketMax = max(hSocketMax, ev.hSocket);
+            have_fds = true;
+        }
+
+        int hWakeup = wakeup.GetReadFd();
+        if (hWakeup != -1 && IsSelectableSocket(hWakeup)) {
+            FD_SET(hWakeup, &fdsetRecv);
+            hSocketMax = max(hSocketMax, (SOCKET)hWakeup);
+            have_fds = true;
+        }
+
+        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        if (nSelect == SOCKET_ERROR) {
+            if (!have_fds)
+                MilliSleep(nTimeoutMs);
+            vWatched.clear();
+            return !have_fds;
+        }
+
+        if (hWakeup != -1 && IsSelectableSocket(hWakeup) && FD_ISSET(hWakeup, &fdsetRecv))
+            wakeup.Drain();
+
+        for (size_t i = 0; nSelect > 0 && i < vWatched.size(); i++) {
+            const Watched& watched = vWatched[i];
+            Event ev;
+            ev.pContext = watched.pContext;
+            ev.nEvents = 0;
+            if (FD_ISSET(watched.hSocket, &fdsetRecv))
+                ev.nEvents |= POLL_RECV;
+            if (FD_ISSET(watched.hSocket, &fdsetSend))
+                ev.nEvents |= POLL_SEND;
+            if (FD_ISSET(watched.hSocket, &fdsetError))
+                ev.nEvents |= POLL_ERR;
+            if (ev.nEvents)
+                vEvents.push_back(ev);
+        }
+        vWatched.clear();
+        return true;
+    }
+
+    void Interrupt()
+    {
+        wakeup.Signal();
+    }
+};
+
+#ifdef HAVE_SYS_EPOLL_H
+/**
+ * Edge-triggered poller on top of epoll. The interest list lives in the
+ * kernel, so a round only costs system calls for sockets whose interest
+ * changed, and the number of sockets is not bounded by FD_SETSIZE.
+ */
+class CEpollPoller : public CSocketPoller
+{
+private:
+    int hEpoll;
+    CWakeupPipe wakeup;
+    std::vector<struct epoll_event> vReady;
+
+    static uint32_t ToEpoll(int nEvents)
+    {
+        uint32_t events = EPOLLET;
+        if (nEvents & POLL_RECV)
+            events |= EPOLLIN;
+        if (nEvents & POLL_SEND)
+            events |= EPOLLOUT;
+        return events;
+    }
+
+public:
+    CEpollPoller() : vReady(256)
+    {
+        hEpoll = epoll_create(1);
+        if (hEpoll == -1) {
+            LogPrintf("CEpollPoller: epoll_create failed: %s\n", strerror(errno));
+            return;
+        }
+        fcntl(hEpoll, F_SETFD, FD_CLOEXEC);
+        if (wakeup.GetReadFd() != -1) {
+            // The wakeup pipe is level-triggered: it stays ready until drained.
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.ptr = &wakeup;
+            epoll_ctl(hEpoll, EPOLL_CTL_ADD, wakeup.GetReadFd(), &ev);
+        }
+    }
+
+    ~CEpollPoller()
+    {
+        if (hEpoll != -1)
+            close(hEpoll);
+    }
+
+    bool IsValid() const { return hEpoll != -1; }
+
+    const char* GetName() const { return "epoll"; }
+    bool IsLimitedBySetSize() const { return false; }
+    bool IsEdgeTriggered() const { return true; }
+
+    void Watch(SOCKET hSocket, int nEventsOld, int nEvents, void* pContext)
+    {
+        if (nEventsOld == nEvents)
+            return;
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = ToEpoll(nEvents);
+        ev.data.ptr = pContext;
+        // A descriptor number may be reused once closed, so the caller's
+        // view of what is registered can be stale in either direction.
+        int nOp = nEventsOld == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (epoll_ctl(hEpoll, nOp, hSocket, &ev) == 0)
+            return;
+        if (nOp == EPOLL_CTL_ADD && errno == EEXIST)
+            nOp = EPOLL_CTL_MOD;
+        else if (nOp == EPOLL_CTL_MOD && errno == ENOENT)
+            nOp = EPOLL_CTL_ADD;
+        else
+            nOp = -1;
+        if (nOp == -1 || epoll_ctl(hEpoll, nOp, hSocket, &ev) != 0)
+            LogPrint("net", "CEpollPoller: epoll_ctl(%d) failed: %s\n", hSocket, strerror(errno));
+    }
+
+    void Unwatch(SOCKET hSocket)
+    {
+        // Closing the descriptor is not enough: the open file it refers to
+        // stays registered, and reported with the old context, for as long
+        // as a copy of it survives, such as one inherited by a child process.
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        if (epoll_ctl(hEpoll, EPOLL_CTL_DEL, hSocket, &ev) != 0 && errno != ENOENT)
+            LogPrint("net", "CEpollPoller: epoll_ctl(%d) failed: %s\n", hSocket, strerror(errno));
+    }
+
+    bool Wait(int nTimeoutMs, std::vector<Event>& vEvents)
+    {
+        vEvents.clear();
+        int nReady = epoll_wait(hEpoll, &vReady[0], vReady.size(), nTimeoutMs);
+        if (nReady < 0)
+            return errno == EINTR;
+
+        for (int i = 0; i < nReady; i++) {
+            const struct epoll_event& ready = vReady[i];
+            if (ready.data.ptr == &wakeup) {
+                wakeup.Drain();
+                continue;
+            }
+            Event ev;
+            ev.pContext = ready.data.ptr;
+            ev.nEvents = 0;
+            if (ready.events & EPOLLIN)
+                ev.nEvents |= POLL_RECV;
+            if (ready.events & EPOLLOUT)
+                ev.nEvents |= POLL_SEND;
+            if (ready.events & (EPOLLERR | EPOLLHUP))
+                ev.nEvents |= POLL_ERR;
+            vEvents.push_back(ev);
+        }
+        // Grow the buffer when it was filled, so that a busy round does not
+        // need several waits to drain.
+        if ((size_t)nReady == vReady.size())
+            vReady.resize(vReady.size() * 2);
+        return true;
+    }
+
+    void Interrupt()
+    {
+        wakeup.Signal();
+    }
+};
+#endif
+
+} // anon namespace
+
+CSocketPoller* CreateSocketPoller(const std::string& strName)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (strName == "epoll") {
+        CEpollPoller* pPoller = new CEpollPoller();
+        if (pPoller->IsValid())
+            return pPoller;
+        delete pPoller;
+        return NULL;
+    }
+#endif
+    if (strName == "select")
+        return new CSelectPoller();
+    return NULL;
+}
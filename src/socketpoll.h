@@ -0,0 +1,87 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SOCKETPOLL_H
+#define BITCOIN_SOCKETPOLL_H
+
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
+#include "compat.h"
+
+#include <string>
+#include <vector>
+
+#if defined(HAVE_SYS_EPOLL_H)
+static const char* const DEFAULT_SOCKET_POLLER = "epoll";
+#else
+static const char* const DEFAULT_SOCKET_POLLER = "select";
+#endif
+
+/**
+ * Waits for sockets to become ready, on behalf of the socket handler thread.
+ *
+ * Level-triggered backends report a socket for as long as it is ready, and
+ * the caller declares its interest in every open socket before each Wait().
+ *
+ * Edge-triggered backends only report a socket when it becomes ready, and
+ * keep the interest list between rounds. The caller watches each socket
+ * once, with everything it may want to wait for, and decides when handling
+ * a report whether to act on it. It must remember what was reported and
+ * keep reading or writing until the operation would block. A socket must
+ * be unwatched before it is closed: another process may share it, and the
+ * kernel keeps reporting it for as long as anyone has it open.
+ *
+ * Either way, Watch() is passed the interest declared the previous time
+ * (0 for a socket not seen before), and a context that comes back with
+ * the socket's events.
+ */
+class CSocketPoller
+{
+public:
+    enum
+    {
+        POLL_RECV = (1 << 0),
+        POLL_SEND = (1 << 1),
+        POLL_ERR  = (1 << 2), //!< error or hang-up; always reported, but callers include it in
+                              //!< every interest so that 0 only ever means "not watched yet"
+    };
+
+    struct Event
+    {
+        void* pContext; //!< as passed to Watch()
+        int nEvents;
+    };
+
+    virtual ~CSocketPoller() {}
+
+    virtual const char* GetName() const = 0;
+
+    /** Whether the number of sockets is bounded by FD_SETSIZE */
+    virtual bool IsLimitedBySetSize() const = 0;
+
+    /** Whether sockets are only reported when they become ready (see above) */
+    virtual bool IsEdgeTriggered() const = 0;
+
+    /** Declare interest in socket; nEventsOld is what was declared last time. */
+    virtual void Watch(SOCKET hSocket, int nEventsOld, int nEvents, void* pContext) = 0;
+
+    /** Stop watching socket, before closing it. Thread safe. */
+    virtual void Unwatch(SOCKET hSocket) = 0;
+
+    /**
+     * Wait for up to nTimeoutMs milliseconds, or until Interrupt() is called,
+     * and return the ready sockets in vEvents. Returns false on error.
+     */
+    virtual bool Wait(int nTimeoutMs, std::vector<Event>& vEvents) = 0;
+
+    /** Make a concurrent or the next Wait() return early. Thread safe. */
+    virtual void Interrupt() = 0;
+};
+
+/** Create a poller by name ("epoll" or "select"); returns NULL if it is not available. */
+CSocketPoller* CreateSocketPoller(const std::string& strName);
+
+#endif // BITCOIN_SOCKETPOLL_H
@@ -0,0 +1,71 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SPENTINDEX_H
+#define BITCOIN_SPENTINDEX_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <utility>
+
+/** -spentindex default */
+static const bool DEFAULT_SPENTINDEX = false;
+
+/** An output of a transaction in the active chain */
+struct CSpentIndexKey
+{
+    uint256 txid;
+    unsigned int outputIndex;
+
+    CSpentIndexKey() : outputIndex(0) {}
+    CSpentIndexKey(const uint256& txidIn, unsigned int outputIndexIn) : txid(txidIn), outputIndex(outputIndexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(txid);
+        READWRITE(outputIndex);
+    }
+};
+
+/**
+ * The input that spent an output, with what it was worth: the amount paid
+ * to the output and the interest it had accrued by the spending block.
+ */
+struct CSpentIndexValue
+{
+    uint256 txid;
+    unsigned int inputIndex;
+    int blockHeight;
+    CAmount satoshis;
+    CAmount interest;
+    unsigned char addressType; //!< As in the address index, or 0 if the output paid to no address
+    uint160 addressHash;
+
+    CSpentIndexValue() : inputIndex(0), blockHeight(0), satoshis(0), interest(0), addressType(0) {}
+    CSpentIndexValue(const uint256& txidIn, unsigned int inputIndexIn, int blockHeightIn, CAmount satoshisIn,
+                     CAmount interestIn, unsigned char addressTypeIn, const uint160& addressHashIn) :
+        txid(txidIn), inputIndex(inputIndexIn), blockHeight(blockHeightIn), satoshis(satoshisIn),
+        interest(interestIn), addressType(addressTypeIn), addressHash(addressHashIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(txid);
+        READWRITE(inputIndex);
+        READWRITE(blockHeight);
+        READWRITE(satoshis);
+        READWRITE(interest);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+};
+
+typedef std::pair<CSpentIndexKey, CSpentIndexValue> CSpentIndexEntry;
+
+#endif // BITCOIN_SPENTINDEX_H
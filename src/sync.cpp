@@ -12,6 +12,34 @@
 #include <boost/foreach.hpp>
 #include <boost/thread.hpp>
 
+/** The innermost counter of each thread; counters live on the stack, so are not freed here */
+static void LeaveLockWaitCounter(CLockWaitCounter*) {}
+static boost::thread_specific_ptr<CLockWaitCounter> plockwaitcounter(LeaveLockWaitCounter);
+
+CLockWaitCounter::CLockWaitCounter() : nMicros(0), pprev(plockwaitcounter.get())
+{
+    plockwaitcounter.reset(this);
+}
+
+CLockWaitCounter::~CLockWaitCounter()
+{
+    plockwaitcounter.reset(pprev);
+    if (pprev)
+        pprev->nMicros += nMicros;
+}
+
+bool CLockWaitCounter::IsCounting()
+{
+    return plockwaitcounter.get() != NULL;
+}
+
+void CLockWaitCounter::AddWait(int64_t nWaitMicros)
+{
+    CLockWaitCounter* pcounter = plockwaitcounter.get();
+    if (pcounter)
+        pcounter->nMicros += nWaitMicros;
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
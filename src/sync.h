@@ -7,6 +7,9 @@
 #define BITCOIN_SYNC_H
 
 #include "threadsafety.h"
+#include "utiltime.h"
+
+#include <stdint.h>
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
@@ -104,6 +107,33 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/**
+ * Counts, while it exists, the time the thread that made it spends waiting
+ * for locks held by other threads. Counters nest: when an inner one goes,
+ * what it counted is added to the outer one.
+ */
+class CLockWaitCounter
+{
+public:
+    CLockWaitCounter();
+    ~CLockWaitCounter();
+
+    /** Microseconds waited so far */
+    int64_t GetMicros() const { return nMicros; }
+
+    /** Whether the current thread has a counter */
+    static bool IsCounting();
+    /** Count a wait of the current thread */
+    static void AddWait(int64_t nWaitMicros);
+
+private:
+    int64_t nMicros;
+    CLockWaitCounter* pprev;
+
+    CLockWaitCounter(const CLockWaitCounter&);
+    void operator=(const CLockWaitCounter&);
+};
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex>
 class CMutexLock
@@ -114,14 +144,15 @@ private:
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            int64_t nWaitStart = CLockWaitCounter::IsCounting() ? GetTimeMicros() : 0;
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            if (nWaitStart)
+                CLockWaitCounter::AddWait(GetTimeMicros() - nWaitStart);
         }
-#endif
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
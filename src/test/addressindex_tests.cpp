@@ -0,0 +1,157 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+#include "key.h"
+#include "pubkey.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "txdb.h"
+#include "utilstrencodings.h"
+#include "version.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+// The keys as the block tree database stores them, prefix included
+template<typename T>
+static string DBKey(const T& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << make_pair('a', key);
+    return ss.str();
+}
+
+static CAddressIndexKey IndexKey(unsigned char type, const uint160& hashBytes, int nHeight, unsigned int nTx, unsigned int n = 0, bool fSpending = false)
+{
+    return CAddressIndexKey(type, hashBytes, nHeight, nTx, uint256(nHeight * 1000 + nTx), n, fSpending);
+}
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_AUTO_TEST_CASE(addressindex_key_serialization)
+{
+    CAddressIndexKey key = IndexKey(ADDRESSINDEX_SCRIPTHASH, uint160(7), 0x01020304, 0x0a0b0c0d, 3, true);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    BOOST_CHECK_EQUAL(ss.size(), key.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+    // Height and position in the block big endian, after type and address
+    BOOST_CHECK_EQUAL(HexStr(ss.begin() + 21, ss.begin() + 29), "010203040a0b0c0d");
+
+    CAddressIndexKey key2;
+    ss >> key2;
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK_EQUAL(key2.type, key.type);
+    BOOST_CHECK(key2.hashBytes == key.hashBytes);
+    BOOST_CHECK_EQUAL(key2.blockHeight, key.blockHeight);
+    BOOST_CHECK_EQUAL(key2.txindex, key.txindex);
+    BOOST_CHECK(key2.txhash == key.txhash);
+    BOOST_CHECK_EQUAL(key2.index, key.index);
+    BOOST_CHECK_EQUAL(key2.spending, key.spending);
+
+    CAddressIndexIteratorKey start(ADDRESSINDEX_SCRIPTHASH, uint160(7));
+    CAddressIndexIteratorKey startHeight(ADDRESSINDEX_SCRIPTHASH, uint160(7), 0x01020304);
+    BOOST_CHECK_EQUAL(DBKey(start).size(), 1 + start.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK_EQUAL(DBKey(startHeight).size(), 1 + startHeight.GetSerializeSize(SER_DISK, CLIENT_VERSION));
+    // The iterator keys are prefixes of the keys they start at
+    BOOST_CHECK_EQUAL(DBKey(key).compare(0, DBKey(start).size(), DBKey(start)), 0);
+    BOOST_CHECK_EQUAL(DBKey(key).compare(0, DBKey(startHeight).size(), DBKey(startHeight)), 0);
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    const uint160 hash(1000);
+
+    // Heights and positions across byte boundaries sort numerically
+    int heights[] = {0, 1, 255, 256, 65535, 65536, 0x01000000};
+    for (unsigned int i = 1; i < ARRAYLEN(heights); i++) {
+        BOOST_CHECK(DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, heights[i - 1], 0)) < DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, heights[i], 0)));
+        BOOST_CHECK(DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, 10, heights[i - 1])) < DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, 10, heights[i])));
+        // Height comes before the position in the block
+        BOOST_CHECK(DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, heights[i - 1], 0xffffffff)) < DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, heights[i], 0)));
+    }
+
+    // An address's entries are together, whatever their heights
+    BOOST_CHECK(DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, uint160(1), 0x7fffffff, 0)) < DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, uint160(2), 0, 0)));
+    BOOST_CHECK(DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, 0x7fffffff, 0)) < DBKey(IndexKey(ADDRESSINDEX_SCRIPTHASH, hash, 0, 0)));
+
+    // Starting from a height skips exactly the entries below it
+    CAddressIndexIteratorKey start(ADDRESSINDEX_PUBKEYHASH, hash, 256);
+    BOOST_CHECK(DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, 255, 0xffffffff, 0xffffffff, true)) < DBKey(start));
+    BOOST_CHECK(DBKey(start) < DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, 256, 0)));
+    BOOST_CHECK(DBKey(CAddressIndexIteratorKey(ADDRESSINDEX_PUBKEYHASH, hash)) < DBKey(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, 0, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_read_range)
+{
+    CBlockTreeDB db(1 << 20, true);
+    const uint160 hash(1000);
+
+    // Written out of order, around the entries of neighbouring addresses
+    int heights[] = {65536, 1, 256, 255, 300, 256, 65535};
+    vector<CAddressIndexEntry> vDeltas;
+    for (unsigned int i = 0; i < ARRAYLEN(heights); i++)
+        vDeltas.push_back(make_pair(IndexKey(ADDRESSINDEX_PUBKEYHASH, hash, heights[i], i), (CAmount)heights[i]));
+    vDeltas.push_back(make_pair(IndexKey(ADDRESSINDEX_PUBKEYHASH, uint160(999), 300, 0), 1));
+    vDeltas.push_back(make_pair(IndexKey(ADDRESSINDEX_PUBKEYHASH, uint160(1001), 1, 0), 1));
+    vDeltas.push_back(make_pair(IndexKey(ADDRESSINDEX_SCRIPTHASH, hash, 1, 0), 1));
+    BOOST_CHECK(db.UpdateAddressIndex(vDeltas, vector<CAddressUnspentEntry>(), vector<CAddressUnspentEntry>()));
+
+    vector<CAddressIndexEntry> vEntries;
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESSINDEX_PUBKEYHASH, hash, vEntries));
+    BOOST_CHECK_EQUAL(vEntries.size(), ARRAYLEN(heights));
+    int expected[] = {1, 255, 256, 256, 300, 65535, 65536};
+    unsigned int expectedTx[] = {1, 3, 2, 5, 4, 6, 0};
+    for (unsigned int i = 0; i < vEntries.size(); i++) {
+        BOOST_CHECK_EQUAL(vEntries[i].first.blockHeight, expected[i]);
+        BOOST_CHECK_EQUAL(vEntries[i].first.txindex, expectedTx[i]);
+        BOOST_CHECK_EQUAL(vEntries[i].second, expected[i]);
+    }
+
+    // Start and end heights are both included
+    vEntries.clear();
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESSINDEX_PUBKEYHASH, hash, vEntries, 256, 65535));
+    BOOST_CHECK_EQUAL(vEntries.size(), 4U);
+    BOOST_CHECK_EQUAL(vEntries.front().first.blockHeight, 256);
+    BOOST_CHECK_EQUAL(vEntries.back().first.blockHeight, 65535);
+
+    // Disconnecting erases them again
+    BOOST_CHECK(db.EraseAddressIndex(vDeltas, vector<CAddressUnspentEntry>(), vector<CAddressUnspentEntry>()));
+    vEntries.clear();
+    BOOST_CHECK(db.ReadAddressIndex(ADDRESSINDEX_PUBKEYHASH, hash, vEntries));
+    BOOST_CHECK(vEntries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_destination)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    unsigned char type;
+    uint160 hashBytes;
+
+    BOOST_CHECK(GetAddressIndexDestination(GetScriptForDestination(pubkey.GetID()), type, hashBytes));
+    BOOST_CHECK_EQUAL(type, ADDRESSINDEX_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == pubkey.GetID());
+
+    // Pay to pubkey is indexed under the key's hash
+    CScript p2pk = CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
+    BOOST_CHECK(GetAddressIndexDestination(p2pk, type, hashBytes));
+    BOOST_CHECK_EQUAL(type, ADDRESSINDEX_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == pubkey.GetID());
+
+    BOOST_CHECK(GetAddressIndexDestination(GetScriptForDestination(CScriptID(p2pk)), type, hashBytes));
+    BOOST_CHECK_EQUAL(type, ADDRESSINDEX_SCRIPTHASH);
+    BOOST_CHECK(hashBytes == CScriptID(p2pk));
+
+    BOOST_CHECK(!GetAddressIndexDestination(CScript() << OP_RETURN, type, hashBytes));
+    vector<CPubKey> keys(1, pubkey);
+    BOOST_CHECK(!GetAddressIndexDestination(GetScriptForMultisig(1, keys), type, hashBytes));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+// Copyright (c) 2026 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "main.h"
+#include "script/script.h"
+#include "streams.h"
+#include "utilstrencodings.h"
+#include "version.h"
+
+#include <ios>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included_elements.insert(element1);
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded_elements.insert(element2);
+    }
+
+    GCSFilter filter(GCSFilter::Params(0, 0, 10, 1 << 10), included_elements);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+    BOOST_FOREACH(const GCSFilter::Element& element, included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        GCSFilter::ElementSet query(excluded_elements);
+        query.insert(element);
+        BOOST_CHECK(filter.MatchAny(query));
+    }
+
+    // A filter decoded from the encoding behaves the same
+    GCSFilter filter2(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(filter2.GetN(), 100U);
+    BOOST_CHECK(filter2.GetEncoded() == filter.GetEncoded());
+    BOOST_FOREACH(const GCSFilter::Element& element, included_elements)
+        BOOST_CHECK(filter2.Match(element));
+
+    // The empty filter matches nothing
+    GCSFilter filter3(GCSFilter::Params(0, 0, 10, 1 << 10), GCSFilter::ElementSet());
+    BOOST_CHECK_EQUAL(filter3.GetN(), 0U);
+    BOOST_CHECK(filter3.GetEncoded() == vector<unsigned char>(1, 0));
+    BOOST_CHECK(!filter3.MatchAny(included_elements));
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_malformed_test)
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < 10; ++i)
+        elements.insert(GCSFilter::Element(8, i));
+    GCSFilter filter(GCSFilter::Params(1, 2, 19, 784931), elements);
+    const vector<unsigned char>& vEncoded = filter.GetEncoded();
+
+    // Nothing at all
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vector<unsigned char>()), ios_base::failure);
+
+    // Truncated
+    vector<unsigned char> vTruncated(vEncoded.begin(), vEncoded.end() - 1);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vTruncated), ios_base::failure);
+
+    // Trailing garbage
+    vector<unsigned char> vExtended(vEncoded);
+    vExtended.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vExtended), ios_base::failure);
+
+    // Claims more elements than it holds
+    vector<unsigned char> vCount(vEncoded);
+    vCount[0] = 11;
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), vCount), ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[4], excluded_scripts[3];
+
+    // First two are outputs on a single transaction.
+    included_scripts[0] << vector<unsigned char>(65, 0) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Third is an output on a second transaction.
+    included_scripts[2] << OP_1 << vector<unsigned char>(32, 2);
+
+    // Last is spent by this block.
+    included_scripts[3] << OP_HASH160 << vector<unsigned char>(20, 3) << OP_EQUAL;
+
+    // OP_RETURN and empty outputs are left out.
+    excluded_scripts[0] << OP_RETURN << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+    excluded_scripts[2] << OP_0 << vector<unsigned char>(20, 4);
+
+    CMutableTransaction tx_1;
+    tx_1.vout.resize(3);
+    tx_1.vout[0].scriptPubKey = included_scripts[0];
+    tx_1.vout[1].scriptPubKey = included_scripts[1];
+    tx_1.vout[2].scriptPubKey = excluded_scripts[1];
+
+    CMutableTransaction tx_2;
+    tx_2.vout.resize(2);
+    tx_2.vout[0].scriptPubKey = included_scripts[2];
+    tx_2.vout[1].scriptPubKey = excluded_scripts[0];
+
+    CBlock block;
+    block.vtx.push_back(tx_1);
+    block.vtx.push_back(tx_2);
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.resize(1);
+    block_undo.vtxundo[0].vprevout.push_back(CTxInUndo(CTxOut(500, included_scripts[3]), false, 1000, 1));
+
+    BlockFilter block_filter(BASIC_FILTER, block, block_undo);
+    BOOST_CHECK(block_filter.GetBlockHash() == block.GetHash());
+    const GCSFilter& filter = block_filter.GetFilter();
+    BOOST_CHECK_EQUAL(filter.GetN(), 4U);
+
+    for (int i = 0; i < 4; ++i)
+        BOOST_CHECK(filter.Match(GCSFilter::Element(included_scripts[i].begin(), included_scripts[i].end())));
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(excluded_scripts[0].begin(), excluded_scripts[0].end())));
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(excluded_scripts[2].begin(), excluded_scripts[2].end())));
+
+    // Serialization round trip
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    BlockFilter block_filter2;
+    stream >> block_filter2;
+    BOOST_CHECK_EQUAL(block_filter2.GetFilterType(), BASIC_FILTER);
+    BOOST_CHECK(block_filter2.GetBlockHash() == block_filter.GetBlockHash());
+    BOOST_CHECK(block_filter2.GetEncodedFilter() == block_filter.GetEncodedFilter());
+
+    // An unknown filter type does not deserialize
+    CDataStream stream2(SER_NETWORK, PROTOCOL_VERSION);
+    stream2 << block_filter;
+    stream2[0] = 1;
+    BOOST_CHECK_THROW(stream2 >> block_filter2, ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_bip158_vector_test)
+{
+    // Block 0 of testnet3, from the BIP 158 test vectors
+    uint256 hashBlock("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    vector<unsigned char> vScript = ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac");
+
+    GCSFilter::ElementSet elements;
+    elements.insert(vScript);
+    GCSFilter filter(GCSFilter::Params(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8), 19, 784931), elements);
+    BOOST_CHECK_EQUAL(HexStr(filter.GetEncoded()), "019dfca8");
+
+    BlockFilter block_filter(BASIC_FILTER, hashBlock, filter.GetEncoded());
+    BOOST_CHECK(block_filter.GetFilter().Match(vScript));
+    BOOST_CHECK_EQUAL(block_filter.ComputeHeader(0).GetHex(), "21584579b7eb08997773e5aeff3a7f932700042d0ed2a6129012b7d7ae81b750");
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_type_names)
+{
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BASIC_FILTER), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(INVALID_BLOCK_FILTER_TYPE), "");
+
+    BlockFilterType filter_type;
+    BOOST_CHECK(BlockFilterTypeByName("basic", filter_type));
+    BOOST_CHECK_EQUAL(filter_type, BASIC_FILTER);
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filter_type));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include "clientversion.h"
 #include "key.h"
 #include "merkleblock.h"
+#include "random.h"
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
@@ -459,4 +460,90 @@ BOOST_AUTO_TEST_CASE(merkle_block_4_test_update_none)
     BOOST_CHECK(!filter.contains(COutPoint(uint256("0x02981fa052f0481dbc5868f4fc2166035a10f27a03cfd2de67326471df5bc041"), 0)));
 }
 
+static std::vector<unsigned char> RandomData()
+{
+    uint256 r = GetRandHash();
+    return std::vector<unsigned char>(r.begin(), r.end());
+}
+
+BOOST_AUTO_TEST_CASE(bloom_contains_many)
+{
+    CBloomFilter filter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    vector<vector<unsigned char> > vKeys;
+    for (int i = 0; i < 10; i++) {
+        vKeys.push_back(RandomData());
+        if (i % 2 == 0)
+            filter.insert(vKeys.back());
+    }
+
+    vector<bool> vFound;
+    BOOST_CHECK(filter.containsMany(vKeys, vFound));
+    BOOST_CHECK_EQUAL(vFound.size(), vKeys.size());
+    for (unsigned int i = 0; i < vKeys.size(); i++) {
+        BOOST_CHECK_EQUAL(vFound[i], filter.contains(vKeys[i]));
+        BOOST_CHECK_EQUAL(vFound[i], i % 2 == 0);
+    }
+
+    vector<vector<unsigned char> > vMissing(1, RandomData());
+    BOOST_CHECK(!filter.containsMany(vMissing, vFound));
+    BOOST_CHECK(!vFound[0]);
+
+    // An empty filter matches nothing, a full one everything
+    CBloomFilter filterEmpty(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filterEmpty.clear();
+    BOOST_CHECK(!filterEmpty.containsMany(vKeys, vFound));
+    CBloomFilter filterFull;
+    BOOST_CHECK(filterFull.containsMany(vKeys, vFound));
+    BOOST_CHECK(vFound == vector<bool>(vKeys.size(), true));
+}
+
+BOOST_AUTO_TEST_CASE(rolling_bloom)
+{
+    // last-100-entry, 1% false positive:
+    CRollingBloomFilter rb1(100, 0.01);
+
+    // Overfill:
+    static const int DATASIZE = 399;
+    std::vector<unsigned char> data[DATASIZE];
+    for (int i = 0; i < DATASIZE; i++) {
+        data[i] = RandomData();
+        rb1.insert(data[i]);
+    }
+    // Last 100 guaranteed to be remembered:
+    for (int i = 299; i < DATASIZE; i++)
+        BOOST_CHECK(rb1.contains(data[i]));
+
+    // The false positive rate is 1%, so about 100 hits are expected when
+    // testing 10,000 random keys
+    unsigned int nHits = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (rb1.contains(RandomData()))
+            ++nHits;
+    }
+    BOOST_CHECK(nHits < 175);
+
+    // Entries older than three generations are forgotten
+    unsigned int nOldHits = 0;
+    for (int i = 0; i < 100; i++) {
+        if (rb1.contains(data[i]))
+            ++nOldHits;
+    }
+    BOOST_CHECK(nOldHits < 10);
+
+    // Hashes are found through either overload
+    uint256 hash = GetRandHash();
+    rb1.insert(hash);
+    BOOST_CHECK(rb1.contains(hash));
+    BOOST_CHECK(rb1.contains(std::vector<unsigned char>(hash.begin(), hash.end())));
+
+    rb1.reset();
+    nHits = 0;
+    for (int i = 299; i < DATASIZE; i++) {
+        if (rb1.contains(data[i]))
+            ++nHits;
+    }
+    BOOST_CHECK(nHits < 10);
+    BOOST_CHECK(!rb1.contains(hash));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "coins.h"
+#include "interest.h"
 #include "random.h"
 #include "uint256.h"
 
@@ -175,4 +176,48 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+BOOST_AUTO_TEST_CASE(coins_stats_incremental)
+{
+    // Outputs counted in any order, and some counted out again, give the
+    // same statistics as the remaining ones counted in once
+    std::vector<uint256> vTxid;
+    std::vector<CTxOut> vOut;
+    std::vector<int> vHeight;
+    for (int i = 0; i < 100; i++) {
+        vTxid.push_back(GetRandHash());
+        vOut.push_back(CTxOut(insecure_rand() % 10000000000LL, CScript() << OP_TRUE));
+        vHeight.push_back(1 + insecure_rand() % 500000);
+    }
+
+    CCoinsStats statsAll, statsSome;
+    for (int i = 0; i < 100; i++)
+        statsAll.AddOutput(vTxid[i], i % 3, vOut[i], vHeight[i], i % 7 == 0);
+    for (int i = 99; i >= 0; i--)
+        statsSome.AddOutput(vTxid[i], i % 3, vOut[i], vHeight[i], i % 7 == 0);
+    BOOST_CHECK(statsAll.GetHashSerialized() == statsSome.GetHashSerialized());
+    BOOST_CHECK_EQUAL(statsAll.nDiscountedAmount, statsSome.nDiscountedAmount);
+
+    CCoinsStats statsRest;
+    for (int i = 0; i < 100; i++) {
+        if (i % 2)
+            statsSome.RemoveOutput(vTxid[i], i % 3, vOut[i], vHeight[i], i % 7 == 0);
+        else
+            statsRest.AddOutput(vTxid[i], i % 3, vOut[i], vHeight[i], i % 7 == 0);
+    }
+    BOOST_CHECK(statsSome.GetHashSerialized() == statsRest.GetHashSerialized());
+    BOOST_CHECK(statsSome.GetHashSerialized() != statsAll.GetHashSerialized());
+    BOOST_CHECK_EQUAL(statsSome.nTransactionOutputs, 50U);
+    BOOST_CHECK_EQUAL(statsSome.nTotalAmount, statsRest.nTotalAmount);
+    BOOST_CHECK_EQUAL(statsSome.nDiscountedAmount, statsRest.nDiscountedAmount);
+
+    // The interest accrued by a height is that of each output, to within
+    // the rounding of each
+    statsRest.nHeight = 600000;
+    CAmount nInterest = 0;
+    for (int i = 0; i < 100; i += 2)
+        nInterest += ComputeInterest(statsRest.nHeight - vHeight[i], vOut[i]);
+    BOOST_CHECK(nInterest > 0);
+    BOOST_CHECK(llabs(statsRest.GetAccruedInterest() - nInterest) <= 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
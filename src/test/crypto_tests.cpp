@@ -2,6 +2,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/muhash.h"
 #include "crypto/rfc6979_hmac_sha256.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
@@ -10,7 +11,9 @@
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
 #include "random.h"
+#include "streams.h"
 #include "utilstrencodings.h"
+#include "version.h"
 
 #include <vector>
 
@@ -282,4 +285,48 @@ BOOST_AUTO_TEST_CASE(rfc6979_hmac_sha256)
             ("7597887cbd76321f32e30440679a22cf7f8d9d2eac390e581fea091ce202ba94"));
 }
 
+static std::string MuHashHex(const CMuHash3072& muhash)
+{
+    unsigned char hash[CMuHash3072::OUTPUT_SIZE];
+    muhash.Finalize(hash);
+    return HexStr(hash, hash + sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_testvectors)
+{
+    const unsigned char* abc = (const unsigned char*)"abc";
+    const unsigned char* digest = (const unsigned char*)"message digest";
+
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072()), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072().Insert(abc, 3)), "dd026e59b7cd56a8ba5c21c0acb5a1940b96712a41a49507d7cb55be6c8dbad5");
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072().Insert(digest, 14)), "397913e5f17a9e8e7cd5326a831b016f9b7ee2ffba197fc5fa33479b8f7d710f");
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072().Remove(abc, 3)), "207ae83aae4f907d3222a47e57e5ab18fd3cd918db87edbad6d5dc1b2520a267");
+
+    // Elements added and removed in any order
+    CMuHash3072 muhash;
+    muhash.Insert(abc, 3).Insert(digest, 14);
+    BOOST_CHECK_EQUAL(MuHashHex(muhash), "5102de7f015ca0946d00dcc2f1c237c0a8de95f53ce76a4b74080df02edf4b10");
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072().Insert(digest, 14).Insert(abc, 3)), MuHashHex(muhash));
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072(muhash).Remove(digest, 14)), MuHashHex(CMuHash3072().Insert(abc, 3)));
+    BOOST_CHECK_EQUAL(MuHashHex(CMuHash3072().Remove(digest, 14).Insert(digest, 14)), MuHashHex(CMuHash3072()));
+
+    // Kept with what was removed, and read back
+    muhash.Remove(abc, 3);
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << muhash;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    CMuHash3072 muhash2;
+    ss >> muhash2;
+    BOOST_CHECK_EQUAL(MuHashHex(muhash2), MuHashHex(CMuHash3072().Insert(digest, 14)));
+
+    // Numbers from the prime up are reduced: 2^3072 - 1 is 1103716
+    std::vector<unsigned char> vMax(Num3072::BYTE_SIZE, 0xff);
+    Num3072 num(&vMax[0]);
+    BOOST_CHECK_EQUAL(num.limbs[0], 1103716U);
+    for (int i = 1; i < Num3072::LIMBS; i++)
+        BOOST_CHECK_EQUAL(num.limbs[i], 0U);
+    num.Multiply(num.GetInverse());
+    BOOST_CHECK_EQUAL(num.limbs[0], 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+
+#include "random.h"
+#include "uint256.h"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_AUTO_TEST_SUITE(cuckoocache_tests)
+
+// An unsized cache never reports a hit
+BOOST_AUTO_TEST_CASE(cuckoocache_empty)
+{
+    CCuckooCache cache;
+    uint256 e = GetRandHash();
+    cache.Insert(e);
+    BOOST_CHECK(!cache.Contains(e, false));
+}
+
+// Everything inserted into a lightly loaded cache can be found again, and
+// nothing else is reported as present
+BOOST_AUTO_TEST_CASE(cuckoocache_insert_contains)
+{
+    CCuckooCache cache;
+    uint32_t nSlots = cache.Setup(1 << 20);
+    BOOST_CHECK(nSlots > 0);
+
+    std::vector<uint256> vInserted;
+    for (uint32_t i = 0; i < nSlots / 2; i++) {
+        vInserted.push_back(GetRandHash());
+        cache.Insert(vInserted.back());
+    }
+    for (size_t i = 0; i < vInserted.size(); i++)
+        BOOST_CHECK(cache.Contains(vInserted[i], false));
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(!cache.Contains(GetRandHash(), false));
+
+    // The all-zero digest marks empty slots and is never stored
+    cache.Insert(uint256(0));
+    BOOST_CHECK(!cache.Contains(uint256(0), false));
+
+    CCuckooCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nSlots, nSlots);
+    BOOST_CHECK_EQUAL(stats.nHits, vInserted.size());
+    BOOST_CHECK_EQUAL(stats.nEvictions, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_erase)
+{
+    CCuckooCache cache;
+    cache.Setup(1 << 16);
+    uint256 e = GetRandHash();
+    cache.Insert(e);
+    BOOST_CHECK(cache.Contains(e, true));
+    BOOST_CHECK(!cache.Contains(e, false));
+}
+
+// Overfilling the cache evicts older entries but keeps most recent ones
+BOOST_AUTO_TEST_CASE(cuckoocache_overfill)
+{
+    CCuckooCache cache;
+    uint32_t nSlots = cache.Setup(1 << 16);
+
+    std::vector<uint256> vInserted;
+    for (uint32_t i = 0; i < nSlots * 2; i++) {
+        vInserted.push_back(GetRandHash());
+        cache.Insert(vInserted.back());
+    }
+    size_t nFound = 0;
+    for (size_t i = vInserted.size() - nSlots / 4; i < vInserted.size(); i++)
+        nFound += cache.Contains(vInserted[i], false);
+    BOOST_CHECK(nFound > nSlots / 8);
+    BOOST_CHECK(cache.GetStats().nEvictions > 0);
+}
+
+static void InsertAndCheck(CCuckooCache* cache, const std::vector<uint256>* vElems, size_t nBegin, size_t nEnd, bool* fOk)
+{
+    for (size_t i = nBegin; i < nEnd; i++)
+        cache->Insert((*vElems)[i]);
+    for (size_t i = 0; i < vElems->size(); i++)
+        cache->Contains((*vElems)[i], false);
+    *fOk = true;
+}
+
+// Concurrent inserters and readers never see an element that was not inserted
+BOOST_AUTO_TEST_CASE(cuckoocache_concurrent)
+{
+    CCuckooCache cache;
+    uint32_t nSlots = cache.Setup(1 << 18);
+    const int nThreads = 4;
+
+    std::vector<uint256> vElems;
+    for (uint32_t i = 0; i < nSlots / 2; i++)
+        vElems.push_back(GetRandHash());
+
+    bool fOk[nThreads];
+    boost::thread_group threads;
+    size_t nChunk = vElems.size() / nThreads;
+    for (int i = 0; i < nThreads; i++) {
+        fOk[i] = false;
+        threads.create_thread(boost::bind(&InsertAndCheck, &cache, &vElems, i * nChunk, (i + 1) * nChunk, &fOk[i]));
+    }
+    threads.join_all();
+
+    for (int i = 0; i < nThreads; i++)
+        BOOST_CHECK(fOk[i]);
+    size_t nFound = 0;
+    for (size_t i = 0; i < vElems.size(); i++)
+        nFound += cache.Contains(vElems[i], false);
+    BOOST_CHECK(nFound > vElems.size() * 9 / 10);
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(!cache.Contains(GetRandHash(), false));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
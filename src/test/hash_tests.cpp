@@ -46,4 +46,68 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(murmurhash3_multi)
+{
+    // Every length around the word and inline buffer boundaries, under a
+    // batch of seeds that is not a multiple of four
+    static const unsigned int SEEDS = 11;
+    uint32_t nSeeds[SEEDS], nHashes[SEEDS];
+    for (unsigned int i = 0; i < SEEDS; i++)
+        nSeeds[i] = i * 0xFBA4C795 + 0x12345678;
+
+    CMurmurHash3Multi hasher;
+    vector<unsigned char> vData;
+    for (unsigned int nLen = 0; nLen < 200; nLen++) {
+        hasher.Set(vData);
+        hasher.Hash(nSeeds, nHashes, SEEDS);
+        for (unsigned int i = 0; i < SEEDS; i++) {
+            BOOST_CHECK_EQUAL(nHashes[i], MurmurHash3(nSeeds[i], vData));
+            BOOST_CHECK_EQUAL(hasher.Hash(nSeeds[i]), MurmurHash3(nSeeds[i], vData));
+        }
+        vData.push_back(nLen * 37 + 11);
+    }
+
+    // Back to short data after long
+    vData.resize(5);
+    hasher.Set(vData);
+    BOOST_CHECK_EQUAL(hasher.Hash(0), MurmurHash3(0, vData));
+    BOOST_CHECK_EQUAL(CMurmurHash3Multi(ParseHex("00112233")).Hash(0), 0xb4471bf8U);
+}
+
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    CSipHasher hasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x726fdb47dd0e0e31ull);
+    static const unsigned char t0[1] = {0};
+    hasher.Write(t0, 1);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x74f839c593dc67fdull);
+    static const unsigned char t1[7] = {1,2,3,4,5,6,7};
+    hasher.Write(t1, 7);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x93f5f5799a932462ull);
+    hasher.Write(0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x3f2acc7f57c29bdbull);
+    static const unsigned char t2[2] = {16,17};
+    hasher.Write(t2, 2);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x4bc1b3f0968dd39cull);
+    static const unsigned char t3[9] = {18,19,20,21,22,23,24,25,26};
+    hasher.Write(t3, 9);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x2f2e6163076bcfadull);
+    static const unsigned char t4[5] = {27,28,29,30,31};
+    hasher.Write(t4, 5);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x7127512f72f27cceull);
+    hasher.Write(0x2726252423222120ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x0e3ea96b5304a7d0ull);
+    hasher.Write(0x2F2E2D2C2B2A2928ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0xe612a3cb9ecba951ull);
+
+    // The specialized uint256 version matches writing the bytes
+    uint256 x;
+    for (unsigned int i = 0; i < 32; i++)
+        *(x.begin() + i) = i;
+    CSipHasher hasher2(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    hasher2.Write(x.begin(), 32);
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x), hasher2.Finalize());
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x), 0x7127512f72f27cceull);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
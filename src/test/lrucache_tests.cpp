@@ -0,0 +1,84 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lrucache.h"
+
+#include "random.h"
+
+#include <list>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+#define NUM_TESTS 16
+#define MAX_SIZE 100
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(lrucache_tests)
+
+BOOST_AUTO_TEST_CASE(lrucache_evicts_least_recently_used)
+{
+    lrucache<int, int> cache(3);
+    cache.insert(1, 10);
+    cache.insert(2, 20);
+    cache.insert(3, 30);
+    // Using 1 makes 2 the least recently used
+    BOOST_CHECK(cache.get(1) && *cache.get(1) == 10);
+    pair<int, int> evicted;
+    BOOST_CHECK(cache.insert(4, 40, &evicted));
+    BOOST_CHECK(evicted.first == 2 && evicted.second == 20);
+    BOOST_CHECK(cache.get(2) == NULL);
+    BOOST_CHECK_EQUAL(cache.size(), 3U);
+
+    // Replacing a value evicts nothing, and makes it the most recently used
+    BOOST_CHECK(!cache.insert(3, 31));
+    BOOST_CHECK(*cache.get(3) == 31);
+    BOOST_CHECK(cache.insert(5, 50, &evicted));
+    BOOST_CHECK_EQUAL(evicted.first, 1);
+
+    BOOST_CHECK(cache.erase(4));
+    BOOST_CHECK(!cache.erase(4));
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+    BOOST_CHECK_EQUAL(cache.begin()->first, 5);
+}
+
+// Compare with a reference model: a list of keys, most recently used first
+BOOST_AUTO_TEST_CASE(lrucache_like_model)
+{
+    for (int nTest = 0; nTest < NUM_TESTS; nTest++) {
+        lrucache<int, int> cache(MAX_SIZE);
+        list<int> model;
+        map<int, int> values;
+        for (int n = 0; n < 10000; n++) {
+            int k = insecure_rand() % (2 * MAX_SIZE);
+            if (insecure_rand() % 2) {
+                int v = insecure_rand();
+                cache.insert(k, v);
+                model.remove(k);
+                model.push_front(k);
+                values[k] = v;
+                if (model.size() > MAX_SIZE) {
+                    values.erase(model.back());
+                    model.pop_back();
+                }
+            } else {
+                int* pv = cache.get(k);
+                map<int, int>::const_iterator it = values.find(k);
+                BOOST_CHECK_EQUAL(pv != NULL, it != values.end());
+                if (pv && it != values.end()) {
+                    BOOST_CHECK_EQUAL(*pv, it->second);
+                    model.remove(k);
+                    model.push_front(k);
+                }
+            }
+        }
+        BOOST_CHECK_EQUAL(cache.size(), model.size());
+        list<int>::const_iterator itModel = model.begin();
+        for (lrucache<int, int>::const_iterator it = cache.begin(); it != cache.end(); ++it, ++itModel)
+            BOOST_CHECK_EQUAL(it->first, *itModel);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,161 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "net.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "random.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(net_tests)
+
+// A shared message has exactly the bytes PushMessage would have produced
+BOOST_AUTO_TEST_CASE(serialized_message_matches_pushmessage)
+{
+    std::vector<unsigned char> vPayload(1000);
+    GetRandBytes(&vPayload[0], vPayload.size());
+
+    CNode node(INVALID_SOCKET, CAddress(), "", true);
+    node.BeginMessage("tx");
+    node.ssSend << vPayload;
+    CDataStream ssExpected(node.ssSend.begin(), node.ssSend.end(), SER_NETWORK, PROTOCOL_VERSION);
+    node.AbortMessage();
+
+    CSerializedNetMsg msg = MakeSerializedNetMsg("tx", vPayload);
+    BOOST_REQUIRE_EQUAL(msg->size(), ssExpected.size());
+    // Only the size and checksum, filled in when the message is completed, may differ
+    BOOST_CHECK(std::equal(msg->begin(), msg->begin() + CMessageHeader::MESSAGE_SIZE_OFFSET, ssExpected.begin()));
+    BOOST_CHECK(std::equal(msg->begin() + CMessageHeader::HEADER_SIZE, msg->end(), ssExpected.begin() + CMessageHeader::HEADER_SIZE));
+
+    unsigned int nSize = 0;
+    memcpy(&nSize, &(*msg)[CMessageHeader::MESSAGE_SIZE_OFFSET], sizeof(nSize));
+    BOOST_CHECK_EQUAL(nSize, msg->size() - CMessageHeader::HEADER_SIZE);
+}
+
+// Sent messages are counted under their command, unknown ones under "*other*"
+BOOST_AUTO_TEST_CASE(bytes_per_message_command)
+{
+    CNode node(INVALID_SOCKET, CAddress(), "", true);
+    uint64_t nonce = 1;
+    node.PushMessage("ping", nonce);
+    node.PushMessage("ping", nonce);
+    node.PushMessage("nosuchcmd");
+
+    CNodeStats stats;
+    node.copyStats(stats);
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd["ping"], 2 * (CMessageHeader::HEADER_SIZE + sizeof(nonce)));
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER], (uint64_t)CMessageHeader::HEADER_SIZE);
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd["block"], 0U);
+    BOOST_CHECK(stats.mapSendBytesPerMsgCmd.count("nosuchcmd") == 0);
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd.size(), GetAllNetMessageTypes().size() + 1);
+}
+
+BOOST_AUTO_TEST_CASE(max_outbound_target)
+{
+    BOOST_CHECK(!CNode::OutboundTargetReached(false));
+    BOOST_CHECK(!CNode::OutboundTargetReached(true));
+
+    // Start a fresh cycle, then leave more than a day's worth of blocks
+    CNode::SetMaxOutboundTimeframe(MAX_UPLOAD_TIMEFRAME + 1);
+    CNode::SetMaxOutboundTimeframe(MAX_UPLOAD_TIMEFRAME);
+    uint64_t nReserve = MAX_UPLOAD_TIMEFRAME / Params().TargetSpacing() * MAX_BLOCK_SIZE;
+    CNode::SetMaxOutboundTarget(nReserve + 1000000);
+    CNode::RecordBytesSent(0);
+    uint64_t nLeft = CNode::GetOutboundTargetBytesLeft();
+    BOOST_CHECK(nLeft > 0 && nLeft <= nReserve + 1000000);
+    BOOST_CHECK(CNode::GetMaxOutboundTimeLeftInCycle() <= MAX_UPLOAD_TIMEFRAME);
+    BOOST_CHECK(!CNode::OutboundTargetReached(false));
+
+    // Past the target minus the reserve, only historical blocks are refused
+    CNode::RecordBytesSent(1000000);
+    BOOST_CHECK(CNode::OutboundTargetReached(true));
+    BOOST_CHECK(!CNode::OutboundTargetReached(false));
+
+    CNode::RecordBytesSent(nReserve);
+    BOOST_CHECK(CNode::OutboundTargetReached(false));
+    BOOST_CHECK_EQUAL(CNode::GetOutboundTargetBytesLeft(), 0U);
+
+    CNode::SetMaxOutboundTarget(0);
+    BOOST_CHECK(!CNode::OutboundTargetReached(false));
+}
+
+// The payload is hashed as it arrives, however it is split up
+BOOST_AUTO_TEST_CASE(receive_message_hash)
+{
+    std::vector<unsigned char> vPayload(300000);
+    GetRandBytes(&vPayload[0], vPayload.size());
+    CSerializedNetMsg msg = MakeSerializedNetMsg("block", vPayload);
+    uint256 hashExpected = Hash(msg->begin() + CMessageHeader::HEADER_SIZE, msg->end());
+
+    for (int nRound = 0; nRound < 3; nRound++) {
+        CNode node(INVALID_SOCKET, CAddress(), "", true);
+        LOCK(node.cs_vRecvMsg);
+        size_t nPos = 0;
+        while (nPos < msg->size()) {
+            size_t nChunk = std::min<size_t>(msg->size() - nPos, 1 + GetRand(nRound == 0 ? 10 : 100000));
+            BOOST_REQUIRE(node.ReceiveMsgBytes(&(*msg)[nPos], nChunk));
+            nPos += nChunk;
+        }
+        BOOST_REQUIRE_EQUAL(node.vRecvMsg.size(), 1U);
+        const CNetMessage& msgRecv = node.vRecvMsg.front();
+        BOOST_CHECK(msgRecv.complete());
+        BOOST_CHECK_EQUAL(msgRecv.GetMessageHash().ToString(), hashExpected.ToString());
+        BOOST_CHECK(memcmp(msgRecv.GetMessageHash().begin(), &msgRecv.hdr.nChecksum, CMessageHeader::CHECKSUM_SIZE) == 0);
+        BOOST_CHECK(std::equal(msgRecv.vRecv.begin(), msgRecv.vRecv.end(), msg->begin() + CMessageHeader::HEADER_SIZE));
+    }
+}
+
+#ifndef WIN32
+// Queued messages, shared or not, arrive complete and in order, also when
+// the socket buffer fills up part way through a message
+BOOST_AUTO_TEST_CASE(send_queued_messages)
+{
+    int fds[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    SOCKET hSocket = fds[0];
+    BOOST_REQUIRE(SetSocketNonBlocking(hSocket, true));
+
+    std::vector<unsigned char> vPayload(20000);
+    GetRandBytes(&vPayload[0], vPayload.size());
+    CSerializedNetMsg shared = MakeSerializedNetMsg("block", vPayload);
+
+    std::vector<char> vExpected;
+    CNode* pnode = new CNode(hSocket, CAddress(), "", true);
+    for (int i = 0; i < 100; i++) {
+        if (i % 3 == 0) {
+            uint64_t nonce = i;
+            pnode->PushMessage("ping", nonce);
+            CSerializedNetMsg ping = MakeSerializedNetMsg("ping", nonce);
+            vExpected.insert(vExpected.end(), ping->begin(), ping->end());
+        }
+        pnode->PushSerializedMessage(shared);
+        vExpected.insert(vExpected.end(), shared->begin(), shared->end());
+    }
+    // More than a socket buffer's worth was queued
+    BOOST_CHECK(!pnode->vSendMsg.empty());
+
+    std::vector<char> vReceived;
+    char buf[4096];
+    for (int nRounds = 0; vReceived.size() < vExpected.size() && nRounds < 100000; nRounds++) {
+        ssize_t n = read(fds[1], buf, sizeof(buf));
+        if (n > 0)
+            vReceived.insert(vReceived.end(), buf, buf + n);
+        LOCK(pnode->cs_vSend);
+        SocketSendData(pnode);
+    }
+    BOOST_CHECK(pnode->vSendMsg.empty());
+    BOOST_CHECK_EQUAL(pnode->nSendSize, 0U);
+    BOOST_CHECK_EQUAL(pnode->nSendBytes, vExpected.size());
+    BOOST_CHECK(vReceived == vExpected);
+
+    delete pnode;
+    close(fds[1]);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
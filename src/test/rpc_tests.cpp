@@ -6,42 +6,44 @@
 #include "rpcclient.h"
 
 #include "base58.h"
+#include "jsonwriter.h"
 #include "netbase.h"
 
+#include <limits>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
-using namespace json_spirit;
 
-Array
+UniValue
 createArgs(int nRequired, const char* address1=NULL, const char* address2=NULL)
 {
-    Array result;
+    UniValue result(UniValue::VARR);
     result.push_back(nRequired);
-    Array addresses;
+    UniValue addresses(UniValue::VARR);
     if (address1) addresses.push_back(address1);
     if (address2) addresses.push_back(address2);
     result.push_back(addresses);
     return result;
 }
 
-Value CallRPC(string args)
+UniValue CallRPC(string args)
 {
     vector<string> vArgs;
     boost::split(vArgs, args, boost::is_any_of(" \t"));
     string strMethod = vArgs[0];
     vArgs.erase(vArgs.begin());
-    Array params = RPCConvertValues(strMethod, vArgs);
+    UniValue params = RPCConvertValues(strMethod, vArgs);
 
     rpcfn_type method = tableRPC[strMethod]->actor;
     try {
-        Value result = (*method)(params, false);
+        UniValue result = (*method)(params, false);
         return result;
     }
-    catch (Object& objError)
+    catch (UniValue& objError)
     {
-        throw runtime_error(find_value(objError, "message").get_str());
+        throw runtime_error(get_str(find_value(objError, "message")));
     }
 }
 
@@ -51,7 +53,7 @@ BOOST_AUTO_TEST_SUITE(rpc_tests)
 BOOST_AUTO_TEST_CASE(rpc_rawparams)
 {
     // Test raw transaction API argument handling
-    Value r;
+    UniValue r;
 
     BOOST_CHECK_THROW(CallRPC("getrawtransaction"), runtime_error);
     BOOST_CHECK_THROW(CallRPC("getrawtransaction not_hex"), runtime_error);
@@ -70,8 +72,8 @@ BOOST_AUTO_TEST_CASE(rpc_rawparams)
     BOOST_CHECK_THROW(CallRPC("decoderawtransaction DEADBEEF"), runtime_error);
     string rawtx = "0100000001a15d57094aa7a21a28cb20b59aab8fc7d1149a3bdbcddba9c622e4f5f6a99ece010000006c493046022100f93bb0e7d8db7bd46e40132d1f8242026e045f03a0efe71bbb8e3f475e970d790221009337cd7f1f929f00cc6ff01f03729b069a7c21b59b1736ddfee5db5946c5da8c0121033b9b137ee87d5a812d6f506efdd37f0affa7ffc310711c06c7f3e097c9447c52ffffffff0100e1f505000000001976a9140389035a9225b3839e2bbf32d826a1e222031fd888ac00000000";
     BOOST_CHECK_NO_THROW(r = CallRPC(string("decoderawtransaction ")+rawtx));
-    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "version").get_int(), 1);
-    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "locktime").get_int(), 0);
+    BOOST_CHECK_EQUAL(get_int(find_value(get_obj(r), "version")), 1);
+    BOOST_CHECK_EQUAL(get_int(find_value(get_obj(r), "locktime")), 0);
     BOOST_CHECK_THROW(r = CallRPC(string("decoderawtransaction ")+rawtx+" extra"), runtime_error);
 
     BOOST_CHECK_THROW(CallRPC("signrawtransaction"), runtime_error);
@@ -91,7 +93,7 @@ BOOST_AUTO_TEST_CASE(rpc_rawparams)
 
 BOOST_AUTO_TEST_CASE(rpc_rawsign)
 {
-    Value r;
+    UniValue r;
     // input is a 1-of-2 multisig (so is output):
     string prevout =
       "[{\"txid\":\"b4cc287e58f87cdae59417329f710f3ecd75a4ee1d2872b7248f50977c8493f3\","
@@ -99,31 +101,33 @@ BOOST_AUTO_TEST_CASE(rpc_rawsign)
       "\"redeemScript\":\"512103debedc17b3df2badbcdd86d5feb4562b86fe182e5998abd8bcd4f122c6155b1b21027e940bb73ab8732bfdf7f9216ecefca5b94d6df834e77e108f68e66f126044c052ae\"}]";
     r = CallRPC(string("createrawtransaction ")+prevout+" "+
       "{\"3HqAe9LtNBjnsfM4CyYaWTnvCaUYT7v4oZ\":11}");
-    string notsigned = r.get_str();
+    string notsigned = get_str(r);
     string privkey1 = "\"KzsXybp9jX64P5ekX1KUxRQ79Jht9uzW7LorgwE65i5rWACL6LQe\"";
     string privkey2 = "\"Kyhdf5LuKTRx4ge69ybABsiUAWjVRK4XGxAKk2FQLp2HjGMy87Z4\"";
     r = CallRPC(string("signrawtransaction ")+notsigned+" "+prevout+" "+"[]");
-    BOOST_CHECK(find_value(r.get_obj(), "complete").get_bool() == false);
+    BOOST_CHECK(get_bool(find_value(get_obj(r), "complete")) == false);
     r = CallRPC(string("signrawtransaction ")+notsigned+" "+prevout+" "+"["+privkey1+","+privkey2+"]");
-    BOOST_CHECK(find_value(r.get_obj(), "complete").get_bool() == true);
+    BOOST_CHECK(get_bool(find_value(get_obj(r), "complete")) == true);
 }
 
 BOOST_AUTO_TEST_CASE(rpc_format_monetary_values)
 {
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(0LL), false), "0.00000000");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(1LL), false), "0.00000001");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(17622195LL), false), "0.17622195");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(50000000LL), false), "0.50000000");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(89898989LL), false), "0.89898989");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(100000000LL), false), "1.00000000");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(2099999999999990LL), false), "20999999.99999990");
-    BOOST_CHECK_EQUAL(write_string(ValueFromAmount(2099999999999999LL), false), "20999999.99999999");
+    BOOST_CHECK_EQUAL(ValueFromAmount(0LL).write(), "0.00000000");
+    BOOST_CHECK_EQUAL(ValueFromAmount(1LL).write(), "0.00000001");
+    BOOST_CHECK_EQUAL(ValueFromAmount(17622195LL).write(), "0.17622195");
+    BOOST_CHECK_EQUAL(ValueFromAmount(50000000LL).write(), "0.50000000");
+    BOOST_CHECK_EQUAL(ValueFromAmount(89898989LL).write(), "0.89898989");
+    BOOST_CHECK_EQUAL(ValueFromAmount(100000000LL).write(), "1.00000000");
+    BOOST_CHECK_EQUAL(ValueFromAmount(2099999999999990LL).write(), "20999999.99999990");
+    BOOST_CHECK_EQUAL(ValueFromAmount(2099999999999999LL).write(), "20999999.99999999");
+    BOOST_CHECK_EQUAL(ValueFromAmount(-1LL).write(), "-0.00000001");
+    BOOST_CHECK_EQUAL(ValueFromAmount(-2099999999999999LL).write(), "-20999999.99999999");
 }
 
-static Value ValueFromString(const std::string &str)
+static UniValue ValueFromString(const std::string &str)
 {
-    Value value;
-    BOOST_CHECK(read_string(str, value));
+    UniValue value;
+    BOOST_CHECK(value.setNumStr(str));
     return value;
 }
 
@@ -139,6 +143,84 @@ BOOST_AUTO_TEST_CASE(rpc_parse_monetary_values)
     BOOST_CHECK_EQUAL(AmountFromValue(ValueFromString("20999999.99999999")), 2099999999999999LL);
 }
 
+static void WriteDocument(CJSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.KeyValue("hash", "00ff");
+    writer.KeyValue("height", 7);
+    writer.KeyValue("value", ValueFromAmount(1LL));
+    writer.Key("tx");
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.KeyValue("coinbase", ValueFromBool(true));
+    writer.Key("vout");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.EndObject();
+    writer.Value("a \"quoted\" string");
+    writer.Value(NullUniValue);
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginObject();
+    writer.EndObject();
+    UniValue sub(UniValue::VARR);
+    sub.push_back(1);
+    writer.KeyValue("sub", sub);
+    writer.EndObject();
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_writer)
+{
+    const string strExpected = "{\"hash\":\"00ff\",\"height\":7,\"value\":0.00000001,"
+        "\"tx\":[{\"coinbase\":true,\"vout\":[]},\"a \\\"quoted\\\" string\",null],\"empty\":{},\"sub\":[1]}";
+
+    string str("prefix ");
+    CJSONStringWriter stringWriter(str);
+    WriteDocument(stringWriter);
+    BOOST_CHECK_EQUAL(str, "prefix " + strExpected);
+
+    CJSONTreeWriter treeWriter;
+    WriteDocument(treeWriter);
+    const UniValue& val = treeWriter.Get();
+    BOOST_CHECK_EQUAL(val.write(), strExpected);
+    BOOST_CHECK_EQUAL(get_int(find_value(val, "height")), 7);
+    BOOST_CHECK(get_bool(find_value(find_value(val, "tx")[0], "coinbase")));
+
+    // A scalar on its own is a document too
+    str.clear();
+    CJSONStringWriter scalarWriter(str);
+    scalarWriter.Value(ValueFromDouble(1.5));
+    BOOST_CHECK_EQUAL(str, "1.5");
+}
+
+BOOST_AUTO_TEST_CASE(rpc_univalue_compat)
+{
+    UniValue obj;
+    BOOST_CHECK(obj.read("{\"b\":1,\"a \\\"q\\\":\\\"x:y\":[{\"c\":2}],\"d\":{\"e\":true},\"f\":\"g:h\"}"));
+    vector<string> vKeys = getKeys(obj);
+    BOOST_REQUIRE_EQUAL(vKeys.size(), 4U);
+    BOOST_CHECK_EQUAL(vKeys[0], "b");
+    BOOST_CHECK_EQUAL(vKeys[1], "a \"q\":\"x:y");
+    BOOST_CHECK_EQUAL(vKeys[2], "d");
+    BOOST_CHECK_EQUAL(vKeys[3], "f");
+    BOOST_CHECK_EQUAL(getValues(obj).size(), 4U);
+    BOOST_CHECK_EQUAL(get_int(getValues(obj)[0]), 1);
+    BOOST_CHECK(get_bool(find_value(find_value(obj, "d"), "e")));
+    BOOST_CHECK(find_value(obj, "e").isNull());
+    BOOST_CHECK(getKeys(UniValue(UniValue::VOBJ)).empty());
+    BOOST_CHECK_THROW(getKeys(UniValue(UniValue::VARR)), runtime_error);
+
+    BOOST_CHECK_THROW(get_str(find_value(obj, "b")), runtime_error);
+    BOOST_CHECK_THROW(get_int(UniValue(1.5)), runtime_error);
+    BOOST_CHECK_THROW(get_int(UniValue((int64_t)1 << 40)), runtime_error);
+    BOOST_CHECK_EQUAL(get_int64(UniValue((int64_t)1 << 40)), (int64_t)1 << 40);
+
+    BOOST_CHECK_EQUAL(ValueFromBool(true).write(), "true");
+    BOOST_CHECK_EQUAL(ValueFromBool(false).write(), "false");
+    BOOST_CHECK_EQUAL(ValueFromDouble(4.656542373906925e-10).write(), "4.656542373906925e-10");
+    BOOST_CHECK_EQUAL(get_real(ValueFromDouble(0.1)), 0.1);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_boostasiotocnetaddr)
 {
     // Check IPv4 addresses
@@ -154,4 +236,87 @@ BOOST_AUTO_TEST_CASE(rpc_boostasiotocnetaddr)
     BOOST_CHECK_EQUAL(BoostAsioToCNetAddr(boost::asio::ip::address::from_string("::ffff:127.0.0.1")).ToString(), "127.0.0.1");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_http_request_parser)
+{
+    const string strRequests =
+        "POST / HTTP/1.1\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 5\r\n"
+        "\r\n"
+        "hello"
+        "GET /rest/tx/00.json HTTP/1.0\r\n"
+        "\r\n";
+
+    // Fed a byte at a time, the first request ends at its body
+    HTTPRequestParser parser(MAX_HTTP_HEADERS_SIZE, 1000);
+    size_t nPos = 0;
+    while (nPos < strRequests.size() && !parser.IsComplete())
+        nPos += parser.Feed(&strRequests[nPos], 1);
+    BOOST_CHECK(parser.IsComplete());
+    BOOST_CHECK_EQUAL(parser.strMethod, "POST");
+    BOOST_CHECK_EQUAL(parser.strURI, "/");
+    BOOST_CHECK_EQUAL(parser.nProto, 1);
+    BOOST_CHECK_EQUAL(parser.mapHeaders["content-type"], "application/json");
+    BOOST_CHECK_EQUAL(parser.strBody, "hello");
+    BOOST_CHECK(parser.fKeepAlive);
+
+    // The pipelined one follows, all in one go
+    parser.Reset();
+    BOOST_CHECK_EQUAL(parser.Feed(&strRequests[nPos], strRequests.size() - nPos), strRequests.size() - nPos);
+    BOOST_CHECK(parser.IsComplete());
+    BOOST_CHECK_EQUAL(parser.strMethod, "GET");
+    BOOST_CHECK_EQUAL(parser.strURI, "/rest/tx/00.json");
+    BOOST_CHECK(parser.strBody.empty());
+    BOOST_CHECK(!parser.fKeepAlive);
+    BOOST_CHECK_EQUAL(parser.mapHeaders["connection"], "close");
+
+    // Malformed and oversized requests
+    const char* pszBad[] = {
+        "PUT / HTTP/1.1\r\n\r\n",
+        "GET\r\n\r\n",
+        "GET noslash HTTP/1.1\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: 1001\r\n\r\n",
+        "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+    };
+    for (unsigned int i = 0; i < ARRAYLEN(pszBad); i++) {
+        parser.Reset();
+        parser.Feed(pszBad[i], strlen(pszBad[i]));
+        BOOST_CHECK_MESSAGE(parser.IsFailed(), pszBad[i]);
+    }
+    parser.Reset();
+    string strLong = "GET /" + string(MAX_HTTP_HEADERS_SIZE, 'a');
+    parser.Feed(&strLong[0], strLong.size());
+    BOOST_CHECK(parser.IsFailed());
+
+    // Incomplete
+    parser.Reset();
+    string strPartial = "POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\n12345";
+    BOOST_CHECK_EQUAL(parser.Feed(&strPartial[0], strPartial.size()), strPartial.size());
+    BOOST_CHECK(!parser.IsComplete() && !parser.IsFailed());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_method_stats)
+{
+    // Buckets cover every latency, in order
+    for (uint64_t n = 0; n < 100000; n++) {
+        int nBucket = CRPCMethodStats::GetBucket(n);
+        BOOST_CHECK(n < CRPCMethodStats::GetBucketEnd(nBucket));
+        BOOST_CHECK(nBucket == 0 || n >= CRPCMethodStats::GetBucketEnd(nBucket - 1));
+    }
+    BOOST_CHECK_EQUAL(CRPCMethodStats::GetBucket(std::numeric_limits<uint64_t>::max()), RPC_LATENCY_BUCKETS - 1);
+
+    CRPCMethodStats stats;
+    for (int i = 0; i < 100; i++)
+        stats.Record(1000, 0, false);
+    stats.Record(100000, 40000, true);
+    UniValue obj = stats.ToJSON();
+    BOOST_CHECK_EQUAL(get_int(find_value(obj, "calls")), 101);
+    BOOST_CHECK_EQUAL(get_int(find_value(obj, "errors")), 1);
+    BOOST_CHECK_CLOSE(get_real(find_value(obj, "total_ms")), 200.0, 0.001);
+    BOOST_CHECK_CLOSE(get_real(find_value(obj, "p50_ms")), 1.024, 0.001);
+    BOOST_CHECK_CLOSE(get_real(find_value(obj, "p99_ms")), 1.024, 0.001);
+    BOOST_CHECK_CLOSE(get_real(find_value(obj, "max_ms")), 100.0, 0.001);
+    BOOST_CHECK_CLOSE(get_real(find_value(obj, "lockwait_ms")), 40.0, 0.001);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
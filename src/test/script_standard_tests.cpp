@@ -0,0 +1,290 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/script.h"
+#include "script/standard.h"
+#include "util.h"
+#include "utilstrencodings.h"
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+typedef vector<unsigned char> valtype;
+
+// Solver as it was before MatchTemplate: a scan of every template, op by op.
+static bool SolverOld(const CScript& scriptPubKey, txnouttype& typeRet, vector<valtype>& vSolutionsRet)
+{
+    static multimap<txnouttype, CScript> mTemplates;
+    if (mTemplates.empty())
+    {
+        mTemplates.insert(make_pair(TX_PUBKEY, CScript() << OP_PUBKEY << OP_CHECKSIG));
+        mTemplates.insert(make_pair(TX_PUBKEYHASH, CScript() << OP_DUP << OP_HASH160 << OP_PUBKEYHASH << OP_EQUALVERIFY << OP_CHECKSIG));
+        mTemplates.insert(make_pair(TX_MULTISIG, CScript() << OP_SMALLINTEGER << OP_PUBKEYS << OP_SMALLINTEGER << OP_CHECKMULTISIG));
+        if (GetBoolArg("-datacarrier", true))
+            mTemplates.insert(make_pair(TX_NULL_DATA, CScript() << OP_RETURN << OP_SMALLDATA));
+        mTemplates.insert(make_pair(TX_NULL_DATA, CScript() << OP_RETURN));
+    }
+
+    if (scriptPubKey.IsPayToScriptHash())
+    {
+        typeRet = TX_SCRIPTHASH;
+        vector<unsigned char> hashBytes(scriptPubKey.begin()+2, scriptPubKey.begin()+22);
+        vSolutionsRet.push_back(hashBytes);
+        return true;
+    }
+
+    const CScript& script1 = scriptPubKey;
+    BOOST_FOREACH(const PAIRTYPE(txnouttype, CScript)& tplate, mTemplates)
+    {
+        const CScript& script2 = tplate.second;
+        vSolutionsRet.clear();
+
+        opcodetype opcode1, opcode2;
+        vector<unsigned char> vch1, vch2;
+
+        CScript::const_iterator pc1 = script1.begin();
+        CScript::const_iterator pc2 = script2.begin();
+        while (true)
+        {
+            if (pc1 == script1.end() && pc2 == script2.end())
+            {
+                typeRet = tplate.first;
+                if (typeRet == TX_MULTISIG)
+                {
+                    unsigned char m = vSolutionsRet.front()[0];
+                    unsigned char n = vSolutionsRet.back()[0];
+                    if (m < 1 || n < 1 || m > n || vSolutionsRet.size()-2 != n)
+                        return false;
+                }
+                return true;
+            }
+            if (!script1.GetOp(pc1, opcode1, vch1))
+                break;
+            if (!script2.GetOp(pc2, opcode2, vch2))
+                break;
+
+            if (opcode2 == OP_PUBKEYS)
+            {
+                while (vch1.size() >= 33 && vch1.size() <= 65)
+                {
+                    vSolutionsRet.push_back(vch1);
+                    if (!script1.GetOp(pc1, opcode1, vch1))
+                        break;
+                }
+                if (!script2.GetOp(pc2, opcode2, vch2))
+                    break;
+            }
+
+            if (opcode2 == OP_PUBKEY)
+            {
+                if (vch1.size() < 33 || vch1.size() > 65)
+                    break;
+                vSolutionsRet.push_back(vch1);
+            }
+            else if (opcode2 == OP_PUBKEYHASH)
+            {
+                if (vch1.size() != sizeof(uint160))
+                    break;
+                vSolutionsRet.push_back(vch1);
+            }
+            else if (opcode2 == OP_SMALLINTEGER)
+            {
+                if (opcode1 == OP_0 ||
+                    (opcode1 >= OP_1 && opcode1 <= OP_16))
+                {
+                    char n = (char)CScript::DecodeOP_N(opcode1);
+                    vSolutionsRet.push_back(valtype(1, n));
+                }
+                else
+                    break;
+            }
+            else if (opcode2 == OP_SMALLDATA)
+            {
+                if (vch1.size() > nMaxDatacarrierBytes)
+                    break;
+            }
+            else if (opcode1 != opcode2 || vch1 != vch2)
+            {
+                break;
+            }
+        }
+    }
+
+    vSolutionsRet.clear();
+    typeRet = TX_NONSTANDARD;
+    return false;
+}
+
+static void CheckSame(const CScript& script)
+{
+    txnouttype typeOld, typeNew;
+    vector<valtype> vSolutionsOld, vSolutionsNew;
+    bool fOld = SolverOld(script, typeOld, vSolutionsOld);
+    bool fNew = Solver(script, typeNew, vSolutionsNew);
+    BOOST_CHECK_EQUAL(fOld, fNew);
+    if (fOld && fNew) {
+        BOOST_CHECK_EQUAL(typeOld, typeNew);
+        BOOST_CHECK(vSolutionsOld == vSolutionsNew);
+    } else {
+        // On failure the old matcher could leave a partial TX_MULTISIG
+        // result behind; the new one always reports TX_NONSTANDARD.
+        BOOST_CHECK_EQUAL(typeNew, TX_NONSTANDARD);
+        BOOST_CHECK(vSolutionsNew.empty());
+    }
+}
+
+// Append a push of data using the given push opcode (0: the direct form)
+static void AppendPush(CScript& script, const valtype& data, int nEncoding)
+{
+    unsigned int nSize = data.size();
+    if (nEncoding == 0 && nSize < OP_PUSHDATA1) {
+        script.push_back((unsigned char)nSize);
+    } else if (nEncoding <= 1 && nSize <= 0xff) {
+        script.push_back(OP_PUSHDATA1);
+        script.push_back((unsigned char)nSize);
+    } else if (nEncoding <= 2 && nSize <= 0xffff) {
+        script.push_back(OP_PUSHDATA2);
+        script.push_back(nSize & 0xff);
+        script.push_back((nSize >> 8) & 0xff);
+    } else {
+        script.push_back(OP_PUSHDATA4);
+        for (int i = 0; i < 4; i++)
+            script.push_back((nSize >> (8 * i)) & 0xff);
+    }
+    script.insert(script.end(), data.begin(), data.end());
+}
+
+static valtype RandomBytes(unsigned int nSize)
+{
+    valtype data(nSize);
+    for (unsigned int i = 0; i < nSize; i++)
+        data[i] = insecure_rand() & 0xff;
+    return data;
+}
+
+// A random script assembled from pieces of the standard templates
+static CScript RandomTemplateLikeScript()
+{
+    static const opcodetype ops[] = {
+        OP_0, OP_1, OP_2, OP_3, OP_16, OP_1NEGATE, OP_DUP, OP_HASH160, OP_EQUALVERIFY, OP_EQUAL,
+        OP_CHECKSIG, OP_CHECKMULTISIG, OP_RETURN, OP_NOP, OP_PUBKEY, OP_PUBKEYHASH, OP_SMALLINTEGER,
+    };
+    static const unsigned int sizes[] = {0, 1, 19, 20, 21, 32, 33, 34, 40, 41, 64, 65, 66, 80};
+
+    CScript script;
+    int nOps = insecure_rand() % 8;
+    for (int i = 0; i < nOps; i++) {
+        switch (insecure_rand() % 4) {
+        case 0:
+        case 1:
+            script << ops[insecure_rand() % (sizeof(ops) / sizeof(ops[0]))];
+            break;
+        case 2:
+            AppendPush(script, RandomBytes(sizes[insecure_rand() % (sizeof(sizes) / sizeof(sizes[0]))]),
+                       insecure_rand() % 8 == 0 ? insecure_rand() % 4 : 0);
+            break;
+        case 3:
+            script.push_back(insecure_rand() & 0xff);
+            break;
+        }
+    }
+    return script;
+}
+
+static vector<CScript> StandardScripts()
+{
+    vector<CScript> ret;
+    CKey keys[3];
+    vector<CPubKey> pubkeys;
+    for (int i = 0; i < 3; i++) {
+        keys[i].MakeNewKey(i != 1);
+        pubkeys.push_back(keys[i].GetPubKey());
+    }
+    ret.push_back(CScript() << ToByteVector(pubkeys[0]) << OP_CHECKSIG);
+    ret.push_back(CScript() << ToByteVector(pubkeys[1]) << OP_CHECKSIG);
+    ret.push_back(GetScriptForDestination(pubkeys[0].GetID()));
+    ret.push_back(GetScriptForDestination(CScriptID(ret[0])));
+    for (int m = 1; m <= 3; m++)
+        ret.push_back(GetScriptForMultisig(m, pubkeys));
+    ret.push_back(CScript() << OP_RETURN);
+    ret.push_back(CScript() << OP_RETURN << RandomBytes(40));
+    ret.push_back(CScript() << OP_RETURN << RandomBytes(41));
+    return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(script_standard_tests)
+
+BOOST_AUTO_TEST_CASE(match_template_standard)
+{
+    vector<CScript> scripts = StandardScripts();
+    static const txnouttype types[] = {TX_PUBKEY, TX_PUBKEY, TX_PUBKEYHASH, TX_SCRIPTHASH, TX_MULTISIG, TX_MULTISIG, TX_MULTISIG, TX_NULL_DATA, TX_NULL_DATA, TX_NONSTANDARD};
+    for (unsigned int i = 0; i < scripts.size(); i++) {
+        CTemplateMatch match;
+        BOOST_CHECK_EQUAL(MatchTemplate(scripts[i], match), types[i] != TX_NONSTANDARD);
+        BOOST_CHECK_EQUAL(match.type, types[i]);
+        CheckSame(scripts[i]);
+    }
+
+    // The spans point into the script itself
+    CTemplateMatch match;
+    BOOST_CHECK(MatchTemplate(scripts[6], match));
+    BOOST_CHECK_EQUAL(match.nRequired, 3U);
+    BOOST_CHECK_EQUAL(match.nSpans, 3U);
+    BOOST_CHECK(match.spans[0].begin == &scripts[6][2]);
+    BOOST_CHECK_EQUAL(match.spans[1].size, 65U);
+}
+
+BOOST_AUTO_TEST_CASE(match_template_mutations)
+{
+    vector<CScript> scripts = StandardScripts();
+    for (int n = 0; n < 20000; n++) {
+        CScript script = scripts[insecure_rand() % scripts.size()];
+        int nMutations = 1 + insecure_rand() % 3;
+        for (int i = 0; i < nMutations && !script.empty(); i++) {
+            unsigned int pos = insecure_rand() % script.size();
+            switch (insecure_rand() % 4) {
+            case 0:
+                script[pos] ^= 1 << (insecure_rand() % 8);
+                break;
+            case 1:
+                script[pos] = insecure_rand() & 0xff;
+                break;
+            case 2:
+                script.erase(script.begin() + pos);
+                break;
+            case 3:
+                script.insert(script.begin() + pos, insecure_rand() & 0xff);
+                break;
+            }
+        }
+        CheckSame(script);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(match_template_fuzz)
+{
+    unsigned int nMaxDatacarrierBytesSaved = nMaxDatacarrierBytes;
+    for (int n = 0; n < 50000; n++) {
+        nMaxDatacarrierBytes = (n % 2) ? 80 : MAX_OP_RETURN_RELAY;
+        CScript script = RandomTemplateLikeScript();
+        CheckSame(script);
+
+        // Re-encode pushes of multisig-like scripts with non-minimal opcodes
+        CScript multisig;
+        multisig << (opcodetype)(OP_1 + insecure_rand() % 3);
+        int nKeys = insecure_rand() % 4;
+        for (int i = 0; i < nKeys; i++)
+            AppendPush(multisig, RandomBytes(33 + insecure_rand() % 33), insecure_rand() % 4);
+        multisig << (opcodetype)(OP_1 + insecure_rand() % 3) << OP_CHECKMULTISIG;
+        CheckSame(multisig);
+    }
+    nMaxDatacarrierBytes = nMaxDatacarrierBytesSaved;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,301 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "primitives/transaction.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/interpreter.h"
+#include "script/script.h"
+#include "script/script_error.h"
+#include "script/standard.h"
+
+#include <limits>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+typedef vector<unsigned char> valtype;
+
+// Whether the top of the stack counts as true, judged by OP_VERIFY
+static bool TopIsTrue(const vector<valtype>& stack)
+{
+    if (stack.empty())
+        return false;
+    vector<valtype> stackTop(1, stack.back());
+    return EvalScript(stackTop, CScript() << OP_VERIFY, 0, BaseSignatureChecker());
+}
+
+// VerifyScript as it was before the standard templates got their fast
+// paths: everything goes through EvalScript.
+static bool VerifyScriptOld(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    *serror = SCRIPT_ERR_UNKNOWN_ERROR;
+
+    if ((flags & SCRIPT_VERIFY_SIGPUSHONLY) != 0 && !scriptSig.IsPushOnly()) {
+        *serror = SCRIPT_ERR_SIG_PUSHONLY;
+        return false;
+    }
+
+    vector<valtype> stack, stackCopy;
+    if (!EvalScript(stack, scriptSig, flags, checker, serror))
+        return false;
+    if (flags & SCRIPT_VERIFY_P2SH)
+        stackCopy = stack;
+    if (!EvalScript(stack, scriptPubKey, flags, checker, serror))
+        return false;
+    if (!TopIsTrue(stack)) {
+        *serror = SCRIPT_ERR_EVAL_FALSE;
+        return false;
+    }
+
+    if ((flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash())
+    {
+        if (!scriptSig.IsPushOnly()) {
+            *serror = SCRIPT_ERR_SIG_PUSHONLY;
+            return false;
+        }
+        const valtype& pubKeySerialized = stackCopy.back();
+        CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
+        stackCopy.pop_back();
+
+        if (!EvalScript(stackCopy, pubKey2, flags, checker, serror))
+            return false;
+        if (!TopIsTrue(stackCopy)) {
+            *serror = SCRIPT_ERR_EVAL_FALSE;
+            return false;
+        }
+    }
+
+    *serror = SCRIPT_ERR_OK;
+    return true;
+}
+
+// Records every signature check, so that both paths can be shown to check
+// the same signatures, against the same keys and script code, in the same order.
+class RecordingChecker : public SignatureChecker
+{
+public:
+    mutable vector<valtype> vCalls;
+
+    RecordingChecker(const CTransaction& txToIn, unsigned int nInIn) : SignatureChecker(txToIn, nInIn) {}
+
+    bool CheckSig(const valtype& vchSig, const valtype& vchPubKey, const CScript& scriptCode) const
+    {
+        vCalls.push_back(vchSig);
+        vCalls.push_back(vchPubKey);
+        vCalls.push_back(valtype(scriptCode.begin(), scriptCode.end()));
+        return SignatureChecker::CheckSig(vchSig, vchPubKey, scriptCode);
+    }
+};
+
+static CMutableTransaction BuildSpendingTransaction(const CScript& scriptPubKey)
+{
+    CMutableTransaction txCredit;
+    txCredit.nVersion = 1;
+    txCredit.nLockTime = 0;
+    txCredit.vin.resize(1);
+    txCredit.vout.resize(1);
+    txCredit.vin[0].prevout.SetNull();
+    txCredit.vin[0].scriptSig = CScript() << CScriptNum(0) << CScriptNum(0);
+    txCredit.vin[0].nSequence = std::numeric_limits<unsigned int>::max();
+    txCredit.vout[0].scriptPubKey = scriptPubKey;
+    txCredit.vout[0].nValue = 0;
+
+    CMutableTransaction txSpend;
+    txSpend.nVersion = 1;
+    txSpend.nLockTime = 0;
+    txSpend.vin.resize(1);
+    txSpend.vout.resize(1);
+    txSpend.vin[0].prevout.hash = txCredit.GetHash();
+    txSpend.vin[0].prevout.n = 0;
+    txSpend.vin[0].nSequence = std::numeric_limits<unsigned int>::max();
+    txSpend.vout[0].scriptPubKey = CScript();
+    txSpend.vout[0].nValue = 0;
+    return txSpend;
+}
+
+static const unsigned int flagsToTest[] = {
+    SCRIPT_VERIFY_NONE,
+    SCRIPT_VERIFY_P2SH,
+    SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC,
+    SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_DERSIG | SCRIPT_VERIFY_LOW_S,
+    SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_NULLDUMMY | SCRIPT_VERIFY_MINIMALDATA,
+    SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_NULLDUMMY | SCRIPT_VERIFY_MINIMALDATA | SCRIPT_VERIFY_SIGPUSHONLY,
+};
+
+static void CheckSame(const CScript& scriptSig, const CScript& scriptPubKey, const CTransaction& tx)
+{
+    for (unsigned int i = 0; i < sizeof(flagsToTest) / sizeof(flagsToTest[0]); i++) {
+        unsigned int flags = flagsToTest[i];
+        ScriptError errOld, errNew;
+        RecordingChecker checkerOld(tx, 0), checkerNew(tx, 0);
+        bool fOld = VerifyScriptOld(scriptSig, scriptPubKey, flags, checkerOld, &errOld);
+        bool fNew = VerifyScript(scriptSig, scriptPubKey, flags, checkerNew, &errNew);
+        BOOST_CHECK_MESSAGE(fOld == fNew && errOld == errNew && checkerOld.vCalls == checkerNew.vCalls,
+            "mismatch: " << ScriptErrorString(errOld) << " vs " << ScriptErrorString(errNew) << " flags " << flags);
+    }
+}
+
+static valtype Sign(const CKey& key, const CScript& scriptCode, const CTransaction& tx, int nHashType)
+{
+    valtype vchSig;
+    uint256 hash = SignatureHash(scriptCode, tx, 0, nHashType);
+    BOOST_CHECK(key.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)nHashType);
+    return vchSig;
+}
+
+// A push of data that is not the shortest possible encoding.
+static CScript PushNonMinimal(const valtype& data)
+{
+    CScript script;
+    script.push_back(OP_PUSHDATA1);
+    script.push_back((unsigned char)data.size());
+    script.insert(script.end(), data.begin(), data.end());
+    return script;
+}
+
+// Variants of a scriptSig built from the given pushes, most of them broken
+static vector<CScript> Mutations(const vector<valtype>& pushes)
+{
+    vector<CScript> ret;
+    CScript base;
+    for (unsigned int i = 0; i < pushes.size(); i++)
+        base << pushes[i];
+    ret.push_back(base);
+
+    for (unsigned int i = 0; i < pushes.size(); i++) {
+        CScript drop, flip, truncate, grow, nonMinimal;
+        for (unsigned int j = 0; j < pushes.size(); j++) {
+            valtype push = pushes[j];
+            if (i == j) {
+                nonMinimal += PushNonMinimal(push);
+                if (!push.empty()) {
+                    valtype flipped(push);
+                    flipped[insecure_rand() % flipped.size()] ^= 1 << (insecure_rand() % 8);
+                    flip << flipped;
+                    truncate << valtype(push.begin(), push.end() - 1);
+                } else {
+                    flip << valtype(1, 1);
+                    truncate << push;
+                }
+                push.push_back(0);
+                grow << push;
+                continue;
+            }
+            drop << pushes[j];
+            flip << pushes[j];
+            truncate << pushes[j];
+            grow << pushes[j];
+            nonMinimal << pushes[j];
+        }
+        ret.push_back(drop);
+        ret.push_back(flip);
+        ret.push_back(truncate);
+        ret.push_back(grow);
+        ret.push_back(nonMinimal);
+    }
+
+    ret.push_back((CScript() << OP_0) + base);
+    ret.push_back(base + (CScript() << OP_1));
+    ret.push_back(base + (CScript() << OP_NOP));
+    ret.push_back(CScript());
+    return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(script_template_tests)
+
+BOOST_AUTO_TEST_CASE(script_template_equivalence)
+{
+    CKey keys[4];
+    for (int i = 0; i < 4; i++)
+        keys[i].MakeNewKey(i % 2 == 0);
+
+    static const int nHashTypes[] = {SIGHASH_ALL, SIGHASH_NONE, SIGHASH_SINGLE | SIGHASH_ANYONECANPAY, 0x21};
+
+    for (int nTest = 0; nTest < 40; nTest++) {
+        const CKey& key = keys[nTest % 4];
+        const CPubKey pubkey = key.GetPubKey();
+        const int nHashType = nHashTypes[(nTest / 4) % 4];
+        bool fP2SH = nTest >= 20;
+
+        // Pick the inner script and the stack that satisfies it
+        CScript inner;
+        int nKind = nTest % 3;
+        if (nKind == 0) {
+            inner = GetScriptForDestination(pubkey.GetID());
+        } else if (nKind == 1) {
+            inner = CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
+        } else {
+            vector<CPubKey> vPubKeys;
+            for (int i = 0; i < 3; i++)
+                vPubKeys.push_back(keys[(nTest + i) % 4].GetPubKey());
+            inner = GetScriptForMultisig(1 + nTest % 3, vPubKeys);
+        }
+        CScript scriptPubKey = fP2SH ? GetScriptForDestination(CScriptID(inner)) : inner;
+        CTransaction tx(BuildSpendingTransaction(scriptPubKey));
+
+        vector<valtype> pushes;
+        if (nKind == 0) {
+            pushes.push_back(Sign(key, inner, tx, nHashType));
+            pushes.push_back(ToByteVector(pubkey));
+        } else if (nKind == 1) {
+            pushes.push_back(Sign(key, inner, tx, nHashType));
+        } else {
+            pushes.push_back(valtype());
+            for (int i = 0; i < 1 + nTest % 3; i++)
+                pushes.push_back(Sign(keys[(nTest + i) % 4], inner, tx, nHashType));
+        }
+        if (fP2SH)
+            pushes.push_back(valtype(inner.begin(), inner.end()));
+
+        vector<CScript> scriptSigs = Mutations(pushes);
+        for (unsigned int i = 0; i < scriptSigs.size(); i++)
+            CheckSame(scriptSigs[i], scriptPubKey, tx);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(script_template_encodings)
+{
+    CKey key;
+    key.MakeNewKey(false);
+    CPubKey pubkey = key.GetPubKey();
+
+    // Hybrid public key (0x06/0x07 prefix): only rejected under STRICTENC
+    valtype vchHybrid = ToByteVector(pubkey);
+    vchHybrid[0] = 0x06 | (vchHybrid[64] & 1);
+
+    CScript scripts[] = {
+        CScript() << vchHybrid << OP_CHECKSIG,
+        CScript() << OP_1 << vchHybrid << ToByteVector(pubkey) << OP_2 << OP_CHECKMULTISIG,
+        CScript() << OP_DUP << OP_HASH160 << ToByteVector(Hash160(vchHybrid)) << OP_EQUALVERIFY << OP_CHECKSIG,
+    };
+    for (unsigned int i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+        for (int fP2SH = 0; fP2SH < 2; fP2SH++) {
+            CScript scriptPubKey = fP2SH ? GetScriptForDestination(CScriptID(scripts[i])) : scripts[i];
+            CTransaction tx(BuildSpendingTransaction(scriptPubKey));
+            valtype vchSig = Sign(key, scripts[i], tx, SIGHASH_ALL);
+
+            // Signature with trailing garbage, which is not strict DER
+            valtype vchPadded(vchSig);
+            vchPadded.insert(vchPadded.end() - 1, 0);
+
+            for (int nSig = 0; nSig < 2; nSig++) {
+                CScript scriptSig;
+                if (i == 1)
+                    scriptSig << OP_0;
+                scriptSig << (nSig ? vchPadded : vchSig);
+                if (i == 2)
+                    scriptSig << vchHybrid;
+                if (fP2SH)
+                    scriptSig << valtype(scripts[i].begin(), scripts[i].end());
+                CheckSame(scriptSig, scriptPubKey, tx);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
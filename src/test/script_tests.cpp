@@ -106,6 +106,9 @@ void DoTest(const CScript& scriptPubKey, const CScript& scriptSig, int flags, bo
     CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
     stream << tx2;
     BOOST_CHECK_MESSAGE(bitcoinconsensus_verify_script(begin_ptr(scriptPubKey), scriptPubKey.size(), (const unsigned char*)&stream[0], stream.size(), 0, flags, NULL) == expect,message);
+    const unsigned char* pScriptPubKey = begin_ptr(scriptPubKey);
+    unsigned int nScriptPubKeyLen = scriptPubKey.size();
+    BOOST_CHECK_MESSAGE(bitcoinconsensus_verify_transaction((const unsigned char*)&stream[0], stream.size(), &pScriptPubKey, &nScriptPubKeyLen, NULL, 1, flags, 1, NULL, NULL) == expect, message);
 #endif
 }
 
@@ -898,4 +901,63 @@ BOOST_AUTO_TEST_CASE(script_IsPushOnly_on_invalid_scripts)
     BOOST_CHECK(!CScript(direct, direct+sizeof(direct)).IsPushOnly());
 }
 
+#if defined(HAVE_CONSENSUS_LIB)
+BOOST_AUTO_TEST_CASE(script_consensus_verify_transaction)
+{
+    // A transaction spending several pay-to-pubkey-hash outputs at once
+    static const unsigned int nInputs = 7;
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    CMutableTransaction txCredit = BuildCreditingTransaction(scriptPubKey);
+    txCredit.vout.resize(nInputs, txCredit.vout[0]);
+    CMutableTransaction txSpend = BuildSpendingTransaction(CScript(), txCredit);
+    txSpend.vin.resize(nInputs, txSpend.vin[0]);
+    for (unsigned int i = 0; i < nInputs; i++)
+        txSpend.vin[i].prevout.n = i;
+    CBasicKeyStore keystore;
+    keystore.AddKey(key);
+    for (unsigned int i = 0; i < nInputs; i++)
+        BOOST_CHECK(SignSignature(keystore, txCredit, txSpend, i));
+    // Break input 3 by signing it for another input
+    txSpend.vin[3].scriptSig = txSpend.vin[4].scriptSig;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << txSpend;
+    vector<const unsigned char*> vScriptPubKeys(nInputs, begin_ptr(scriptPubKey));
+    vector<unsigned int> vScriptPubKeyLens(nInputs, scriptPubKey.size());
+    vector<int64_t> vAmounts(nInputs, 1);
+
+    for (unsigned int nThreads = 0; nThreads <= 8; nThreads++) {
+        bitcoinconsensus_error err;
+        vector<int> results(nInputs, -1);
+        BOOST_CHECK_EQUAL(bitcoinconsensus_verify_transaction((const unsigned char*)&stream[0], stream.size(), &vScriptPubKeys[0], &vScriptPubKeyLens[0],
+                                                              &vAmounts[0], nInputs, bitcoinconsensus_SCRIPT_FLAGS_VERIFY_P2SH, nThreads, &results[0], &err), 0);
+        BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+        for (unsigned int i = 0; i < nInputs; i++)
+            BOOST_CHECK_EQUAL(results[i], i == 3 ? 0 : 1);
+    }
+
+    // Every input must have its scriptPubKey
+    bitcoinconsensus_error err;
+    BOOST_CHECK_EQUAL(bitcoinconsensus_verify_transaction((const unsigned char*)&stream[0], stream.size(), &vScriptPubKeys[0], &vScriptPubKeyLens[0],
+                                                          NULL, nInputs - 1, 0, 1, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_TX_INDEX);
+
+    vAmounts[5] = -1;
+    BOOST_CHECK_EQUAL(bitcoinconsensus_verify_transaction((const unsigned char*)&stream[0], stream.size(), &vScriptPubKeys[0], &vScriptPubKeyLens[0],
+                                                          &vAmounts[0], nInputs, 0, 1, NULL, &err), 0);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_AMOUNT);
+
+    // Once input 3 is signed properly, everything verifies
+    BOOST_CHECK(SignSignature(keystore, txCredit, txSpend, 3));
+    CDataStream streamGood(SER_NETWORK, PROTOCOL_VERSION);
+    streamGood << txSpend;
+    BOOST_CHECK_EQUAL(bitcoinconsensus_verify_transaction((const unsigned char*)&streamGood[0], streamGood.size(), &vScriptPubKeys[0], &vScriptPubKeyLens[0],
+                                                          NULL, nInputs, bitcoinconsensus_SCRIPT_FLAGS_VERIFY_P2SH, 4, NULL, &err), 1);
+    BOOST_CHECK_EQUAL(err, bitcoinconsensus_ERR_OK);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
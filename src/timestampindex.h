@@ -0,0 +1,68 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TIMESTAMPINDEX_H
+#define BITCOIN_TIMESTAMPINDEX_H
+
+#include "crypto/common.h"
+#include "serialize.h"
+#include "uint256.h"
+
+/** -timestampindex default */
+static const bool DEFAULT_TIMESTAMPINDEX = false;
+
+/**
+ * A block of the active chain by its timestamp. The timestamp is stored big
+ * endian, so that the blocks sort by it; block times are not monotonic, so
+ * the order is not always that of the chain.
+ */
+struct CTimestampIndexKey
+{
+    unsigned int timestamp;
+    uint256 blockHash;
+
+    CTimestampIndexKey() : timestamp(0) {}
+    CTimestampIndexKey(unsigned int timestampIn, const uint256& blockHashIn) : timestamp(timestampIn), blockHash(blockHashIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 4 + 32;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        unsigned char buf[4];
+        WriteBE32(buf, timestamp);
+        s.write((char*)buf, 4);
+        s << blockHash;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        unsigned char buf[4];
+        s.read((char*)buf, 4);
+        timestamp = ReadBE32(buf);
+        s >> blockHash;
+    }
+};
+
+/** Where the blocks from a timestamp on start */
+struct CTimestampIndexIteratorKey
+{
+    unsigned int timestamp;
+
+    explicit CTimestampIndexIteratorKey(unsigned int timestampIn) : timestamp(timestampIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 4;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        unsigned char buf[4];
+        WriteBE32(buf, timestamp);
+        s.write((char*)buf, 4);
+    }
+};
+
+#endif // BITCOIN_TIMESTAMPINDEX_H
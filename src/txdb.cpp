@@ -106,10 +106,8 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
     pcursor->SeekToFirst();
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    stats = CCoinsStats();
     stats.hashBlock = GetBestBlock();
-    ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -124,22 +122,12 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
                 ssValue >> coins;
                 uint256 txhash;
                 ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
                 stats.nTransactions++;
                 for (unsigned int i=0; i<coins.vout.size(); i++) {
                     const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
+                    if (!out.IsNull())
+                        stats.AddOutput(txhash, i, out, coins.nHeight, coins.fCoinBase);
                 }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
             }
             pcursor->Next();
         } catch (std::exception &e) {
@@ -147,8 +135,6 @@ bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
         }
     }
     stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
-    stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
@@ -163,6 +149,182 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadAddressIndex(unsigned char type, const uint160 &hashBytes, std::vector<CAddressIndexEntry> &vEntries, int nStartHeight, int nEndHeight) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, hashBytes, nStartHeight > 0 ? nStartHeight : -1));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'a')
+                break;
+            CAddressIndexKey key;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes)
+                break;
+            if (nEndHeight > 0 && key.blockHeight > nEndHeight)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vEntries.push_back(make_pair(key, nValue));
+            pcursor->Next();
+        } catch (std::exception &e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(unsigned char type, const uint160 &hashBytes, std::vector<CAddressUnspentEntry> &vEntries) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('u', make_pair(type, hashBytes));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 'u')
+                break;
+            CAddressUnspentKey key;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data()+slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            vEntries.push_back(make_pair(key, value));
+            pcursor->Next();
+        } catch (std::exception &e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateAddressIndex(const std::vector<CAddressIndexEntry> &vDeltas, const std::vector<CAddressUnspentEntry> &vCreated, const std::vector<CAddressUnspentEntry> &vSpent) {
+    // Written in order: an output created and spent in the same block ends up erased
+    CLevelDBBatch batch;
+    for (std::vector<CAddressIndexEntry>::const_iterator it = vDeltas.begin(); it != vDeltas.end(); it++)
+        batch.Write(make_pair('a', it->first), it->second);
+    for (std::vector<CAddressUnspentEntry>::const_iterator it = vCreated.begin(); it != vCreated.end(); it++)
+        batch.Write(make_pair('u', it->first), it->second);
+    for (std::vector<CAddressUnspentEntry>::const_iterator it = vSpent.begin(); it != vSpent.end(); it++)
+        batch.Erase(make_pair('u', it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<CAddressIndexEntry> &vDeltas, const std::vector<CAddressUnspentEntry> &vCreated, const std::vector<CAddressUnspentEntry> &vSpent) {
+    CLevelDBBatch batch;
+    for (std::vector<CAddressIndexEntry>::const_iterator it = vDeltas.begin(); it != vDeltas.end(); it++)
+        batch.Erase(make_pair('a', it->first));
+    for (std::vector<CAddressUnspentEntry>::const_iterator it = vSpent.begin(); it != vSpent.end(); it++)
+        batch.Write(make_pair('u', it->first), it->second);
+    for (std::vector<CAddressUnspentEntry>::const_iterator it = vCreated.begin(); it != vCreated.end(); it++)
+        batch.Erase(make_pair('u', it->first));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WriteAddressIndexBackfill(const std::vector<CAddressIndexEntry> &vDeltas, const std::vector<CAddressUnspentEntry> &vUnspent, int nHeight, int nEndHeight) {
+    CLevelDBBatch batch;
+    for (std::vector<CAddressIndexEntry>::const_iterator it = vDeltas.begin(); it != vDeltas.end(); it++)
+        batch.Write(make_pair('a', it->first), it->second);
+    for (std::vector<CAddressUnspentEntry>::const_iterator it = vUnspent.begin(); it != vUnspent.end(); it++)
+        batch.Write(make_pair('u', it->first), it->second);
+    if (nHeight < nEndHeight)
+        batch.Write('A', make_pair(nHeight, nEndHeight));
+    else
+        batch.Erase('A');
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(make_pair('p', key), value);
+}
+
+bool CBlockTreeDB::WriteSpentIndex(const std::vector<CSpentIndexEntry> &vEntries) {
+    CLevelDBBatch batch;
+    for (std::vector<CSpentIndexEntry>::const_iterator it = vEntries.begin(); it != vEntries.end(); it++)
+        batch.Write(make_pair('p', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseSpentIndex(const std::vector<CSpentIndexKey> &vKeys) {
+    CLevelDBBatch batch;
+    for (std::vector<CSpentIndexKey>::const_iterator it = vKeys.begin(); it != vKeys.end(); it++)
+        batch.Erase(make_pair('p', *it));
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256> &vHashes) {
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('s', CTimestampIndexIteratorKey(nLow));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data()+slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 's')
+                break;
+            CTimestampIndexKey key;
+            ssKey >> key;
+            if (key.timestamp >= nHigh)
+                break;
+            vHashes.push_back(key.blockHash);
+            pcursor->Next();
+        } catch (std::exception &e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &key) {
+    return Write(make_pair('s', key), '1');
+}
+
+bool CBlockTreeDB::EraseTimestampIndex(const CTimestampIndexKey &key) {
+    return Erase(make_pair('s', key));
+}
+
+bool CBlockTreeDB::ReadUTXOStats(const uint256 &hashBlock, CCoinsStats &stats) {
+    return Read(make_pair('U', hashBlock), stats);
+}
+
+bool CBlockTreeDB::WriteUTXOStats(const CCoinsStats &stats) {
+    return Write(make_pair('U', stats.hashBlock), stats);
+}
+
+bool CBlockTreeDB::ReadAddressIndexBackfill(int &nHeight, int &nEndHeight) {
+    std::pair<int, int> range;
+    if (!Read('A', range))
+        return false;
+    nHeight = range.first;
+    nEndHeight = range.second;
+    return true;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
 }
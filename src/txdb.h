@@ -6,8 +6,11 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "main.h"
+#include "spentindex.h"
+#include "timestampindex.h"
 
 #include <map>
 #include <string>
@@ -57,6 +60,25 @@ public:
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    bool ReadAddressIndex(unsigned char type, const uint160 &hashBytes, std::vector<CAddressIndexEntry> &vEntries, int nStartHeight = 0, int nEndHeight = 0);
+    bool ReadAddressUnspentIndex(unsigned char type, const uint160 &hashBytes, std::vector<CAddressUnspentEntry> &vEntries);
+    //! Connect a block: record vDeltas and vCreated, and remove vSpent
+    bool UpdateAddressIndex(const std::vector<CAddressIndexEntry> &vDeltas, const std::vector<CAddressUnspentEntry> &vCreated, const std::vector<CAddressUnspentEntry> &vSpent);
+    //! Disconnect a block: the reverse of UpdateAddressIndex()
+    bool EraseAddressIndex(const std::vector<CAddressIndexEntry> &vDeltas, const std::vector<CAddressUnspentEntry> &vCreated, const std::vector<CAddressUnspentEntry> &vSpent);
+    //! Record the entries of an old block, and that the ones from nHeight up to nEndHeight are left
+    bool WriteAddressIndexBackfill(const std::vector<CAddressIndexEntry> &vDeltas, const std::vector<CAddressUnspentEntry> &vUnspent, int nHeight, int nEndHeight);
+    bool ReadAddressIndexBackfill(int &nHeight, int &nEndHeight);
+    bool ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value);
+    bool WriteSpentIndex(const std::vector<CSpentIndexEntry> &vEntries);
+    bool EraseSpentIndex(const std::vector<CSpentIndexKey> &vKeys);
+    //! The blocks with a timestamp from nLow up to, not including, nHigh, in timestamp order
+    bool ReadTimestampIndex(unsigned int nHigh, unsigned int nLow, std::vector<uint256> &vHashes);
+    bool WriteTimestampIndex(const CTimestampIndexKey &key);
+    bool EraseTimestampIndex(const CTimestampIndexKey &key);
+    //! The UTXO set statistics as of block hashBlock, if they were kept when it was connected
+    bool ReadUTXOStats(const uint256 &hashBlock, CCoinsStats &stats);
+    bool WriteUTXOStats(const CCoinsStats &stats);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts();
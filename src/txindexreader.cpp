@@ -0,0 +1,258 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txindexreader.h"
+
+#include "clientversion.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <algorithm>
+#include <ios>
+#include <string.h>
+
+using namespace std;
+
+/** Bytes read ahead by a single lookup, and by one of several */
+static const size_t READ_CHUNK_SIZE = 4 * 1024;
+static const size_t READ_MANY_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Reads a block file through a buffer, which is kept when seeking within
+ * it: transactions close together in a file are read with a single read.
+ */
+class CTxIndexReader::Stream
+{
+private:
+    CTxIndexReader& reader;
+    int nType;
+    int nVersion;
+    int nFile;
+    unsigned int nBufStart; //!< Position in the file of vBuf[0]
+    std::vector<char> vBuf;
+    size_t nBufLen;         //!< Bytes of vBuf read from the file
+    size_t nReadPos;        //!< Offset in vBuf of the next byte to hand out
+
+    void Fill()
+    {
+        nBufStart += nBufLen;
+        nBufLen = 0;
+        nReadPos = 0;
+        nBufLen = reader.ReadFile(nFile, nBufStart, &vBuf[0], vBuf.size());
+        if (nBufLen == 0)
+            throw std::ios_base::failure("CTxIndexReader::Stream::read : end of file");
+    }
+
+public:
+    Stream(CTxIndexReader& readerIn, size_t nChunkSize, int nTypeIn, int nVersionIn) :
+        reader(readerIn), nType(nTypeIn), nVersion(nVersionIn), nFile(-1), nBufStart(0), vBuf(nChunkSize), nBufLen(0), nReadPos(0) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    /** Go on reading at nPos of block file nFileIn */
+    void Seek(int nFileIn, unsigned int nPos)
+    {
+        if (nFileIn == nFile && nPos >= nBufStart && nPos <= nBufStart + nBufLen) {
+            nReadPos = nPos - nBufStart;
+            return;
+        }
+        nFile = nFileIn;
+        nBufStart = nPos;
+        nBufLen = 0;
+        nReadPos = 0;
+    }
+
+    Stream& read(char* pch, size_t nSize)
+    {
+        while (nSize > 0) {
+            if (nReadPos == nBufLen)
+                Fill();
+            size_t n = min(nSize, nBufLen - nReadPos);
+            memcpy(pch, &vBuf[nReadPos], n);
+            pch += n;
+            nSize -= n;
+            nReadPos += n;
+        }
+        return *this;
+    }
+
+    template<typename T>
+    Stream& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return *this;
+    }
+};
+
+CTxIndexReader::CTxIndexReader(unsigned int nMaxOpenFilesIn, unsigned int nMaxCachedTxsIn, unsigned int nMaxCachedBlockHashesIn) :
+    cacheTxs(nMaxCachedTxsIn), cacheBlockHashes(nMaxCachedBlockHashesIn), nGeneration(0), openFiles(nMaxOpenFilesIn)
+{
+}
+
+CTxIndexReader::~CTxIndexReader()
+{
+    CloseFiles();
+}
+
+size_t CTxIndexReader::ReadFile(int nFile, unsigned int nPos, char* pch, size_t nSize)
+{
+    LOCK(cs_files);
+    FILE* file;
+    FILE** pfile = openFiles.get(nFile);
+    if (pfile) {
+        file = *pfile;
+    } else {
+        boost::filesystem::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+        file = fopen(path.string().c_str(), "rb");
+        if (!file)
+            throw std::ios_base::failure("CTxIndexReader::ReadFile : unable to open " + path.string());
+        // Stream buffers instead: stdio's would outlive the bytes of the file appended to since
+        setvbuf(file, NULL, _IONBF, 0);
+        pair<int, FILE*> evicted;
+        if (openFiles.insert(nFile, file, &evicted))
+            fclose(evicted.second);
+    }
+    if (fseek(file, nPos, SEEK_SET))
+        throw std::ios_base::failure("CTxIndexReader::ReadFile : fseek failed");
+    size_t nRead = fread(pch, 1, nSize, file);
+    bool fError = nRead < nSize && ferror(file);
+    clearerr(file);
+    if (fError)
+        throw std::ios_base::failure("CTxIndexReader::ReadFile : fread failed");
+    return nRead;
+}
+
+void CTxIndexReader::CloseFiles()
+{
+    LOCK(cs_files);
+    for (lrucache<int, FILE*>::const_iterator it = openFiles.begin(); it != openFiles.end(); ++it)
+        fclose(it->second);
+    openFiles.clear();
+}
+
+bool CTxIndexReader::GetCached(const uint256& hash, CTransaction& tx, uint256& hashBlock)
+{
+    LOCK(cs);
+    CachedTx* pcached = cacheTxs.get(hash);
+    if (!pcached)
+        return false;
+    tx = pcached->tx;
+    hashBlock = pcached->hashBlock;
+    return true;
+}
+
+void CTxIndexReader::Cache(const uint256& hash, const CTransaction& tx, const uint256& hashBlock, uint64_t nGenerationRead)
+{
+    LOCK(cs);
+    if (nGeneration != nGenerationRead)
+        return;
+    CachedTx cached;
+    cached.tx = tx;
+    cached.hashBlock = hashBlock;
+    cacheTxs.insert(hash, cached);
+}
+
+bool CTxIndexReader::ReadAt(Stream& stream, const uint256& hash, const CDiskTxPos& pos, CTransaction& tx, uint256& hashBlock)
+{
+    const pair<int, unsigned int> blockPos(pos.nFile, pos.nPos);
+    try {
+        bool fHashCached = false;
+        {
+            LOCK(cs);
+            uint256* phashBlock = cacheBlockHashes.get(blockPos);
+            if (phashBlock) {
+                hashBlock = *phashBlock;
+                fHashCached = true;
+            }
+        }
+        if (!fHashCached) {
+            CBlockHeader header;
+            stream.Seek(pos.nFile, pos.nPos);
+            stream >> header;
+            hashBlock = header.GetHash();
+            LOCK(cs);
+            cacheBlockHashes.insert(blockPos, hashBlock);
+        }
+        stream.Seek(pos.nFile, pos.nPos + ::GetSerializeSize(CBlockHeader(), SER_DISK, CLIENT_VERSION) + pos.nTxOffset);
+        stream >> tx;
+    } catch (std::exception &e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    if (tx.GetHash() != hash)
+        return error("%s : txid mismatch", __func__);
+    return true;
+}
+
+bool CTxIndexReader::Get(const uint256& hash, CTransaction& tx, uint256& hashBlock)
+{
+    uint64_t nGenerationRead;
+    {
+        LOCK(cs);
+        nGenerationRead = nGeneration;
+    }
+    if (GetCached(hash, tx, hashBlock))
+        return true;
+
+    CDiskTxPos pos;
+    if (!pblocktree->ReadTxIndex(hash, pos))
+        return false;
+    Stream stream(*this, READ_CHUNK_SIZE, SER_DISK, CLIENT_VERSION);
+    if (!ReadAt(stream, hash, pos, tx, hashBlock))
+        return false;
+    Cache(hash, tx, hashBlock, nGenerationRead);
+    return true;
+}
+
+static bool CompareByDiskPos(const pair<CDiskTxPos, unsigned int>& a, const pair<CDiskTxPos, unsigned int>& b)
+{
+    if (a.first.nFile != b.first.nFile)
+        return a.first.nFile < b.first.nFile;
+    if (a.first.nPos != b.first.nPos)
+        return a.first.nPos < b.first.nPos;
+    return a.first.nTxOffset < b.first.nTxOffset;
+}
+
+void CTxIndexReader::GetMany(const vector<uint256>& vHashes, vector<CTransaction>& vtx, vector<uint256>& vHashBlock, vector<bool>& vFound)
+{
+    vtx.assign(vHashes.size(), CTransaction());
+    vHashBlock.assign(vHashes.size(), uint256(0));
+    vFound.assign(vHashes.size(), false);
+
+    uint64_t nGenerationRead;
+    {
+        LOCK(cs);
+        nGenerationRead = nGeneration;
+    }
+    vector<pair<CDiskTxPos, unsigned int> > vPos;
+    for (unsigned int i = 0; i < vHashes.size(); i++) {
+        if (GetCached(vHashes[i], vtx[i], vHashBlock[i])) {
+            vFound[i] = true;
+            continue;
+        }
+        CDiskTxPos pos;
+        if (pblocktree->ReadTxIndex(vHashes[i], pos))
+            vPos.push_back(make_pair(pos, i));
+    }
+
+    sort(vPos.begin(), vPos.end(), CompareByDiskPos);
+    Stream stream(*this, READ_MANY_CHUNK_SIZE, SER_DISK, CLIENT_VERSION);
+    for (unsigned int j = 0; j < vPos.size(); j++) {
+        unsigned int i = vPos[j].second;
+        if (ReadAt(stream, vHashes[i], vPos[j].first, vtx[i], vHashBlock[i])) {
+            vFound[i] = true;
+            Cache(vHashes[i], vtx[i], vHashBlock[i], nGenerationRead);
+        }
+    }
+}
+
+void CTxIndexReader::Forget(const vector<pair<uint256, CDiskTxPos> >& vPos)
+{
+    LOCK(cs);
+    nGeneration++;
+    for (unsigned int i = 0; i < vPos.size(); i++)
+        cacheTxs.erase(vPos[i].first);
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXINDEXREADER_H
+#define BITCOIN_TXINDEXREADER_H
+
+#include "lrucache.h"
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+struct CDiskTxPos;
+
+/** Block files kept open for -txindex lookups */
+static const unsigned int TXINDEX_OPEN_FILES = 16;
+/** Transactions last looked up through -txindex kept decoded */
+static const unsigned int TXINDEX_CACHED_TXS = 10000;
+/** Block hashes kept by position, so that headers are not hashed (with scrypt, say) again */
+static const unsigned int TXINDEX_CACHED_BLOCK_HASHES = 4096;
+
+/**
+ * Reads the transactions -txindex points to. Block files stay open between
+ * lookups, and are read through a buffer of the reader's own rather than
+ * stdio's (which may hold bytes of a file since appended to). Recent
+ * transactions and the hashes of the blocks they are in are cached. Thread
+ * safe.
+ */
+class CTxIndexReader
+{
+public:
+    CTxIndexReader(unsigned int nMaxOpenFilesIn, unsigned int nMaxCachedTxsIn, unsigned int nMaxCachedBlockHashesIn);
+    ~CTxIndexReader();
+
+    /** Look up a transaction in the block files; false if it is not indexed or cannot be read */
+    bool Get(const uint256& hash, CTransaction& tx, uint256& hashBlock);
+
+    /**
+     * Look up several transactions, reading them in block file order. The
+     * results are in the order of vHashes; vFound says which were found.
+     */
+    void GetMany(const std::vector<uint256>& vHashes, std::vector<CTransaction>& vtx, std::vector<uint256>& vHashBlock, std::vector<bool>& vFound);
+
+    /** The index was updated for these transactions: drop what was cached of them */
+    void Forget(const std::vector<std::pair<uint256, CDiskTxPos> >& vPos);
+
+    /** Close the block files kept open */
+    void CloseFiles();
+
+    class Stream;
+
+private:
+    struct CachedTx
+    {
+        CTransaction tx;
+        uint256 hashBlock;
+    };
+
+    CCriticalSection cs;
+    lrucache<uint256, CachedTx> cacheTxs;
+    lrucache<std::pair<int, unsigned int>, uint256> cacheBlockHashes;
+    //! Bumped by Forget(), so that a lookup racing it does not cache what it found
+    uint64_t nGeneration;
+
+    CCriticalSection cs_files;
+    lrucache<int, FILE*> openFiles;
+
+    CTxIndexReader(const CTxIndexReader&);
+    void operator=(const CTxIndexReader&);
+
+    bool GetCached(const uint256& hash, CTransaction& tx, uint256& hashBlock);
+    bool ReadAt(Stream& stream, const uint256& hash, const CDiskTxPos& pos, CTransaction& tx, uint256& hashBlock);
+    void Cache(const uint256& hash, const CTransaction& tx, const uint256& hashBlock, uint64_t nGenerationRead);
+
+    friend class Stream;
+    /** Read up to nSize bytes of block file nFile from nPos on; returns how many were read */
+    size_t ReadFile(int nFile, unsigned int nPos, char* pch, size_t nSize);
+};
+
+#endif // BITCOIN_TXINDEXREADER_H
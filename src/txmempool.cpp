@@ -586,7 +586,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             waitingOnDependants.push_back(&it->second);
         else {
             CValidationState state; CTxUndo undo;
-            assert(CheckInputs(tx, state, mempoolDuplicate, false, 0, false, NULL));
+            assert(CheckInputs(tx, state, mempoolDuplicate, false, 0, false, PrecomputedTransactionData(), NULL));
             UpdateCoins(tx, state, mempoolDuplicate, undo, 1000000);
         }
     }
@@ -600,7 +600,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             stepsSinceLastRemove++;
             assert(stepsSinceLastRemove < waitingOnDependants.size());
         } else {
-            assert(CheckInputs(entry->GetTx(), state, mempoolDuplicate, false, 0, false, NULL));
+            assert(CheckInputs(entry->GetTx(), state, mempoolDuplicate, false, 0, false, PrecomputedTransactionData(), NULL));
             CTxUndo undo;
             UpdateCoins(entry->GetTx(), state, mempoolDuplicate, undo, 1000000);
             stepsSinceLastRemove = 0;
@@ -629,6 +629,30 @@ void CTxMemPool::queryHashes(vector<uint256>& vtxid)
         vtxid.push_back((*mi).first);
 }
 
+void CTxMemPool::queryEntries(vector<CTxMemPoolEntryInfo>& vInfo, unsigned int nCurrentHeight)
+{
+    vInfo.clear();
+
+    LOCK(cs);
+    vInfo.resize(mapTx.size());
+    unsigned int i = 0;
+    for (map<uint256, CTxMemPoolEntry>::const_iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi, ++i) {
+        const CTxMemPoolEntry& e = mi->second;
+        CTxMemPoolEntryInfo& info = vInfo[i];
+        info.hash = mi->first;
+        info.nTxSize = e.GetTxSize();
+        info.nFee = e.GetFee();
+        info.nTime = e.GetTime();
+        info.nHeight = e.GetHeight();
+        info.dStartingPriority = e.GetPriority(e.GetHeight());
+        info.dCurrentPriority = e.GetPriority(nCurrentHeight);
+        BOOST_FOREACH(const CTxIn& txin, e.GetTx().vin) {
+            if (mapTx.count(txin.prevout.hash))
+                info.vDepends.push_back(txin.prevout.hash);
+        }
+    }
+}
+
 bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
 {
     LOCK(cs);
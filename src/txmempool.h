@@ -58,6 +58,19 @@ public:
     unsigned int GetHeight() const { return nHeight; }
 };
 
+/** What getrawmempool reports of a CTxMemPoolEntry, copied out so it can be written without holding CTxMemPool::cs */
+struct CTxMemPoolEntryInfo
+{
+    uint256 hash;
+    size_t nTxSize;
+    CAmount nFee;
+    int64_t nTime;
+    unsigned int nHeight;
+    double dStartingPriority;
+    double dCurrentPriority;
+    std::vector<uint256> vDepends; //!< Parents in the pool, once for each input spending one
+};
+
 class CMinerPolicyEstimator;
 
 /** An inpoint - a combination of a transaction and an index n into its vin */
@@ -119,6 +132,8 @@ public:
                         std::list<CTransaction>& conflicts);
     void clear();
     void queryHashes(std::vector<uint256>& vtxid);
+    //! Copy out the entries, in txid order, with their priority at nCurrentHeight
+    void queryEntries(std::vector<CTxMemPoolEntryInfo>& vInfo, unsigned int nCurrentHeight);
     void pruneSpent(const uint256& hash, CCoins &coins);
     unsigned int GetTransactionsUpdated() const;
     void AddTransactionsUpdated(unsigned int n);
@@ -0,0 +1,151 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "univalue_compat.h"
+
+#include <errno.h>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <stdlib.h>
+
+using namespace std;
+
+const UniValue NullUniValue;
+
+const UniValue& find_value(const UniValue& obj, const string& name)
+{
+    return obj[name];
+}
+
+bool get_bool(const UniValue& val)
+{
+    if (!val.isBool())
+        throw runtime_error("JSON value is not a boolean as expected");
+    return val.getBool();
+}
+
+string get_str(const UniValue& val)
+{
+    if (!val.isStr())
+        throw runtime_error("JSON value is not a string as expected");
+    return val.getValStr();
+}
+
+/** Parse an integer the whole of str is made of, within the range of int64_t */
+static bool ParseInt64(const string& str, int64_t *out)
+{
+    if (str.empty() || isspace(str[0]) || str.find_first_of(".eE") != string::npos)
+        return false;
+    char *endp = NULL;
+    errno = 0;
+    long long n = strtoll(str.c_str(), &endp, 10);
+    if (out) *out = (int64_t)n;
+    return endp && *endp == 0 && errno == 0;
+}
+
+int get_int(const UniValue& val)
+{
+    if (!val.isNum())
+        throw runtime_error("JSON value is not an integer as expected");
+    int64_t n;
+    if (!ParseInt64(val.getValStr(), &n) || n < numeric_limits<int>::min() || n > numeric_limits<int>::max())
+        throw runtime_error("JSON integer out of range");
+    return (int)n;
+}
+
+int64_t get_int64(const UniValue& val)
+{
+    if (!val.isNum())
+        throw runtime_error("JSON value is not an integer as expected");
+    int64_t n;
+    if (!ParseInt64(val.getValStr(), &n))
+        throw runtime_error("JSON integer out of range");
+    return n;
+}
+
+double get_real(const UniValue& val)
+{
+    if (!val.isNum())
+        throw runtime_error("JSON value is not a number as expected");
+    char *endp = NULL;
+    errno = 0;
+    double d = strtod(val.getValStr().c_str(), &endp);
+    if (!endp || *endp != 0 || errno != 0)
+        throw runtime_error("JSON double out of range");
+    return d;
+}
+
+const UniValue& get_obj(const UniValue& val)
+{
+    if (!val.isObject())
+        throw runtime_error("JSON value is not an object as expected");
+    return val;
+}
+
+const UniValue& get_array(const UniValue& val)
+{
+    if (!val.isArray())
+        throw runtime_error("JSON value is not an array as expected");
+    return val;
+}
+
+vector<string> getKeys(const UniValue& obj)
+{
+    if (!obj.isObject())
+        throw runtime_error("JSON value is not an object as expected");
+
+    // UniValue keeps its keys to itself, so they are read back from the
+    // object's JSON: each string before a colon at the top level of it
+    vector<string> vKeys;
+    string strJSON = obj.write();
+    const char* raw = strJSON.c_str();
+    int nDepth = 0;
+    string strToken, strPrev;
+    enum jtokentype tokPrev = JTOK_NONE;
+    while (true) {
+        unsigned int nConsumed;
+        enum jtokentype tok = getJsonToken(strToken, nConsumed, raw);
+        if (tok == JTOK_NONE || tok == JTOK_ERR)
+            break;
+        raw += nConsumed;
+        if (tok == JTOK_OBJ_OPEN || tok == JTOK_ARR_OPEN)
+            nDepth++;
+        else if (tok == JTOK_OBJ_CLOSE || tok == JTOK_ARR_CLOSE)
+            nDepth--;
+        else if (tok == JTOK_COLON && nDepth == 1 && tokPrev == JTOK_STRING)
+            vKeys.push_back(strPrev);
+        tokPrev = tok;
+        strPrev.swap(strToken);
+    }
+    return vKeys;
+}
+
+vector<UniValue> getValues(const UniValue& val)
+{
+    if (!val.isObject() && !val.isArray())
+        throw runtime_error("JSON value is not an object or array as expected");
+    vector<UniValue> vValues;
+    vValues.reserve(val.count());
+    for (unsigned int i = 0; i < val.count(); i++)
+        vValues.push_back(val[i]);
+    return vValues;
+}
+
+UniValue ValueFromBool(bool f)
+{
+    UniValue val;
+    val.setBool(f);
+    return val;
+}
+
+UniValue ValueFromDouble(double d)
+{
+    ostringstream oss;
+    oss << setprecision(16) << d;
+    UniValue val;
+    val.setNumStr(oss.str());
+    return val;
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2016 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UNIVALUE_COMPAT_H
+#define BITCOIN_UNIVALUE_COMPAT_H
+
+#include "univalue/univalue.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * What the RPC code needs of UniValue beyond the vendored library, kept
+ * here so that univalue/ stays as released. The get_* accessors are those
+ * of json_spirit: they throw std::runtime_error on a value of the wrong
+ * type, which the RPC server reports to the caller.
+ */
+
+/** Returned by find_value() for a missing key, and by calls without a result */
+extern const UniValue NullUniValue;
+
+/** The value of key name in obj, or null if it has none or is not an object */
+const UniValue& find_value(const UniValue& obj, const std::string& name);
+
+bool get_bool(const UniValue& val);
+std::string get_str(const UniValue& val);
+int get_int(const UniValue& val);
+int64_t get_int64(const UniValue& val);
+double get_real(const UniValue& val);
+const UniValue& get_obj(const UniValue& val);
+const UniValue& get_array(const UniValue& val);
+
+/** The keys of an object, in order */
+std::vector<std::string> getKeys(const UniValue& obj);
+/** The values of an object or array, in order */
+std::vector<UniValue> getValues(const UniValue& val);
+
+/** A JSON boolean; given a bool, UniValue's constructors make it a number. */
+UniValue ValueFromBool(bool f);
+/** A JSON number with enough digits for val to read back the same. */
+UniValue ValueFromDouble(double val);
+
+#endif // BITCOIN_UNIVALUE_COMPAT_H
@@ -10,18 +10,15 @@
 #include "script/script.h"
 #include "script/standard.h"
 
-#include <boost/foreach.hpp>
-
 using namespace std;
 
-typedef vector<unsigned char> valtype;
-
-unsigned int HaveKeys(const vector<valtype>& pubkeys, const CKeyStore& keystore)
+static unsigned int HaveKeys(const CTemplateMatch& match, const CKeyStore& keystore)
 {
     unsigned int nResult = 0;
-    BOOST_FOREACH(const valtype& pubkey, pubkeys)
+    for (unsigned int i = 0; i < match.nSpans; i++)
     {
-        CKeyID keyID = CPubKey(pubkey).GetID();
+        const CScriptSpan& pubkey = match.spans[i];
+        CKeyID keyID = CPubKey(pubkey.begin, pubkey.begin + pubkey.size).GetID();
         if (keystore.HaveKey(keyID))
             ++nResult;
     }
@@ -36,33 +33,32 @@ isminetype IsMine(const CKeyStore &keystore, const CTxDestination& dest)
 
 isminetype IsMine(const CKeyStore &keystore, const CScript& scriptPubKey)
 {
-    vector<valtype> vSolutions;
-    txnouttype whichType;
-    if (!Solver(scriptPubKey, whichType, vSolutions)) {
+    CTemplateMatch match;
+    if (!MatchTemplate(scriptPubKey, match)) {
         if (keystore.HaveWatchOnly(scriptPubKey))
             return ISMINE_WATCH_ONLY;
         return ISMINE_NO;
     }
 
     CKeyID keyID;
-    switch (whichType)
+    switch (match.type)
     {
     case TX_NONSTANDARD:
     case TX_NULL_DATA:
         break;
     case TX_PUBKEY:
-        keyID = CPubKey(vSolutions[0]).GetID();
+        keyID = CPubKey(match.spans[0].begin, match.spans[0].begin + match.spans[0].size).GetID();
         if (keystore.HaveKey(keyID))
             return ISMINE_SPENDABLE;
         break;
     case TX_PUBKEYHASH:
-        keyID = CKeyID(uint160(vSolutions[0]));
+        keyID = CKeyID(match.spans[0].ToHash160());
         if (keystore.HaveKey(keyID))
             return ISMINE_SPENDABLE;
         break;
     case TX_SCRIPTHASH:
     {
-        CScriptID scriptID = CScriptID(uint160(vSolutions[0]));
+        CScriptID scriptID = CScriptID(match.spans[0].ToHash160());
         CScript subscript;
         if (keystore.GetCScript(scriptID, subscript)) {
             isminetype ret = IsMine(keystore, subscript);
@@ -78,8 +74,7 @@ isminetype IsMine(const CKeyStore &keystore, const CScript& scriptPubKey)
         // partially owned (somebody else has a key that can spend
         // them) enable spend-out-from-under-you attacks, especially
         // in shared-wallet situations.
-        vector<valtype> keys(vSolutions.begin()+1, vSolutions.begin()+vSolutions.size()-1);
-        if (HaveKeys(keys, keystore) == keys.size())
+        if (HaveKeys(match, keystore) == match.nSpans)
             return ISMINE_SPENDABLE;
         break;
     }